@@ -60,6 +60,7 @@ struct c6_vario_type {
 
 void control6_init(void);
 void control6_run(void);
+void control6_wakeup(void);
 
 uint8_t control6_set(const char *varname, struct c6_vario_type value);
 uint8_t control6_get(const char *varname, struct c6_vario_type *value);
@@ -45,6 +45,7 @@ define(`globals_divert', 2)divert(globals_divert)/* C6-DIVERT: globals_divert */
 define(`pin_table_divert', 3)divert(pin_table_divert)/* C6-DIVERT: pin_table_divert */
 define(`ecmd_variable_divert', 4)divert(ecmd_variable_divert)/* C6-DIVERT: ecmd_variable_divert */
 define(`action_divert', 5)divert(action_divert)/* C6-DIVERT: action_divert */
+define(`schedule_divert', 6)divert(schedule_divert)/* C6-DIVERT: schedule_divert */
 define(`init_divert', 9)divert(init_divert)/* C6-DIVERT: init_divert */
 define(`normal_start_divert', 10)divert(normal_start_divert)/* C6-DIVERT: normal_start_divert */
 define(`normal_divert', 11)divert(normal_divert)/* C6-DIVERT: normal_divert */
@@ -31,6 +31,28 @@ const char PROGMEM $1_text[] = "$1";
 divert(ecmd_variable_divert)dnl
 { .name = $1_text, .value = { .type = C6_TYPE_$3, .data.d_$3 = ifelse(`$2', `', `0', `$2') } },
 `#define $1 (c6_ecmd_vars[' ecmd_global_count `].value.data.d_$3)'
+define(`c6_ecmd_hash_'ecmd_global_count, _C6_HASH(0, `$1'))dnl
 define(`ecmd_global_count', incr(ecmd_global_count))dnl
+C6_STATE_NAME(`$1')dnl
 divert(old_divert)')
 
+dnl
+dnl  Hash table for control6_find(), built from the names at CONTROL_END
+dnl
+define(`_C6_FOR', `ifelse(eval($1 < $2), 1, `$3($1)$0(incr($1), $2, `$3')')')
+
+dnl _C6_ORD(char), ASCII code of an identifier character
+define(`_C6_ORD', `ifelse(index(`abcdefghijklmnopqrstuvwxyz', `$1'), -1,
+  `eval(48 + index(`0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\]^_', `$1'))',
+  `eval(97 + index(`abcdefghijklmnopqrstuvwxyz', `$1'))')')
+dnl _C6_HASH(0, name), same as hash = hash * 33 + c in control6_find()
+define(`_C6_HASH', `ifelse(`$2', `', `$1',
+  `$0(eval(($1 * 33 + _C6_ORD(substr(`$2', 0, 1))) & 65535), substr(`$2', 1))')')
+
+define(`_C6_ECMD_CHAIN', `_C6_ECMD_LINK($1, eval(c6_ecmd_hash_$1 % c6_ecmd_buckets))')
+define(`_C6_ECMD_LINK', `dnl
+define(`c6_ecmd_next_$1', ifdef(`c6_ecmd_head_$2', `c6_ecmd_head_$2', 255))dnl
+define(`c6_ecmd_head_$2', $1)')
+define(`_C6_ECMD_HEAD', ` ifdef(`c6_ecmd_head_$1', `c6_ecmd_head_$1', 255),')
+define(`_C6_ECMD_NEXT', ` c6_ecmd_next_$1,')
+
@@ -4,5 +4,5 @@
 
 define(`GLOBAL', `define(`old_divert', divnum)dnl
 divert(globals_divert)ifelse(`$#', 2, `$2', `uint8_t') $1;
-divert(old_divert)')
+divert(old_divert)C6_STATE_NAME(`$1')')
 
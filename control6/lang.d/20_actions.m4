@@ -2,7 +2,8 @@
 # Actions
 ################################
 define(`THREAD', `define(`action_thread_ident', __line__)divert(0)dnl
- {0, {0} },define(`action_thread_$1_idx', action_thread_count)dnl
+ {0, {0}, 0 },define(`action_thread_$1_idx', action_thread_count)dnl
+define(`action_thread_idx', action_thread_count)dnl
 define(`action_thread_count', incr(action_thread_count))dnl
 divert(action_divert)dnl
 
@@ -11,15 +12,15 @@ divert(action_divert)dnl
 static 
 PT_THREAD(action_thread_$1(struct pt *pt)) {
   PT_BEGIN(pt);
-divert(normal_end_divert)
-  if (action_threads[action_thread_$1_idx].started) { THREAD_DO($1) }dnl
+divert(schedule_divert)
+  wake = control6_resume(&action_threads[action_thread_$1_idx], action_thread_$1, wake);dnl
 divert(action_divert)')
 
 define(`INTHREAD', `ifdef(`action_thread_ident', `$1', `$2')')
 define(`DIE', `errprint(`ERROR: $1
 ')m4exit(255)')
 
-define(`THREAD_END', `undefine(`action_thread_ident')divert(action_divert)dnl
+define(`THREAD_END', `undefine(`action_thread_ident')undefine(`action_thread_idx')divert(action_divert)dnl
 dnl PT_WAIT_WHILE(pt, 1);
   PT_RESTART(pt);
   PT_END(pt);		/* mmh, not really nice, since not reached.
@@ -31,20 +32,94 @@ define(`THREAD_DO', `dnl
 action_threads[action_thread_$1_idx].started =
   (PT_SCHEDULE (action_thread_$1(&action_threads[action_thread_$1_idx].pt)));')
 
-define(`THREAD_START',  `action_threads[action_thread_$1_idx].started = 1;')
-define(`THREAD_STOP',  `action_threads[action_thread_$1_idx].started = 0;')
+define(`THREAD_START',  `action_threads[action_thread_$1_idx].started = 1; C6_STATE_CHANGED')
+define(`THREAD_STOP',  `action_threads[action_thread_$1_idx].started = 0; C6_STATE_CHANGED')
 define(`THREAD_WAIT',  `action_threads[action_thread_$1_idx].started = 0;
-PT_WAIT_WHILE(pt, action_threads[action_thread_$1_idx].started == 1);')
-define(`THREAD_RESTART',  `do { action_threads[action_thread_$1_idx].started = 1; 
-  PT_INIT(&action_threads[action_thread_$1_idx].pt); } while(0);')
+_C6_WAIT(`C6_WAKE_STATE', `PT_WAIT_WHILE', `action_threads[action_thread_$1_idx].started == 1');')
+define(`THREAD_RESTART',  `do { action_threads[action_thread_$1_idx].started = 1;
+  action_threads[action_thread_$1_idx].wait = 0;
+  PT_INIT(&action_threads[action_thread_$1_idx].pt); } while(0); C6_STATE_CHANGED')
 divert(action_table_divert)dnl
+/* Sources which wake up a waiting thread */
+#define C6_WAKE_TICK	0x01	/* periodic run, polls all other threads */
+#define C6_WAKE_CLOCK	0x02	/* next second of the uptime */
+#define C6_WAKE_STATE	0x04	/* variables or threads changed */
+#define C6_WAKE_ECMD	0x08	/* variable changed by ECMD */
+
 struct action {
   uint8_t started;
   struct pt pt;
+  uint8_t wait;		/* C6_WAKE_* of the current wait, 0 if polled */
 };
 
+static uint8_t c6_events;
+
+/* Resumes the thread if it waits for one of the sources in wake.  A
+   completed wait raises C6_WAKE_STATE itself; the end of the thread is
+   reported here, a thread may be waiting for it. */
+static uint8_t
+control6_resume(struct action *a, char (*thread)(struct pt *), uint8_t wake)
+{
+  if (!a->started)
+    return wake;
+  if (a->wait ? !(a->wait & wake) : !(wake & C6_WAKE_TICK))
+    return wake;
+
+  a->started = PT_SCHEDULE(thread(&a->pt));
+  if (!a->started) {
+    c6_events |= C6_WAKE_STATE;
+    wake |= C6_WAKE_STATE;
+  }
+  return wake;
+}
+
 define(`THREAD_EXIT', `PT_EXIT (pt);')
 
 define(`THREAD_STARTED', `action_threads[action_thread_$1_idx].started')
 
+define(`C6_STATE_CHANGED', `c6_events |= C6_WAKE_STATE;')
+
 divert(-1)
+################################
+# Wakeup sources
+################################
+dnl A waiting thread is only run again when one of the sources it waits for
+dnl fires, see control6_resume().  WAIT, TIMER_WAIT and THREAD_WAIT register
+dnl them, and so do WAIT_UNTIL and WAIT_WHILE, whose condition may only read
+dnl timers, the clock, (ECMD_)GLOBALs and thread states.  Everything else
+dnl (pins, ADC, network) needs a PT_WAIT_UNTIL, which is polled on every run.
+dnl Finishing a WAIT raises C6_WAKE_STATE, see _C6_WAIT.
+define(`c6_state_names', `\baction_threads\b')
+define(`C6_STATE_NAME', `define(`c6_state_names', defn(`c6_state_names')`\|\b$1\b')')
+
+define(`C6_WAKE_USED', `ifdef(`c6_wake_used', `', `dnl
+define(`old_divert', divnum)dnl
+define(`c6_wake_used')dnl
+divert(globals_divert)static timestamp_t c6_uptime;
+divert(normal_start_divert)dnl
+  if (clock_get_uptime() != c6_uptime) {
+    c6_uptime = clock_get_uptime();
+    wake |= C6_WAKE_CLOCK;
+  }
+divert(old_divert)')')
+
+dnl C6_WAKE_SOURCES(expression) expands to the C6_WAKE_* mask of the sources
+dnl read by the expression, empty if there are others or none at all
+define(`C6_WAKE_SOURCES', `ifelse(regexp(`$1',
+  `^\([] ()[<>=!&|+*/%^~?:.-]\|[0-9][0-9A-Za-z]*\|\.[A-Za-z_][A-Za-z_0-9]*\|\bcurrent_time\b\|\btimers\b\|\bdatetime\b\|'defn(`c6_state_names')`\)*$'),
+  -1, `', `_C6_WAKE_OR(ifelse(regexp(`$1', `\bcurrent_time\b\|\bdatetime\b'), -1, `', `C6_WAKE_CLOCK'),
+  ifelse(regexp(`$1', defn(`c6_state_names')), -1, `', `C6_WAKE_STATE'))')')
+define(`_C6_WAKE_OR', `ifelse(`$1', `', `$2', `$2', `', `$1', `$1 | $2')')
+
+dnl _C6_WAIT(mask, PT_WAIT_UNTIL or PT_WAIT_WHILE, condition), polls if mask
+dnl is empty.  Once the wait is over the thread goes on to change things
+dnl others may wait for, so it raises C6_WAKE_STATE.
+define(`_C6_WAIT', `ifelse(`$1', `', `do { $2(pt, $3); C6_STATE_CHANGED } while(0)', `ifelse(regexp(`$1', `C6_WAKE_CLOCK'), -1, `', `C6_WAKE_USED()')do { dnl
+action_threads[action_thread_idx].wait = $1; $2(pt, $3); dnl
+action_threads[action_thread_idx].wait = 0; C6_STATE_CHANGED } while(0)')')
+
+dnl _C6_WAIT_ON(WAIT_UNTIL or WAIT_WHILE, condition)
+define(`_C6_WAIT_ON', `INTHREAD(`', `DIE(`Can use $1 only in a THREAD')')dnl
+_C6_WAIT(ifelse(C6_WAKE_SOURCES(`$2'), `', `DIE(`$1($2): only timers, the clock, variables and thread states can wake up a THREAD, use PT_$1(pt, ...) to poll')', `C6_WAKE_SOURCES(`$2')'), `PT_$1', `$2')')
+define(`WAIT_UNTIL', `_C6_WAIT_ON(`WAIT_UNTIL', `$1')')
+define(`WAIT_WHILE', `_C6_WAIT_ON(`WAIT_WHILE', `$1')')
@@ -16,8 +16,16 @@ struct c6_option_t {
 
 struct c6_option_t c6_ecmd_vars[] = {
   /* hier alle variablen definieren */
+divert(schedule_divert)dnl
+/* Runs the threads which wait for one of the sources in wake */
+static void control6_schedule(uint8_t wake) {
+  wake |= c6_events;
+  c6_events = 0;
 divert(init_divert)void control6_init(void) {
-divert(normal_start_divert)void control6_run(void) { dnl
+divert(normal_start_divert)void control6_run(void) {
+  uint8_t wake = C6_WAKE_TICK;
+divert(normal_end_divert)
+  control6_schedule(wake);dnl
 divert(normal_divert)')
 define(`CONTROL_END', `divert(control_end_divert)
 }
@@ -26,28 +34,47 @@ define(`CONTROL_END', `divert(control_end_divert)
   header(control6/control6.h)
   init(control6_init)
   timer(1, control6_run())
+  mainloop(control6_wakeup)
 */
 divert(ecmd_variable_divert)dnl
 };
-`uint8_t control6_set(const char *varname, struct c6_vario_type value) {
+define(`c6_ecmd_buckets', ifelse(ecmd_global_count, 0, 1, ecmd_global_count))dnl
+_C6_FOR(0, ecmd_global_count, `_C6_ECMD_CHAIN')dnl
+
+/* Hash chains of c6_ecmd_vars, the buckets are indexed with the
+   hash of the name, see control6_find() */
+static const uint8_t c6_ecmd_head[] PROGMEM = {dnl
+_C6_FOR(0, c6_ecmd_buckets, `_C6_ECMD_HEAD') };
+static const uint8_t c6_ecmd_next[] PROGMEM = {dnl
+_C6_FOR(0, ecmd_global_count, `_C6_ECMD_NEXT') };
+
+`/* Returns the index of the variable, 255 if there is none */
+static uint8_t control6_find(const char *varname) {
+  uint16_t hash = 0;
+  const char *p;
   uint8_t i;
-  for(i = 0;i < ' ecmd_global_count `;i ++) {
-    if (strcmp_P(varname, c6_ecmd_vars[i].name) == 0) {
-      c6_ecmd_vars[i].value = value;
-      return 1;
-    }
-  }
-  return 0;
+
+  for (p = varname; *p; p++)
+    hash = hash * 33 + (uint8_t) *p;
+  i = pgm_read_byte(&c6_ecmd_head[hash % ' c6_ecmd_buckets `]);
+  while (i != 255 && strcmp_P(varname, c6_ecmd_vars[i].name) != 0)
+    i = pgm_read_byte(&c6_ecmd_next[i]);
+  return i;
+}
+uint8_t control6_set(const char *varname, struct c6_vario_type value) {
+  uint8_t i = control6_find(varname);
+  if (i == 255)
+    return 0;
+  c6_ecmd_vars[i].value = value;
+  c6_events |= C6_WAKE_STATE | C6_WAKE_ECMD;
+  return 1;
 }
 uint8_t control6_get(const char *varname, struct c6_vario_type *value) {
-  uint8_t i;
-  for(i = 0;i < ' ecmd_global_count `;i ++) {
-    if (strcmp_P(varname, c6_ecmd_vars[i].name) == 0) {
-      *value = c6_ecmd_vars[i].value;
-      return 1;
-    }
-  }
-  return 0;
+  uint8_t i = control6_find(varname);
+  if (i == 255)
+    return 0;
+  *value = c6_ecmd_vars[i].value;
+  return 1;
 }
 
 #endif  /* C6_ECMD_USED */'
@@ -60,6 +87,15 @@ divert(pin_table_divert)
 divert(init_divert)dnl
 }
 
+divert(schedule_divert)
+}
+
+/* Runs the threads waiting for variables right after an ECMD changed one */
+void control6_wakeup(void) {
+  if (c6_events & C6_WAKE_ECMD)
+    control6_schedule(0);
+}
+
 divert(action_table_divert)
 };
 
@@ -3,7 +3,7 @@
 ################################
 define(`ON', `if (')
 define(`UNLESS', `if (! ')
-define(`DO', `ifelse(`$#', 0, `) {', `THREAD($1)divert(normal_divert)) { THREAD_START($1) }divert(action_divert)')')
+define(`DO', `ifelse(`$#', 0, `) { C6_STATE_CHANGED', `THREAD($1)divert(normal_divert)) { THREAD_START($1) }divert(action_divert)')')
 define(`END', `ifelse(`$#', 0, `}', `THREAD_END($1)}')')
 define(`BETWEEN', `$1 > $2 && $1 < $3')
 define(`NOT', `ifelse(`$#', 0, `!', `! ( $1 )')')
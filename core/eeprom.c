@@ -180,6 +180,11 @@ eeprom_init (void)
   };
   eeprom_save (tanklevel_params, &tanklevel_temp, sizeof(tanklevel_params_t));
 #endif
+
+#ifdef CLOCK_NTP_ADJUST_SUPPORT
+  int32_t clock_freq_temp = 0;
+  eeprom_save (clock_freq, &clock_freq_temp, sizeof(int32_t));
+#endif
   eeprom_update_chksum ();
 }
 
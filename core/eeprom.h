@@ -143,6 +143,10 @@ struct eeprom_config_t
 #ifdef TANKLEVEL_SUPPORT
   tanklevel_params_t tanklevel_params;
 #endif
+
+#ifdef CLOCK_NTP_ADJUST_SUPPORT
+  int32_t clock_freq;
+#endif
   uint8_t crc;
 };
 
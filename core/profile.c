@@ -0,0 +1,173 @@
+/*
+ *
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "config.h"
+#include "core/periodic.h"
+#include "core/profile.h"
+
+#ifdef FREQCOUNT_SUPPORT
+#error "META_PROFILING_SUPPORT needs timer1 as set up by periodic.c"
+#endif
+
+/* Time is read from timer1, which ticks with F_CPU/CLOCK_PRESCALER.
+ * Without CPU clock it restarts every 20ms, so milliticks is taken
+ * into account, with CPU clock it runs through a whole second. Either
+ * way readings repeat once a second. */
+#ifdef CLOCK_CPU_SUPPORT
+#define PROFILE_PERIOD  ((uint16_t) CLOCK_SECONDS)
+#else
+#define PROFILE_PERIOD  ((uint16_t) (HZ * CLOCK_TICKS))
+#endif
+
+static uint16_t loop_start;
+static uint16_t loop_max;
+static uint16_t loop_count;
+static uint16_t loop_rate;
+static uint8_t loop_running;
+
+
+uint16_t
+profile_now(void)
+{
+  uint8_t m;
+  uint16_t c;
+  do
+  {
+    m = *(volatile uint8_t *) &milliticks;
+    c = TC1_COUNTER_CURRENT;
+  }
+  while (m != *(volatile uint8_t *) &milliticks);
+
+#ifdef CLOCK_CPU_SUPPORT
+  return c;
+#else
+  return m * CLOCK_TICKS + c;
+#endif
+}
+
+
+static uint16_t
+profile_elapsed(uint16_t start)
+{
+  uint16_t now = profile_now();
+  if (now < start)
+    now += PROFILE_PERIOD;
+  return now - start;
+}
+
+
+void
+profile_hook(uint8_t id, uint16_t start)
+{
+  uint16_t t = profile_elapsed(start);
+  struct profile_hook_t *hook = &profile_hooks[id];
+
+  hook->calls++;
+  hook->total += t;
+  if (t > hook->max)
+    hook->max = t;
+}
+
+
+void
+profile_loop(void)
+{
+  if (loop_running)
+  {
+    uint16_t t = profile_elapsed(loop_start);
+    if (t > loop_max)
+      loop_max = t;
+  }
+  loop_running = 1;
+  loop_start = profile_now();
+
+  if (loop_count < UINT16_MAX)
+    loop_count++;
+}
+
+
+void
+profile_periodic(void)
+{
+  loop_rate = loop_count;
+  loop_count = 0;
+}
+
+
+void
+profile_reset(void)
+{
+  memset(profile_hooks, 0, profile_hook_count * sizeof(struct profile_hook_t));
+  loop_max = 0;
+  loop_running = 0;
+}
+
+
+uint8_t
+profile_lines(void)
+{
+  return profile_hook_count + 2;
+}
+
+
+void
+profile_format(uint8_t line, char *buf)
+{
+  uint8_t len;
+
+  if (line == 0)
+    len = snprintf_P(buf, PROFILE_LINE_LEN + 1,
+                     PSTR("loops/s %5u  max loop %5u  unit %3u us"),
+                     loop_rate, loop_max,
+                     (uint16_t) (1000000UL / CLOCK_SECONDS));
+  else if (line == 1)
+    len = snprintf_P(buf, PROFILE_LINE_LEN + 1,
+                     PSTR("%-20S %10S %10S %5S"), PSTR("hook"),
+                     PSTR("calls"), PSTR("total"), PSTR("max"));
+  else
+  {
+    struct profile_hook_t hook;
+    line -= 2;
+    /* copy, hooks may run from within the caller */
+    memcpy(&hook, &profile_hooks[line], sizeof(hook));
+    len = snprintf_P(buf, PROFILE_LINE_LEN + 1, PSTR("%-20.20S %10lu %10lu %5u"),
+                     (const char *) pgm_read_word(&profile_names[line]),
+                     hook.calls, hook.total, hook.max);
+  }
+
+  /* pad, so that every line has the same length */
+  if (len > PROFILE_LINE_LEN)
+    len = PROFILE_LINE_LEN;
+  memset(buf + len, ' ', PROFILE_LINE_LEN - len);
+  buf[PROFILE_LINE_LEN] = 0;
+}
+
+/*
+  -- Ethersex META --
+  header(core/profile.h)
+  timer(50, profile_periodic())
+*/
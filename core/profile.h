@@ -0,0 +1,63 @@
+/*
+ *
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+struct profile_hook_t
+{
+  uint32_t calls;
+  uint32_t total;               /* timer counts */
+  uint16_t max;                 /* timer counts */
+};
+
+/* Generated by meta_magic.m4, one entry per mainloop and timer hook. */
+extern struct profile_hook_t profile_hooks[];
+extern const char *const profile_names[] PROGMEM;
+extern const uint8_t profile_hook_count;
+
+/* Every line of the report has this width, not counting the newline. */
+#define PROFILE_LINE_LEN  48
+
+/* Wrap a hook call, used by the generated meta.c. */
+#define PROFILE_HOOK(id, call)                  \
+  do {                                          \
+    uint16_t _profile_start = profile_now ();   \
+    call;                                       \
+    profile_hook (id, _profile_start);          \
+  } while (0)
+
+uint16_t profile_now(void);
+void profile_hook(uint8_t id, uint16_t start);
+void profile_loop(void);
+void profile_periodic(void);
+void profile_reset(void);
+
+/* Number of report lines, and line number LINE formatted to BUF, which
+ * must hold PROFILE_LINE_LEN + 1 bytes. */
+uint8_t profile_lines(void);
+void profile_format(uint8_t line, char *buf);
+
+#endif /* _PROFILE_H */
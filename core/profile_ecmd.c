@@ -0,0 +1,66 @@
+/*
+ *
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#include "config.h"
+#include "core/profile.h"
+#include "protocols/ecmd/ecmd-base.h"
+
+
+int16_t
+parse_cmd_profile(char *cmd, char *output, uint16_t len)
+{
+  /* trick: use bytes on cmd as "connection specific static variables" */
+  if (cmd[0] != ECMD_STATE_MAGIC)
+  {
+    char *arg = cmd;
+    while (*arg == ' ')
+      arg++;
+    if (strcmp_P(arg, PSTR("reset")) == 0)
+    {
+      profile_reset();
+      return ECMD_FINAL_OK;
+    }
+    if (*arg)
+      return ECMD_ERR_PARSE_ERROR;
+
+    cmd[0] = ECMD_STATE_MAGIC;
+    cmd[1] = 0;                 /* line */
+  }
+
+  uint8_t line = cmd[1]++;
+  if (len <= PROFILE_LINE_LEN)
+    return ECMD_ERR_PARSE_ERROR;
+  profile_format(line, output);
+
+  if (line + 1 >= profile_lines())
+    return ECMD_FINAL(PROFILE_LINE_LEN);
+  return ECMD_AGAIN(PROFILE_LINE_LEN);
+}
+
+/*
+  -- Ethersex META --
+  block(Miscelleanous)
+  ecmd_feature(profile, "profile",[reset], Show run times of mainloop and timer hooks or reset them)
+*/
@@ -31,6 +31,26 @@ uint8_t tty_image[LINES * COLS];
 WINDOW tty_mainwin;
 uint8_t tty_ll_y, tty_ll_x;
 
+/* What the display currently shows.  doupdate copies changed cells
+   from tty_image over here, writing them to the display. */
+static uint8_t tty_screen[LINES * COLS];
+
+/* Cells still to compare against the display, reset to the whole
+   screen whenever tty_image changes. */
+static uint16_t tty_pending;
+
+/* Next cell to compare, continued with on the next pass. */
+static uint16_t tty_scan;
+
+/* Clear the display before the next update. */
+static uint8_t tty_clear_pending;
+
+/* Cursor position wanted by a window that isn't leaveok. */
+static uint8_t tty_cur_y, tty_cur_x;
+static uint8_t tty_cur_pending;
+
+#define touch()		(tty_pending = LINES * COLS)
+
 /* The input fifo queue.  Fill it with _getch_queue. */
 static char tty_input_queue[8];
 
@@ -75,6 +95,15 @@ tty_ll_goto (uint8_t y, uint8_t x)
   tty_ll_x = x;
 }
 
+/* Have the cursor placed there once the display is up to date. */
+static void
+tty_cursor (uint8_t y, uint8_t x)
+{
+  tty_cur_y = y;
+  tty_cur_x = x;
+  tty_cur_pending = 1;
+}
+
 inline static void
 tty_ll_put (uint8_t y, uint8_t x, uint8_t ch)
 {
@@ -112,6 +141,68 @@ initscr (void)
   curscr->maxy = LINES - 1;
 
   tty_ll_clear ();
+  memset (tty_image, 32, LINES * COLS);
+  memset (tty_screen, 32, LINES * COLS);
+}
+
+
+/* Write at most CELLS changed cells to the display, continuing where
+   the last call stopped.  Returns 0 once the display is up to date. */
+static uint8_t
+tty_flush (uint16_t cells)
+{
+  if (tty_clear_pending)
+    {
+      /* One clear command is cheaper than overwriting every cell. */
+      tty_ll_clear ();
+      tty_ll_y = 0;
+      tty_ll_x = 0;
+      memset (tty_screen, 32, LINES * COLS);
+      tty_clear_pending = 0;
+      touch ();
+    }
+
+  uint16_t i = tty_scan;
+  for (; tty_pending; tty_pending --)
+    {
+      if (tty_image[i] != tty_screen[i])
+	{
+	  if (cells == 0)
+	    break;
+	  cells --;
+
+	  tty_screen[i] = tty_image[i];
+	  tty_ll_put (i / COLS, i % COLS, tty_image[i]);
+	}
+
+      if (++ i == LINES * COLS)
+	i = 0;
+    }
+  tty_scan = i;
+
+  if (tty_pending)
+    return 1;
+
+  if (tty_cur_pending)
+    {
+      tty_ll_goto (tty_cur_y, tty_cur_x);
+      tty_cur_pending = 0;
+    }
+
+  return 0;
+}
+
+void
+doupdate (void)
+{
+  tty_flush (UINT16_MAX);
+}
+
+void
+tty_update (void)
+{
+  if (tty_pending || tty_clear_pending || tty_cur_pending)
+    tty_flush (TTY_UPDATE_CELLS);
 }
 
 /* Override until end of line, don't care for the cursor. */
@@ -160,7 +251,7 @@ wclear (WINDOW *win)
       /* Yippie, root window, clear it all up ... */
       TTYDEBUG ("clearing root-window.\n");
       memset (tty_image, 32, LINES * COLS);
-      tty_ll_clear ();
+      tty_clear_pending = 1;
       win->y = 0;
       win->x = 0;
 
@@ -182,13 +273,14 @@ wscroll (WINDOW *win, uint8_t lines)
       return;
     }
 
+  /* Move the content in RAM only, the next update rewrites the cells
+     that actually differ. */
   for (uint8_t y = 0; y <= win->maxy - lines; y ++)
     {
       TTYDEBUG_MAP ("wscroll: copying y=%d\n", y);
-      wmove (win, y, 0);
-      for (uint8_t x = 0; x <= win->maxx; x ++)
-	waddch (win, map (win, y + lines, win->x)); /* Copy content. */
+      memmove (&map (win, y, 0), &map (win, y + lines, 0), win->maxx + 1);
     }
+  touch ();
 
   /* Finally position the cursor to the beginning of the first clear
      line and clear till the end. */
@@ -224,7 +316,7 @@ waddch (WINDOW *win, const char ch)
     case '\r':			/* Return */
       win->x = 0;
       if (!win->leaveok)
-	tty_ll_goto (win->y + win->begy, win->x + win->begx);
+	tty_cursor (win->y + win->begy, win->x + win->begx);
       break;
 
     default:			/* Print everything else. */
@@ -233,7 +325,7 @@ waddch (WINDOW *win, const char ch)
       if (map (win, win->y, win->x) != ch)
 	{
 	  map (win, win->y, win->x) = ch;
-	  tty_ll_put (win->y + win->begy, win->x + win->begx, ch);
+	  touch ();
 	}
 
       if (win->x == win->maxx)
@@ -246,10 +338,10 @@ waddch (WINDOW *win, const char ch)
 	    }
 
 	  if (!win->leaveok)
-	    tty_ll_goto (win->y + win->begy, win->begx);
+	    tty_cursor (win->y + win->begy, win->begx);
 	}
       else
-	win->x ++;			/* Now need to tty_ll_goto. */
+	win->x ++;
       break;
     }
 
@@ -281,7 +373,7 @@ wmove (WINDOW *win, uint8_t y, uint8_t x)
   win->x = x;
 
   if (!win->leaveok)
-    tty_ll_goto (y + win->begy, x + win->begx);
+    tty_cursor (y + win->begy, x + win->begx);
 }
 
 void
@@ -383,4 +475,5 @@ _getch_queue (char ch)
   -- Ethersex META --
   header(core/tty/tty.h)
   init(initscr)
+  mainloop(tty_update)
 */
@@ -41,7 +41,8 @@
 # define TTYDEBUG_MAP(a...)
 #endif
 
-/* The (one and only) off-screen image. */
+/* The (one and only) off-screen image.  Printing only changes this
+   image, the display follows from the mainloop (see tty_update). */
 extern uint8_t tty_image[LINES * COLS];
 
 /* Low-level cursor position. */
@@ -118,6 +119,15 @@ void wclrtobot (WINDOW *);
 void wclrtoeol (WINDOW *);
 void wscroll (WINDOW *, uint8_t);
 
+/* Bring the display up to date right away, instead of waiting for
+   tty_update to catch up with at most TTY_UPDATE_CELLS cells per
+   mainloop pass. */
+void doupdate (void);
+void tty_update (void);
+
+#define refresh()		doupdate()
+#define wrefresh(w)		doupdate()
+
 #define clear()			wclear(curscr)
 #define clrtobot()		wclrtobot(curscr)
 #define clrtoeol()		wclrtoeol(curscr)
@@ -19,6 +19,7 @@
  * http://www.gnu.org/copyleft/gpl.html
  */
 
+#define _GNU_SOURCE             /* memmem */
 #include <stdint.h>
 typedef uint32_t vfs_size_t;
 
@@ -71,6 +72,67 @@ crc_calc(uint8_t * data, int len)
 }
 
 
+static uint32_t
+fnv_hash(uint8_t * data, int len)
+{
+  uint32_t h = 2166136261U;
+  int i;
+
+  for (i = 0; i < len; i++)
+  {
+    h ^= data[i];
+    h *= 16777619U;
+  }
+
+  return h;
+}
+
+
+/* Add the file to the directory index of the firmware (if there is one),
+ * keeping it sorted by name.  Later files replace earlier ones of the same
+ * name, just like the flash scan of vfs_inline_open() would find them. */
+static void
+index_add(uint8_t * image, int image_len, struct vfs_inline_dirent_t *ent)
+{
+  struct vfs_inline_index_t hdr;
+  struct vfs_inline_dirent_t *tab;
+  uint8_t *p;
+  int i;
+
+  p = memmem(image, image_len, VFS_INLINE_INDEX_MAGIC,
+             VFS_INLINE_INDEX_MAGIC_LEN);
+  if (p == NULL)
+    return;                     /* built without index */
+
+  memcpy(&hdr, p, sizeof(hdr));
+  tab = (struct vfs_inline_dirent_t *) (p + sizeof(hdr));
+
+  if (hdr.count == VFS_INLINE_INDEX_OVERFLOW)
+    return;
+
+  for (i = 0; i < hdr.count; i++)
+    if (strncmp(tab[i].fn, ent->fn, VFS_INLINE_FNLEN) >= 0)
+      break;
+
+  if (i < hdr.count && strncmp(tab[i].fn, ent->fn, VFS_INLINE_FNLEN) == 0)
+    tab[i] = *ent;
+  else if (hdr.count == hdr.size)
+  {
+    fprintf(stderr, "vfs-concat: Directory index full, "
+            "falling back to flash scan.\n");
+    hdr.count = VFS_INLINE_INDEX_OVERFLOW;
+  }
+  else
+  {
+    memmove(&tab[i + 1], &tab[i], (hdr.count - i) * sizeof(*ent));
+    tab[i] = *ent;
+    hdr.count++;
+  }
+
+  memcpy(p, &hdr, sizeof(hdr));
+}
+
+
 int
 main(int argc, char **argv)
 {
@@ -122,14 +184,6 @@ main(int argc, char **argv)
   fprintf(stderr, "vfs-concat: Lengths: image=%d, file=%d\n",
           image_len, file_len);
 
-  fwrite(buf_image, 1, image_len, stdout);
-
-  while (image_len % pagesz)
-  {
-    putchar(0xFF);
-    image_len++;
-  }
-
   while ((ptr = strchr(argv[3], '/')))
     argv[3] = ptr + 1;
 
@@ -139,6 +193,24 @@ main(int argc, char **argv)
     return 1;
   }
 
+  struct vfs_inline_dirent_t ent;
+  memset(&ent, 0, sizeof(ent));
+  strncpy(ent.fn, argv[3], VFS_INLINE_FNLEN);
+  ent.offset = (image_len + pagesz - 1) / pagesz * pagesz
+    + 1 + sizeof(node);
+  ent.len = file_len;
+  if (file_len >= 2 && buf_file[0] == 0x1f && buf_file[1] == 0x8b)
+    ent.flags |= VFS_INLINE_GZIP;
+  ent.hash = fnv_hash(buf_file, file_len);
+  index_add(buf_image, image_len, &ent);
+
+  fwrite(buf_image, 1, image_len, stdout);
+
+  while (image_len % pagesz)
+  {
+    putchar(0xFF);
+    image_len++;
+  }
 
   putchar(VFS_INLINE_MAGIC);
 
@@ -20,6 +20,7 @@
  */
 
 #include <avr/pgmspace.h>
+#include <string.h>
 #include "core/debug.h"
 #include "core/vfs/vfs.h"
 #ifndef VFS_TEENSY
@@ -54,16 +55,192 @@ const struct vfs_func_t vfs_funcs[] PROGMEM = {
 #endif
 };
 
+/* Fetch a single function pointer of backend TYPE from flash, instead of
+   copying the whole struct vfs_func_t to the stack on every call. */
+#define vfs_func(type, call) \
+  ((__typeof__ (vfs_funcs[0].call)) pgm_read_word (&vfs_funcs[(type)].call))
+
+#ifdef VFS_ROUTING_SUPPORT
+
+/* Backends searched by names without mount prefix, in that order. */
+static uint8_t vfs_order[VFS_LAST];
+static uint8_t vfs_order_len;
+static uint8_t vfs_order_valid;
+
+#if VFS_LOOKUP_CACHE_LEN > 0
+#define VFS_LOOKUP_MISS 0xFF
+
+struct vfs_lookup_t {
+  /* The name is not stored.  It is recognized by two independent
+     hashes and its length, a single hash may collide. */
+  uint32_t hash;
+  uint16_t hash2;
+  uint8_t len;
+  /* Backend the name was found on, or VFS_LOOKUP_MISS. */
+  uint8_t type;
+  /* Seconds until the entry expires, zero marks a free slot. */
+  uint8_t ttl;
+};
+
+static struct vfs_lookup_t vfs_lookup_cache[VFS_LOOKUP_CACHE_LEN];
+static uint8_t vfs_lookup_next;
+#endif
+
+/* Return the backend whose mod_name is the LEN chars starting at NAME,
+   or VFS_LAST if there is none. */
+static uint8_t
+vfs_find_backend (const char *name, uint8_t len)
+{
+  for (uint8_t i = 0; i < VFS_LAST; i ++) {
+    const char *mod_name = vfs_func (i, mod_name);
+    if (strncmp (mod_name, name, len) == 0 && mod_name[len] == 0)
+      return i;
+  }
+
+  return VFS_LAST;
+}
+
+/* Build the default search order from CONF_VFS_SEARCH_ORDER, a list of
+   mod_names separated by blanks or commas.  An empty list searches all
+   backends in table order. */
+static void
+vfs_order_init (void)
+{
+  const char *p = CONF_VFS_SEARCH_ORDER;
+
+  vfs_order_len = 0;
+  while (*p) {
+    const char *end = p;
+    while (*end && *end != ' ' && *end != ',')
+      end ++;
+
+    uint8_t type = vfs_find_backend (p, end - p);
+    if (type != VFS_LAST && memchr (vfs_order, type, vfs_order_len) == NULL)
+      vfs_order[vfs_order_len ++] = type;
+
+    p = *end ? end + 1 : end;
+  }
+
+  if (vfs_order_len == 0)
+    for (; vfs_order_len < VFS_LAST; vfs_order_len ++)
+      vfs_order[vfs_order_len] = vfs_order_len;
+
+  vfs_order_valid = 1;
+}
+
+/* Split off a "mod_name:" mount prefix.  Returns the backend and advances
+   *NAME behind the colon, or returns VFS_LAST and leaves *NAME alone. */
+static uint8_t
+vfs_route (const char **name)
+{
+  const char *colon = strchr (*name, ':');
+  if (colon == NULL)
+    return VFS_LAST;
+
+  uint8_t type = vfs_find_backend (*name, colon - *name);
+  if (type != VFS_LAST)
+    *name = colon + 1;
+
+  return type;
+}
+
+#if VFS_LOOKUP_CACHE_LEN > 0
+/* Fill in the hashes and the length of NAME. */
+static void
+vfs_lookup_key (const char *name, struct vfs_lookup_t *key)
+{
+  uint32_t hash = 2166136261UL;		/* FNV-1a */
+  uint16_t hash2 = 5381;		/* djb2 */
+  uint8_t len = 0;
+
+  for (; *name; name ++, len ++) {
+    hash = (hash ^ (uint8_t) *name) * 16777619UL;
+    hash2 = hash2 * 33 + (uint8_t) *name;
+  }
+
+  key->hash = hash;
+  key->hash2 = hash2;
+  key->len = len;
+}
+
+static struct vfs_lookup_t *
+vfs_lookup_find (const struct vfs_lookup_t *key)
+{
+  for (uint8_t i = 0; i < VFS_LOOKUP_CACHE_LEN; i ++) {
+    struct vfs_lookup_t *entry = &vfs_lookup_cache[i];
+    if (entry->ttl && entry->hash == key->hash
+        && entry->hash2 == key->hash2 && entry->len == key->len)
+      return entry;
+  }
+
+  return NULL;
+}
+
+static void
+vfs_lookup_store (const struct vfs_lookup_t *key, uint8_t type)
+{
+  struct vfs_lookup_t *entry = vfs_lookup_find (key);
+  if (entry == NULL) {
+    entry = &vfs_lookup_cache[vfs_lookup_next];
+    vfs_lookup_next = (vfs_lookup_next + 1) % VFS_LOOKUP_CACHE_LEN;
+  }
+
+  *entry = *key;
+  entry->type = type;
+  entry->ttl = VFS_LOOKUP_CACHE_TTL;
+}
+
+void
+vfs_lookup_flush (void)
+{
+  for (uint8_t i = 0; i < VFS_LOOKUP_CACHE_LEN; i ++)
+    vfs_lookup_cache[i].ttl = 0;
+}
+
+void
+vfs_lookup_periodic (void)
+{
+  for (uint8_t i = 0; i < VFS_LOOKUP_CACHE_LEN; i ++)
+    if (vfs_lookup_cache[i].ttl)
+      vfs_lookup_cache[i].ttl --;
+}
+#endif	/* VFS_LOOKUP_CACHE_LEN > 0 */
+
 struct vfs_file_handle_t *
 vfs_open (const char *filename)
 {
   struct vfs_file_handle_t *fh = NULL;
-  struct vfs_func_t funcs;
 
-  for (uint8_t i = 0; fh == NULL && i < VFS_LAST; i ++) {
-    memcpy_P(&funcs, &vfs_funcs[i], sizeof(struct vfs_func_t));
-    fh = funcs.open (filename);
+  uint8_t type = vfs_route (&filename);
+  if (type != VFS_LAST)
+    return vfs_func (type, open) (filename);
+
+#if VFS_LOOKUP_CACHE_LEN > 0
+  struct vfs_lookup_t key;
+  vfs_lookup_key (filename, &key);
+  struct vfs_lookup_t *entry = vfs_lookup_find (&key);
+  if (entry) {
+    if (entry->type == VFS_LOOKUP_MISS)
+      return NULL;
+
+    fh = vfs_func (entry->type, open) (filename);
+    if (fh)
+      return fh;
+
+    /* Gone from that backend, forget about it and search again. */
+    entry->ttl = 0;
   }
+#endif
+
+  if (!vfs_order_valid)
+    vfs_order_init ();
+
+  for (uint8_t i = 0; fh == NULL && i < vfs_order_len; i ++)
+    fh = vfs_func (vfs_order[i], open) (filename);
+
+#if VFS_LOOKUP_CACHE_LEN > 0
+  vfs_lookup_store (&key, fh ? fh->fh_type : VFS_LOOKUP_MISS);
+#endif
 
   return fh;
 }
@@ -72,34 +249,81 @@ struct vfs_file_handle_t *
 vfs_create (const char *name)
 {
   struct vfs_file_handle_t *fh = NULL;
-  struct vfs_func_t funcs;
+  struct vfs_file_handle_t * (*create) (const char *);
+
+#if VFS_LOOKUP_CACHE_LEN > 0
+  /* The new file may hide a cached miss or shadow a cached hit. */
+  vfs_lookup_flush ();
+#endif
+
+  uint8_t type = vfs_route (&name);
+  if (type != VFS_LAST) {
+    create = vfs_func (type, create);
+    return create ? create (name) : NULL;
+  }
+
+  if (!vfs_order_valid)
+    vfs_order_init ();
+
+  for (uint8_t i = 0; fh == NULL && i < vfs_order_len; i ++) {
+    create = vfs_func (vfs_order[i], create);
+    if (create)
+      fh = create (name);
+  }
+
+  return fh;
+}
+
+#else  /* not VFS_ROUTING_SUPPORT */
+
+struct vfs_file_handle_t *
+vfs_open (const char *filename)
+{
+  struct vfs_file_handle_t *fh = NULL;
+
+  for (uint8_t i = 0; fh == NULL && i < VFS_LAST; i ++)
+    fh = vfs_func (i, open) (filename);
+
+  return fh;
+}
+
+struct vfs_file_handle_t *
+vfs_create (const char *name)
+{
+  struct vfs_file_handle_t *fh = NULL;
+  struct vfs_file_handle_t * (*create) (const char *);
 
   for (uint8_t i = 0; fh == NULL && i < VFS_LAST; i ++) {
-    memcpy_P(&funcs, &vfs_funcs[i], sizeof(struct vfs_func_t));
-    if (funcs.create)
-      fh = funcs.create (name);
+    create = vfs_func (i, create);
+    if (create)
+      fh = create (name);
   }
 
   return fh;
 }
 
+#endif	/* not VFS_ROUTING_SUPPORT */
+
 /* flag: 0=read, 1=write, 2=size */
 vfs_size_t
 vfs_read_write_size(uint8_t flag, struct vfs_file_handle_t *handle, void *buf,
                vfs_size_t length)
 {
-  struct vfs_func_t funcs;
-  memcpy_P(&funcs, &vfs_funcs[handle->fh_type], sizeof(struct vfs_func_t));
-
-  if (flag == 0 && funcs.read)
-      return funcs.read(handle, buf, length);
+  if (flag == 0) {
+    vfs_size_t (*read) (struct vfs_file_handle_t *, void *, vfs_size_t)
+      = vfs_func (handle->fh_type, read);
+    return read ? read(handle, buf, length) : 0;
+  }
 
-  if (flag == 1 && funcs.write)
-    return funcs.write(handle, buf, length);
+  if (flag == 1) {
+    vfs_size_t (*write) (struct vfs_file_handle_t *, void *, vfs_size_t)
+      = vfs_func (handle->fh_type, write);
+    return write ? write(handle, buf, length) : 0;
+  }
 
-  if (flag == 2 && funcs.size)
-    return funcs.size(handle);
-    return 0;
+  vfs_size_t (*size) (struct vfs_file_handle_t *)
+    = vfs_func (handle->fh_type, size);
+  return size ? size(handle) : 0;
 }
 
 /* flag: 0=fseek, 1=truncate, 2=close */
@@ -107,26 +331,42 @@ uint8_t
 vfs_fseek_truncate_close(uint8_t flag, struct vfs_file_handle_t *handle,
                          vfs_size_t length, uint8_t whence)
 {
-  struct vfs_func_t funcs;
-  memcpy_P(&funcs, &vfs_funcs[handle->fh_type], sizeof(struct vfs_func_t));
-
-  if (flag == 0 && funcs.fseek) 
+  if (flag == 0) {
+    uint8_t (*fseek) (struct vfs_file_handle_t *, vfs_size_t, uint8_t)
+      = vfs_func (handle->fh_type, fseek);
     /* handle, offset, whence */
-    return funcs.fseek(handle, length, whence);
+    return fseek ? fseek(handle, length, whence) : 0;
+  }
 
-  if (flag == 1 && funcs.truncate)
-    return funcs.truncate(handle, length);
+  if (flag == 1) {
+    uint8_t (*truncate) (struct vfs_file_handle_t *, vfs_size_t)
+      = vfs_func (handle->fh_type, truncate);
+    return truncate ? truncate(handle, length) : 0;
+  }
 
-  if (flag == 2 && funcs.close)
-    funcs.close(handle);
+  void (*close) (struct vfs_file_handle_t *) = vfs_func (handle->fh_type, close);
+  if (close)
+    close(handle);
 
   return 0;
 }
 
+uint32_t
+vfs_etag (struct vfs_file_handle_t *handle)
+{
+  uint32_t (*etag) (struct vfs_file_handle_t *)
+    = vfs_func (handle->fh_type, etag);
+
+  /* Never fall back to hashing the content, that would read the whole
+     file for every request. */
+  return etag ? etag (handle) : 0;
+}
+
 
 #endif	/* not VFS_TEENSY */
 
 /*
   -- Ethersex META --
   header(core/vfs/vfs.h)
+  ifdef(`conf_VFS_ROUTING', `timer(50, vfs_lookup_periodic())')
 */
@@ -74,6 +74,7 @@ typedef uint32_t vfs_size_t;
 #include "hardware/storage/dataflash/vfs_df.h"
 #include "hardware/storage/sd_reader/vfs_sd.h"
 #include "core/vfs/vfs_inline.h"
+#include "core/vfs/vfs_proc.h"
 #include "hardware/i2c/master/vfs_eeprom.h"
 #include "hardware/i2c/master/vfs_eeprom_raw.h"
 #include "hardware/camera/vfs_dc3840.h"
@@ -88,6 +89,7 @@ struct vfs_file_handle_t {
     vfs_file_handle_df_t df;
     vfs_file_handle_sd_t sd;
     vfs_file_handle_inline_t il;
+    vfs_file_handle_proc_t proc;
     vfs_file_handle_eeprom_t ee;
     vfs_file_handle_eeprom_raw_t ee_raw;
     vfs_file_handle_dc3840_t dc3840;
@@ -129,6 +131,10 @@ struct vfs_func_t {
 
   /* Return the size of the file. */
   vfs_size_t (*size) (struct vfs_file_handle_t *);
+
+  /* Return a tag that changes whenever the file's content changes, or 0
+     if the module can't tell cheaply. */
+  uint32_t (*etag) (struct vfs_file_handle_t *);
 };
 
 extern const struct vfs_func_t vfs_funcs[];
@@ -145,12 +151,29 @@ struct vfs_file_handle_t *vfs_open (const char *filename);
    store for the new file. */
 struct vfs_file_handle_t *vfs_create (const char *name);
 
+/* With VFS_ROUTING_SUPPORT a name may start with "mod_name:", e.g.
+   "sd:index.html", to address that backend only.  Names without prefix
+   search the backends in CONF_VFS_SEARCH_ORDER, and recent results
+   (including misses) are cached.  Backends whose set of files changes
+   behind the VFS' back must call vfs_lookup_flush. */
+#if defined(VFS_ROUTING_SUPPORT) && VFS_LOOKUP_CACHE_LEN > 0
+void vfs_lookup_flush (void);
+void vfs_lookup_periodic (void);
+#else
+#define vfs_lookup_flush()	do { } while (0)
+#define vfs_lookup_periodic()	do { } while (0)
+#endif
+
 uint8_t vfs_fseek_truncate_close(uint8_t flag, struct vfs_file_handle_t *handle,
                          vfs_size_t length, uint8_t whence);
 
 vfs_size_t vfs_read_write_size(uint8_t flag, struct vfs_file_handle_t *handle, 
                                void *buf, vfs_size_t length);
 
+/* Entity tag of the file, i.e. the module's tag or else a hash of the
+   content.  Returns 0 if neither is available. */
+uint32_t vfs_etag (struct vfs_file_handle_t *handle);
+
 #define VFS_FUNC(handle,call)	              \
   ((pgm_read_word(((void *)&(vfs_funcs[(handle)->fh_type].call))))
 
@@ -22,6 +22,7 @@
 #include <avr/pgmspace.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "core/eeprom.h"
 #include "core/vfs/vfs.h"
@@ -33,9 +34,75 @@
 #endif
 
 
+#ifdef VFS_INLINE_INDEX_SUPPORT
+/* size and count of the index header are bytes */
+#if VFS_INLINE_INDEX_LEN > 254
+#error VFS_INLINE_INDEX_LEN must not exceed 254
+#endif
+
+/* Filled in by vfs-concat when the files are embedded. */
+static const struct {
+  struct vfs_inline_index_t h;
+  struct vfs_inline_dirent_t ent[VFS_INLINE_INDEX_LEN];
+} vfs_inline_index PROGMEM = {
+  { VFS_INLINE_INDEX_MAGIC, VFS_INLINE_INDEX_LEN, 0 },
+  { }
+};
+
+/* Binary search for FILENAME in the directory index.  Returns 1 and
+   fills in ENT if found, 0 if not and -1 if there is no usable index. */
+static int8_t
+vfs_inline_lookup (const char *filename, struct vfs_inline_dirent_t *ent)
+{
+  uint8_t count = pgm_read_byte (&vfs_inline_index.h.count);
+  if (count == 0 || count > VFS_INLINE_INDEX_LEN)
+    return -1;
+
+  uint8_t lo = 0, hi = count;
+  while (lo < hi) {
+    uint8_t mid = (lo + hi) / 2;
+    memcpy_P (ent, &vfs_inline_index.ent[mid], sizeof (*ent));
+
+    int cmp = strncmp (ent->fn, filename, VFS_INLINE_FNLEN);
+    if (cmp == 0)
+      return 1;
+    if (cmp < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return 0;
+}
+#endif	/* VFS_INLINE_INDEX_SUPPORT */
+
+static struct vfs_file_handle_t *
+vfs_inline_handle (vfs_size_t offset, uint16_t len)
+{
+  struct vfs_file_handle_t *fh = malloc (sizeof (struct vfs_file_handle_t));
+  if (fh == NULL)
+    return NULL;
+
+  fh->fh_type = VFS_INLINE;
+  fh->u.il.offset = offset;
+  fh->u.il.pos = 0;
+  fh->u.il.len = len;
+  return fh;
+}
+
 struct vfs_file_handle_t *
 vfs_inline_open (const char *filename)
 {
+#ifdef VFS_INLINE_INDEX_SUPPORT
+  struct vfs_inline_dirent_t ent;
+  switch (vfs_inline_lookup (filename, &ent)) {
+  case 1:
+    return vfs_inline_handle (ent.offset, ent.len);
+  case 0:
+    return NULL;		/* File not found. */
+  }
+#endif
+
   vfs_size_t offset = FLASHEND - SPM_PAGESIZE + 1;
   for (; offset; offset -= SPM_PAGESIZE) {
     if (__pgm_read_byte (offset) != VFS_INLINE_MAGIC)
@@ -54,15 +121,8 @@ vfs_inline_open (const char *filename)
       continue;
 
     /* Found file, create a handle. */
-    struct vfs_file_handle_t *fh = malloc (sizeof (struct vfs_file_handle_t));
-    if (fh == NULL)
-      return NULL;
-
-    fh->fh_type = VFS_INLINE;
-    fh->u.il.offset = offset + sizeof (union vfs_inline_node_t) + 1;
-    fh->u.il.pos = 0;
-    fh->u.il.len = node.s.len;
-    return fh;
+    return vfs_inline_handle (offset + sizeof (union vfs_inline_node_t) + 1,
+			      node.s.len);
   }
 
   return NULL;			/* File not found. */
@@ -128,3 +188,19 @@ vfs_inline_size (struct vfs_file_handle_t *fh)
   return fh->u.il.len;
 }
 #endif	/* VFS_TEENSY */
+
+/* The content hash from the directory index, computed at build time.
+   Without index there is no tag. */
+uint32_t
+vfs_inline_etag (struct vfs_file_handle_t *fh)
+{
+#ifdef VFS_INLINE_INDEX_SUPPORT
+  uint8_t count = pgm_read_byte (&vfs_inline_index.h.count);
+  if (count <= VFS_INLINE_INDEX_LEN)
+    for (uint8_t i = 0; i < count; i ++)
+      if (pgm_read_dword (&vfs_inline_index.ent[i].offset) == fh->u.il.offset)
+	return pgm_read_dword (&vfs_inline_index.ent[i].hash);
+#endif
+
+  return 0;
+}
@@ -37,6 +37,28 @@ union vfs_inline_node_t {
   unsigned char raw[0];
 };
 
+/* Directory index, reserved in the firmware and filled in by vfs-concat
+   with one entry per embedded file, sorted by name. */
+#define VFS_INLINE_INDEX_MAGIC "\x23vfsidx\x23"
+#define VFS_INLINE_INDEX_MAGIC_LEN 8
+#define VFS_INLINE_INDEX_OVERFLOW 0xFF	/* too many files, scan the flash */
+
+#define VFS_INLINE_GZIP 0x01
+
+struct __attribute__((__packed__)) vfs_inline_dirent_t {
+  char fn[VFS_INLINE_FNLEN];
+  uint32_t offset;		/* File data in program memory. */
+  uint16_t len;
+  uint8_t flags;
+  uint32_t hash;		/* FNV-1a of the (compressed) content. */
+};
+
+struct __attribute__((__packed__)) vfs_inline_index_t {
+  char magic[VFS_INLINE_INDEX_MAGIC_LEN];
+  uint8_t size;			/* Entries reserved after the header. */
+  uint8_t count;		/* Entries in use. */
+};
+
 typedef struct {
   vfs_size_t offset;		/* Offset in program memory. */
   uint16_t pos;			/* Position in file. */
@@ -49,6 +71,7 @@ void vfs_inline_close (struct vfs_file_handle_t *);
 vfs_size_t vfs_inline_read  (struct vfs_file_handle_t *, void *buf,
 			 vfs_size_t length);
 vfs_size_t vfs_inline_size (struct vfs_file_handle_t *);
+uint32_t vfs_inline_etag (struct vfs_file_handle_t *);
 uint8_t vfs_inline_fseek (struct vfs_file_handle_t *, vfs_size_t offset,
 			  uint8_t whence);
 
@@ -63,6 +86,7 @@ uint8_t vfs_inline_fseek (struct vfs_file_handle_t *, vfs_size_t offset,
     NULL, /* truncate */		\
     NULL, /* create */			\
     vfs_inline_size,			\
+    vfs_inline_etag,			\
   }
 
 #endif	/* VFS_INLINE_H */
@@ -0,0 +1,143 @@
+/*
+ *
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <avr/pgmspace.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/vfs/vfs.h"
+#include "core/profile.h"
+
+struct vfs_proc_file_t {
+  const char *name;
+  uint8_t width;		/* Line length, without newline. */
+  uint8_t (*lines) (void);
+  void (*format) (uint8_t line, char *buf);
+};
+
+static const char vfs_proc_profile[] PROGMEM = "profile";
+
+static const struct vfs_proc_file_t vfs_proc_files[] PROGMEM = {
+  { vfs_proc_profile, PROFILE_LINE_LEN, profile_lines, profile_format },
+};
+
+#define VFS_PROC_FILES (sizeof (vfs_proc_files) / sizeof (vfs_proc_files[0]))
+#define VFS_PROC_WIDTH_MAX PROFILE_LINE_LEN
+
+#define vfs_proc_field(fh, field)					\
+  ((__typeof__ (vfs_proc_files[0].field))				\
+   pgm_read_word (&vfs_proc_files[(fh)->u.proc.file].field))
+
+
+struct vfs_file_handle_t *
+vfs_proc_open (const char *filename)
+{
+  for (uint8_t i = 0; i < VFS_PROC_FILES; i ++) {
+    if (strcmp_P (filename,
+		  (const char *) pgm_read_word (&vfs_proc_files[i].name)))
+      continue;
+
+    struct vfs_file_handle_t *fh = malloc (sizeof (struct vfs_file_handle_t));
+    if (fh == NULL)
+      return NULL;
+
+    fh->fh_type = VFS_PROC;
+    fh->u.proc.file = i;
+    fh->u.proc.pos = 0;
+    return fh;
+  }
+
+  return NULL;			/* File not found. */
+}
+
+void
+vfs_proc_close (struct vfs_file_handle_t *fh)
+{
+  free (fh);
+}
+
+vfs_size_t
+vfs_proc_size (struct vfs_file_handle_t *fh)
+{
+  uint8_t width = pgm_read_byte (&vfs_proc_files[fh->u.proc.file].width);
+  return (vfs_size_t) vfs_proc_field (fh, lines) () * (width + 1);
+}
+
+vfs_size_t
+vfs_proc_read (struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
+{
+  uint8_t width = pgm_read_byte (&vfs_proc_files[fh->u.proc.file].width);
+  vfs_size_t size = vfs_proc_size (fh);
+  vfs_size_t done = 0;
+  char line[VFS_PROC_WIDTH_MAX + 1];
+
+  while (done < length && fh->u.proc.pos < size) {
+    uint8_t n = fh->u.proc.pos / (width + 1);
+    uint8_t col = fh->u.proc.pos % (width + 1);
+
+    vfs_proc_field (fh, format) (n, line);
+    line[width] = '\n';
+
+    uint8_t len = width + 1 - col;
+    if (len > length - done)
+      len = length - done;
+
+    memcpy ((char *) buf + done, line + col, len);
+    done += len;
+    fh->u.proc.pos += len;
+  }
+
+  return done;
+}
+
+uint8_t
+vfs_proc_fseek (struct vfs_file_handle_t *fh, vfs_size_t offset,
+		uint8_t whence)
+{
+  vfs_size_t new_pos;
+  vfs_size_t size = vfs_proc_size (fh);
+
+  switch (whence)
+    {
+    case SEEK_SET:
+      new_pos = offset;
+      break;
+
+    case SEEK_CUR:
+      new_pos = fh->u.proc.pos + offset;
+      break;
+
+    case SEEK_END:
+      new_pos = size + offset;
+      break;
+
+    default:
+      return -1;		/* Invalid argument. */
+    }
+
+  if (new_pos > size)
+    return -1;			/* Beyond end of file. */
+
+  fh->u.proc.pos = new_pos;
+  return 0;
+}
@@ -0,0 +1,57 @@
+/*
+ *
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef VFS_PROC_H
+#define VFS_PROC_H
+
+/* Read-only files generated on the fly.  Every file consists of lines
+   of fixed width, so that any position can be served without
+   rendering what comes before it. */
+
+typedef struct {
+  uint8_t file;
+  vfs_size_t pos;
+} vfs_file_handle_proc_t;
+
+struct vfs_file_handle_t *vfs_proc_open (const char *filename);
+void vfs_proc_close (struct vfs_file_handle_t *);
+vfs_size_t vfs_proc_read  (struct vfs_file_handle_t *, void *buf,
+			   vfs_size_t length);
+uint8_t vfs_proc_fseek (struct vfs_file_handle_t *, vfs_size_t offset,
+			uint8_t whence);
+vfs_size_t vfs_proc_size (struct vfs_file_handle_t *);
+
+
+#define VFS_PROC_FUNCS {		\
+    "proc",				\
+    vfs_proc_open,			\
+    vfs_proc_close,			\
+    vfs_proc_read,			\
+    NULL, /* write */			\
+    vfs_proc_fseek,			\
+    NULL, /* truncate */		\
+    NULL, /* create */			\
+    vfs_proc_size,			\
+    NULL, /* etag */			\
+  }
+
+#endif	/* VFS_PROC_H */
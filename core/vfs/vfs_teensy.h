@@ -41,5 +41,6 @@
 #define vfs_fseek(fh,p,w)   (((w) == SEEK_SET) ? ((fh)->u.il.pos = (p)) : -1)
 #define vfs_size(fh)	((fh)->u.il.len)
 #define vfs_rewind(fh)  ((fh)->u.il.pos = 0)
+#define vfs_etag	vfs_inline_etag
 
 #endif  /* VFS_TEENSY_H */
@@ -35,6 +35,10 @@ dc3840_save_snapshot (void)
 {
   if (dc3840_capture ())
     return;			/* Camera failed to make a picture. */
+#ifdef SER_RAM_DC3840_SUPPORT
+  if (dc3840_fetch_wait ())
+    return;			/* Download to the serial RAM failed. */
+#endif
 
   /* Generate destination directory name, based on current date and hour. */
   clock_datetime_t datetime;
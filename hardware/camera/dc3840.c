@@ -21,10 +21,14 @@
 
 #include <string.h>
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 #include <util/delay.h>
 
 #include "config.h"
 #include "dc3840.h"
+#ifdef SER_RAM_DC3840_SUPPORT
+#include "hardware/serial_ram/23k256/sram_23k256.h"
+#endif
 
 #include "protocols/ecmd/ecmd-base.h"
 
@@ -40,6 +44,9 @@
 /* Length of current image, declared extern in dc3840.h */
 uint16_t dc3840_data_length;
 
+/* Number of open VFS handles, declared extern in dc3840.h */
+uint8_t dc3840_readers;
+
 /* We generate our own usart init module, for our usart port */
 generate_usart_init()
 
@@ -59,6 +66,36 @@ static volatile uint16_t dc3840_capture_start;
 /* How many bytes to capture.  Counted down in RX vector as well. */
 static volatile uint16_t dc3840_capture_len;
 
+#ifdef SER_RAM_DC3840_SUPPORT
+/* Image data is passed from the RX vector to dc3840_fetch_step through
+   this ring, which copies it to the serial RAM.  The RX vector can't
+   access the SPI bus itself, the mainloop might be using it.  At 921600
+   baud the ring fills up in 1.4 ms. */
+#define DC3840_RING_LEN 128
+static volatile uint8_t dc3840_ring[DC3840_RING_LEN];
+static volatile uint8_t dc3840_ring_head;
+static volatile uint8_t dc3840_ring_tail;
+static volatile uint8_t dc3840_ring_on;
+static volatile uint8_t dc3840_ring_overflow;
+
+/* State of the download to the serial RAM */
+enum
+{
+  DC3840_FETCH_IDLE,
+  DC3840_FETCH_HEADER,		/* waiting for the DATA header */
+  DC3840_FETCH_DATA,		/* copying the ring to the serial RAM */
+  DC3840_FETCH_DRAIN,		/* ring overflowed, waiting for the end */
+};
+static uint8_t dc3840_fetch_state;
+
+/* How often the picture is requested again after an overflow */
+#define DC3840_FETCH_RETRIES 3
+static uint8_t dc3840_fetch_retries;
+
+static uint16_t dc3840_fetch_length;
+static uint16_t dc3840_fetch_stored;
+#endif
+
 /* Send one single byte to camera UART. */
 static void noinline dc3840_send_uart (uint8_t byte);
 
@@ -225,6 +262,11 @@ dc3840_init (void)
 uint8_t
 dc3840_capture (void)
 {
+#ifdef SER_RAM_DC3840_SUPPORT
+  if (dc3840_fetch_state != DC3840_FETCH_IDLE)
+    return 1;			/* The camera is still sending. */
+#endif
+
   /* Reset configuration. */
   dc3840_do (DC3840_CMD_RESET, DC3840_RESET_STATES, 0, 0, 0);
 
@@ -248,8 +290,35 @@ dc3840_capture (void)
   dc3840_data_length = 0;
   dc3840_do (DC3840_CMD_SNAPSHOT, 0, 0, 0, 0);
 
+#ifdef SER_RAM_DC3840_SUPPORT
+  /* Download it once, reads are served from the serial RAM. */
+  dc3840_fetch_retries = DC3840_FETCH_RETRIES;
+  return dc3840_fetch ();
+#else
   return 0;			/* Success. */
+#endif
+}
+
+
+#ifdef DC3840_SNAPSHOT_SUPPORT
+/* Take a new picture every DC3840_SNAPSHOT_INTERVAL seconds, unless the
+   current one is being read or downloaded. */
+void
+dc3840_periodic (void)
+{
+  static uint16_t seconds;
+
+  if (++ seconds < DC3840_SNAPSHOT_INTERVAL || dc3840_readers)
+    return;
+#ifdef SER_RAM_DC3840_SUPPORT
+  if (dc3840_fetching ())
+    return;
+#endif
+
+  seconds = 0;
+  dc3840_capture ();
 }
+#endif	/* DC3840_SNAPSHOT_SUPPORT */
 
 
 #ifdef ECMD_PARSER_SUPPORT
@@ -329,6 +398,16 @@ ISR(usart(USART,_RX_vect))
   if (dc3840_reply_ptr < 16)
     dc3840_reply_buf[dc3840_reply_ptr] = temp;
 
+#ifdef SER_RAM_DC3840_SUPPORT
+  else if (dc3840_ring_on)
+    {
+      if ((uint8_t) (dc3840_ring_head - dc3840_ring_tail) < DC3840_RING_LEN)
+	dc3840_ring[dc3840_ring_head ++ & (DC3840_RING_LEN - 1)] = temp;
+      else
+	dc3840_ring_overflow = 1;
+    }
+#endif
+
   else if (dc3840_capture_start)
     dc3840_capture_start --;
 
@@ -342,10 +421,220 @@ ISR(usart(USART,_RX_vect))
 }
 
 
+/* Check the DATA header following the ACK for GET_PICTURE and take the
+   image size from it.  Returns 0 on success. */
+static uint8_t
+dc3840_data_header (void)
+{
+  /* In dc3840_reply_buf we now have:
+     -> ACK for our GET_PICTURE		[00..07]
+     -> DATA header			[08..0F] */
+  if (dc3840_reply_buf[8 + 3] != DC3840_CMD_DATA)
+    {
+      DC3840_DEBUG ("expected DATA reply, found 0x%02x\n",
+		    dc3840_reply_buf[8 + 3]);
+      return 1;
+    }
+
+  if (dc3840_reply_buf[8 + 4] != DC3840_DATA_TYPE_JPEG)
+    {
+      DC3840_DEBUG ("expect JPEG data, found 0x%02x\n",
+		    dc3840_reply_buf[8 + 4]);
+      return 1;
+    }
+
+  dc3840_data_length = (dc3840_reply_buf[8 + 6] << 8)
+    | dc3840_reply_buf[8 + 5];
+  DC3840_DEBUG ("Image size: %u bytes\n", dc3840_data_length);
+  return 0;
+}
+
+
+#ifdef SER_RAM_DC3840_SUPPORT
+/* Request the snapshot for the download to the serial RAM, which
+   dc3840_fetch_step does from the mainloop.  Returns 0 on success. */
+uint8_t
+dc3840_fetch (void)
+{
+  dc3840_ring_on = 0;
+  dc3840_data_length = 0;
+  dc3840_ring_head = 0;
+  dc3840_ring_tail = 0;
+  dc3840_ring_overflow = 0;
+  dc3840_ring_on = 1;
+
+  if (dc3840_send_command (DC3840_CMD_GET_PICTURE,
+			   DC3840_PICT_TYPE_SNAPSHOT, 0, 0, 0))
+    {
+      dc3840_ring_on = 0;
+      dc3840_fetch_state = DC3840_FETCH_IDLE;
+      return 1;
+    }
+
+  dc3840_fetch_state = DC3840_FETCH_HEADER;
+  return 0;
+}
+
+
+/* Bytes received since the last command, read atomically. */
+static uint16_t
+dc3840_received (void)
+{
+  uint16_t received;
+  ATOMIC_BLOCK (ATOMIC_FORCEON)
+    {
+      received = dc3840_reply_ptr;
+    }
+  return received;
+}
+
+
+/* Does one step of the download, i.e. copies at most one chunk of the
+   ring to the serial RAM.  Called in each pass of the mainloop, which
+   has to come round before the ring is full. */
+void
+dc3840_fetch_step (void)
+{
+  uint8_t chunk[DC3840_RING_LEN / 4];
+
+  switch (dc3840_fetch_state)
+    {
+    case DC3840_FETCH_HEADER:
+      if (dc3840_received () < 16)
+	return;
+      if (dc3840_data_header ())
+	break;
+
+      dc3840_fetch_length = dc3840_data_length;
+      dc3840_data_length = 0;
+      if (dc3840_fetch_length > SRAM23K256_DC3840_SIZE)
+	{
+	  DC3840_DEBUG ("Image too large for serial RAM\n");
+	  break;
+	}
+      dc3840_fetch_stored = 0;
+      dc3840_fetch_state = DC3840_FETCH_DATA;
+      return;
+
+    case DC3840_FETCH_DATA:
+      {
+	if (dc3840_ring_overflow)
+	  {
+	    DC3840_DEBUG ("Ring overflow at %u\n", dc3840_fetch_stored);
+	    dc3840_fetch_state = DC3840_FETCH_DRAIN;
+	    return;
+	  }
+
+	/* Copy whole chunks, but don't wait for the last one. */
+	uint8_t avail = dc3840_ring_head - dc3840_ring_tail;
+	uint16_t left = dc3840_fetch_length - dc3840_fetch_stored;
+	if (avail < sizeof (chunk) && avail < left)
+	  return;
+
+	uint8_t n = sizeof (chunk);
+	if (n > left)
+	  n = left;
+	uint8_t tail = dc3840_ring_tail;
+	for (uint8_t i = 0; i < n; i ++)
+	  chunk[i] = dc3840_ring[tail ++ & (DC3840_RING_LEN - 1)];
+	dc3840_ring_tail = tail;
+
+	sram23k256_write (SRAM23K256_DC3840_BASE + dc3840_fetch_stored,
+			  chunk, n);
+	dc3840_fetch_stored += n;
+	if (dc3840_fetch_stored < dc3840_fetch_length)
+	  return;
+
+	dc3840_ring_on = 0;
+	dc3840_data_length = dc3840_fetch_length;
+	dc3840_fetch_state = DC3840_FETCH_IDLE;
+	return;
+      }
+
+    case DC3840_FETCH_DRAIN:
+      /* The camera can't be stopped, request the picture again once it
+	 has sent all of it. */
+      if (dc3840_received () - 16 < dc3840_fetch_length)
+	return;
+      if (dc3840_fetch_retries -- && !dc3840_fetch ())
+	return;
+      break;
+
+    default:
+      return;
+    }
+
+  /* Failed. */
+  dc3840_ring_on = 0;
+  dc3840_fetch_state = DC3840_FETCH_IDLE;
+}
+
+
+/* Gives up the download if the camera didn't send anything since the
+   last call, but hasn't sent the whole image yet.  The rest of a
+   complete image is copied by dc3840_fetch_step without waiting for
+   more, a partial chunk of a truncated one stays in the ring.  Called
+   every 100 ms. */
+void
+dc3840_fetch_timeout (void)
+{
+  static uint16_t last;
+  uint16_t received = dc3840_received ();
+
+  if (dc3840_fetch_state != DC3840_FETCH_IDLE && received == last
+      && (dc3840_fetch_state != DC3840_FETCH_DATA
+	  || received - 16 < dc3840_fetch_length))
+    {
+      DC3840_DEBUG ("Timeout capturing :(, got %u\n", dc3840_fetch_stored);
+      dc3840_ring_on = 0;
+      dc3840_fetch_state = DC3840_FETCH_IDLE;
+    }
+  last = received;
+}
+
+
+uint8_t
+dc3840_fetching (void)
+{
+  return dc3840_fetch_state != DC3840_FETCH_IDLE;
+}
+
+
+/* Finish the download in one go, for callers that need the picture at
+   once.  Returns 0 on success. */
+uint8_t
+dc3840_fetch_wait (void)
+{
+  uint16_t polls = 0;
+
+  while (dc3840_fetch_state != DC3840_FETCH_IDLE)
+    {
+      dc3840_fetch_step ();
+      _delay_us (25);
+      if (++ polls == 4000)	/* about 100 ms */
+	{
+	  polls = 0;
+	  dc3840_fetch_timeout ();
+	  wdt_kick ();
+	}
+    }
+
+  return dc3840_data_length == 0;
+}
+#endif	/* SER_RAM_DC3840_SUPPORT */
+
+
 /* Store LEN bytes of image data to DATA, starting with OFFSET */
 uint8_t
 dc3840_get_data (uint8_t *data, uint16_t offset, uint16_t len)
 {
+#ifdef SER_RAM_DC3840_SUPPORT
+  if ((uint32_t) offset + len > dc3840_data_length)
+    return 1;			/* No image, or not that much. */
+
+  sram23k256_read (SRAM23K256_DC3840_BASE + offset, data, len);
+  return 0;
+#else
   dc3840_capture_ptr = data;
   dc3840_capture_start = offset;
   dc3840_capture_len = len;
@@ -367,26 +656,8 @@ dc3840_get_data (uint8_t *data, uint16_t offset, uint16_t len)
       return 1;
     }
 
-  /* In dc3840_reply_buf we now have:
-     -> ACK for our GET_PICTURE		[00..07]
-     -> DATA header			[08..0F] */
-  if (dc3840_reply_buf[8 + 3] != DC3840_CMD_DATA)
-    {
-      DC3840_DEBUG ("expected DATA reply, found 0x%02x\n",
-		    dc3840_reply_buf[8 + 3]);
-      return 1;
-    }
-
-  if (dc3840_reply_buf[8 + 4] != DC3840_DATA_TYPE_JPEG)
-    {
-      DC3840_DEBUG ("expect JPEG data, found 0x%02x\n",
-		    dc3840_reply_buf[8 + 4]);
-      return 1;
-    }
-
-  dc3840_data_length = (dc3840_reply_buf[8 + 6] << 8)
-    | dc3840_reply_buf[8 + 5];
-  DC3840_DEBUG ("Image size: %u bytes\n", dc3840_data_length);
+  if (dc3840_data_header ())
+    return 1;
 
   /* Wait for data to be captured. */
   uint8_t timeout = 200;
@@ -402,6 +673,7 @@ dc3840_get_data (uint8_t *data, uint16_t offset, uint16_t len)
     }
 
   return 0;
+#endif	/* SER_RAM_DC3840_SUPPORT */
 }
 
 
@@ -409,6 +681,9 @@ dc3840_get_data (uint8_t *data, uint16_t offset, uint16_t len)
   -- Ethersex META --
   header(hardware/camera/dc3840.h)
   init(dc3840_init)
+  ifdef(`conf_DC3840_SNAPSHOT', `timer(50, dc3840_periodic())')
+  ifdef(`conf_SER_RAM_DC3840', `mainloop(dc3840_fetch_step)')
+  ifdef(`conf_SER_RAM_DC3840', `timer(5, dc3840_fetch_timeout())')
   block([[Dc3840_camera|DC3840 mobil camera support]])
   ecmd_feature(dc3840_capture, "dc3840 capture",, Take a picture.  Access 'dc3840' via VFS afterwards.  See [[DC3840 Camera]] for details.)
   ecmd_feature(dc3840_send, "dc3840 send ", A B C D E, Send provided command bytes to the camera.)
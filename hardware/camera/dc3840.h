@@ -86,7 +86,9 @@
 /* Initialize DC3840 communication. */
 void dc3840_init (void);
 
-/* Capture one image.  Return 0 on success. */
+/* Capture one image.  Return 0 on success.  With SER_RAM_DC3840_SUPPORT
+   the download to the serial RAM goes on in the mainloop afterwards, the
+   image length stays 0 until it is complete. */
 uint8_t dc3840_capture (void);
 
 /* The size (in bytes) of the current image.  If known, 0 otherwise. */
@@ -95,6 +97,25 @@ extern uint16_t dc3840_data_length;
 /* Store LEN bytes of image data to DATA, starting with OFFSET */
 uint8_t dc3840_get_data (uint8_t *data, uint16_t offset, uint16_t len);
 
+/* Start the download of the current image to the serial RAM, which
+   dc3840_fetch_step continues in the mainloop.  Return 0 on success. */
+uint8_t dc3840_fetch (void);
+void dc3840_fetch_step (void);
+void dc3840_fetch_timeout (void);
+
+/* Whether a download to the serial RAM is running. */
+uint8_t dc3840_fetching (void);
+
+/* Block until the download is complete.  Return 0 on success. */
+uint8_t dc3840_fetch_wait (void);
+
+/* Periodic snapshots, called every second. */
+void dc3840_periodic (void);
+
+/* Number of VFS handles open on the image, no new snapshot is taken
+   by dc3840_periodic while it isn't 0. */
+extern uint8_t dc3840_readers;
+
 /* (SYSLOG) debugging support */
 #if 1 && defined(SYSLOG_SUPPORT)
 #include "protocols/syslog/syslog.h"
@@ -21,6 +21,7 @@
 
 #include <avr/pgmspace.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "core/vfs/vfs.h"
@@ -36,6 +37,11 @@ vfs_dc3840_open (const char *filename)
   //if (dc3840_capture ())
   //  return NULL;		/* Failed to aquire image. */
 
+#ifdef SER_RAM_DC3840_SUPPORT
+  if (dc3840_fetching ())
+    return NULL;		/* The picture is being downloaded. */
+#endif
+
   /* The camera has taken a picture, create a handle. */
   struct vfs_file_handle_t *fh = malloc (sizeof (struct vfs_file_handle_t));
   if (fh == NULL)
@@ -43,12 +49,14 @@ vfs_dc3840_open (const char *filename)
 
   fh->fh_type = VFS_DC3840;
   fh->u.dc3840.pos = 0;
+  dc3840_readers ++;
   return fh;
 }
 
 void
 vfs_dc3840_close (struct vfs_file_handle_t *fh)
 {
+  dc3840_readers --;
   free (fh);
 }
 
@@ -59,6 +67,7 @@ vfs_dc3840_read (struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
     {				/* We already know the image's total size. */
       uint16_t maxlen = dc3840_data_length - fh->u.dc3840.pos;
       if (length > maxlen) length = maxlen;
+      if (length == 0) return 0;	/* End of image. */
     }
 
   if (dc3840_get_data (buf, fh->u.dc3840.pos, length))
@@ -67,3 +76,25 @@ vfs_dc3840_read (struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
   fh->u.dc3840.pos += length;
   return length;
 }
+
+vfs_size_t
+vfs_dc3840_size (struct vfs_file_handle_t *fh)
+{
+  return dc3840_data_length;
+}
+
+uint8_t
+vfs_dc3840_fseek (struct vfs_file_handle_t *fh, vfs_size_t offset,
+		  uint8_t whence)
+{
+  if (whence == SEEK_CUR)
+    offset += fh->u.dc3840.pos;
+  else if (whence == SEEK_END)
+    offset += dc3840_data_length;
+
+  if (offset > dc3840_data_length)
+    return 1;			/* Behind the image. */
+
+  fh->u.dc3840.pos = offset;
+  return 0;
+}
@@ -44,10 +44,11 @@ uint8_t vfs_dc3840_fseek (struct vfs_file_handle_t *, vfs_size_t offset,
     vfs_dc3840_close,			\
     vfs_dc3840_read,			\
     NULL, /* write */			\
-    NULL, /* fseek */			\
+    vfs_dc3840_fseek,			\
     NULL, /* truncate */		\
     NULL, /* create */			\
-    NULL, /* size */			\
+    vfs_dc3840_size,			\
+    NULL, /* etag */			\
   }
 
 #endif	/* VFS_DC3840_H */
@@ -22,11 +22,15 @@
 */
 
 #include <stdint.h>
+#include <avr/interrupt.h>
 #include <util/delay.h>
 
 #include "config.h"
 #include "core/debug.h"
 #include "core/periodic.h"      /* for HZ */
+#ifdef CLOCK_CPU_SUPPORT
+#include "services/clock/clock.h"
+#endif
 
 #include "dht.h"
 
@@ -87,11 +91,6 @@ Implementation based on
 - https://github.com/adafruit/DHT-sensor-library
 */
 
-/* The packet size is 40bit but each bit consists of low and high state
-so 40 x 2 = 80 transitions. Also we have 2 transistions DHT response
-and 2 transitions which indicates End Of Frame. In total 84 */
-#define MAXTIMINGS 84
-
 /* global variables */
 dht_global_t dht_global;
 
@@ -102,6 +101,131 @@ dht_start(void)
   PIN_CLEAR(DHT);
 }
 
+static void
+dht_convert(const uint8_t *data)
+{
+  int16_t t;
+#if DHT_TYPE == DHT_TYPE_11
+  t = data[2];
+  t *= 10;
+  dht_global.temp = t;
+  t = data[0];
+  t *= 10;
+  dht_global.humid = t;
+#elif DHT_TYPE == DHT_TYPE_22
+  t = data[2] << 8 | data[3];
+  if (t & 0x8000)
+  {
+    t &= ~0x8000;
+    t = -t;
+  }
+  dht_global.temp = t;
+  t = data[0] << 8 | data[1];
+  dht_global.humid = t;
+#endif
+  DHT_DEBUG("t=%d, h=%d%%", dht_global.temp, dht_global.humid);
+}
+
+#ifdef DHT_EDGE_SUPPORT
+/* The ISR timestamps the falling edges with timer1, which runs the
+ * periodic tick at the same time.  The frame is decoded in the mainloop
+ * as soon as it is complete or the capture timed out. */
+#ifndef DHT_VECTOR
+#error DHT_EDGE_SUPPORT needs DHT_USE_INT or DHT_USE_PCINT in the pinning
+#endif
+
+#ifdef FREQCOUNT_SUPPORT
+#define DHT_TIMER_HZ  F_CPU
+#else
+#define DHT_TIMER_HZ  (F_CPU / CLOCK_PRESCALER)
+#endif
+/* counts of timer1 from one wrap to the next.  The CPU clock restarts it
+ * at the start of each second, which it adjusts; a frame and its decoding
+ * take far less than a second, so there's no other wrap in between. */
+#if defined(CLOCK_CPU_SUPPORT)
+#define DHT_TIMER_SPAN (65536UL - clock_second_start())
+#elif defined(FREQCOUNT_SUPPORT)
+#define DHT_TIMER_SPAN 65536UL
+#else
+#define DHT_TIMER_SPAN (F_CPU / CLOCK_PRESCALER / HZ)
+#endif
+/* A zero takes ~54us low and ~24us high, a one ~54us low and ~70us high */
+#define DHT_TIMER_ONE ((uint16_t) (DHT_TIMER_HZ * 100UL / 1000000UL))
+
+/* coarser counts can't tell a zero from a one reliably, this leaves a
+ * F_CPU of 16MHz or the frequency counter, which runs timer1 at F_CPU */
+#if DHT_TIMER_HZ < 62500
+#error DHT_EDGE_SUPPORT needs timer1 to count at least every 16us
+#endif
+
+#ifdef DHT_INT_PIN
+#define dht_int_enable() \
+  do { \
+    _EICRA = (_EICRA & ~DHT_INT_ISCMASK) | DHT_INT_ISC; \
+    _EIMSK |= _BV(DHT_INT_PIN); \
+  } while(0)
+#define dht_int_disable() _EIMSK &= ~_BV(DHT_INT_PIN)
+#endif
+
+static uint16_t dht_falling[DHT_EDGES];
+static volatile uint8_t dht_edges;
+static uint8_t dht_level;
+/* ticks left plus one while capturing, 0 otherwise */
+static uint8_t dht_capture;
+
+ISR(DHT_VECTOR)
+{
+  uint8_t level = PIN_HIGH(DHT);
+  if (level == dht_level)
+    return;                     /* other pin of the same PCINT bank */
+  dht_level = level;
+
+  if (!level && dht_edges < DHT_EDGES)
+    dht_falling[dht_edges++] = TC1_COUNTER_CURRENT;
+}
+
+static void
+dht_read(void)
+{
+  dht_edges = 0;
+  dht_level = 0;
+  dht_int_enable();
+
+  /* release the bus, the sensor responds after 20-40us */
+  PIN_SET(DHT);
+  DDR_CONFIG_IN(DHT);
+
+  /* the frame takes ~5ms, give it at least one full tick */
+  dht_capture = 3;
+}
+
+void
+dht_process(void)
+{
+  if (!dht_capture || (dht_capture > 1 && dht_edges < DHT_EDGES))
+    return;
+
+  dht_int_disable();
+  dht_capture = 0;
+
+  uint8_t data[5];
+  uint8_t result = dht_decode(dht_falling, dht_edges, DHT_TIMER_SPAN,
+                              DHT_TIMER_ONE, data);
+  if (result != DHT_OK)
+  {
+    dht_global.errors++;
+    DHT_DEBUG("read failed, error=%u, edges=%u", result, dht_edges);
+    return;
+  }
+
+  dht_convert(data);
+}
+#else
+/* The packet size is 40bit but each bit consists of low and high state
+so 40 x 2 = 80 transitions. Also we have 2 transistions DHT response
+and 2 transitions which indicates End Of Frame. In total 84 */
+#define MAXTIMINGS 84
+
 static void
 dht_read(void)
 {
@@ -126,6 +250,7 @@ dht_read(void)
       _delay_us(5);
       if (++counter == 20)
       {
+        dht_global.errors++;
         DHT_DEBUG("read timeout, edge=%u", i);
         return;                 /* timeout in conversation */
       }
@@ -147,32 +272,15 @@ dht_read(void)
   if ((j < 40) ||
       (data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF)))
   {
+    dht_global.errors++;
     DHT_DEBUG("read failed, bits=%u, %02X %02X %02X %02X %02X",
               j, data[0], data[1], data[2], data[3], data[4]);
     return;
   }
 
-  int16_t t;
-#if DHT_TYPE == DHT_TYPE_11
-  t = data[2];
-  t *= 10;
-  dht_global.temp = t;
-  t = data[0];
-  t *= 10;
-  dht_global.humid = t;
-#elif DHT_TYPE == DHT_TYPE_22
-  t = data[2] << 8 | data[3];
-  if (t & 0x8000)
-  {
-    t &= ~0x8000;
-    t = -t;
-  }
-  dht_global.temp = t;
-  t = data[0] << 8 | data[1];
-  dht_global.humid = t;
-#endif
-  DHT_DEBUG("t=%d, h=%d%%", dht_global.temp, dht_global.humid);
+  dht_convert(data);
 }
+#endif /* DHT_EDGE_SUPPORT */
 
 void
 dht_init(void)
@@ -185,6 +293,11 @@ dht_init(void)
 void
 dht_periodic(void)
 {
+#ifdef DHT_EDGE_SUPPORT
+  if (dht_capture > 1)
+    dht_capture--;
+#endif
+
   if (dht_global.polling_delay == 0)
   {
     /* read sensor data */
@@ -202,4 +315,5 @@ dht_periodic(void)
   header(hardware/dht/dht.h)
   init(dht_init)
   timer(1,dht_periodic())
+  ifdef(`conf_DHT_EDGE', `mainloop(dht_process)')
 */
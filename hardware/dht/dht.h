@@ -29,16 +29,30 @@
 #define DHT_TYPE_11 11
 #define DHT_TYPE_22 22
 
+/* Falling edges of a frame: response, 40 bits and end of frame */
+#define DHT_EDGES 42
+
+/* Results of dht_decode */
+#define DHT_OK           0
+#define DHT_ERR_EDGES    1      /* no response or incomplete frame */
+#define DHT_ERR_TIMING   2      /* bit period out of range */
+#define DHT_ERR_CHECKSUM 3
+
 typedef struct
 {
   uint16_t polling_delay;
   int16_t temp;
   int16_t humid;
+  uint16_t errors;              /* failed reads */
 } dht_global_t;
 
 extern dht_global_t dht_global;
 
 void dht_init(void);
 void dht_periodic(void);
+void dht_process(void);
+
+uint8_t dht_decode(const uint16_t *falling, uint8_t edges, uint32_t span,
+                   uint16_t one, uint8_t *data);
 
 #endif /* DHT_H */
@@ -0,0 +1,62 @@
+/*
+ * Decode a DHT frame from the timestamps of its edges
+ *
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+
+#include "dht.h"
+
+/* Decodes a frame from the timer timestamps of its falling edges.  The
+ * timer goes through span counts before it wraps: from span - 1 to 0 in
+ * CTC mode, from 0xFFFF to the start of the second when it runs the CPU
+ * clock.  The first edge starts the response of the sensor, every
+ * following one a bit, which is a one if its period (low plus high
+ * time) is longer than one timer counts.  Kept free of hardware access,
+ * so it can be checked against recorded waveforms on the host. */
+uint8_t
+dht_decode(const uint16_t *falling, uint8_t edges, uint32_t span,
+           uint16_t one, uint8_t *data)
+{
+  if (edges != DHT_EDGES)
+    return DHT_ERR_EDGES;
+
+  for (uint8_t i = 0; i < 40; i++)
+  {
+    uint16_t start = falling[i + 1];
+    uint16_t end = falling[i + 2];
+    uint16_t period = end - start;
+    if (end < start)
+      period += span;           /* wrapped after span counts, not 65536 */
+
+    if (period > 2 * one)
+      return DHT_ERR_TIMING;
+
+    data[i / 8] <<= 1;
+    if (period > one)
+      data[i / 8] |= 1;
+  }
+
+  if (data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF))
+    return DHT_ERR_CHECKSUM;
+
+  return DHT_OK;
+}
@@ -22,6 +22,8 @@
 */
 
 #include <stdint.h>
+#include <stdio.h>
+#include <avr/pgmspace.h>
 
 #include "config.h"
 #include "core/util/fixedpoint.h"
@@ -40,9 +42,15 @@ int16_t parse_cmd_dht_humid(char *cmd, char *output, uint16_t len)
   return ECMD_FINAL(itoa_fixedpoint(dht_global.humid,1,output));
 }
 
+int16_t parse_cmd_dht_errors(char *cmd, char *output, uint16_t len)
+{
+  return ECMD_FINAL(snprintf_P(output, len, PSTR("%u"), dht_global.errors));
+}
+
 /*
   -- Ethersex META --
   block([[DHT]])
   ecmd_feature(dht_temp, "dht temp",, Return temperature of DHT sensor)
   ecmd_feature(dht_humid, "dht humid",, Return humidity of DHT sensor)
+  ecmd_feature(dht_errors, "dht errors",, Return number of failed reads of DHT sensor)
 */
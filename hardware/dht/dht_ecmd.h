@@ -28,5 +28,6 @@
 
 int16_t parse_cmd_dht_temp(char *, char *, uint16_t);
 int16_t parse_cmd_dht_humid(char *, char *, uint16_t);
+int16_t parse_cmd_dht_errors(char *, char *, uint16_t);
 
 #endif /* __DHT_ECMD_H */
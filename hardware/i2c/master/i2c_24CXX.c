@@ -22,15 +22,25 @@
 
 #include <avr/io.h>
 #include <util/twi.h>
-        
+#include <string.h>
+
 #include "config.h"
 #include "core/debug.h"
 #include "core/bit-macros.h"
 #include "i2c_master.h"
 #include "i2c_24CXX.h"
+#ifdef SER_RAM_CACHE_EEPROM
+#include "hardware/serial_ram/23k256/sram_cache.h"
+#endif
 
 static uint8_t i2c_24cxx_address;
 
+/* Acknowledge polling of the write cycle, run through the I2C queue.
+ * Only the next access to the EEPROM has to wait for it. */
+static i2c_request_t i2c_24cxx_poll_req;
+static uint16_t i2c_24cxx_polls;
+static uint8_t i2c_24cxx_writing;
+
 void 
 i2c_24CXX_init(void)
 {
@@ -40,98 +50,119 @@ i2c_24CXX_init(void)
   #endif
 }
 
-uint8_t 
-i2c_24CXX_set_addr(uint16_t addr)
+static void
+i2c_24CXX_poll_cb(i2c_request_t *req)
 {
-  uint8_t ret;
-
-  if (! i2c_master_select(i2c_24cxx_address, TW_WRITE)) { ret = 0; goto end; }
-
-  TWDR = HI8(addr);
-  if (i2c_master_transmit() != TW_MT_DATA_ACK) { ret = 0; goto end; }
-  TWDR = LO8(addr);
-  if (i2c_master_transmit() != TW_MT_DATA_ACK) { ret = 0; goto end; } 
+  /* the eeprom doesn't acknowledge its address until it is done */
+  if (req->status != I2C_REQ_DONE && --i2c_24cxx_polls) {
+    i2c_master_enqueue(req);
+    return;
+  }
+#ifdef DEBUG_I2C
+  if (!i2c_24cxx_polls)
+	  debug_printf("NOT WRITTEN!!\r\n");
+#endif
+  i2c_24cxx_writing = 0;
+}
 
-  ret = 1;
-end:
-  return ret;
+static void
+i2c_24CXX_wait(void)
+{
+  while (i2c_24cxx_writing) {
+    i2c_master_wait_idle();
+    i2c_master_process();
+  }
 }
 
-uint8_t 
-i2c_24CXX_read_block(uint16_t addr, uint8_t *ptr, uint8_t len) 
+static uint8_t
+i2c_24CXX_read_direct(uint16_t addr, uint8_t *ptr, uint8_t len)
 {
-  uint8_t ret;
+  uint8_t addrbuf[2] = { HI8(addr), LO8(addr) };
 #ifdef DEBUG_I2C
   debug_printf("read %i bytes at address: %i \r\n", len, addr);
 #endif
 
-  if (!i2c_24CXX_set_addr(addr)) {ret = 0; goto end; }
-
-  /* Do an repeated start condition */
-  if (i2c_master_start() != TW_REP_START) {ret = 0; goto end; }
-
-  /* Send the address again */
-  TWDR = (i2c_24cxx_address << 1) | TW_READ;
-  if(i2c_master_transmit() != TW_MR_SLA_ACK) {ret = 0; goto end; }
-
-  for (ret = 0; ret < ( len - 1) ; ret ++) {
-    /* Recv one byte and ack */
-    if (i2c_master_transmit_with_ack() != TW_MR_DATA_ACK) {goto end; }
-    ptr[ret] = TWDR;
-#ifdef DEBUG_I2C
-    debug_printf("%i ,", ptr[ret]);
-#endif
-  }
-  /* recv one byte and do not ack */
-  if (i2c_master_transmit() != TW_MR_DATA_NACK) {goto end; }
-  ptr[ret++] = TWDR;
-#ifdef DEBUG_I2C
-  debug_printf("%i \r\n", ptr[ret - 1]);
-#endif
-end:
-  i2c_master_stop();
-  return ret;
-
+  i2c_24CXX_wait();
+  if (!i2c_master_transfer(i2c_24cxx_address, addrbuf, 2, ptr, len))
+    return 0;
+  return len;
 }
 
-uint8_t 
-i2c_24CXX_write_block_int(uint16_t addr, uint8_t *ptr, uint8_t len)
+#ifdef SER_RAM_CACHE_EEPROM
+static uint8_t
+i2c_24CXX_read_chunk(uint32_t block, uint16_t offset, uint8_t *data,
+                     uint8_t len)
 {
-  uint8_t ret;
-
-  if (!i2c_24CXX_set_addr(addr)) { ret = 0; goto end; }
+  uint16_t addr = block * SER_RAM_CACHE_BLOCK_SIZE + offset;
+  return i2c_24CXX_read_direct(addr, data, len) == len;
+}
 
-  for (ret = 0; ret < len; ret++) {
-#ifdef DEBUG_I2C
-	  debug_printf("%i ,", ptr[ret]);
-#endif
-	TWDR = ptr[ret];
-    if (i2c_master_transmit() != TW_MT_DATA_ACK) {ret = 0; goto end; }
+/* Write-through of data written to the EEPROM, for the blocks cached */
+static void
+i2c_24CXX_cache_update(uint16_t addr, uint8_t *ptr, uint8_t len)
+{
+  uint16_t done = 0;
+  while (done < len) {
+    uint16_t pos = addr + done;
+    uint16_t offset = pos % SER_RAM_CACHE_BLOCK_SIZE;
+    uint16_t part = SER_RAM_CACHE_BLOCK_SIZE - offset;
+    if (part > len - done)
+      part = len - done;
+    sram_cache_update(SRAM_CACHE_EEPROM, pos / SER_RAM_CACHE_BLOCK_SIZE,
+                      offset, ptr + done, part);
+    done += part;
   }
-#ifdef DEBUG_I2C
-  debug_printf("\r\n");
+}
 #endif
-end:
-  TWCR=((1<<TWEN)|(1<<TWINT)|(1<<TWSTO));     // Stopbedingung senden
-  while (!(TWCR & (1<<TWSTO)));               // warten bis TWI fertig
-
-  /* Here we start to do the polling of the write cycle */
-  uint16_t polls = 500;
-  while (polls--) {
-    if (i2c_master_select(i2c_24cxx_address, TW_WRITE)) {
-      break;
-    }
-  }
 
-#ifdef DEBUG_I2C
-  if (!polls)
-  {
-	  debug_printf("NOT WRITTEN!!\r\n");
+uint8_t 
+i2c_24CXX_read_block(uint16_t addr, uint8_t *ptr, uint8_t len) 
+{
+#ifdef SER_RAM_CACHE_EEPROM
+  /* Blocks not cached yet are read from the EEPROM as a whole. */
+  uint16_t done = 0;
+  while (done < len) {
+    uint16_t pos = addr + done;
+    uint32_t block = pos / SER_RAM_CACHE_BLOCK_SIZE;
+    uint16_t offset = pos % SER_RAM_CACHE_BLOCK_SIZE;
+    uint16_t part = SER_RAM_CACHE_BLOCK_SIZE - offset;
+    if (part > len - done)
+      part = len - done;
+    if (!sram_cache_fetch(SRAM_CACHE_EEPROM, block, i2c_24CXX_read_chunk) ||
+        !sram_cache_read(SRAM_CACHE_EEPROM, block, offset, ptr + done, part))
+      return i2c_24CXX_read_direct(addr, ptr, len);
+    done += part;
   }
+  return len;
+#else
+  return i2c_24CXX_read_direct(addr, ptr, len);
 #endif
+}
 
-  i2c_master_stop();
-  return ret;
+static uint8_t
+i2c_24CXX_write_block_int(uint16_t addr, uint8_t *ptr, uint8_t len)
+{
+  uint8_t buf[CONF_I2C_24CXX_PAGESIZE + 2];
+
+  buf[0] = HI8(addr);
+  buf[1] = LO8(addr);
+  memcpy(buf + 2, ptr, len);
+
+  i2c_24CXX_wait();
+  if (!i2c_master_transfer(i2c_24cxx_address, buf, len + 2, NULL, 0))
+    return 0;
+
+  /* Here we start the polling of the write cycle, it goes on in the
+   * background. */
+  i2c_24cxx_writing = 1;
+  i2c_24cxx_polls = 500;
+  i2c_24cxx_poll_req.address = i2c_24cxx_address;
+  i2c_24cxx_poll_req.wlen = 0;
+  i2c_24cxx_poll_req.rlen = 0;
+  i2c_24cxx_poll_req.callback = i2c_24CXX_poll_cb;
+  i2c_master_enqueue(&i2c_24cxx_poll_req);
+
+  return len;
 }
 
 uint8_t i2c_24CXX_write_block(uint16_t addr, uint8_t *ptr, uint8_t len) {
@@ -153,6 +184,13 @@ uint8_t i2c_24CXX_write_block(uint16_t addr, uint8_t *ptr, uint8_t len) {
 				templen);
 		writelen += templen;
 	} while ((writelen < len) && (ret == writelen));
+#ifdef SER_RAM_CACHE_EEPROM
+	/* after a failed write the EEPROM content is unknown */
+	if (ret == len)
+		i2c_24CXX_cache_update(addr, ptr, len);
+	else
+		sram_cache_invalidate(SRAM_CACHE_EEPROM);
+#endif
 	return ret;
 }
 
@@ -165,32 +203,20 @@ i2c_24CXX_write_byte(uint16_t addr, uint8_t data)
 uint8_t 
 i2c_24CXX_compare_block(uint16_t addr, uint8_t *ptr, uint8_t len) 
 {
-  uint8_t ret;
-
-  if (!i2c_24CXX_set_addr(addr)) {ret = 0; goto end; }
-
-  /* Do an repeated start condition */
-  if (i2c_master_start() != TW_REP_START) {ret = 0; goto end; }
-
-  /* Send the address again */
-  TWDR = (i2c_24cxx_address << 1) | TW_READ;
-  if(i2c_master_transmit() != TW_MR_SLA_ACK) {ret = 0; goto end; }
-
-  for (ret = 0; ret < ( len - 1) ; ret ++) {
-    /* Recv one byte and ack */
-    if (i2c_master_transmit_with_ack() != TW_MR_DATA_ACK) { ret = 0; goto end; }
-    if (ptr[ret] != TWDR) {ret = 0; goto end;}
+  uint8_t buf[16];
+
+  while (len) {
+    uint8_t chunk = len < sizeof(buf) ? len : sizeof(buf);
+    /* verifies the EEPROM itself, not the serial RAM cache */
+    if (i2c_24CXX_read_direct(addr, buf, chunk) != chunk)
+      return 0;
+    if (memcmp(buf, ptr, chunk) != 0)
+      return 0;
+    addr += chunk;
+    ptr += chunk;
+    len -= chunk;
   }
-
-  /* recv one byte and do not ack */
-  if (i2c_master_transmit() != TW_MR_DATA_NACK) {goto end; }
-  if (ptr[ret] != TWDR) {ret = 0; goto end;}
-
-  ret = 1;
-
-end:
-  i2c_master_stop();
-  return ret;
+  return 1;
 }
 
 /*
@@ -26,7 +26,6 @@
 #define I2C_SLA_24CXX 80
 
 void i2c_24CXX_init(void);
-uint8_t i2c_24CXX_set_addr(uint16_t addr);
 
 uint8_t i2c_24CXX_write_byte(uint16_t addr, uint8_t data);
 uint8_t i2c_24CXX_write_block(uint16_t addr, uint8_t *ptr, uint8_t len);
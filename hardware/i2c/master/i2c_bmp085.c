@@ -45,73 +45,33 @@ static struct bmp085_cal cal;
 // MSB is read first, on the atmega with gcc the MSB is last
 uint8_t bmp085_read(uint8_t regaddr, uint8_t bytes, void* buffer)
 {
-    uint8_t ret = 0xff;
-    
-    if (!i2c_master_select(BMP085_ADDRESS, TW_WRITE))
-    {
-#ifdef DEBUG_I2C
-        debug_printf("I2C: i2c_bmp085: error selecting for writing\n");
-#endif
-        goto end;
-    }
+    uint8_t buf[4];
 
-    TWDR = regaddr;
-    
-    if (i2c_master_transmit() != TW_MT_DATA_ACK )
+    if (bytes > sizeof(buf))
+        return 0xff;
+
+    // register address and data are sent as two separate transfers,
+    // not required by datasheet but fixes transmission problems seen in practice
+    if (!i2c_master_transfer(BMP085_ADDRESS, &regaddr, 1, NULL, 0))
     {
 #ifdef DEBUG_I2C
         debug_printf("I2C: i2c_bmp085: error sending register address\n");
 #endif
-        goto end;
+        return 0xff;
     }
 
-    // not required by datasheet but fixes transmission problems seen in practice
-    i2c_master_stop();
-
-    if (!i2c_master_select(BMP085_ADDRESS, TW_READ))
+    if (!i2c_master_transfer(BMP085_ADDRESS, NULL, 0, buf, bytes))
     {
 #ifdef DEBUG_I2C
-        debug_printf("I2C: i2c_bmp085: error selecting for reading\n");
+        debug_printf("I2C: i2c_bmp085: error reading from 0x%.2X\n",regaddr);
 #endif
-        goto end;
+        return 0xff;
     }
 
-    while (bytes-- > 0)
-    {
-        uint8_t res;
-
-        if (bytes > 0)
-        {
-            // more bytes to read
-            res=(i2c_master_transmit_with_ack() != TW_MR_DATA_ACK);
-        }
-        else
-        {
-            // last byte
-            res=(i2c_master_transmit() != TW_MR_DATA_NACK);
-        }
-        
-        if (res)
-        {
-    #ifdef DEBUG_I2C
-            debug_printf("I2C: i2c_bmp085: error reading byte %d\n",bytes);
-    #endif
-            goto end;
-        }
-
-        *((unsigned char*)buffer+bytes)=TWDR;
-
-    #ifdef DEBUG_I2C
-        debug_printf("I2C: i2c_bmp085: read 0x%.2X at addr 0x%.2X\n",TWDR,regaddr++);
-    #endif
-    }
+    for (uint8_t i = 0; i < bytes; i++)
+        *((unsigned char*)buffer+bytes-1-i)=buf[i];
 
-    // success
-    ret = 0;
-    
-end:
-    i2c_master_stop();
-    return ret;
+    return 0;
 }
 
 
@@ -163,48 +123,25 @@ uint8_t bmp085_readCal(uint8_t oss)
 
 uint8_t bmp085_startMeas(bmp085_meas_t type)
 {
-    uint8_t ret = 0xff;
-    uint8_t cmd;
-    
-    if (!i2c_master_select(BMP085_ADDRESS, TW_WRITE))
-    {
-#ifdef DEBUG_I2C
-        debug_printf("I2C: i2c_bmp085: error selecting for writing\n");
-#endif
-        goto end;
-    }
-
-    TWDR = BMP085_CTRL_MEAS_REG;
-    
-    if (i2c_master_transmit() != TW_MT_DATA_ACK )
-    {
-#ifdef DEBUG_I2C
-        debug_printf("I2C: i2c_bmp085: error sending register address\n");
-#endif
-        goto end;
-    }
+    uint8_t buf[2];
 
     // command
-    cmd = (type == BMP085_TEMP ? 0x2E : (0x34 | (cal.oss << 6)));
-    TWDR = cmd;
+    buf[0] = BMP085_CTRL_MEAS_REG;
+    buf[1] = (type == BMP085_TEMP ? 0x2E : (0x34 | (cal.oss << 6)));
 
-    if (i2c_master_transmit() != TW_MT_DATA_ACK )
+    if (!i2c_master_transfer(BMP085_ADDRESS, buf, 2, NULL, 0))
     {
 #ifdef DEBUG_I2C
         debug_printf("I2C: i2c_bmp085: error sending command\n");
 #endif
-        goto end;
+        return 0xff;
     }
 
 #ifdef DEBUG_I2C
-    debug_printf("I2C: i2c_bmp085: written 0x%.2X to control register 0xF4\n",cmd);
+    debug_printf("I2C: i2c_bmp085: written 0x%.2X to control register 0xF4\n",buf[1]);
 #endif
 
-    ret=0;
-
-end:
-    i2c_master_stop();
-    return ret;
+    return 0;
 }
 
 void bmp085_calc(int16_t ut, int32_t up, int16_t *tval, int32_t *pval)
@@ -255,9 +192,112 @@ void bmp085_calc(int16_t ut, int32_t up, int16_t *tval, int32_t *pval)
     return;
 }
 
+/* Background sampling through the I2C queue, driven by a 20ms timer:
+ * once a second a temperature and a pressure conversion are started,
+ * and read out a few ticks later.  The ECMD returns the last sample
+ * instead of waiting for the conversions with _delay_us(). */
+#define BMP085_SAMPLE_PERIOD 50         /* in 20ms ticks */
+
+enum { BMP085_SAMPLE_IDLE, BMP085_SAMPLE_TEMP, BMP085_SAMPLE_PRES };
+
+static i2c_request_t sample_cmd_req;
+static i2c_request_t sample_reg_req;
+static i2c_request_t sample_req;
+static uint8_t sample_cmd[2];
+static uint8_t sample_reg;
+static uint8_t sample_buf[3];
+static uint8_t sample_state;
+static uint8_t sample_ticks;
+static uint8_t sample_valid;
+static int16_t sample_ut;
+static int16_t sample_temp;
+static int32_t sample_press;
+
+static void bmp085_sample_start(bmp085_meas_t type)
+{
+    sample_cmd[0] = BMP085_CTRL_MEAS_REG;
+    sample_cmd[1] = (type == BMP085_TEMP ? 0x2E : (0x34 | (cal.oss << 6)));
+    sample_cmd_req.address = BMP085_ADDRESS;
+    sample_cmd_req.wbuf = sample_cmd;
+    sample_cmd_req.wlen = 2;
+    sample_cmd_req.rlen = 0;
+    sample_cmd_req.callback = NULL;
+    i2c_master_enqueue(&sample_cmd_req);
+
+    sample_state = (type == BMP085_TEMP ? BMP085_SAMPLE_TEMP : BMP085_SAMPLE_PRES);
+    // the first tick may follow right away
+    sample_ticks = get_bmp085_measure_us_delay(type, cal.oss) / 20000 + 2;
+}
+
+static void bmp085_sample_cb(i2c_request_t *req)
+{
+    if (sample_cmd_req.status != I2C_REQ_DONE
+        || sample_reg_req.status != I2C_REQ_DONE
+        || req->status != I2C_REQ_DONE)
+    {
+        sample_valid = 0;
+        sample_state = BMP085_SAMPLE_IDLE;
+        return;
+    }
+
+    if (sample_state == BMP085_SAMPLE_TEMP)
+    {
+        sample_ut = (sample_buf[0] << 8) | sample_buf[1];
+        bmp085_sample_start(BMP085_PRES);
+        return;
+    }
+
+    int32_t up = ((int32_t) sample_buf[0] << 16) | ((uint16_t) sample_buf[1] << 8)
+        | sample_buf[2];
+    bmp085_calc(sample_ut, up >> (8 - cal.oss), &sample_temp, &sample_press);
+    sample_valid = 1;
+    sample_state = BMP085_SAMPLE_IDLE;
+}
+
+/* Register address and read are queued together, so no other transfer
+ * gets in between */
+static void bmp085_sample_read(uint8_t bytes)
+{
+    sample_reg = BMP085_ADC_OUT_START_REG;
+    sample_reg_req.address = BMP085_ADDRESS;
+    sample_reg_req.wbuf = &sample_reg;
+    sample_reg_req.wlen = 1;
+    sample_reg_req.rlen = 0;
+    sample_reg_req.callback = NULL;
+    sample_req.address = BMP085_ADDRESS;
+    sample_req.wlen = 0;
+    sample_req.rbuf = sample_buf;
+    sample_req.rlen = bytes;
+    sample_req.callback = bmp085_sample_cb;
+    i2c_master_enqueue(&sample_reg_req);
+    i2c_master_enqueue(&sample_req);
+}
+
+void bmp085_periodic(void)
+{
+    if (sample_state == BMP085_SAMPLE_IDLE)
+    {
+        if (++sample_ticks < BMP085_SAMPLE_PERIOD)
+            return;
+        sample_ticks = 0;
+        // the calibration is read only once, blocking
+        if (!cal.initialized && bmp085_readCal(I2C_BMP085_OVERSAMPLING) != 0)
+            return;
+        bmp085_sample_start(BMP085_TEMP);
+    }
+    else if (sample_ticks && !--sample_ticks)
+        bmp085_sample_read(sample_state == BMP085_SAMPLE_TEMP ? 2 : 3);
+}
+
 int16_t bmp085_get_temp()
 {
     int16_t ut, tval;
+
+    if (sample_valid)
+        return sample_temp;
+    // don't disturb a conversion of the background sampling
+    if (sample_state != BMP085_SAMPLE_IDLE)
+        return -1;
     
     if (!cal.initialized)
         bmp085_readCal(I2C_BMP085_OVERSAMPLING);
@@ -290,6 +330,11 @@ int32_t bmp085_get_abs_press()
     int16_t ut, tval;
     int32_t up, pval;
 
+    if (sample_valid)
+        return sample_press;
+    if (sample_state != BMP085_SAMPLE_IDLE)
+        return -1;
+
     if (!cal.initialized)
         bmp085_readCal(I2C_BMP085_OVERSAMPLING);
     
@@ -357,12 +402,15 @@ int32_t bmp085_get_pa_pressure_nn(int32_t abs_pa_pressure, int32_t height_cm)
 void bmp085_init(void)
 {
     cal.initialized=0;
+    // take the first sample right away
+    sample_ticks = BMP085_SAMPLE_PERIOD - 1;
 }
 
 /*
  -- Ethersex META --
  header(hardware/i2c/master/i2c_bmp085.h)
  init(bmp085_init)
+ timer(1, bmp085_periodic())
  */
 
 #endif /* I2C_BMP085_SUPPORT */
@@ -61,6 +61,7 @@ uint8_t bmp085_startMeas(bmp085_meas_t type);
 
 void bmp085_calc(int16_t ut, int32_t up, int16_t *tval, int32_t *pval);
 void bmp085_init(void);
+void bmp085_periodic(void);
 
 int16_t bmp085_get_temp();
 int32_t bmp085_get_abs_press();
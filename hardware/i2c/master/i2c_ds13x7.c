@@ -32,53 +32,22 @@
 #include "services/clock/clock.h"
 
 uint8_t i2c_ds13x7_set_block(uint8_t addr, char *data, uint8_t len) {
-     uint8_t ret = 0;
+     uint8_t buf[sizeof(ds13x7_reg_t) + 1];
 
-     uint8_t sreg = SREG; cli();
-     
-     if (!i2c_master_select( I2C_SLA_DS13X7, TW_WRITE)) { ret=1; goto end; }
-     
-     TWDR = addr;
-     if (i2c_master_transmit_with_ack() != TW_MT_DATA_ACK) { ret=2; goto end; }
+     if (len >= sizeof(buf))
+	  return 3;
 
-     for (uint8_t i=0;i<len;i++) {
-	  TWDR = *(data+i);
-	  if (i2c_master_transmit_with_ack() != TW_MT_DATA_ACK) { ret=3; goto end; }
-     }
-     
- end:
-     i2c_master_stop();
-     SREG = sreg; 
-     return ret;
+     buf[0] = addr;
+     memcpy(buf + 1, data, len);
+     if (!i2c_master_transfer(I2C_SLA_DS13X7, buf, len + 1, NULL, 0))
+	  return 1;
+     return 0;
 }
 
 uint8_t i2c_ds13x7_get_block(uint8_t addr, char *data, uint8_t len) {
-     uint8_t ret = 0;
-
-     uint8_t sreg = SREG; cli();
-     
-     if (!i2c_master_select( I2C_SLA_DS13X7, TW_WRITE)) { ret=1; goto end; }
-     
-     TWDR = addr;
-     if (i2c_master_transmit_with_ack() != TW_MT_DATA_ACK) { ret=2; goto end; }
-
-     /* Do an repeated start condition */
-     if (i2c_master_start() != TW_REP_START) {ret = 3; goto end; }
-
-     /* Send the address again */
-     TWDR = (I2C_SLA_DS13X7 << 1) | TW_READ;
-     if(i2c_master_transmit() != TW_MR_SLA_ACK) {ret = 4; goto end; }
-
-     for (uint8_t i=0;i<len;i++) {
-	  if (i2c_master_transmit_with_ack() != TW_MR_DATA_ACK) { ret = 5; goto end; }
-	  *(data+i) = TWDR;
-     }
-     
-     
- end:
-     i2c_master_stop();
-     SREG = sreg; 
-     return ret;
+     if (!i2c_master_transfer(I2C_SLA_DS13X7, &addr, 1, (uint8_t *)data, len))
+	  return 1;
+     return 0;
 }
 
 uint16_t i2c_ds13x7_set(uint8_t reg, uint8_t data) {
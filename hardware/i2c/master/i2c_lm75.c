@@ -23,40 +23,91 @@
  */
 
 #include <avr/io.h>
+#include <stddef.h>
 #include <util/twi.h>
         
 #include "config.h"
 #include "core/debug.h"
 #include "i2c_master.h"
+#include "i2c_lm75.h"
 
 #ifdef I2C_LM75_SUPPORT
 
+#define I2C_LM75_SENSORS 8
+
+/* Background sampling: once a second all eight addresses are read one
+ * after the other through the I2C queue, the ECMD just returns the last
+ * value instead of waiting for the bus. */
+static i2c_request_t lm75_req;
+static uint8_t lm75_buf[2];
+static uint8_t lm75_index;
+static uint8_t lm75_sampled;
+static int16_t lm75_temp[I2C_LM75_SENSORS];
+
+static int16_t
+i2c_lm75_convert(uint8_t *temp)
+{
+  return ( (temp[0] << 8) | (temp[1] & 0x80) ) / 128*5;
+}
+
 int16_t
 i2c_lm75_read_temp(uint8_t address){
   uint8_t temp[2];
-  uint16_t ret;
 
 #ifdef DEBUG_I2C
   debug_printf("I2C: lm75 read\n");
 #endif
-  if (!i2c_master_select(address, TW_READ)) { ret = 0xffff; goto end; }
-
-  if (i2c_master_transmit_with_ack() != TW_MR_DATA_ACK) { ret = 0xffff; goto end; }
-  temp[0] = TWDR;
+  if (!i2c_master_transfer(address, NULL, 0, temp, 2))
+    return 0xffff;
 #ifdef DEBUG_I2C
-  debug_printf("I2C: lm75 read value1: %d\n", temp[0]);
+  debug_printf("I2C: lm75 read value: %d %d\n", temp[0], temp[1]);
 #endif
 
-  if (i2c_master_transmit() != TW_MR_DATA_NACK) { ret = 0xffff; goto end; }
-  temp[1] = (TWDR & 0x80);
-#ifdef DEBUG_I2C
-  debug_printf("I2C: lm75 read value2: %d\n",temp[1]);
-#endif
-	
-  ret = ( (temp[0] << 8) | temp[1] ) / 128*5;
-end:
-  i2c_master_stop();
-  return ret;
+  return i2c_lm75_convert(temp);
+}
+
+static void
+i2c_lm75_sample_cb(i2c_request_t *req)
+{
+  lm75_temp[lm75_index] = req->status == I2C_REQ_DONE
+    ? i2c_lm75_convert(lm75_buf) : (int16_t) 0xffff;
+  lm75_sampled |= _BV(lm75_index);
+
+  if (++lm75_index < I2C_LM75_SENSORS) {
+    req->address = I2C_SLA_LM75 + lm75_index;
+    i2c_master_enqueue(req);
+  }
 }
 
+void
+i2c_lm75_periodic(void)
+{
+  if (i2c_master_busy(&lm75_req))
+    return;
+
+  lm75_index = 0;
+  lm75_req.address = I2C_SLA_LM75;
+  lm75_req.wlen = 0;
+  lm75_req.rbuf = lm75_buf;
+  lm75_req.rlen = sizeof(lm75_buf);
+  lm75_req.callback = i2c_lm75_sample_cb;
+  i2c_master_enqueue(&lm75_req);
+}
+
+/* Last sampled temperature of sensor n (0..7), read directly if there
+ * is no sample yet */
+int16_t
+i2c_lm75_get_temp(uint8_t n)
+{
+  if (!(lm75_sampled & _BV(n)))
+    return i2c_lm75_read_temp(I2C_SLA_LM75 + n);
+  return lm75_temp[n];
+}
+
+/*
+  -- Ethersex META --
+  header(hardware/i2c/master/i2c_lm75.h)
+  timer(50, i2c_lm75_periodic())
+*/
+
 #endif /* I2C_LM75_SUPPORT */
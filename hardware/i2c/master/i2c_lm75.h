@@ -25,8 +25,12 @@
 #ifndef _I2C_LM75_H
 #define _I2C_LM75_H
 
+#include <stdint.h>
+
 #define I2C_SLA_LM75 0x48
 
 int16_t i2c_lm75_read_temp(uint8_t address);
+int16_t i2c_lm75_get_temp(uint8_t n);
+void i2c_lm75_periodic(void);
 
 #endif /* _I2C_LM75_H */
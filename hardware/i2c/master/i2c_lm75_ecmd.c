@@ -39,7 +39,7 @@ parse_cmd_i2c_lm75(char *cmd, char *output, uint16_t len)
     cmd++;
   if (*cmd < '0' || *cmd > '7')
     return ECMD_ERR_PARSE_ERROR;
-  int16_t temp = i2c_lm75_read_temp(I2C_SLA_LM75 + (cmd[0] - '0'));
+  int16_t temp = i2c_lm75_get_temp(cmd[0] - '0');
   if (temp == 0xffff)
     return ECMD_FINAL(snprintf_P(output, len, PSTR("no sensor detected")));
 #ifdef ECMD_MIRROR_REQUEST
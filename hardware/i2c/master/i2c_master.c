@@ -18,12 +18,28 @@
 }}} */
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 #include <util/twi.h>
 
 #include "config.h"
 #include "core/debug.h"
 #include "i2c_master.h"
 
+#ifdef ECMD_SERIAL_I2C_SUPPORT
+#error "I2C master and ECMD via I2C (slave) both need the TWI interrupt"
+#endif
+
+/* requests waiting for (or currently owning) the bus */
+static i2c_request_t *volatile i2c_queue_head;
+static i2c_request_t *i2c_queue_tail;
+
+/* finished requests whose callback has not been called yet */
+static i2c_request_t *volatile i2c_done_head;
+static i2c_request_t *i2c_done_tail;
+
+#define I2C_TWCR_BASE  (_BV(TWEN) | _BV(TWIE) | _BV(TWINT))
+
 void
 i2c_master_init(void)
 {
@@ -80,6 +96,8 @@ i2c_master_stop(void)
 uint8_t
 i2c_master_select(uint8_t address, uint8_t mode)
 {
+  /* the polling primitives must not interfere with queued requests */
+  i2c_master_wait_idle();
   i2c_master_enable();
   #ifdef DEBUG_I2C
     debug_printf("i2c master select adr+mode 0x%X\n", (address << 1) | mode);
@@ -97,8 +115,186 @@ i2c_master_select(uint8_t address, uint8_t mode)
     return 0;
 }
 
+static void
+i2c_master_finish(i2c_request_t *req, uint8_t status)
+{
+  i2c_request_t *next = req->next;
+
+  req->status = status;
+  req->next = NULL;
+  if (req->callback) {
+    if (i2c_done_head)
+      i2c_done_tail->next = req;
+    else
+      i2c_done_head = req;
+    i2c_done_tail = req;
+  }
+
+  i2c_queue_head = next;
+  if (next) {
+    /* stop condition directly followed by the next start condition */
+    next->status = I2C_REQ_BUSY;
+    next->pos = 0;
+    TWCR = I2C_TWCR_BASE | _BV(TWSTO) | _BV(TWSTA);
+  } else {
+    TWCR = _BV(TWEN) | _BV(TWINT) | _BV(TWSTO);
+  }
+}
+
+/* Advance the request at the head of the queue, called with TWINT set */
+static void
+i2c_master_step(void)
+{
+  i2c_request_t *req = i2c_queue_head;
+
+  if (!req) {
+    TWCR = _BV(TWEN) | _BV(TWINT) | _BV(TWSTO);
+    return;
+  }
+
+  switch (TW_STATUS) {
+    case TW_START:
+      /* write phase first, unless this is a pure read */
+      TWDR = (req->address << 1) | ((req->wlen || !req->rlen) ? TW_WRITE : TW_READ);
+      TWCR = I2C_TWCR_BASE;
+      break;
+
+    case TW_REP_START:
+      TWDR = (req->address << 1) | TW_READ;
+      TWCR = I2C_TWCR_BASE;
+      break;
+
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+      if (req->pos < req->wlen) {
+        TWDR = req->wbuf[req->pos++];
+        TWCR = I2C_TWCR_BASE;
+      } else if (req->rlen) {
+        req->pos = 0;
+        TWCR = I2C_TWCR_BASE | _BV(TWSTA);
+      } else {
+        i2c_master_finish(req, I2C_REQ_DONE);
+      }
+      break;
+
+    case TW_MR_SLA_ACK:
+      /* only acknowledge if more than one byte is expected */
+      req->pos = 0;
+      TWCR = I2C_TWCR_BASE | (req->rlen > 1 ? _BV(TWEA) : 0);
+      break;
+
+    case TW_MR_DATA_ACK:
+      req->rbuf[req->pos++] = TWDR;
+      TWCR = I2C_TWCR_BASE | (req->pos < req->rlen - 1 ? _BV(TWEA) : 0);
+      break;
+
+    case TW_MR_DATA_NACK:
+      req->rbuf[req->pos++] = TWDR;
+      i2c_master_finish(req, I2C_REQ_DONE);
+      break;
+
+    case TW_MT_ARB_LOST:
+      /* somebody else owns the bus, retry as soon as it is free again */
+      req->pos = 0;
+      TWCR = I2C_TWCR_BASE | _BV(TWSTA);
+      break;
+
+    default:
+      /* slave NACKed address or data, or bus error */
+      i2c_master_finish(req, I2C_REQ_ERROR);
+      break;
+  }
+}
+
+ISR(TWI_vect)
+{
+  i2c_master_step();
+}
+
+/* Drive the queue by polling TWINT until cond is false.  Used instead of
+ * waiting for the ISR when interrupts are disabled, e.g. when the clock
+ * is set from the DCF77 interrupt and syncs the RTC. */
+#define i2c_master_poll_while(cond)                     \
+  do {                                                  \
+    while (cond) {                                      \
+      if (SREG & _BV(SREG_I))                           \
+        continue;                                       \
+      if (bit_is_set(TWCR, TWINT))                      \
+        i2c_master_step();                              \
+    }                                                   \
+  } while (0)
+
+/* Append a request to the queue, the transfer is started immediately
+ * if the bus is idle.  The callback is only dispatched by the mainloop. */
+void
+i2c_master_enqueue(i2c_request_t *req)
+{
+  req->next = NULL;
+  req->pos = 0;
+  req->status = I2C_REQ_QUEUED;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (i2c_queue_head) {
+      i2c_queue_tail->next = req;
+      i2c_queue_tail = req;
+    } else {
+      i2c_queue_head = i2c_queue_tail = req;
+      req->status = I2C_REQ_BUSY;
+      /* wait for a preceding stop condition to be sent */
+      loop_until_bit_is_clear(TWCR, TWSTO);
+      TWCR = I2C_TWCR_BASE | _BV(TWSTA);
+    }
+  }
+}
+
+/* Blocking convenience wrapper around the queue, returns 1 on success.
+ * Used by ECMD handlers and init code that need the result right away.
+ * With interrupts disabled the queue is run by polling, so this is safe
+ * to call from interrupt context, too. */
+uint8_t
+i2c_master_transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen,
+                    uint8_t *rbuf, uint8_t rlen)
+{
+  i2c_request_t req;
+
+  req.address = address;
+  req.wbuf = wbuf;
+  req.wlen = wlen;
+  req.rbuf = rbuf;
+  req.rlen = rlen;
+  req.callback = NULL;
+
+  i2c_master_enqueue(&req);
+  i2c_master_poll_while(i2c_master_busy(&req));
+
+  return req.status == I2C_REQ_DONE;
+}
+
+void
+i2c_master_wait_idle(void)
+{
+  i2c_master_poll_while(i2c_queue_head);
+  loop_until_bit_is_clear(TWCR, TWSTO);
+}
+
+/* Dispatch the callbacks of finished requests. */
+void
+i2c_master_process(void)
+{
+  while (i2c_done_head) {
+    i2c_request_t *req;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      req = i2c_done_head;
+      i2c_done_head = req->next;
+      req->next = NULL;
+    }
+    req->callback(req);
+  }
+}
+
 /*
   -- Ethersex META --
   header(hardware/i2c/master/i2c_master.h)
   initearly(i2c_master_init)
+  mainloop(i2c_master_process)
 */
@@ -24,6 +24,9 @@
 #ifndef _I2C_EEPROM_I2C_MASTER_H
 #define _I2C_EEPROM_I2C_MASTER_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #define i2c_master_disable() TWCR = 0
 #define i2c_master_enable() TWCR=(1<<TWEN)|(1<<TWINT)
 
@@ -38,7 +41,46 @@ uint8_t  i2c_master_select(uint8_t address, uint8_t mode);
 #define i2c_master_transmit() i2c_master_do(_BV(TWEN) | _BV(TWINT)) 
 #define i2c_master_transmit_with_ack() i2c_master_do(_BV(TWEN) | _BV(TWINT) | _BV(TWEA) ) 
 
+/* Interrupt driven transaction queue.  A request addresses one slave,
+ * sends wlen bytes from wbuf and afterwards (after a repeated start)
+ * receives rlen bytes into rbuf.  Either length may be zero.  Requests
+ * (and their buffers) are owned by the caller and must stay valid until
+ * the request has finished.  The callback, if any, is called from the
+ * mainloop, never from interrupt context. */
+#define I2C_REQ_IDLE    0
+#define I2C_REQ_QUEUED  1
+#define I2C_REQ_BUSY    2
+#define I2C_REQ_DONE    3
+#define I2C_REQ_ERROR   4
+
+typedef struct i2c_request i2c_request_t;
+typedef void (*i2c_callback_t)(i2c_request_t *req);
+
+struct i2c_request
+{
+  uint8_t address;
+  uint8_t *wbuf;
+  uint8_t wlen;
+  uint8_t *rbuf;
+  uint8_t rlen;
+  uint8_t pos;                  /* bytes transferred in current phase */
+  volatile uint8_t status;
+  i2c_callback_t callback;
+  void *data;                   /* free for use by the callback */
+  i2c_request_t *next;
+};
+
+void i2c_master_enqueue(i2c_request_t *req);
+uint8_t i2c_master_transfer(uint8_t address, uint8_t *wbuf, uint8_t wlen,
+                            uint8_t *rbuf, uint8_t rlen);
+void i2c_master_wait_idle(void);
+void i2c_master_process(void);
+
+#define i2c_master_busy(req) ((req)->status == I2C_REQ_QUEUED \
+                              || (req)->status == I2C_REQ_BUSY)
+
 #include "config.h"
+
 #ifdef DEBUG_I2C
 # include "core/debug.h"
 # define I2CDEBUG(a...)  debug_printf("i2c: " a)
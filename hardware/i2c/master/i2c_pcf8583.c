@@ -50,96 +50,30 @@
 static uint16_t sync_timer;
 #endif /* I2C_PCF8583_SYNC */
 
-uint8_t
-i2c_pcf8583_set_addr(uint8_t Adr)
-{
-  if (!i2c_master_select(PCF8583_ADR, TW_WRITE))
-  {
-    return 0;
-  }
-
-  TWDR = Adr;
-  if (i2c_master_transmit() != TW_MT_DATA_ACK)
-  {
-    return 0;
-  }
-
-  return 1;
-}
-
-uint8_t
-i2c_pcf8583_start_read(void)
-{
-  /* Do an repeated start condition */
-  if (i2c_master_start() != TW_REP_START)
-  {
-    return 0;
-  }
-
-  TWDR = (PCF8583_ADR << 1) | TW_READ;
-  if (i2c_master_transmit() != TW_MR_SLA_ACK)
-  {
-    return 0;
-  }
-
-  return 1;
-}
-
 uint8_t
 i2c_pcf8583_set_byte(uint8_t Adr, uint8_t Val)
 {
-  uint8_t ret = 0;
+  uint8_t buf[2] = { Adr, Val };
 
 #ifdef DEBUG_I2C
   debug_printf
     ("I2C: i2c_pcf8583_set_byte: 0x%X (%d) [0x%X (%d)] : [0x%X (%d)]\n",
      PCF8583_ADR, PCF8583_ADR, Adr, Adr, Val, Val);
 #endif
-  if (!i2c_pcf8583_set_addr(Adr))
-  {
-    goto end;
-  }
-
-  TWDR = Val;
-  if (i2c_master_transmit() != TW_MT_DATA_ACK)
-  {
-    goto end;
-  }
-  ret = 1;
-
-end:
-  i2c_master_stop();
-  return ret;
+  return i2c_master_transfer(PCF8583_ADR, buf, 2, NULL, 0);
 }
 
 uint8_t
 i2c_pcf8583_get_byte(uint8_t Adr)
 {
-  uint8_t ret = 0xff;
+  uint8_t ret;
 
 #ifdef DEBUG_I2C
   debug_printf("I2C: i2c_pcf8583_get_byte: 0x%X (%d) [0x%X (%d)]\n",
                PCF8583_ADR, PCF8583_ADR, Adr, Adr);
 #endif
-  if (!i2c_pcf8583_set_addr(Adr))
-  {
-    goto end;
-  }
-
-  /* start reading */
-  if (!i2c_pcf8583_start_read())
-  {
-    goto end;
-  }
-
-  if (i2c_master_transmit() != TW_MR_DATA_NACK)
-  {
-    goto end;
-  }
-  ret = TWDR;
-
-end:
-  i2c_master_stop();
+  if (!i2c_master_transfer(PCF8583_ADR, &Adr, 1, &ret, 1))
+    ret = 0xff;
 
 #ifdef DEBUG_I2C
   debug_printf("I2C: i2c_pcf8583_get_byte value: 0x%X (%d)\n", ret, ret);
@@ -151,71 +85,28 @@ end:
 uint8_t
 i2c_pcf8583_set_word(uint8_t Adr, uint16_t Val)
 {
-  uint8_t ret = 0;
+  uint8_t buf[3] = { Adr, HI8(Val), LO8(Val) };
 
 #ifdef DEBUG_I2C
   debug_printf
     ("I2C: i2c_pcf8583_set_word: 0x%X (%d) [0x%X (%d)] : [0x%X (%d)]\n",
      PCF8583_ADR, PCF8583_ADR, Adr, Adr, Val, Val);
 #endif
-  if (!i2c_pcf8583_set_addr(Adr))
-  {
-    goto end;
-  }
-
-  TWDR = HI8(Val);
-  if (i2c_master_transmit() != TW_MT_DATA_ACK)
-  {
-    goto end;
-  }
-
-  TWDR = LO8(Val);
-  if (i2c_master_transmit() != TW_MT_DATA_ACK)
-  {
-    goto end;
-  }
-  ret = 1;
-
-end:
-  i2c_master_stop();
-  return ret;
+  return i2c_master_transfer(PCF8583_ADR, buf, 3, NULL, 0);
 }
 
 uint16_t
 i2c_pcf8583_get_word(uint8_t Adr)
 {
+  uint8_t buf[2];
   uint16_t ret = 0xffff;
 
 #ifdef DEBUG_I2C
   debug_printf("I2C: i2c_pcf8583_get_word: 0x%X (%d) [0x%X (%d)]\n",
                PCF8583_ADR, PCF8583_ADR, Adr, Adr);
 #endif
-  if (!i2c_pcf8583_set_addr(Adr))
-  {
-    goto end;
-  }
-
-  /* start reading */
-  if (!i2c_pcf8583_start_read())
-  {
-    goto end;
-  }
-
-  if (i2c_master_transmit_with_ack() != TW_MR_DATA_ACK)
-  {
-    goto end;
-  }
-  ret = (uint16_t) TWDR << 8;
-
-  if (i2c_master_transmit() != TW_MR_DATA_NACK)
-  {
-    ret = 0xffff;
-    goto end;
-  }
-  ret |= (uint16_t) TWDR;
-
-end:
-  i2c_master_stop();
+  if (i2c_master_transfer(PCF8583_ADR, &Adr, 1, buf, 2))
+    ret = ((uint16_t) buf[0] << 8) | buf[1];
 
 #ifdef DEBUG_I2C
   debug_printf("I2C: i2c_pcf8583_get_word value: 0x%X (%d)\n", ret, ret);
@@ -224,6 +115,21 @@ end:
   return ret;
 }
 
+/* Convert the time and date registers (starting with the 100s register)
+ * into dt, returns the two-bit year counter. */
+static uint8_t
+i2c_pcf8583_decode(pcf8583_reg_t * dt, uint8_t * buf)
+{
+  dt->hsec = BCD2BIN(buf[0]);
+  dt->sec = BCD2BIN(buf[1]);
+  dt->min = BCD2BIN(buf[2]);
+  dt->hour = BCD2BIN(buf[3] & 0x3f);
+  dt->day = BCD2BIN(buf[4] & 0x3f);
+  dt->mon = BCD2BIN(buf[5] & 0x1f);
+  dt->wday = buf[5] >> 5;
+  return buf[4] >> 6;
+}
+
 void
 i2c_pcf8583_init(void)
 {
@@ -287,28 +193,108 @@ i2c_pcf8583_get(void)
 #endif /* CLOCK_DATETIME_SUPPORT */
 }
 
+#ifdef CLOCK_DATETIME_SUPPORT
+static void
+i2c_pcf8583_set_clock(pcf8583_reg_t * dt)
+{
+  clock_datetime_t d;
+
+  d.sec = dt->sec;
+  d.min = dt->min;
+  d.hour = dt->hour;
+  d.dow = dt->wday;
+  d.day = dt->day;
+  d.month = dt->mon;
+  d.year = dt->year;
+  d.isdst = 0;
+
+  clock_set_time_raw_hr(clock_mktime(&d, 1), (dt->hsec) >> 1);
+}
+#endif /* CLOCK_DATETIME_SUPPORT */
+
 void
 i2c_pcf8583_sync(void)
 {
 #ifdef CLOCK_DATETIME_SUPPORT
   pcf8583_reg_t dt;
-  clock_datetime_t d;
 
   if (!i2c_pcf8583_get_rtc(&dt))
     return;
-  d.sec = dt.sec;
-  d.min = dt.min;
-  d.hour = dt.hour;
-  d.dow = dt.wday;
-  d.day = dt.day;
-  d.month = dt.mon;
-  d.year = dt.year;
-  d.isdst = 0;
-
-  clock_set_time_raw_hr(clock_mktime(&d, 1), (dt.hsec) >> 1);
+  i2c_pcf8583_set_clock(&dt);
 #endif /* CLOCK_DATETIME_SUPPORT */
 }
 
+#if defined(I2C_PCF8583_SYNC) && defined(CLOCK_DATETIME_SUPPORT)
+/* The periodic sync runs through the I2C queue, so the mainloop isn't
+ * blocked while the registers are read.  First the time and date
+ * registers are fetched, then the year word from the NVRAM. */
+static i2c_request_t sync_req;
+static uint8_t sync_reg;
+static uint8_t sync_buf[8];
+static uint8_t sync_year[3];
+
+static void
+i2c_pcf8583_sync_year_cb(i2c_request_t * req)
+{
+  pcf8583_reg_t dt;
+  uint8_t YearCnt;
+  uint16_t YearReg;
+
+  if (req->status != I2C_REQ_DONE)
+    return;
+
+  YearCnt = i2c_pcf8583_decode(&dt, sync_buf);
+  YearReg = ((uint16_t) sync_buf[6] << 8) | sync_buf[7];
+  if (YearReg == 0xffff)
+    return;
+
+  /* Increment passed years, update the NVRAM only if it changed */
+  uint16_t year = YearReg + ((YearCnt - (YearReg & 0x03)) & 0x03);
+  if (year != YearReg) {
+    sync_year[0] = PCF8583_YEAR_REG;
+    sync_year[1] = HI8(year);
+    sync_year[2] = LO8(year);
+    req->wbuf = sync_year;
+    req->wlen = 3;
+    req->rlen = 0;
+    req->callback = NULL;
+    i2c_master_enqueue(req);
+  }
+
+  dt.year = year;
+  i2c_pcf8583_set_clock(&dt);
+}
+
+static void
+i2c_pcf8583_sync_time_cb(i2c_request_t * req)
+{
+  if (req->status != I2C_REQ_DONE)
+    return;
+
+  sync_reg = PCF8583_YEAR_REG;
+  req->rbuf = sync_buf + 6;
+  req->rlen = 2;
+  req->callback = i2c_pcf8583_sync_year_cb;
+  i2c_master_enqueue(req);
+}
+
+static void
+i2c_pcf8583_sync_start(void)
+{
+  if (i2c_master_busy(&sync_req))
+    return;
+
+  sync_reg = PCF8583_100S_REG;
+  sync_req.address = PCF8583_ADR;
+  sync_req.wbuf = &sync_reg;
+  sync_req.wlen = 1;
+  sync_req.rbuf = sync_buf;
+  sync_req.rlen = 6;
+  sync_req.callback = i2c_pcf8583_sync_time_cb;
+  i2c_master_enqueue(&sync_req);
+}
+#endif
+
 uint8_t
 i2c_pcf8583_reset_rtc(void)
 {
@@ -327,7 +313,7 @@ i2c_pcf8583_reset_rtc(void)
 uint8_t
 i2c_pcf8583_set_rtc(pcf8583_reg_t * dt)
 {
-  uint8_t ret = 0;
+  uint8_t buf[8];
 
 #ifdef DEBUG_I2C
   debug_printf
@@ -335,56 +321,19 @@ i2c_pcf8583_set_rtc(pcf8583_reg_t * dt)
      PCF8583_ADR, PCF8583_ADR, dt->year, dt->mon, dt->day, dt->wday, dt->hour,
      dt->min, dt->sec, dt->hsec);
 #endif
-  if (!i2c_pcf8583_set_addr(PCF8583_CTRL_STATUS_REG))
-  {
-    goto end;
-  }
-
+  buf[0] = PCF8583_CTRL_STATUS_REG;
   /* Stop counting */
-  TWDR = PCF8583_STOP_COUNTING | PCF8583_MASK;
-  if (i2c_master_transmit() != TW_MT_DATA_ACK)
-  {
-    goto end;
-  }
-
+  buf[1] = PCF8583_STOP_COUNTING | PCF8583_MASK;
   /* Time */
-  TWDR = BIN2BCD(dt->hsec);
-  if (i2c_master_transmit() != TW_MT_DATA_ACK)
-  {
-    goto end;
-  }
-  TWDR = BIN2BCD(dt->sec);
-  if (i2c_master_transmit() != TW_MT_DATA_ACK)
-  {
-    goto end;
-  }
-  TWDR = BIN2BCD(dt->min);
-  if (i2c_master_transmit() != TW_MT_DATA_ACK)
-  {
-    goto end;
-  }
-  TWDR = BIN2BCD(dt->hour) & 0x3f;      /* 24h mode */
-  if (i2c_master_transmit() != TW_MT_DATA_ACK)
-  {
-    goto end;
-  }
-
+  buf[2] = BIN2BCD(dt->hsec);
+  buf[3] = BIN2BCD(dt->sec);
+  buf[4] = BIN2BCD(dt->min);
+  buf[5] = BIN2BCD(dt->hour) & 0x3f;    /* 24h mode */
   /* Date */
-  TWDR = (BIN2BCD(dt->day) & 0x3f) | ((dt->year & 0x03) << 6);
-  if (i2c_master_transmit() != TW_MT_DATA_ACK)
-  {
-    goto end;
-  }
-  TWDR = (BIN2BCD(dt->mon) & 0x1f) | ((dt->wday & 0x07) << 5);
-  if (i2c_master_transmit() != TW_MT_DATA_ACK)
-  {
-    goto end;
-  }
-  ret = 1;
+  buf[6] = (BIN2BCD(dt->day) & 0x3f) | ((dt->year & 0x03) << 6);
+  buf[7] = (BIN2BCD(dt->mon) & 0x1f) | ((dt->wday & 0x07) << 5);
 
-end:
-  i2c_master_stop();
-  if (!ret)
+  if (!i2c_master_transfer(PCF8583_ADR, buf, sizeof(buf), NULL, 0))
     return 0;
 
   /* update Year register */
@@ -401,66 +350,19 @@ end:
 uint8_t
 i2c_pcf8583_get_rtc(pcf8583_reg_t * dt)
 {
-  uint8_t ret = 0;
-  uint8_t YearCnt = 0;
+  uint8_t YearCnt;
   uint16_t YearReg;
 
 #ifdef DEBUG_I2C
   debug_printf("I2C: i2c_pcf8583_get_rtc: 0x%X (%d)\n", PCF8583_ADR,
                PCF8583_ADR);
 #endif
-  if (!i2c_pcf8583_set_addr(PCF8583_100S_REG))
-  {
-    goto end;
-  }
-
-  /* start reading */
-  if (!i2c_pcf8583_start_read())
-  {
-    goto end;
-  }
+  uint8_t reg = PCF8583_100S_REG;
+  uint8_t buf[6];
 
-  /* Time */
-  if (i2c_master_transmit_with_ack() != TW_MR_DATA_ACK)
-  {
-    goto end;
-  }
-  dt->hsec = BCD2BIN(TWDR);
-  if (i2c_master_transmit_with_ack() != TW_MR_DATA_ACK)
-  {
-    goto end;
-  }
-  dt->sec = BCD2BIN(TWDR);
-  if (i2c_master_transmit_with_ack() != TW_MR_DATA_ACK)
-  {
-    goto end;
-  }
-  dt->min = BCD2BIN(TWDR);
-  if (i2c_master_transmit_with_ack() != TW_MR_DATA_ACK)
-  {
-    goto end;
-  }
-  dt->hour = BCD2BIN(TWDR & 0x3f);
-
-  /* Date */
-  if (i2c_master_transmit_with_ack() != TW_MR_DATA_ACK)
-  {
-    goto end;
-  }
-  YearCnt = TWDR >> 6;
-  dt->day = BCD2BIN(TWDR & 0x3f);
-  if (i2c_master_transmit() != TW_MR_DATA_NACK)
-  {
-    goto end;
-  }
-  dt->mon = BCD2BIN(TWDR & 0x1f);
-  dt->wday = TWDR >> 5;
-  ret = 1;
-
-end:
-  i2c_master_stop();
-  if (!ret)
+  if (!i2c_master_transfer(PCF8583_ADR, &reg, 1, buf, sizeof(buf)))
     return 0;
+  YearCnt = i2c_pcf8583_decode(dt, buf);
 
   /* Read the year from NVRAM. */
   YearReg = i2c_pcf8583_get_word(PCF8583_YEAR_REG);
@@ -495,7 +397,9 @@ i2c_pcf8583_tick(void)
     if (++sync_timer >= I2C_PCF8583_SYNC_PERIOD)
     {
       sync_timer = 0;
-      i2c_pcf8583_sync();
+#ifdef CLOCK_DATETIME_SUPPORT
+      i2c_pcf8583_sync_start();
+#endif
     }
   }
 #endif
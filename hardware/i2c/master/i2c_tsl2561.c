@@ -19,49 +19,107 @@ static uint8_t devstatus[3]; // maximum of 3 devices
 
 static uint8_t write8(uint8_t n,uint8_t reg,uint8_t val)
 {
-	uint8_t ret=0xff;
-	if(!i2c_master_select(DEVID(n),TW_WRITE))
-		goto end;
-	TWDR=reg;
-	if(i2c_master_transmit_with_ack()!=TW_MT_DATA_ACK)
-		goto end;
-	TWDR=val;
-	if(i2c_master_transmit_with_ack()!=TW_MT_DATA_ACK)
-		goto end;
-	ret=0;
-end:
-	i2c_master_stop();
-	return ret;
+	uint8_t buf[2] = { reg, val };
+	if(!i2c_master_transfer(DEVID(n),buf,2,NULL,0))
+		return 0xff;
+	return 0;
 }
 
 static int32_t read16(uint8_t n,uint8_t reg)
 {
-	if(!i2c_master_select(DEVID(n),TW_WRITE))
-		goto end;
-	TWDR=reg;
-	if(i2c_master_transmit_with_ack() != TW_MT_DATA_ACK) goto end;
-	i2c_master_stop();
-	if(!i2c_master_select(DEVID(n),TW_READ))
-		goto end;
-	if(i2c_master_transmit_with_ack() != TW_MR_DATA_ACK) goto end;
-	uint16_t t=TWDR;
-	if(i2c_master_transmit() != TW_MR_DATA_NACK) goto end;
-	t=t|(TWDR<<8);
-	i2c_master_stop();
-	return t;
-end:
-	i2c_master_stop();
-	return -1;
-	
+	uint8_t buf[2];
+	/* register address and read as two separate transfers */
+	if(!i2c_master_transfer(DEVID(n),&reg,1,NULL,0))
+		return -1;
+	if(!i2c_master_transfer(DEVID(n),NULL,0,buf,2))
+		return -1;
+	return buf[0]|(buf[1]<<8);
+}
+
+/* Background sampling: once a second both channels of all powered up
+ * devices are read through the I2C queue.  The register address and
+ * the read are queued together, so no other transfer can move the
+ * register pointer in between. */
+static i2c_request_t sample_reg_req;
+static i2c_request_t sample_req;
+static uint8_t sample_reg;
+static uint8_t sample_buf[2];
+static uint8_t sample_dev;
+static uint8_t sample_chan;
+static uint8_t sampled;
+static uint16_t sample_ch[3][2];
+
+static void
+i2c_tsl2561_sample(void)
+{
+	/* skip devices that are switched off */
+	while (sample_dev < 3 && !(devstatus[sample_dev] & DEVSTATUS_ON)) {
+		sampled &= ~_BV(sample_dev);
+		sample_dev++;
+	}
+	if (sample_dev >= 3)
+		return;
+
+	sample_reg = TSL2561_COMMAND_BIT | TSL2561_WORD_BIT |
+		(sample_chan ? TSL2561_REGISTER_CHAN1_LOW : TSL2561_REGISTER_CHAN0_LOW);
+	sample_reg_req.address = DEVID(sample_dev);
+	sample_reg_req.wbuf = &sample_reg;
+	sample_reg_req.wlen = 1;
+	sample_reg_req.rlen = 0;
+	sample_reg_req.callback = NULL;
+	sample_req.address = DEVID(sample_dev);
+	sample_req.wlen = 0;
+	sample_req.rbuf = sample_buf;
+	sample_req.rlen = 2;
+	i2c_master_enqueue(&sample_reg_req);
+	i2c_master_enqueue(&sample_req);
+}
+
+static void
+i2c_tsl2561_sample_cb(i2c_request_t *req)
+{
+	if (sample_reg_req.status != I2C_REQ_DONE || req->status != I2C_REQ_DONE) {
+		sampled &= ~_BV(sample_dev);
+		sample_chan = 1;
+	} else {
+		sample_ch[sample_dev][sample_chan] = sample_buf[0] | (sample_buf[1] << 8);
+		if (sample_chan)
+			sampled |= _BV(sample_dev);
+	}
+
+	if (sample_chan) {
+		sample_chan = 0;
+		sample_dev++;
+	} else
+		sample_chan = 1;
+	i2c_tsl2561_sample();
+}
+
+void i2c_tsl2561_periodic(void)
+{
+	if (i2c_master_busy(&sample_reg_req) || i2c_master_busy(&sample_req))
+		return;
+
+	sample_dev = 0;
+	sample_chan = 0;
+	sample_req.callback = i2c_tsl2561_sample_cb;
+	i2c_tsl2561_sample();
 }
 
 /*
- * Read both channels of the specified device in the given mode
+ * Read both channels of the specified device in the given mode, the
+ * last sample if there is one
  */
 uint8_t i2c_tsl2561_getluminosity(uint8_t devnum,uint16_t *ch0,uint16_t *ch1)
 {
 	if(!(devstatus[devnum]&DEVSTATUS_ON))
 		return 1; // Device not active
+
+	if(sampled&_BV(devnum)) {
+		*ch0=sample_ch[devnum][0];
+		*ch1=sample_ch[devnum][1];
+		return 0;
+	}
 	
 	int32_t x;
 	x=read16(devnum,TSL2561_COMMAND_BIT | TSL2561_WORD_BIT | TSL2561_REGISTER_CHAN1_LOW);
@@ -319,6 +377,8 @@ uint8_t i2c_tsl2561_setmode(uint8_t devnum,uint8_t integration_time,uint8_t gain
 		return 2; // Error
 	// Remember device mode for calculations
 	devstatus[devnum]=mode | DEVSTATUS_ON | (packagetype?DEVSTATUS_PACKAGE_CS:0);
+	// Samples taken in the old mode don't fit any more
+	sampled&=~_BV(devnum);
 	return 0;
 }
 
@@ -326,6 +386,7 @@ uint8_t i2c_tsl2561_setpower(uint8_t devnum,uint8_t power)
 {
 	if(write8(devnum,TSL2561_COMMAND_BIT | TSL2561_REGISTER_CONTROL, power ? TSL2561_CONTROL_POWERON : TSL2561_CONTROL_POWEROFF))
 		return 2; // Error
+	sampled&=~_BV(devnum);
 	if(power)
 		devstatus[devnum]|=DEVSTATUS_ON;
 	else
@@ -336,6 +397,7 @@ uint8_t i2c_tsl2561_setpower(uint8_t devnum,uint8_t power)
 /*
  -- Ethersex META --
  header(hardware/i2c/master/i2c_tsl2561.h)
+ timer(50, i2c_tsl2561_periodic())
  */
 
 #endif /* I2C_TSL2561_SUPPORT */
@@ -57,5 +57,6 @@ int32_t i2c_tsl2561_getlux(uint8_t devnum);
 uint8_t i2c_tsl2561_getluminosity(uint8_t devnum,uint16_t *ch0,uint16_t *ch1);
 uint8_t i2c_tsl2561_setmode(uint8_t devnum,uint8_t integration_time,uint8_t gain,uint8_t packagetype);
 uint8_t i2c_tsl2561_setpower(uint8_t devnum,uint8_t power);
+void i2c_tsl2561_periodic(void);
 
 #endif /* _I2C_TSL2550_H */
@@ -37,14 +37,129 @@
 #endif
 
 
-#define vfs_eeprom_read_page(page, data, len) i2c_24CXX_read_block(page * SFS_PAGE_SIZE, data, len)
-#define vfs_eeprom_read_slice(page, offset, data, len) i2c_24CXX_read_block(page * SFS_PAGE_SIZE + offset , data, len)
-#define vfs_eeprom_write_page(page, data, len) i2c_24CXX_write_block(page * SFS_PAGE_SIZE, data, len)
-#define vfs_eeprom_write_slice(page, offset, data, len) i2c_24CXX_write_block(page * SFS_PAGE_SIZE + offset , data, len)
+#define vfs_eeprom_read_page(page, data, len) vfs_eeprom_read_slice(page, 0, data, len)
+#define vfs_eeprom_write_page(page, data, len) vfs_eeprom_write_slice(page, 0, data, len)
+
+#if SFS_CACHE_LINES > 0
+/* Read cache of SFS_CACHE_LINES lines, each holding SFS_CACHE_LINE_PAGES
+ * consecutive filesystem pages fetched with a single sequential read.
+ * Writes go to the eeprom right away and update the cached copy, so
+ * nothing written is lost on a reset. */
+#define SFS_CACHE_LINE_SIZE (SFS_CACHE_LINE_PAGES * SFS_PAGE_SIZE)
+#define SFS_CACHE_INVALID 0xffff
+
+#if SFS_CACHE_LINE_SIZE > 255
+#error "SFS_CACHE_LINE_PAGES * SFS_PAGE_SIZE must not exceed 255 bytes"
+#endif
+
+static struct {
+  vfs_eeprom_inode_t tag;       /* page / SFS_CACHE_LINE_PAGES */
+  uint8_t age;
+  uint8_t data[SFS_CACHE_LINE_SIZE];
+} vfs_eeprom_cache[SFS_CACHE_LINES];
+
+/* Forget the cache contents, needed after the eeprom has been written
+ * bypassing the filesystem. */
+void
+vfs_eeprom_sync(void)
+{
+  for (uint8_t i = 0; i < SFS_CACHE_LINES; i++)
+    vfs_eeprom_cache[i].tag = SFS_CACHE_INVALID;
+}
+
+/* Return the cache line holding page, SFS_CACHE_LINES if it isn't
+ * cached. */
+static uint8_t
+vfs_eeprom_cache_find(vfs_eeprom_inode_t page)
+{
+  vfs_eeprom_inode_t tag = page / SFS_CACHE_LINE_PAGES;
+  uint8_t i;
+
+  for (i = 0; i < SFS_CACHE_LINES; i++)
+    if (vfs_eeprom_cache[i].tag == tag)
+      break;
+  return i;
+}
+
+/* Return the cache line holding page, fetching it if necessary.
+ * Returns SFS_CACHE_LINES on failure. */
+static uint8_t
+vfs_eeprom_cache_get(vfs_eeprom_inode_t page)
+{
+  vfs_eeprom_inode_t tag = page / SFS_CACHE_LINE_PAGES;
+  uint8_t i = vfs_eeprom_cache_find(page);
+
+  if (i == SFS_CACHE_LINES) {
+    /* miss, replace the least recently used line */
+    i = 0;
+    for (uint8_t j = 1; j < SFS_CACHE_LINES; j++)
+      if (vfs_eeprom_cache[j].age > vfs_eeprom_cache[i].age)
+        i = j;
+
+    vfs_eeprom_cache[i].tag = SFS_CACHE_INVALID;
+    if (i2c_24CXX_read_block(tag * SFS_CACHE_LINE_SIZE,
+                             vfs_eeprom_cache[i].data,
+                             SFS_CACHE_LINE_SIZE) != SFS_CACHE_LINE_SIZE)
+      return SFS_CACHE_LINES;
+    vfs_eeprom_cache[i].tag = tag;
+  }
+
+  for (uint8_t j = 0; j < SFS_CACHE_LINES; j++)
+    if (vfs_eeprom_cache[j].age < 255)
+      vfs_eeprom_cache[j].age++;
+  vfs_eeprom_cache[i].age = 0;
+
+  return i;
+}
+
+#define vfs_eeprom_cache_offset(page, offset) \
+  ((page % SFS_CACHE_LINE_PAGES) * SFS_PAGE_SIZE + offset)
+#endif /* SFS_CACHE_LINES > 0 */
+
+static uint8_t
+vfs_eeprom_read_slice(vfs_eeprom_inode_t page, vfs_eeprom_len_t offset,
+                      void *data, vfs_eeprom_len_t len)
+{
+#if SFS_CACHE_LINES > 0
+  uint8_t i = vfs_eeprom_cache_get(page);
+  if (i == SFS_CACHE_LINES)
+    return 0;
+  memcpy(data, vfs_eeprom_cache[i].data
+         + vfs_eeprom_cache_offset(page, offset), len);
+  return len;
+#else
+  return i2c_24CXX_read_block(page * SFS_PAGE_SIZE + offset, data, len);
+#endif
+}
+
+static uint8_t
+vfs_eeprom_write_slice(vfs_eeprom_inode_t page, vfs_eeprom_len_t offset,
+                       void *data, vfs_eeprom_len_t len)
+{
+  uint8_t ret = i2c_24CXX_write_block(page * SFS_PAGE_SIZE + offset,
+                                      data, len);
+#if SFS_CACHE_LINES > 0
+  uint8_t i = vfs_eeprom_cache_find(page);
+  if (i < SFS_CACHE_LINES) {
+    if (ret == len)
+      memcpy(vfs_eeprom_cache[i].data
+             + vfs_eeprom_cache_offset(page, offset), data, len);
+    else
+      /* the eeprom content is unknown after a failed write */
+      vfs_eeprom_cache[i].tag = SFS_CACHE_INVALID;
+  }
+#endif
+  return ret;
+}
 
 void
 vfs_eeprom_init(void)
 {
+#if SFS_CACHE_LINES > 0
+  for (uint8_t i = 0; i < SFS_CACHE_LINES; i++)
+    vfs_eeprom_cache[i].tag = SFS_CACHE_INVALID;
+#endif
+
   unsigned char buf[SFS_PAGE_SIZE];
   vfs_eeprom_read_page(0, buf, sizeof(struct vfs_eeprom_page_superblock));
   vfs_eeprom_debug("Superblock %s\n", buf);
@@ -188,6 +303,7 @@ vfs_eeprom_create(const char * filename)
   handle->fh_type = VFS_EEPROM;
   handle->u.ee.file_page = inode;
   handle->u.ee.offset = 0;
+  handle->u.ee.cur_page = 0;
 
   return handle;
 }
@@ -205,6 +321,7 @@ vfs_eeprom_open(const char * filename)
   handle->fh_type = VFS_EEPROM;
   handle->u.ee.file_page = inode;
   handle->u.ee.offset = 0;
+  handle->u.ee.cur_page = 0;
 
   return handle;
 }
@@ -249,13 +366,22 @@ vfs_eeprom_read(struct vfs_file_handle_t *handle, void * buffer, vfs_size_t size
   vfs_size_t count = 0;
 
   if (!handle) return 0;
-  vfs_eeprom_read_page(handle->u.ee.file_page, (uint8_t *)buf, SFS_PAGE_SIZE);
 
-  /* First we have to skip n pages to get to our offset */
-  vfs_eeprom_inode_t pages_skip = handle->u.ee.offset / sizeof(data_page->data);
-  vfs_eeprom_debug("read; skip %d pages\n", pages_skip);
+  /* First we have to skip n pages to get to our offset, start from
+   * the page the last read stopped in if possible */
+  vfs_eeprom_inode_t index = handle->u.ee.offset / sizeof(data_page->data);
+  vfs_eeprom_inode_t pages_skip;
+  vfs_eeprom_inode_t next_page;
 
-  vfs_eeprom_inode_t next_page = file_page->next_page;
+  if (handle->u.ee.cur_page && index >= handle->u.ee.cur_index) {
+    next_page = handle->u.ee.cur_page;
+    pages_skip = index - handle->u.ee.cur_index;
+  } else {
+    vfs_eeprom_read_page(handle->u.ee.file_page, (uint8_t *)buf, SFS_PAGE_SIZE);
+    next_page = file_page->next_page;
+    pages_skip = index;
+  }
+  vfs_eeprom_debug("read; skip %d pages\n", pages_skip);
 
   while(pages_skip) {
     vfs_eeprom_debug("read; skip page: %d\n", next_page);
@@ -263,6 +389,8 @@ vfs_eeprom_read(struct vfs_file_handle_t *handle, void * buffer, vfs_size_t size
     pages_skip --;
     next_page = data_page->next_page;
   }
+  handle->u.ee.cur_page = next_page;
+  handle->u.ee.cur_index = index;
 
   while (count < size) {
     vfs_eeprom_debug("read; read page: %d\n", next_page);
@@ -287,7 +415,14 @@ vfs_eeprom_read(struct vfs_file_handle_t *handle, void * buffer, vfs_size_t size
     count += to_be_copied;
     handle->u.ee.offset += to_be_copied;
     if (eof) break;
+    if (page_offset + to_be_copied < sizeof(data_page->data))
+      break;
+
+    /* page completely consumed, remember the successor */
     next_page = data_page->next_page;
+    if (!next_page) break;
+    handle->u.ee.cur_page = next_page;
+    handle->u.ee.cur_index = ++index;
   }
 
   return count;
@@ -335,6 +470,7 @@ vfs_eeprom_write(struct vfs_file_handle_t *handle, void *data, vfs_size_t len)
   vfs_size_t written_len = len;
 
   if (!handle) return 0;
+  handle->u.ee.cur_page = 0;
   vfs_eeprom_debug("write; file %d, offset %d, len %d\n", handle->u.ee.file_page, handle->u.ee.offset, len);
   /* First we must determine if we need a new blocks at the end */
   vfs_eeprom_inode_t pages_allocated = 0;
@@ -410,12 +546,12 @@ vfs_eeprom_write(struct vfs_file_handle_t *handle, void *data, vfs_size_t len)
 
     vfs_eeprom_debug("write; copy %d byte to page %d at %d\n", copy_len, write_page, write_offset);
     data_page->page_len = write_offset + copy_len;
-    vfs_eeprom_debug("%d, %d, %d, %d\n", write_page, 4 + write_offset, 
-                    data_page->page_len, copy_len);
+    memcpy(data_page->data + write_offset, data, copy_len);
 
-    vfs_eeprom_write_slice(write_page, 4 + write_offset, 
-                    data, copy_len);
-    vfs_eeprom_write_slice(write_page, 3, &data_page->page_len, 1);
+    /* page_len and the data behind it are adjacent, so write them
+     * with a single write cycle */
+    vfs_eeprom_write_slice(write_page, 3, &data_page->page_len,
+                           1 + write_offset + copy_len);
     write_offset = 0;
     write_page = data_page->next_page;
     /* Read the next page */
@@ -74,6 +74,8 @@ struct vfs_eeprom_page_data {
 typedef struct {
   uint16_t file_page; /* the inode, were the file starts */ 
   uint16_t offset; /* the offset from the first  */
+  uint16_t cur_page; /* data page the last read stopped in, 0 if unknown */
+  uint16_t cur_index; /* number of data pages in front of cur_page */
 } vfs_file_handle_eeprom_t;
 
 
@@ -85,6 +87,11 @@ vfs_size_t vfs_eeprom_read(struct vfs_file_handle_t *handle, void *buffer, vfs_s
 vfs_size_t vfs_eeprom_filesize(struct vfs_file_handle_t *handle);
 uint8_t vfs_eeprom_fseek (struct vfs_file_handle_t *handle, vfs_size_t offset, uint8_t whence);
 struct vfs_file_handle_t * vfs_eeprom_create(const char * filename);
+#if SFS_CACHE_LINES > 0
+void vfs_eeprom_sync(void);
+#else
+#define vfs_eeprom_sync()
+#endif
 
 
 #define VFS_EEPROM_FUNCS {				\
@@ -96,7 +103,8 @@ struct vfs_file_handle_t * vfs_eeprom_create(const char * filename);
     vfs_eeprom_fseek,                   \
     NULL,      /* truncate */           \
     vfs_eeprom_create,                  \
-    vfs_eeprom_filesize                \
+    vfs_eeprom_filesize,               \
+    NULL, /* etag */                   \
   }
 
 #endif	/* VFS_EEPROM_H */
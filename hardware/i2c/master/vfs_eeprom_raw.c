@@ -67,6 +67,10 @@ vfs_eeprom_raw_write (struct vfs_file_handle_t *fh, void *buf, vfs_size_t length
   if (length > SFS_PAGE_SIZE) 
     length = SFS_PAGE_SIZE;
   length = i2c_24CXX_write_block(fh->u.ee_raw.inode * SFS_PAGE_SIZE, buf, length);
+#ifdef VFS_EEPROM_SUPPORT
+  /* we bypassed the filesystem cache */
+  vfs_eeprom_sync();
+#endif
   return length;
 }
 
@@ -58,6 +58,7 @@ fs_size_t vfs_df_size (struct vfs_file_handle_t *); */
     NULL, /* truncate */                                \
     vfs_eeprom_raw_open, /* create */                   \
     NULL, /* filesize */                                \
+    NULL, /* etag */                                    \
   }
 
 #endif	/* VFS_EEPROM_RAW_H */
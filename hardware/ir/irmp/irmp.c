@@ -27,6 +27,7 @@
 #include <avr/io.h>
 #include <util/delay.h>
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 
 #include "config.h"
 #include "core/debug.h"
@@ -83,6 +84,72 @@
 #endif
 #define SW_PRESCALER       ((uint8_t)((F_CPU/HW_PRESCALER)/IRMP_HZ))
 
+#ifdef IRMP_RX_EDGE_SUPPORT
+/* In edge mode the timer runs free with the largest prescaler that still
+ * gives three counts per IRMP tick, the overflow interrupt extends it to
+ * 24 bit timestamps. It only switches to the tick rate while sending. */
+#ifndef IRMP_RX_VECTOR
+#error IRMP_RX_EDGE_SUPPORT needs IRMP_RX_USE_INT or IRMP_RX_USE_PCINT in the pinning
+#endif
+#ifdef IRMP_USE_TIMER2
+#if (F_CPU/IRMP_HZ/1024) >= 3
+#define EDGE_PRESCALER     1024UL
+#define SET_EDGE_PRESCALER TC2_PRESCALER_1024
+#elif (F_CPU/IRMP_HZ/256) >= 3
+#define EDGE_PRESCALER     256UL
+#define SET_EDGE_PRESCALER TC2_PRESCALER_256
+#elif (F_CPU/IRMP_HZ/64) >= 3
+#define EDGE_PRESCALER     64UL
+#define SET_EDGE_PRESCALER TC2_PRESCALER_64
+#else
+#define EDGE_PRESCALER     8UL
+#define SET_EDGE_PRESCALER TC2_PRESCALER_8
+#endif
+#define TIMER_COUNTER      TC2_COUNTER_CURRENT
+#define TIMER_COMPARE      TC2_COUNTER_COMPARE
+#define TIMER_COMPARE_ON   TC2_INT_COMPARE_ON
+#define TIMER_COMPARE_OFF  TC2_INT_COMPARE_OFF
+#define TIMER_COMPARE_CLR  TC2_INT_COMPARE_CLR
+#define TIMER_OVERFLOW_ON  TC2_INT_OVERFLOW_ON
+#define TIMER_OVERFLOW_OFF TC2_INT_OVERFLOW_OFF
+#define TIMER_OVERFLOW_TST TC2_INT_OVERFLOW_TST
+#define TIMER_OVERFLOW_CLR TC2_INT_OVERFLOW_CLR
+#define TIMER_OVERFLOW_VECTOR TC2_VECTOR_OVERFLOW
+#else
+#if (F_CPU/IRMP_HZ/1024) >= 3
+#define EDGE_PRESCALER     1024UL
+#define SET_EDGE_PRESCALER TC0_PRESCALER_1024
+#elif (F_CPU/IRMP_HZ/256) >= 3
+#define EDGE_PRESCALER     256UL
+#define SET_EDGE_PRESCALER TC0_PRESCALER_256
+#elif (F_CPU/IRMP_HZ/64) >= 3
+#define EDGE_PRESCALER     64UL
+#define SET_EDGE_PRESCALER TC0_PRESCALER_64
+#else
+#define EDGE_PRESCALER     8UL
+#define SET_EDGE_PRESCALER TC0_PRESCALER_8
+#endif
+#define TIMER_COUNTER      TC0_COUNTER_CURRENT
+#define TIMER_COMPARE      TC0_COUNTER_COMPARE
+#define TIMER_COMPARE_ON   TC0_INT_COMPARE_ON
+#define TIMER_COMPARE_OFF  TC0_INT_COMPARE_OFF
+#define TIMER_COMPARE_CLR  TC0_INT_COMPARE_CLR
+#define TIMER_OVERFLOW_ON  TC0_INT_OVERFLOW_ON
+#define TIMER_OVERFLOW_OFF TC0_INT_OVERFLOW_OFF
+#define TIMER_OVERFLOW_TST TC0_INT_OVERFLOW_TST
+#define TIMER_OVERFLOW_CLR TC0_INT_OVERFLOW_CLR
+#define TIMER_OVERFLOW_VECTOR TC0_VECTOR_OVERFLOW
+#endif
+#define EDGE_HZ            (F_CPU/EDGE_PRESCALER)
+#define EDGE_MASK          0xFFFFFFUL
+/* Longer than any pause the decoder measures (key repetition is 150ms),
+ * silence beyond that is not fed to it. */
+#define EDGE_IDLE          (EDGE_HZ*160/1000)
+#if EDGE_IDLE > 0xFFFF
+#error F_CPU to small for IRMP_RX_EDGE_SUPPORT
+#endif
+#endif
+
 #ifdef STATUSLED_IRMP_RX_SUPPORT
 #ifdef IRMP_RX_LED_LOW_ACTIVE
 #define IRMP_RX_LED_ON     PIN_CLEAR(STATUSLED_IRMP_RX)
@@ -120,6 +187,9 @@
 #define FIFO_SIZE          8
 #define FIFO_NEXT(x)       (((x)+1)&(FIFO_SIZE-1))
 
+#define EDGE_FIFO_SIZE     64
+#define EDGE_FIFO_NEXT(x)  (((x)+1)&(EDGE_FIFO_SIZE-1))
+
 
 ///////////////
 #ifdef F_INTERRUPTS
@@ -175,6 +245,36 @@ static irmp_fifo_t irmp_rx_fifo;
 static irmp_fifo_t irmp_tx_fifo;
 #endif
 
+#ifdef IRMP_RX_EDGE_SUPPORT
+typedef struct
+{
+  uint16_t duration;            /* timer counts since the previous edge */
+  uint8_t data;                 /* input level after the edge */
+} irmp_edge_t;
+
+typedef struct
+{
+  uint8_t read;
+  uint8_t write;
+  irmp_edge_t buffer[EDGE_FIFO_SIZE];
+} irmp_edge_fifo_t;
+
+static irmp_edge_fifo_t irmp_edge_fifo;
+
+/* interrupt side */
+static volatile uint16_t irmp_edge_overflows;
+static uint32_t irmp_edge_time;
+static uint8_t irmp_edge_input;
+#ifdef IRMP_TX_SUPPORT
+static volatile uint8_t irmp_edge_ticking;
+#endif
+
+/* mainloop side */
+static uint8_t irmp_edge_data;
+static uint16_t irmp_edge_fed;
+static uint32_t irmp_edge_rest;
+#endif
+
 #ifdef DEBUG_IRMP
 static const char proto_unknown[] PROGMEM = "unknown";
 static const char proto_sircs[] PROGMEM = "SIRCS";
@@ -255,6 +355,176 @@ const PGM_P const irmp_proto_names[] PROGMEM = {
 #endif
 
 
+#ifdef IRMP_RX_SUPPORT
+static void
+irmp_rx_sample(uint8_t data)
+{
+  if (irmp_rx_process(data) != 0)
+  {
+    uint8_t tmphead = FIFO_NEXT(irmp_rx_fifo.write);
+    if (tmphead != irmp_rx_fifo.read)
+    {
+      if (irmp_rx_get(&irmp_rx_fifo.buffer[tmphead]))
+        irmp_rx_fifo.write = tmphead;
+    }
+  }
+}
+#endif
+
+
+#ifdef IRMP_RX_EDGE_SUPPORT
+/* must be called with interrupts disabled */
+static uint32_t
+irmp_edge_now(void)
+{
+  uint8_t count = TIMER_COUNTER;
+  uint16_t overflows = irmp_edge_overflows;
+  if (TIMER_OVERFLOW_TST && count < 0x80)
+    overflows++;                /* overflow not handled yet */
+  return (uint32_t) overflows << 8 | count;
+}
+
+
+/* must be called with interrupts disabled */
+static void
+irmp_timer_edge(void)
+{
+  SET_EDGE_PRESCALER;
+  TIMER_COMPARE_OFF;
+  TIMER_OVERFLOW_CLR;
+  TIMER_OVERFLOW_ON;
+#ifdef IRMP_TX_SUPPORT
+  irmp_edge_ticking = 0;
+#endif
+  irmp_edge_time = irmp_edge_now();
+}
+
+
+#ifdef IRMP_TX_SUPPORT
+/* must be called with interrupts disabled */
+static void
+irmp_timer_tick(void)
+{
+  irmp_edge_ticking = 1;
+  TIMER_OVERFLOW_OFF;
+  SET_HW_PRESCALER;
+  TIMER_COMPARE = TIMER_COUNTER + SW_PRESCALER;
+  TIMER_COMPARE_CLR;
+  TIMER_COMPARE_ON;
+}
+#endif
+
+
+ISR(TIMER_OVERFLOW_VECTOR)
+{
+  irmp_edge_overflows++;
+}
+
+
+ISR(IRMP_RX_VECTOR)
+{
+  uint8_t data = PIN_HIGH(IRMP_RX) & PIN_BV(IRMP_RX);
+  if (data == irmp_edge_input)
+    return;                     /* other pin of the same PCINT bank */
+  irmp_edge_input = data;
+
+  if (data == IRMP_RX_MARK)
+  {
+    IRMP_RX_LED_ON;
+  }
+  else
+  {
+    IRMP_RX_LED_OFF;
+  }
+
+#ifdef IRMP_TX_SUPPORT
+  if (irmp_edge_ticking)
+    return;                     /* not receiving while sending */
+#endif
+
+  uint32_t now = irmp_edge_now();
+  uint32_t duration = (now - irmp_edge_time) & EDGE_MASK;
+  irmp_edge_time = now;
+
+  /* drop the edge on overrun, the levels stored with the following
+   * ones resynchronize the decoder */
+  uint8_t tmphead = EDGE_FIFO_NEXT(irmp_edge_fifo.write);
+  if (tmphead == irmp_edge_fifo.read)
+    return;
+
+  irmp_edge_fifo.buffer[tmphead].duration =
+    duration > 0xFFFF ? 0xFFFF : duration;
+  irmp_edge_fifo.buffer[tmphead].data = data;
+  irmp_edge_fifo.write = tmphead;
+}
+
+
+/* Replays the interval since the previous edge to the decoder as the
+ * samples the tick interrupt would have taken. The duration is in timer
+ * counts, level is the input after the edge. While level equals the
+ * current one, the edge didn't come yet and the interval is fed as far
+ * as it elapsed. The remainder carries the sampling phase from one
+ * interval to the next, silence is fed up to EDGE_IDLE, so a frame
+ * completes after the usual decoder timeout. */
+void
+irmp_replay(uint16_t duration, uint8_t level)
+{
+  uint32_t counts = duration;
+  if (counts > EDGE_IDLE)
+    counts = EDGE_IDLE;
+
+  uint32_t scaled = irmp_edge_rest + counts * IRMP_HZ;
+  uint16_t ticks = scaled / EDGE_HZ;
+  for (; irmp_edge_fed < ticks; irmp_edge_fed++)
+    irmp_rx_sample(irmp_edge_data);
+
+  if (level == irmp_edge_data)
+    return;
+
+  /* after silence the sampling phase is arbitrary anyway */
+  irmp_edge_rest = counts == EDGE_IDLE ? 0 : scaled % EDGE_HZ;
+  irmp_edge_fed = 0;
+  irmp_edge_data = level;
+}
+
+
+/* Replays the recorded edges, then the time since the last one. */
+void
+irmp_process(void)
+{
+  uint8_t edge;
+
+  do
+  {
+    uint16_t duration;
+    uint8_t level;
+
+    ATOMIC_BLOCK(ATOMIC_FORCEON)
+    {
+      edge = irmp_edge_fifo.read != irmp_edge_fifo.write;
+      if (edge)
+      {
+        irmp_edge_t *edge_p = &irmp_edge_fifo.buffer[irmp_edge_fifo.read =
+                                                     EDGE_FIFO_NEXT
+                                                     (irmp_edge_fifo.read)];
+        duration = edge_p->duration;
+        level = edge_p->data;
+      }
+      else
+      {
+        uint32_t elapsed = (irmp_edge_now() - irmp_edge_time) & EDGE_MASK;
+        duration = elapsed > 0xFFFF ? 0xFFFF : elapsed;
+        level = irmp_edge_data;
+      }
+    }
+
+    irmp_replay(duration, level);
+  }
+  while (edge);
+}
+#endif
+
+
 void
 irmp_init(void)
 {
@@ -274,6 +544,16 @@ irmp_init(void)
   IRMP_TX_LED_OFF;
 #endif
 
+#ifdef IRMP_RX_EDGE_SUPPORT
+  irmp_edge_input = irmp_edge_data = PIN_HIGH(IRMP_RX) & PIN_BV(IRMP_RX);
+  irmp_timer_edge();
+#ifdef IRMP_RX_PCINT_PIN
+  irmp_rx_configure_pcint();
+#else
+  _EIMSK |= _BV(IRMP_RX_INT_PIN);
+  _EICRA = (_EICRA & ~IRMP_RX_INT_ISCMASK) | IRMP_RX_INT_ISC;
+#endif
+#else
   /* init timer0/2 to expire after 1000/IRMP_HZ ms */
 #ifdef IRMP_USE_TIMER2
   SET_HW_PRESCALER;
@@ -286,6 +566,7 @@ irmp_init(void)
   TC0_COUNTER_CURRENT = 0;
   TC0_INT_COMPARE_ON;           /* enable interrupt */
 #endif
+#endif /* IRMP_RX_EDGE_SUPPORT */
 
 #ifdef IRMP_TX_SUPPORT
   PIN_CLEAR(IRMP_TX);
@@ -409,11 +690,20 @@ irmp_write(irmp_data_t * irmp_data_p)
 
   irmp_tx_fifo.buffer[tmphead] = *irmp_data_p;
   irmp_tx_fifo.write = tmphead;
+
+#ifdef IRMP_RX_EDGE_SUPPORT
+  ATOMIC_BLOCK(ATOMIC_FORCEON)
+  {
+    if (!irmp_edge_ticking)
+      irmp_timer_tick();
+  }
+#endif
 }
 
 #endif
 
 
+#if !defined(IRMP_RX_EDGE_SUPPORT) || defined(IRMP_TX_SUPPORT)
 #ifdef IRMP_USE_TIMER2
 ISR(TC2_VECTOR_COMPARE)
 #else
@@ -426,7 +716,7 @@ ISR(TC0_VECTOR_COMPARE)
   TC0_COUNTER_COMPARE += SW_PRESCALER;
 #endif
 
-#ifdef IRMP_RX_SUPPORT
+#if defined(IRMP_RX_SUPPORT) && !defined(IRMP_RX_EDGE_SUPPORT)
   uint8_t data = PIN_HIGH(IRMP_RX) & PIN_BV(IRMP_RX);
 #endif
 
@@ -435,7 +725,7 @@ ISR(TC0_VECTOR_COMPARE)
   {
 #endif
 
-#ifdef IRMP_RX_SUPPORT
+#if defined(IRMP_RX_SUPPORT) && !defined(IRMP_RX_EDGE_SUPPORT)
     if (data == IRMP_RX_MARK)
     {
       IRMP_RX_LED_ON;
@@ -445,27 +735,25 @@ ISR(TC0_VECTOR_COMPARE)
       IRMP_RX_LED_OFF;
     }
 
-    if (irmp_rx_process(data) != 0)
-    {
-      uint8_t tmphead = FIFO_NEXT(irmp_rx_fifo.write);
-      if (tmphead != irmp_rx_fifo.read)
-      {
-        if (irmp_rx_get(&irmp_rx_fifo.buffer[tmphead]))
-          irmp_rx_fifo.write = tmphead;
-      }
-    }
+    irmp_rx_sample(data);
 #endif
 
 #ifdef IRMP_TX_SUPPORT
     if (irmp_tx_fifo.read != irmp_tx_fifo.write)
       irmp_tx_put(&irmp_tx_fifo.buffer[irmp_tx_fifo.read =
                                        FIFO_NEXT(irmp_tx_fifo.read)], 0);
+#ifdef IRMP_RX_EDGE_SUPPORT
+    else
+      irmp_timer_edge();        /* done sending, back to edge timestamps */
+#endif
   }
 #endif
 }
+#endif
 
 /*
   -- Ethersex META --
   header(hardware/ir/irmp/irmp.h)
   init(irmp_init)
+  ifdef(`conf_IRMP_RX_EDGE', `mainloop(irmp_process)')
 */
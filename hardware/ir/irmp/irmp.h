@@ -89,6 +89,7 @@ void irmp_init(void);
 irmp_data_t * irmp_read(void);
 void irmp_write(irmp_data_t *);
 void irmp_process(void);
+void irmp_replay(uint16_t duration, uint8_t level);
 
 #endif /* IRMP_SUPPORT */
 #endif /* IRMP_H */
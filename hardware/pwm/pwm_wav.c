@@ -24,6 +24,8 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "config.h"
 #include "core/debug.h"
@@ -37,46 +39,197 @@
 
 #ifdef VFS_PWM_WAV_SUPPORT
   #include "core/vfs/vfs.h"
-  uint8_t wavebuffer[WAVEBUFFERLEN];
-  uint8_t wavebuffer_pos = WAVEBUFFERLEN;
-  struct vfs_file_handle_t *handle=NULL;
-  uint32_t filesize = 0;
+  /* The ISR plays one buffer while the mainloop refills the other, so
+     no file access happens in the interrupt. */
+  static uint8_t wavebuffer[2][WAVEBUFFERLEN];
+  /* samples left in a buffer, 0 while it waits for the mainloop */
+  static volatile uint8_t wavebuffer_len[2];
+  static uint8_t wavebuffer_pos;
+  static volatile uint8_t wavebuffer_play;
+  static struct vfs_file_handle_t *handle = NULL;
+  /* sample data not read from the file yet */
+  static uint32_t wav_remaining;
+  /* bytes per frame, offset and sign flip of the byte played from it */
+  static uint8_t wav_frame;
+  static uint8_t wav_offset;
+  static uint8_t wav_sign;
+  static uint8_t wav_divisor;
+  static uint8_t wav_prescaler;
+
+  #define WAV_IDLE    0
+  #define WAV_PLAYING 1
+  #define WAV_EOF     2   /* all read, playing the last buffers */
+  #define WAV_DONE    3   /* stopped by the ISR, file still open */
+  static volatile uint8_t wav_state = WAV_IDLE;
+
+  /* samples the mainloop was too late for */
+  uint16_t pwm_wav_underruns;
 #else
   #include "ethersex_wav.h"
   #define PWMSOUNDSIZE sizeof(pwmsound)
+  #define wav_divisor SOUNDDIVISOR
+  #define wav_prescaler (1<<CS00|1<<CS01)
 #endif /* VFS_PWM_WAV_SUPPORT */
 
 uint16_t pwmbytecounter = 0;
 
+static void
+pwm_halt(void)
+{
+	// timer 2 stop
+	TCCR2B = 0;
+
+	// timer 0 stop
+	TCCR0B = 0 ;
+}
+
 //Timer2 Interrupt
 ISR (TIMER0_OVF_vect)
 {
+	TC0_COUNTER_CURRENT = 255 - wav_divisor;
 #ifdef VFS_PWM_WAV_SUPPORT
-    if (wavebuffer_pos == WAVEBUFFERLEN) {
-        if (vfs_read(handle, wavebuffer, WAVEBUFFERLEN) <= 0 ){
-			pwm_stop();
-		}
+    uint8_t play = wavebuffer_play;
+    if (wavebuffer_len[play] == 0) {
+        if (wav_state == WAV_EOF) {
+            pwm_halt();
+            wav_state = WAV_DONE;
+        }
+        else
+            pwm_wav_underruns++;
+        /* keep the last sample */
+        return;
+    }
+    uint8_t s = wavebuffer[play][wavebuffer_pos++];
+    if (--wavebuffer_len[play] == 0) {
         wavebuffer_pos = 0;
+        wavebuffer_play = play ^ 1;
     }
-    uint8_t s = wavebuffer[wavebuffer_pos++];
 #else
 	uint8_t s = pgm_read_byte(&pwmsound[pwmbytecounter]);
 #endif /* VFS_PWM_WAV_SUPPORT */
 #ifdef DEBUG_PWM
     	if (pwmbytecounter < 10 || ((pwmbytecounter % 1000) == 0) ) debug_printf("PWM sound %x at pos %u\n",s, pwmbytecounter);
 #endif
-	TC0_COUNTER_CURRENT = 255 - SOUNDDIVISOR;
 	OCR2A = s;
 	pwmbytecounter++;
-#ifdef VFS_PWM_WAV_SUPPORT
-	if(pwmbytecounter > filesize)
-#else
+#ifndef VFS_PWM_WAV_SUPPORT
 	if(pwmbytecounter > PWMSOUNDSIZE)
-#endif
 	{
 		pwm_stop();
 	}
+#endif
+}
+
+#ifdef VFS_PWM_WAV_SUPPORT
+/* Picks the Timer0 prescaler and reload giving the sample rate,
+   0 if the rate is out of range. */
+static uint8_t
+pwm_wav_rate(uint32_t rate)
+{
+	uint32_t divisor = F_CPU / 8 / rate;
+	wav_prescaler = 1<<CS01;
+	if (divisor > 255) {
+		divisor = F_CPU / 64 / rate;
+		wav_prescaler = 1<<CS00|1<<CS01;
+	}
+	/* leave the ISR some room */
+	if (divisor < 24 || divisor > 255)
+		return 0;
+	wav_divisor = divisor;
+	return 1;
+}
+
+/* Reads the RIFF header up to the sample data.  Files without one are
+   played as raw 8 bit samples at SOUNDFREQ. */
+static uint8_t
+pwm_wav_header(void)
+{
+	struct {
+		char id[4];
+		uint32_t size;
+	} chunk;
+	uint8_t fmt[16];
+
+	wav_frame = 1;
+	wav_offset = 0;
+	wav_sign = 0;
+	pwm_wav_rate(SOUNDFREQ);
+
+	if (vfs_read(handle, &chunk, 8) != 8 || memcmp_P(chunk.id, PSTR("RIFF"), 4)
+	    || vfs_read(handle, chunk.id, 4) != 4 || memcmp_P(chunk.id, PSTR("WAVE"), 4)) {
+		vfs_rewind(handle);
+		wav_remaining = vfs_size(handle);
+		return 1;
+	}
+
+	while (vfs_read(handle, &chunk, 8) == 8) {
+		/* chunks are padded to an even size */
+		uint32_t skip = (chunk.size + 1) & ~1UL;
+		if (memcmp_P(chunk.id, PSTR("data"), 4) == 0) {
+			wav_remaining = chunk.size;
+			return 1;
+		}
+		if (memcmp_P(chunk.id, PSTR("fmt "), 4) == 0) {
+			if (skip < sizeof(fmt) || vfs_read(handle, fmt, sizeof(fmt)) != sizeof(fmt))
+				return 0;
+			skip -= sizeof(fmt);
+			/* PCM, 8 or 16 bit, mono or stereo */
+			uint8_t channels = fmt[2];
+			uint8_t bits = fmt[14];
+			if (fmt[0] != 1 || fmt[1] || channels == 0 || channels > 2 || fmt[3]
+			    || (bits != 8 && bits != 16))
+				return 0;
+			/* 16 bit samples are signed, play the high byte of the
+			   first channel */
+			wav_frame = channels * (bits / 8);
+			wav_offset = bits / 8 - 1;
+			wav_sign = bits == 16 ? 0x80 : 0;
+			if (!pwm_wav_rate(*(uint32_t *) &fmt[4]))
+				return 0;
+		}
+		if (skip && vfs_fseek(handle, skip, SEEK_CUR))
+			return 0;
+	}
+	return 0;
+}
+
+/* Refills the buffer the ISR needs next.  Sample conversion happens
+   here as well, the ISR only copies bytes to the PWM. */
+void
+pwm_wav_mainloop(void)
+{
+	if (wav_state == WAV_DONE)
+		pwm_stop();
+	if (wav_state != WAV_PLAYING)
+		return;
+
+	uint8_t fill = wavebuffer_play;
+	if (wavebuffer_len[fill] != 0) {
+		fill ^= 1;
+		if (wavebuffer_len[fill] != 0)
+			return;
+	}
+
+	vfs_size_t n = WAVEBUFFERLEN;
+	if (n > wav_remaining)
+		n = wav_remaining;
+	n = vfs_read(handle, wavebuffer[fill], n);
+	n -= n % wav_frame;
+	if (n == 0) {
+		wav_state = WAV_EOF;
+		return;
+	}
+	wav_remaining -= n;
+
+	if (wav_frame > 1) {
+		uint8_t *src = wavebuffer[fill] + wav_offset;
+		uint8_t *dst = wavebuffer[fill];
+		for (uint8_t i = 0; i < n; i += wav_frame)
+			*dst++ = src[i] ^ wav_sign;
+	}
+	wavebuffer_len[fill] = n / wav_frame;
 }
+#endif /* VFS_PWM_WAV_SUPPORT */
 
 void
 pwm_wav_init(void)
@@ -84,7 +237,7 @@ pwm_wav_init(void)
 	pwmbytecounter = 0;
 #ifdef DEBUG_PWM
     #ifdef VFS_PWM_WAV_SUPPORT
-    	debug_printf("PWM vfs wav init, size: %lu, %u Hz\n", filesize, SOUNDFREQ );
+    	debug_printf("PWM vfs wav init, size: %lu, divisor %u\n", wav_remaining, wav_divisor );
     #else
     	debug_printf("PWM inline wav init, size: %u, %u Hz\n", PWMSOUNDSIZE, SOUNDFREQ );
     #endif /* VFS_PWM_WAV_SUPPORT */
@@ -97,44 +250,60 @@ pwm_wav_init(void)
 
 	//Set TIMER0
 	TIMSK0 |= (1 << TOIE0);
-	TCCR0B = (1<<CS00|1<<CS01) ;
-	TC0_COUNTER_CURRENT = 255 - SOUNDDIVISOR;
+	TCCR0B = wav_prescaler;
+	TC0_COUNTER_CURRENT = 255 - wav_divisor;
 }
 
 void
 pwm_stop()
 {
+	pwm_halt();
 	pwmbytecounter = 0;
 #ifdef VFS_PWM_WAV_SUPPORT
-    wavebuffer_pos = WAVEBUFFERLEN;
-    vfs_close(handle);
-    filesize=0;
+    wav_state = WAV_IDLE;
+    wavebuffer_len[0] = wavebuffer_len[1] = 0;
+    wavebuffer_pos = 0;
+    wavebuffer_play = 0;
+    if (handle != NULL) {
+        vfs_close(handle);
+        handle = NULL;
+    }
 #endif /* VFS_PWM_WAV_SUPPORT */
 #ifdef DEBUG_PWM
+    #ifdef VFS_PWM_WAV_SUPPORT
+    	debug_printf("PWM stopped, %u underruns\n", pwm_wav_underruns);
+    #else
     	debug_printf("PWM stopped\n");
+    #endif /* VFS_PWM_WAV_SUPPORT */
 #endif
-	// timer 2 stop
-	TCCR2B = 0;
-
-	// timer 0 stop
-	TCCR0B = 0 ;
-
 }
 
 int16_t
 parse_cmd_pwm_wav_play(char *cmd, char *output, uint16_t len)
 {
 #ifdef VFS_PWM_WAV_SUPPORT
-	if (cmd[0] != '\0' ) {
-    	handle = vfs_open(cmd+1);
-		if (handle == NULL) {
+	if (cmd[0] == '\0')
+		return ECMD_ERR_PARSE_ERROR;
+	pwm_stop();
+	handle = vfs_open(cmd+1);
+	if (handle == NULL) {
 #ifdef DEBUG_PWM
-	    	debug_printf("file '%s' not found\n", cmd);
+		debug_printf("file '%s' not found\n", cmd);
 #endif
-    		return ECMD_ERR_READ_ERROR;
-		}
-		filesize = vfs_size(handle);
+		return ECMD_ERR_READ_ERROR;
+	}
+	if (!pwm_wav_header()) {
+#ifdef DEBUG_PWM
+		debug_printf("unsupported wav format\n");
+#endif
+		pwm_stop();
+		return ECMD_ERR_READ_ERROR;
 	}
+	/* fill both buffers before the first sample */
+	pwm_wav_underruns = 0;
+	wav_state = WAV_PLAYING;
+	pwm_wav_mainloop();
+	pwm_wav_mainloop();
 #endif /* VFS_PWM_WAV_SUPPORT */
     pwm_wav_init();
     return ECMD_FINAL_OK;
@@ -147,9 +316,22 @@ parse_cmd_pwm_wav_stop(char *cmd, char *output, uint16_t len)
     return ECMD_FINAL_OK;
 }
 
+#ifdef VFS_PWM_WAV_SUPPORT
+int16_t
+parse_cmd_pwm_wav_underruns(char *cmd, char *output, uint16_t len)
+{
+    return ECMD_FINAL(snprintf_P(output, len, PSTR("%u"), pwm_wav_underruns));
+}
+#endif /* VFS_PWM_WAV_SUPPORT */
+
 /*
   -- Ethersex META --
+  header(hardware/pwm/pwm_wav.h)
+  ifdef(`conf_VFS_PWM_WAV', `mainloop(pwm_wav_mainloop)')
   block([[Sound]]/WAV support)
   ecmd_feature(pwm_wav_play, "pwm wav", <FILENAME>,Play wave file. Use VFS if compiled in. More details at [[Sound]])
   ecmd_feature(pwm_wav_stop, "pwm stop", , Stop wav)
+  ecmd_ifdef(VFS_PWM_WAV_SUPPORT)
+    ecmd_feature(pwm_wav_underruns, "pwm underruns", , Samples the last wav playback had to wait for the file)
+  ecmd_endif
 */
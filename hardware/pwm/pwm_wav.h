@@ -25,8 +25,15 @@
 
 #include <avr/pgmspace.h>
 
-#define WAVEBUFFERLEN 100
+#ifdef VFS_PWM_WAV_SUPPORT
+  // bytes per buffer, holds whole 16 bit stereo frames
+  #define WAVEBUFFERLEN PWM_WAV_BUFFERLEN
+  #if WAVEBUFFERLEN % 4 || WAVEBUFFERLEN > 252
+    #error "PWM_WAV_BUFFERLEN must be a multiple of 4, up to 252"
+  #endif
+#endif /* VFS_PWM_WAV_SUPPORT */
 
+// rate of the inline sound and raw files without wav header
 #define SOUNDFREQ 8000
 #define SOUNDDIVISOR (F_CPU/64/SOUNDFREQ)
 
@@ -37,5 +44,6 @@
 
 void pwm_wav_init(void);
 void pwm_stop(void);
+void pwm_wav_mainloop(void);
 
 #endif /* _PWM_WAV_H */
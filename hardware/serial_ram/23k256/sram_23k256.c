@@ -56,9 +56,9 @@
 *
 * @param address_ui16 RAM address to start reading from.
 * @param dataPtr_pui8 Pointer to destination
-* @param len_ui8 Number of bytes to be read
+* @param len_ui16 Number of bytes to be read, may cross page borders
 */
-void sram23k256_read(uint16_t address_ui16, uint8_t dataPtr_pui8[], uint8_t len_ui8)
+void sram23k256_read(uint16_t address_ui16, uint8_t dataPtr_pui8[], uint16_t len_ui16)
 {
   uint16_t ctr = 0;
 
@@ -71,7 +71,7 @@ void sram23k256_read(uint16_t address_ui16, uint8_t dataPtr_pui8[], uint8_t len_
   spi_send(LO8(address_ui16));
 
   /* Read data from chip */
-  for (ctr = 0; ctr < len_ui8; ctr++)
+  for (ctr = 0; ctr < len_ui16; ctr++)
   {
     dataPtr_pui8[ctr] = spi_send(0);
   }
@@ -88,9 +88,9 @@ void sram23k256_read(uint16_t address_ui16, uint8_t dataPtr_pui8[], uint8_t len_
 *
 * @param address_ui16 RAM address to start writing to.
 * @param dataPtr_pui8 Pointer to source.
-* @param len_ui8 Number of bytes to be written
+* @param len_ui16 Number of bytes to be written, may cross page borders
 */
-void sram23k256_write(uint16_t address_ui16, uint8_t dataPtr_pui8[], uint8_t len_ui8)
+void sram23k256_write(uint16_t address_ui16, uint8_t dataPtr_pui8[], uint16_t len_ui16)
 {
   uint16_t ctr = 0;
 
@@ -103,7 +103,7 @@ void sram23k256_write(uint16_t address_ui16, uint8_t dataPtr_pui8[], uint8_t len
   spi_send(LO8(address_ui16));
 
   /* Write data to chip */
-  for (ctr = 0; ctr < len_ui8; ctr++)
+  for (ctr = 0; ctr < len_ui16; ctr++)
   {
      spi_send(dataPtr_pui8[ctr]);
   }
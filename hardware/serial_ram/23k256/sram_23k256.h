@@ -25,11 +25,25 @@
 
 #define SRAM23K256_SIZE 32768  /* Size of the RAM in bytes */
 
+#include "config.h"
+
+/* Memory map: camera images at the top, the block cache below */
+#ifdef SER_RAM_DC3840_SUPPORT
+#ifdef SER_RAM_CACHE_SUPPORT
+#define SRAM23K256_DC3840_SIZE (SRAM23K256_SIZE / 2)
+#else
+#define SRAM23K256_DC3840_SIZE SRAM23K256_SIZE
+#endif
+#else
+#define SRAM23K256_DC3840_SIZE 0
+#endif
+#define SRAM23K256_DC3840_BASE (SRAM23K256_SIZE - SRAM23K256_DC3840_SIZE)
+#define SRAM23K256_CACHE_SIZE SRAM23K256_DC3840_BASE
+
 int16_t sram23k256_init(void);
-void sram23k256_read(uint16_t address_ui16, uint8_t dataPtr_pui8[], uint8_t len_ui8);
-void sram23k256_write(uint16_t address_ui16, uint8_t dataPtr_pui8[], uint8_t len_ui8);
+void sram23k256_read(uint16_t address_ui16, uint8_t dataPtr_pui8[], uint16_t len_ui16);
+void sram23k256_write(uint16_t address_ui16, uint8_t dataPtr_pui8[], uint16_t len_ui16);
 
-#include "config.h"
 #ifdef DEBUG_SER_RAM_23K256
 # include "core/debug.h"
 # define SERRAMDEBUG(a...)  debug_printf("serial ram: " a)
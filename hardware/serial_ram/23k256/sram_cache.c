@@ -0,0 +1,418 @@
+/*
+ *
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "sram_23k256.h"
+#include "sram_cache.h"
+
+#ifdef SER_RAM_CACHE_SUPPORT
+
+#if SRAM_CACHE_BLOCKS < 2 || SRAM_CACHE_BLOCKS > 128 || \
+    SRAM_CACHE_BLOCKS * SER_RAM_CACHE_BLOCK_SIZE != SRAM23K256_CACHE_SIZE
+#error "SER_RAM_CACHE_BLOCK_SIZE must be a power of two, from 256 up to half the cache size"
+#endif
+
+/* Flag or'ed to the owner in the tag of a block */
+#define SRAM_CACHE_DIRTY 0x80
+
+/* Bytes staged in RAM per call of a write back function */
+#define SRAM_CACHE_CHUNK 32
+
+static uint32_t sram_cache_block[SRAM_CACHE_BLOCKS];
+static uint8_t sram_cache_tag[SRAM_CACHE_BLOCKS];
+/* LRU rank, 0 is the block used last */
+static uint8_t sram_cache_age[SRAM_CACHE_BLOCKS];
+
+static sram_cache_write_back_t sram_cache_write_back[SRAM_CACHE_OWNERS];
+
+#define sram_cache_address(slot) ((uint16_t) (slot) * SER_RAM_CACHE_BLOCK_SIZE)
+
+/**
+* @brief Looks up a block
+*
+* @param owner User of the cache
+* @param block Block number of the owner
+* @return The slot holding the block, 0xff if it is not cached
+*/
+static uint8_t sram_cache_find(uint8_t owner, uint32_t block)
+{
+  for (uint8_t slot = 0; slot < SRAM_CACHE_BLOCKS; slot++)
+  {
+    if ((sram_cache_tag[slot] & ~SRAM_CACHE_DIRTY) == owner &&
+        sram_cache_block[slot] == block)
+    {
+      return slot;
+    }
+  }
+  return 0xff;
+}
+
+/**
+* @brief Marks a slot as used last
+*
+* @param slot Slot to move to the front of the LRU order
+*/
+static void sram_cache_touch(uint8_t slot)
+{
+  uint8_t age = sram_cache_age[slot];
+  for (uint8_t i = 0; i < SRAM_CACHE_BLOCKS; i++)
+  {
+    if (sram_cache_age[i] < age)
+    {
+      sram_cache_age[i]++;
+    }
+  }
+  sram_cache_age[slot] = 0;
+}
+
+/**
+* @brief Writes a dirty block back to its owner
+*
+* The block is copied to the owner in chunks, so no block sized
+* buffer is needed in RAM.
+*
+* @param slot Slot to clean
+* @return 0 on failure, the block stays dirty then
+*/
+static uint8_t sram_cache_clean(uint8_t slot)
+{
+  uint8_t chunk[SRAM_CACHE_CHUNK];
+  uint8_t owner = sram_cache_tag[slot] & ~SRAM_CACHE_DIRTY;
+
+  if (!(sram_cache_tag[slot] & SRAM_CACHE_DIRTY))
+  {
+    return 1;
+  }
+
+  for (uint16_t offset = 0; offset < SER_RAM_CACHE_BLOCK_SIZE;
+       offset += SRAM_CACHE_CHUNK)
+  {
+    sram23k256_read(sram_cache_address(slot) + offset, chunk, SRAM_CACHE_CHUNK);
+    if (!sram_cache_write_back[owner](sram_cache_block[slot], offset, chunk,
+                                      SRAM_CACHE_CHUNK))
+    {
+      SERRAMDEBUG("write back of block %lu failed\n",
+                  (unsigned long) sram_cache_block[slot]);
+      return 0;
+    }
+  }
+
+  sram_cache_tag[slot] = owner;
+  return 1;
+}
+
+/**
+* @brief Makes room for a block
+*
+* Takes an unused slot or evicts the least recently used block.
+* Unused slots are zero, so this works before the init as well.
+*
+* @return The slot, 0xff if the block to evict could not be written back
+*/
+static uint8_t sram_cache_victim(void)
+{
+  uint8_t victim = 0;
+
+  for (uint8_t slot = 0; slot < SRAM_CACHE_BLOCKS; slot++)
+  {
+    if (sram_cache_tag[slot] == SRAM_CACHE_FREE)
+    {
+      return slot;
+    }
+    if (sram_cache_age[slot] > sram_cache_age[victim])
+    {
+      victim = slot;
+    }
+  }
+
+  if (!sram_cache_clean(victim))
+  {
+    return 0xff;
+  }
+  sram_cache_tag[victim] = SRAM_CACHE_FREE;
+  return victim;
+}
+
+/**
+* @brief Initialization during boot-up
+*
+* Starts with an empty cache, runs after the RAM has been cleared.
+*
+* @param void
+*/
+int16_t sram_cache_init(void)
+{
+  for (uint8_t slot = 0; slot < SRAM_CACHE_BLOCKS; slot++)
+  {
+    sram_cache_tag[slot] = SRAM_CACHE_FREE;
+    sram_cache_age[slot] = slot;
+  }
+  return 0;
+}
+
+/**
+* @brief Enables write-back caching for an owner
+*
+* Without a write back function, sram_cache_write() refuses all
+* writes and the owner has to write through with sram_cache_update().
+*
+* @param owner User of the cache
+* @param write_back Function writing dirty blocks to the store
+*/
+void sram_cache_register(uint8_t owner, sram_cache_write_back_t write_back)
+{
+  sram_cache_write_back[owner] = write_back;
+}
+
+/**
+* @brief Reads cached data
+*
+* @param owner User of the cache
+* @param block Block number of the owner
+* @param offset Offset within the block
+* @param data Destination
+* @param len Number of bytes, must not cross the end of the block
+* @return 1 on a hit, 0 if the block is not cached
+*/
+uint8_t sram_cache_read(uint8_t owner, uint32_t block, uint16_t offset,
+                        void *data, uint16_t len)
+{
+  uint8_t slot = sram_cache_find(owner, block);
+  if (slot == 0xff)
+  {
+    return 0;
+  }
+
+  sram23k256_read(sram_cache_address(slot) + offset, data, len);
+  sram_cache_touch(slot);
+  return 1;
+}
+
+/**
+* @brief Adds a block read from the store
+*
+* A block that is already cached keeps its content if it is dirty,
+* as it is newer than the store then.
+*
+* @param owner User of the cache
+* @param block Block number of the owner
+* @param data The whole block
+* @return 0 if no slot could be freed
+*/
+uint8_t sram_cache_insert(uint8_t owner, uint32_t block, const void *data)
+{
+  uint8_t slot = sram_cache_find(owner, block);
+  if (slot == 0xff)
+  {
+    slot = sram_cache_victim();
+    if (slot == 0xff)
+    {
+      return 0;
+    }
+    sram_cache_block[slot] = block;
+    sram_cache_tag[slot] = owner;
+  }
+
+  if (!(sram_cache_tag[slot] & SRAM_CACHE_DIRTY))
+  {
+    sram23k256_write(sram_cache_address(slot), (uint8_t *) data,
+                     SER_RAM_CACHE_BLOCK_SIZE);
+  }
+  sram_cache_touch(slot);
+  return 1;
+}
+
+/**
+* @brief Adds a block read from the store by a function
+*
+* For stores without a block sized buffer in RAM, the block is
+* copied into the serial RAM in chunks.
+*
+* @param owner User of the cache
+* @param block Block number of the owner
+* @param read Function reading chunks of the block from the store
+* @return 1 if the block is cached now
+*/
+uint8_t sram_cache_fetch(uint8_t owner, uint32_t block, sram_cache_read_t read)
+{
+  uint8_t chunk[SRAM_CACHE_CHUNK];
+
+  if (sram_cache_find(owner, block) != 0xff)
+  {
+    return 1;
+  }
+
+  uint8_t slot = sram_cache_victim();
+  if (slot == 0xff)
+  {
+    return 0;
+  }
+
+  for (uint16_t offset = 0; offset < SER_RAM_CACHE_BLOCK_SIZE;
+       offset += SRAM_CACHE_CHUNK)
+  {
+    if (!read(block, offset, chunk, SRAM_CACHE_CHUNK))
+    {
+      /* the slot stays unused */
+      return 0;
+    }
+    sram23k256_write(sram_cache_address(slot) + offset, chunk,
+                     SRAM_CACHE_CHUNK);
+  }
+
+  sram_cache_block[slot] = block;
+  sram_cache_tag[slot] = owner;
+  sram_cache_touch(slot);
+  return 1;
+}
+
+/**
+* @brief Drops a block that is not needed anymore
+*
+* Its slot is taken first by the next block added.  A dirty block is
+* written back before.
+*
+* @param owner User of the cache
+* @param block Block number of the owner
+*/
+void sram_cache_discard(uint8_t owner, uint32_t block)
+{
+  uint8_t slot = sram_cache_find(owner, block);
+  if (slot != 0xff && sram_cache_clean(slot))
+  {
+    sram_cache_tag[slot] = SRAM_CACHE_FREE;
+  }
+}
+
+/**
+* @brief Write-through: updates a cached block written to the store
+*
+* @param owner User of the cache
+* @param block Block number of the owner
+* @param offset Offset within the block
+* @param data Data written to the store
+* @param len Number of bytes, must not cross the end of the block
+* @return 1 if the block is cached
+*/
+uint8_t sram_cache_update(uint8_t owner, uint32_t block, uint16_t offset,
+                          const void *data, uint16_t len)
+{
+  uint8_t slot = sram_cache_find(owner, block);
+  if (slot == 0xff)
+  {
+    return 0;
+  }
+
+  sram23k256_write(sram_cache_address(slot) + offset, (uint8_t *) data, len);
+  return 1;
+}
+
+/**
+* @brief Write-back: writes to the cache only
+*
+* The store is written once the block is evicted or flushed.  A block
+* not cached yet is only taken if it is written as a whole.
+*
+* @param owner User of the cache, with a write back function registered
+* @param block Block number of the owner
+* @param offset Offset within the block
+* @param data Data to write
+* @param len Number of bytes, must not cross the end of the block
+* @return 0 if the owner has to write to the store itself
+*/
+uint8_t sram_cache_write(uint8_t owner, uint32_t block, uint16_t offset,
+                         const void *data, uint16_t len)
+{
+  if (!sram_cache_write_back[owner])
+  {
+    return 0;
+  }
+
+  uint8_t slot = sram_cache_find(owner, block);
+  if (slot == 0xff)
+  {
+    if (offset != 0 || len != SER_RAM_CACHE_BLOCK_SIZE)
+    {
+      return 0;
+    }
+    slot = sram_cache_victim();
+    if (slot == 0xff)
+    {
+      return 0;
+    }
+    sram_cache_block[slot] = block;
+  }
+
+  sram23k256_write(sram_cache_address(slot) + offset, (uint8_t *) data, len);
+  sram_cache_tag[slot] = owner | SRAM_CACHE_DIRTY;
+  sram_cache_touch(slot);
+  return 1;
+}
+
+/**
+* @brief Writes all dirty blocks of an owner back
+*
+* @param owner User of the cache
+* @return 0 if a block could not be written back
+*/
+uint8_t sram_cache_flush(uint8_t owner)
+{
+  uint8_t ret = 1;
+
+  for (uint8_t slot = 0; slot < SRAM_CACHE_BLOCKS; slot++)
+  {
+    if (sram_cache_tag[slot] == (owner | SRAM_CACHE_DIRTY) &&
+        !sram_cache_clean(slot))
+    {
+      ret = 0;
+    }
+  }
+  return ret;
+}
+
+/**
+* @brief Drops all blocks of an owner, e.g. when its medium changed
+*
+* Dirty blocks are dropped without being written back.
+*
+* @param owner User of the cache
+*/
+void sram_cache_invalidate(uint8_t owner)
+{
+  for (uint8_t slot = 0; slot < SRAM_CACHE_BLOCKS; slot++)
+  {
+    if ((sram_cache_tag[slot] & ~SRAM_CACHE_DIRTY) == owner)
+    {
+      sram_cache_tag[slot] = SRAM_CACHE_FREE;
+    }
+  }
+}
+
+/*
+  -- Ethersex META --
+  header(hardware/serial_ram/23k256/sram_cache.h)
+  init(sram_cache_init)
+*/
+#endif /* SER_RAM_CACHE_SUPPORT */
@@ -0,0 +1,66 @@
+/*
+ *
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef HAVE_SRAM_CACHE_H
+#define HAVE_SRAM_CACHE_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "sram_23k256.h"
+
+#define SRAM_CACHE_BLOCKS (SRAM23K256_CACHE_SIZE / SER_RAM_CACHE_BLOCK_SIZE)
+
+/* Users of the cache, each one has its own block numbers */
+enum sram_cache_owner_t
+{
+  SRAM_CACHE_FREE,      /* tag of unused blocks */
+  SRAM_CACHE_SD,
+  SRAM_CACHE_EEPROM,
+  SRAM_CACHE_OWNERS
+};
+
+/* Writes len bytes of a dirty block, starting at offset, back to the store.
+ * Called with chunks of a block on eviction and flush, returns 0 on failure. */
+typedef uint8_t (*sram_cache_write_back_t)(uint32_t block, uint16_t offset,
+                                           const uint8_t *data, uint8_t len);
+
+/* Reads len bytes of a block, starting at offset, from the store.
+ * Called with chunks of a block by sram_cache_fetch(), returns 0 on failure. */
+typedef uint8_t (*sram_cache_read_t)(uint32_t block, uint16_t offset,
+                                     uint8_t *data, uint8_t len);
+
+int16_t sram_cache_init(void);
+void sram_cache_register(uint8_t owner, sram_cache_write_back_t write_back);
+uint8_t sram_cache_read(uint8_t owner, uint32_t block, uint16_t offset,
+                        void *data, uint16_t len);
+uint8_t sram_cache_insert(uint8_t owner, uint32_t block, const void *data);
+uint8_t sram_cache_fetch(uint8_t owner, uint32_t block, sram_cache_read_t read);
+void sram_cache_discard(uint8_t owner, uint32_t block);
+uint8_t sram_cache_update(uint8_t owner, uint32_t block, uint16_t offset,
+                          const void *data, uint16_t len);
+uint8_t sram_cache_write(uint8_t owner, uint32_t block, uint16_t offset,
+                         const void *data, uint16_t len);
+uint8_t sram_cache_flush(uint8_t owner);
+void sram_cache_invalidate(uint8_t owner);
+
+#endif  /* HAVE_SRAM_CACHE_H */
@@ -55,6 +55,7 @@ vfs_size_t vfs_df_size (struct vfs_file_handle_t *);
     vfs_df_truncate,				\
     vfs_df_create,				\
     vfs_df_size,				\
+    NULL, /* etag */				\
   }
 
 #endif	/* VFS_DF_H */
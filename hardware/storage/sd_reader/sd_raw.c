@@ -11,6 +11,9 @@
 #include <string.h>
 #include <avr/io.h>
 #include "sd_raw.h"
+#ifdef SER_RAM_CACHE_SD
+#include "hardware/serial_ram/23k256/sram_cache.h"
+#endif
 
 /**
  * \addtogroup sd_raw MMC/SD/SDHC card raw access
@@ -158,6 +161,47 @@ static uint8_t raw_block_written;
 /* card type state */
 static uint8_t sd_raw_card_type;
 
+#if SD_RAW_SDHC
+#define sd_raw_block_arg(block_address) \
+    (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? (block_address) / 512 : (block_address))
+#else
+#define sd_raw_block_arg(block_address) (block_address)
+#endif
+
+#ifdef SD_MULTIBLOCK_SUPPORT
+/* Multi-block transfer left open by the last access, if any.  The card
+ * keeps it running while deselected, so the next block of a sequential
+ * access costs no command.
+ */
+#define SD_RAW_STREAM_NONE 0
+#define SD_RAW_STREAM_READ 1
+#define SD_RAW_STREAM_WRITE 2
+static uint8_t sd_raw_stream;
+/* block the open transfer continues with */
+static offset_t sd_raw_stream_address;
+#endif
+
+#if defined(SD_MULTIBLOCK_SUPPORT) || SD_CACHE_BLOCKS > 0 || defined(SER_RAM_CACHE_SD)
+/* last block read from the card, to detect sequential reads */
+static offset_t sd_raw_last_read;
+#endif
+
+#if SD_CACHE_BLOCKS > 0
+/* Blocks read at random, i.e. FAT and directory sectors most of the
+ * time, least recently used ones are replaced first.  Blocks read
+ * sequentially take up one slot at most, so that reading a file doesn't
+ * evict everything else.
+ */
+static uint8_t sd_raw_cache[SD_CACHE_BLOCKS][512];
+static offset_t sd_raw_cache_address[SD_CACHE_BLOCKS];
+/* 0 is the most recently used block */
+static uint8_t sd_raw_cache_age[SD_CACHE_BLOCKS];
+#endif
+
+#if defined(SER_RAM_CACHE_SD) && SER_RAM_CACHE_BLOCK_SIZE != 512
+#error "Caching SD card blocks needs a serial RAM cache block size of 512"
+#endif
+
 /* private helper functions */
 #if 0
 static void sd_raw_send_byte(uint8_t b);
@@ -168,6 +212,9 @@ static uint8_t sd_raw_rec_byte(void);
 #define sd_raw_rec_byte() spi_send(0xff)
 #endif
 static uint8_t sd_raw_send_command(uint8_t command, uint32_t arg);
+#if SD_RAW_WRITE_SUPPORT
+static uint8_t sd_raw_flush(offset_t next);
+#endif
 
 
 /**
@@ -207,6 +254,23 @@ uint8_t sd_raw_init(void)
 
     /* initialization procedure */
     sd_raw_card_type = 0;
+#ifdef SD_MULTIBLOCK_SUPPORT
+    sd_raw_stream = SD_RAW_STREAM_NONE;
+#endif
+#if defined(SD_MULTIBLOCK_SUPPORT) || SD_CACHE_BLOCKS > 0 || defined(SER_RAM_CACHE_SD)
+    sd_raw_last_read = (offset_t) -1;
+#endif
+#if SD_CACHE_BLOCKS > 0
+    /* might be another card */
+    for(uint8_t i = 0; i < SD_CACHE_BLOCKS; ++i)
+    {
+        sd_raw_cache_address[i] = (offset_t) -1;
+        sd_raw_cache_age[i] = i;
+    }
+#endif
+#ifdef SER_RAM_CACHE_SD
+    sram_cache_invalidate(SRAM_CACHE_SD);
+#endif
     
     if(!sd_raw_available())
     {
@@ -439,6 +503,10 @@ uint8_t sd_raw_send_command(uint8_t command, uint32_t arg)
            break;
     }
     
+    /* the byte following CMD12 is garbage */
+    if(command == CMD_STOP_TRANSMISSION)
+        sd_raw_rec_byte();
+
     /* receive response */
     for(uint8_t i = 0; i < 10; ++i)
     {
@@ -450,6 +518,280 @@ uint8_t sd_raw_send_command(uint8_t command, uint32_t arg)
     return response;
 }
 
+#ifdef SD_MULTIBLOCK_SUPPORT
+/**
+ * \ingroup sd_raw
+ * Ends the multi-block transfer left open by the last access, if any.
+ */
+static void sd_raw_stream_stop(void)
+{
+    if(sd_raw_stream == SD_RAW_STREAM_NONE)
+        return;
+
+    select_card();
+
+#if SD_RAW_WRITE_SUPPORT
+    if(sd_raw_stream == SD_RAW_STREAM_WRITE)
+    {
+        /* send stop transmission token */
+        sd_raw_rec_byte();
+        sd_raw_send_byte(0xfd);
+        sd_raw_rec_byte();
+    }
+    else
+#endif
+    {
+        sd_raw_send_command(CMD_STOP_TRANSMISSION, 0);
+    }
+    sd_raw_stream = SD_RAW_STREAM_NONE;
+
+    /* wait while card is busy */
+    while(sd_raw_rec_byte() != 0xff);
+
+    /* deaddress card */
+    unselect_card();
+    sd_raw_rec_byte();
+}
+#else
+#define sd_raw_stream_stop() do { } while(0)
+#endif
+
+#if SD_CACHE_BLOCKS > 0
+/**
+ * \ingroup sd_raw
+ * Looks up a block in the sector cache.
+ *
+ * \returns The cache slot, or 0xff if the block is not cached.
+ */
+static uint8_t sd_raw_cache_find(offset_t block_address)
+{
+    for(uint8_t i = 0; i < SD_CACHE_BLOCKS; ++i)
+        if(sd_raw_cache_address[i] == block_address)
+            return i;
+
+    return 0xff;
+}
+
+/**
+ * \ingroup sd_raw
+ * Marks a cache slot as the most recently used one.
+ */
+static void sd_raw_cache_touch(uint8_t slot)
+{
+    uint8_t age = sd_raw_cache_age[slot];
+    for(uint8_t i = 0; i < SD_CACHE_BLOCKS; ++i)
+        if(sd_raw_cache_age[i] < age)
+            ++sd_raw_cache_age[i];
+
+    sd_raw_cache_age[slot] = 0;
+}
+
+/**
+ * \ingroup sd_raw
+ * Finds the least recently used cache slot.
+ */
+static uint8_t sd_raw_cache_victim(void)
+{
+    uint8_t i = 0;
+    while(sd_raw_cache_age[i] != SD_CACHE_BLOCKS - 1)
+        ++i;
+
+    return i;
+}
+#endif
+
+/**
+ * \ingroup sd_raw
+ * Reads one block from the card, keeping bytes \c from up to \c to of it.
+ *
+ * With multi-block support and \c stream set, a read following the
+ * previously read block starts a multi-block transfer, which later reads
+ * simply continue.
+ *
+ * \param[in] block_address The address of the block.
+ * \param[out] buffer The buffer into which to write the data.
+ * \param[in] from The offset within the block of the first byte to keep.
+ * \param[in] to The offset within the block behind the last byte to keep.
+ * \param[in] stream Whether to start a multi-block transfer if sequential.
+ * \returns 0 on failure, 1 on success.
+ */
+static uint8_t sd_raw_read_block(offset_t block_address, uint8_t* buffer, uint16_t from, uint16_t to, uint8_t stream)
+{
+#ifdef SD_MULTIBLOCK_SUPPORT
+    if(sd_raw_stream == SD_RAW_STREAM_READ && block_address == sd_raw_stream_address)
+    {
+        /* address card, the transfer is still running */
+        select_card();
+    }
+    else
+    {
+        sd_raw_stream_stop();
+
+        uint8_t command = CMD_READ_SINGLE_BLOCK;
+        if(stream && block_address == sd_raw_last_read + 512)
+            command = CMD_READ_MULTIPLE_BLOCK;
+
+        /* address card */
+        select_card();
+
+        /* send block request */
+        if(sd_raw_send_command(command, sd_raw_block_arg(block_address)))
+        {
+            unselect_card();
+            return 0;
+        }
+
+        if(command == CMD_READ_MULTIPLE_BLOCK)
+            sd_raw_stream = SD_RAW_STREAM_READ;
+    }
+#else
+    /* address card */
+    select_card();
+
+    /* send single block request */
+    if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, sd_raw_block_arg(block_address)))
+    {
+        unselect_card();
+        return 0;
+    }
+#endif
+
+    /* wait for data block (start byte 0xfe) */
+#ifdef SD_READ_TIMEOUT
+    uint16_t timeout = 20000;
+
+    while(sd_raw_rec_byte() != 0xfe && timeout > 0)
+        timeout --;
+
+    if (timeout == 0)
+    {
+        SDDEBUGRAW ("read timeout reached!\n");
+        unselect_card();
+#ifdef SD_MULTIBLOCK_SUPPORT
+        /* don't wait for a card that doesn't answer */
+        sd_raw_stream = SD_RAW_STREAM_NONE;
+#endif
+        return 0;
+    }
+#else
+    while(sd_raw_rec_byte() != 0xfe);
+#endif
+
+    /* read byte block */
+    for(uint16_t i = 0; i < 512; ++i)
+    {
+        uint8_t b = sd_raw_rec_byte();
+        if(i >= from && i < to)
+            *buffer++ = b;
+    }
+
+    /* read crc16 */
+    sd_raw_rec_byte();
+    sd_raw_rec_byte();
+
+    /* deaddress card */
+    unselect_card();
+
+    /* let card some time to finish */
+    sd_raw_rec_byte();
+
+#if defined(SD_MULTIBLOCK_SUPPORT) || SD_CACHE_BLOCKS > 0 || defined(SER_RAM_CACHE_SD)
+    sd_raw_last_read = block_address;
+#endif
+#ifdef SD_MULTIBLOCK_SUPPORT
+    sd_raw_stream_address = block_address + 512;
+#endif
+
+    return 1;
+}
+
+#ifdef SER_RAM_CACHE_SD
+/**
+ * \ingroup sd_raw
+ * Reads bytes \c from up to \c to of a block, trying the serial RAM first.
+ *
+ * Whole blocks read at random are added to the serial RAM cache.  Of
+ * blocks read sequentially only the last two are kept, each one
+ * replacing the block two before it, so a retransmit of the file
+ * content just sent is served from the serial RAM, but reading a file
+ * doesn't evict the FAT.
+ *
+ * \see sd_raw_read_block
+ */
+static uint8_t sd_raw_read_sram(offset_t block_address, uint8_t* buffer, uint16_t from, uint16_t to, uint8_t stream)
+{
+    uint32_t block = block_address / 512;
+    uint8_t sequential = (block_address == sd_raw_last_read + 512);
+    if(sram_cache_read(SRAM_CACHE_SD, block, from, buffer, to - from))
+    {
+        /* a sequence running through a cached block goes on after it */
+        if(sequential)
+            sd_raw_last_read = block_address;
+        return 1;
+    }
+
+    if(!sd_raw_read_block(block_address, buffer, from, to, stream))
+        return 0;
+
+    if(from == 0 && to == 512)
+    {
+        if(sequential)
+            sram_cache_discard(SRAM_CACHE_SD, block - 2);
+        sram_cache_insert(SRAM_CACHE_SD, block, buffer);
+    }
+
+    return 1;
+}
+#else
+#define sd_raw_read_sram sd_raw_read_block
+#endif
+
+/**
+ * \ingroup sd_raw
+ * Reads bytes \c from up to \c to of a block, using the sector cache.
+ *
+ * Blocks read at random are read into the cache as a whole.  Blocks
+ * read sequentially bypass it, unless there is no block buffer, in which
+ * case they replace the previous block of the sequence.
+ *
+ * \see sd_raw_read_block
+ */
+static uint8_t sd_raw_fetch(offset_t block_address, uint8_t* buffer, uint16_t from, uint16_t to, uint8_t stream)
+{
+#if SD_CACHE_BLOCKS > 0
+    uint8_t slot = sd_raw_cache_find(block_address);
+    if(slot == 0xff)
+    {
+        uint8_t sequential = (block_address == sd_raw_last_read + 512);
+#if SD_RAW_SAVE_RAM
+        if(sequential)
+            slot = sd_raw_cache_find(sd_raw_last_read);
+        if(slot == 0xff)
+#else
+        if(sequential)
+            return sd_raw_read_sram(block_address, buffer, from, to, stream);
+#endif
+            slot = sd_raw_cache_victim();
+
+        sd_raw_cache_address[slot] = (offset_t) -1;
+        if(!sd_raw_read_sram(block_address, sd_raw_cache[slot], 0, 512, stream))
+            return 0;
+        sd_raw_cache_address[slot] = block_address;
+    }
+    else if(block_address == sd_raw_last_read + 512)
+    {
+        /* a sequence running through a cached block goes on after it */
+        sd_raw_last_read = block_address;
+    }
+
+    sd_raw_cache_touch(slot);
+    memcpy(buffer, sd_raw_cache[slot] + from, to - from);
+    return 1;
+#else
+    return sd_raw_read_sram(block_address, buffer, from, to, stream);
+#endif
+}
+
 /**
  * \ingroup sd_raw
  * Reads raw data from the card.
@@ -480,70 +822,26 @@ uint8_t sd_raw_read(offset_t offset, uint8_t* buffer, uintptr_t length)
 #endif
         {
 #if SD_RAW_WRITE_BUFFERING
-            if(!sd_raw_sync())
+            if(!sd_raw_flush((offset_t) -1))
                 return 0;
 #endif
 
-            /* address card */
-            select_card();
-
-            /* send single block request */
-#if SD_RAW_SDHC
-            if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
-#else
-            if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, block_address))
-#endif
-            {
-                unselect_card();
-                return 0;
-            }
-
-            /* wait for data block (start byte 0xfe) */
-#ifdef SD_READ_TIMEOUT
-            uint16_t timeout = 20000;
-
-            while(sd_raw_rec_byte() != 0xfe && timeout > 0)
-                timeout --;
-
-            if (timeout == 0)
-            {
-                SDDEBUGRAW ("read timeout reached!\n");
-                unselect_card();
-                return 0;
-            }
-#else
-            while(sd_raw_rec_byte() != 0xfe);
-#endif
-
 #if SD_RAW_SAVE_RAM
-            /* read byte block */
-            uint16_t read_to = block_offset + read_length;
-            for(uint16_t i = 0; i < 512; ++i)
-            {
-                uint8_t b = sd_raw_rec_byte();
-                if(i >= block_offset && i < read_to)
-                    *buffer++ = b;
-            }
+            /* without a buffer for it, a block read in parts is read
+             * once per part, which a multi-block read can't do
+             */
+            if(!sd_raw_fetch(block_address, buffer, block_offset, block_offset + read_length,
+                             SD_CACHE_BLOCKS > 0 || read_length == 512))
+                return 0;
 #else
-            /* read byte block */
-            uint8_t* cache = raw_block;
-            for(uint16_t i = 0; i < 512; ++i)
-                *cache++ = sd_raw_rec_byte();
+            raw_block_address = (offset_t) -1;
+            if(!sd_raw_fetch(block_address, raw_block, 0, 512, 1))
+                return 0;
             raw_block_address = block_address;
 
             memcpy(buffer, raw_block + block_offset, read_length);
-            buffer += read_length;
 #endif
-            
-            /* read crc16 */
-            sd_raw_rec_byte();
-            sd_raw_rec_byte();
-            
-            /* deaddress card */
-            unselect_card();
-
-            /* let card some time to finish */
-            sd_raw_rec_byte();
+            buffer += read_length;
         }
 #if !SD_RAW_SAVE_RAM
         else
@@ -606,6 +904,8 @@ uint8_t sd_raw_read_interval(offset_t offset, uint8_t* buffer, uintptr_t interva
 
     return 1;
 #else
+    sd_raw_stream_stop();
+
     /* address card */
     select_card();
 
@@ -683,6 +983,122 @@ uint8_t sd_raw_read_interval(offset_t offset, uint8_t* buffer, uintptr_t interva
 #endif
 }
 
+#if DOXYGEN || SD_RAW_WRITE_SUPPORT
+/**
+ * \ingroup sd_raw
+ * Writes the content of the block buffer to the card.
+ *
+ * With multi-block support, a write with more blocks to follow starts
+ * a multi-block transfer, which later sequential writes continue.
+ *
+ * \param[in] block_address The address of the block.
+ * \param[in] more Whether the next block is written right after.
+ * \returns 0 on failure, 1 on success.
+ */
+static uint8_t sd_raw_write_block(offset_t block_address, uint8_t more)
+{
+    /* start byte of a single block write */
+    uint8_t token = 0xfe;
+
+#ifdef SD_MULTIBLOCK_SUPPORT
+    if(sd_raw_stream == SD_RAW_STREAM_WRITE && block_address == sd_raw_stream_address)
+    {
+        /* address card, the transfer is still running */
+        select_card();
+        token = 0xfc;
+    }
+    else
+    {
+        sd_raw_stream_stop();
+
+        uint8_t command = CMD_WRITE_SINGLE_BLOCK;
+        if(more)
+            command = CMD_WRITE_MULTIPLE_BLOCK;
+
+        /* address card */
+        select_card();
+
+        /* send block request */
+        if(sd_raw_send_command(command, sd_raw_block_arg(block_address)))
+        {
+            unselect_card();
+            return 0;
+        }
+
+        if(command == CMD_WRITE_MULTIPLE_BLOCK)
+        {
+            sd_raw_stream = SD_RAW_STREAM_WRITE;
+            token = 0xfc;
+        }
+    }
+#else
+    /* address card */
+    select_card();
+
+    /* send single block request */
+    if(sd_raw_send_command(CMD_WRITE_SINGLE_BLOCK, sd_raw_block_arg(block_address)))
+    {
+        unselect_card();
+        return 0;
+    }
+#endif
+
+    /* send start byte */
+    sd_raw_send_byte(token);
+
+    /* write byte block */
+    uint8_t* cache = raw_block;
+    for(uint16_t i = 0; i < 512; ++i)
+        sd_raw_send_byte(*cache++);
+
+    /* write dummy crc16 */
+    sd_raw_send_byte(0xff);
+    sd_raw_send_byte(0xff);
+
+    /* receive data response */
+    uint8_t response = sd_raw_rec_byte();
+
+    /* wait while card is busy */
+    while(sd_raw_rec_byte() != 0xff);
+    sd_raw_rec_byte();
+
+    /* deaddress card */
+    unselect_card();
+
+#ifdef SD_MULTIBLOCK_SUPPORT
+    sd_raw_stream_address = block_address + 512;
+#endif
+
+#if SD_CACHE_BLOCKS > 0
+    /* keep the sector cache up to date */
+    uint8_t slot = sd_raw_cache_find(block_address);
+#endif
+    if((response & 0x1f) != DR_STATUS_ACCEPTED)
+    {
+        sd_raw_stream_stop();
+#if SD_CACHE_BLOCKS > 0
+        if(slot != 0xff)
+            sd_raw_cache_address[slot] = (offset_t) -1;
+#endif
+#ifdef SER_RAM_CACHE_SD
+        /* the block on the card is unknown now */
+        sram_cache_invalidate(SRAM_CACHE_SD);
+#endif
+        return 0;
+    }
+#if SD_CACHE_BLOCKS > 0
+    if(slot != 0xff)
+        memcpy(sd_raw_cache[slot], raw_block, 512);
+#endif
+#ifdef SER_RAM_CACHE_SD
+    /* write-through, the serial RAM cache never holds dirty blocks */
+    sram_cache_update(SRAM_CACHE_SD, block_address / 512, 0, raw_block, 512);
+#endif
+
+    return 1;
+}
+#endif
+
 #if DOXYGEN || SD_RAW_WRITE_SUPPORT
 /**
  * \ingroup sd_raw
@@ -720,14 +1136,23 @@ uint8_t sd_raw_write(offset_t offset, const uint8_t* buffer, uintptr_t length)
          */
         if(block_address != raw_block_address)
         {
+            uint8_t merge = block_offset || write_length < 512;
+
 #if SD_RAW_WRITE_BUFFERING
-            if(!sd_raw_sync())
+            /* A block following the buffered one continues a multi-block
+             * write, unless it has to be read first, which would stop it.
+             */
+            if(!sd_raw_flush(merge ? (offset_t) -1 : block_address))
                 return 0;
 #endif
 
-            if(block_offset || write_length < 512)
+            raw_block_address = (offset_t) -1;
+            if(merge)
             {
-                if(!sd_raw_read(block_address, raw_block, sizeof(raw_block)))
+                /* the block is written right after, so a multi-block
+                 * read would have to be stopped again anyway
+                 */
+                if(!sd_raw_fetch(block_address, raw_block, 0, 512, 0))
                     return 0;
             }
             raw_block_address = block_address;
@@ -745,38 +1170,8 @@ uint8_t sd_raw_write(offset_t offset, const uint8_t* buffer, uintptr_t length)
 #endif
         }
 
-        /* address card */
-        select_card();
-
-        /* send single block request */
-#if SD_RAW_SDHC
-        if(sd_raw_send_command(CMD_WRITE_SINGLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
-#else
-        if(sd_raw_send_command(CMD_WRITE_SINGLE_BLOCK, block_address))
-#endif
-        {
-            unselect_card();
+        if(!sd_raw_write_block(block_address, length > write_length))
             return 0;
-        }
-
-        /* send start byte */
-        sd_raw_send_byte(0xfe);
-
-        /* write byte block */
-        uint8_t* cache = raw_block;
-        for(uint16_t i = 0; i < 512; ++i)
-            sd_raw_send_byte(*cache++);
-
-        /* write dummy crc16 */
-        sd_raw_send_byte(0xff);
-        sd_raw_send_byte(0xff);
-
-        /* wait while card is busy */
-        while(sd_raw_rec_byte() != 0xff);
-        sd_raw_rec_byte();
-
-        /* deaddress card */
-        unselect_card();
 
         buffer += write_length;
         offset += write_length;
@@ -856,11 +1251,31 @@ uint8_t sd_raw_write_interval(offset_t offset, uint8_t* buffer, uintptr_t length
  * \see sd_raw_write
  */
 uint8_t sd_raw_sync(void)
+{
+    if(!sd_raw_flush((offset_t) -1))
+        return 0;
+
+    /* also finish a multi-block write */
+    sd_raw_stream_stop();
+
+    return 1;
+}
+
+/**
+ * \ingroup sd_raw
+ * Writes the write buffer's content to the card, other than sd_raw_sync()
+ * leaving a multi-block transfer open.
+ *
+ * \param[in] next The block buffered next, a multi-block write is started
+ *                 if it follows the buffered one, (offset_t) -1 if none.
+ * \returns 0 on failure, 1 on success.
+ */
+static uint8_t sd_raw_flush(offset_t next)
 {
 #if SD_RAW_WRITE_BUFFERING
     if(raw_block_written)
         return 1;
-    if(!sd_raw_write(raw_block_address, raw_block, sizeof(raw_block)))
+    if(!sd_raw_write_block(raw_block_address, next == raw_block_address + 512))
         return 0;
     raw_block_written = 1;
 #endif
@@ -890,6 +1305,8 @@ uint8_t sd_raw_get_info(struct sd_raw_info* info)
 
     memset(info, 0, sizeof(*info));
 
+    sd_raw_stream_stop();
+
     select_card();
 
     /* read cid register */
@@ -61,6 +61,7 @@ vfs_sd_try_open_rootnode(void)
   }
 
   SDDEBUGVFS("SD-Card initialized and root node opened.\n");
+  vfs_lookup_flush();
   return 0;                     /* Jippie, we're set. */
 }
 
@@ -100,6 +101,10 @@ vfs_sd_close(struct vfs_file_handle_t *fh)
 {
   fat_close_file(fh->u.sd);
   free(fh);
+#if SD_WRITE_SUPPORT == 1
+  /* write the buffered block and end a multi-block write */
+  sd_raw_sync();
+#endif
 }
 
 vfs_size_t
@@ -268,6 +273,20 @@ vfs_sd_size(struct vfs_file_handle_t *fh)
   return fh->u.sd->dir_entry.file_size;
 }
 
+uint32_t
+vfs_sd_etag(struct vfs_file_handle_t *fh)
+{
+#if FAT_DATETIME_SUPPORT
+  /* Size and modification time, unless the clock wasn't set. */
+  struct fat_dir_entry_struct *entry = &fh->u.sd->dir_entry;
+  if (entry->modification_date)
+    return (((uint32_t) entry->modification_date << 16)
+            | entry->modification_time) ^ (entry->file_size * 16777619UL);
+#endif
+
+  return 0;                     /* No tag, the content isn't hashed. */
+}
+
 #ifdef SD_PING_READ
 static uint8_t
 vfs_sd_ping(void)
@@ -292,6 +311,10 @@ vfs_sd_ping(void)
 static void
 vfs_sd_umount(void)
 {
+#if SD_WRITE_SUPPORT == 1
+  sd_raw_sync();
+#endif
+
   if (vfs_sd_rootnode)
   {
     fat_close_dir(vfs_sd_rootnode);
@@ -309,6 +332,8 @@ vfs_sd_umount(void)
     partition_close(sd_active_partition);
     sd_active_partition = NULL;
   }
+
+  vfs_lookup_flush();
 }
 
 void
@@ -41,6 +41,7 @@ uint8_t vfs_sd_fseek(struct vfs_file_handle_t *, vfs_size_t offset,
 uint8_t vfs_sd_truncate(struct vfs_file_handle_t *, vfs_size_t length);
 struct vfs_file_handle_t *vfs_sd_create(const char *name);
 vfs_size_t vfs_sd_size(struct vfs_file_handle_t *);
+uint32_t vfs_sd_etag(struct vfs_file_handle_t *);
 uint8_t vfs_sd_mkdir_recursive(const char *path);
 
 
@@ -55,6 +56,7 @@ uint8_t vfs_sd_mkdir_recursive(const char *path);
     vfs_sd_truncate,				\
     vfs_sd_create,				\
     vfs_sd_size,				\
+    vfs_sd_etag,				\
   }
 #else
 #define VFS_SD_FUNCS {				\
@@ -67,6 +69,7 @@ uint8_t vfs_sd_mkdir_recursive(const char *path);
     NULL, /* truncate */			\
     NULL, /* create */				\
     vfs_sd_size,				\
+    vfs_sd_etag,				\
   }
 #endif
 
@@ -197,6 +197,58 @@ pin(DCF1, $2, INPUT)
 #define DCF77_VECTOR INT$1`_vect'
 ')
 
+define(`IRMP_RX_USE_PCINT', `dnl
+/* IRMP receiver PinChange-Interrupt Line  PCINT$1 -> $2 */
+pin(IRMP_RX, $2, INPUT)
+#define IRMP_RX_PCINT_PIN $2
+
+dnl Configure pin-change-mask to monitor PCINTn and enable interrupt
+#define irmp_rx_configure_pcint() \
+  _paste(PCMSK, eval($1/8)) |= _BV(PCINT$1); \
+  PCICR  |= _BV(_paste(PCIE, eval($1/8)));
+
+#define IRMP_RX_VECTOR _paste3(PCINT, eval($1/8), _vect)
+')
+
+define(`IRMP_RX_USE_INT', `dnl
+/* IRMP receiver Interrupt Line  INT$1 -> $2 */
+pin(IRMP_RX, $2, INPUT)
+
+/* Configure real interrupt $1, set sense control to trigger on any edge */
+#define IRMP_RX_INT_PIN INT$1
+#define IRMP_RX_INT_ISC _ISC($1,0)
+#define IRMP_RX_INT_ISCMASK (_ISC($1,0) | _ISC($1,1))
+#define IRMP_RX_VECTOR INT$1`_vect'
+')
+
+define(`DHT_USE_PCINT', `dnl
+/* DHT PinChange-Interrupt Line  PCINT$1 -> $2 */
+pin(DHT, $2, INPUT)
+
+dnl Enable or disable monitoring PCINTn, other pins may share the interrupt
+#define dht_int_enable() \
+  do { \
+    _paste(PCMSK, eval($1/8)) |= _BV(PCINT$1); \
+    PCICR  |= _BV(_paste(PCIE, eval($1/8)));   \
+  } while(0)
+
+#define dht_int_disable() \
+  _paste(PCMSK, eval($1/8)) &= ~_BV(PCINT$1)
+
+#define DHT_VECTOR _paste3(PCINT, eval($1/8), _vect)
+')
+
+define(`DHT_USE_INT', `dnl
+/* DHT Interrupt Line  INT$1 -> $2 */
+pin(DHT, $2, INPUT)
+
+/* Configure real interrupt $1, set sense control to trigger on any edge */
+#define DHT_INT_PIN INT$1
+#define DHT_INT_ISC _ISC($1,0)
+#define DHT_INT_ISCMASK (_ISC($1,0) | _ISC($1,1))
+#define DHT_VECTOR INT$1`_vect'
+')
+
 define(`PS2_USE_PCINT', `dnl
 /* PS2 PinChange-Interrupt Line  PCINT$1 -> $2 */
 pin(PS21, $2, INPUT)
@@ -23,7 +23,8 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
-#include <util/crc16.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
 #include <string.h>
 #include "core/eeprom.h"
 #include "config.h"
@@ -39,6 +40,36 @@
 #include "core/usart.h"
 #include "pinning.c"
 
+#ifdef MODBUS_HWTIMER_SUPPORT
+/* One character is 11 bit on the wire (start, 8 data, parity, stop).  Above
+   19200 baud the spec fixes t1.5 to 750us and t3.5 to 1750us. */
+#define MODBUS_CHAR_US (11000000UL / MODBUS_BAUDRATE)
+#if MODBUS_BAUDRATE > 19200
+#define MODBUS_T15_US 750UL
+#define MODBUS_T35_US 1750UL
+#else
+#define MODBUS_T15_US (MODBUS_CHAR_US * 3 / 2)
+#define MODBUS_T35_US (MODBUS_CHAR_US * 7 / 2)
+#endif
+
+#define MODBUS_TIMER_PRESCALE 1024
+#define MODBUS_US_TO_TICKS(us) \
+  ((F_CPU / 1000UL * (us) / 1000UL + MODBUS_TIMER_PRESCALE - 1) \
+   / MODBUS_TIMER_PRESCALE)
+
+/* The timer is restarted at the end of every character, so the interval
+   seen by the next one is the character time plus the gap. */
+#define MODBUS_T15_TICKS MODBUS_US_TO_TICKS(MODBUS_CHAR_US + MODBUS_T15_US)
+#define MODBUS_T35_TICKS MODBUS_US_TO_TICKS(MODBUS_T35_US)
+
+#if MODBUS_T35_TICKS > 255
+#error MODBUS baudrate too low for hardware timer framing
+#endif
+#endif /* MODBUS_HWTIMER_SUPPORT */
+
+/* Ticks to wait for the first byte of an answer */
+#define MODBUS_ANSWER_TIMEOUT 4
+
 #ifdef MODBUS_CLIENT_SUPPORT
 struct modbus_connection_state_t modbus_client_state;
 #endif
@@ -49,20 +80,101 @@ generate_usart_init()
 
 volatile struct modbus_buffer modbus_data;
 
-uint8_t modbus_recv_timer = 0;
-int16_t *modbus_recv_len_ptr = NULL;
+/* Requests waiting for the bus, serviced in order of arrival */
+struct modbus_request {
+  uint8_t *data;
+  uint8_t len;
+  int16_t *recv_len;
+};
+
+static struct modbus_request modbus_queue[MODBUS_QUEUE_LEN];
+static uint8_t modbus_queue_head;
+static uint8_t modbus_queue_count;
+
+static volatile uint8_t modbus_recv_timer = 0;
+static volatile uint8_t modbus_frame_done;
+static volatile uint8_t modbus_frame_error;
+#ifdef MODBUS_HWTIMER_SUPPORT
+static volatile uint8_t modbus_frame_active;
+#endif
+static int16_t * volatile modbus_recv_len_ptr = NULL;
 uint8_t modbus_last_address;
 
+/* Answers of cancelled requests are received into the void */
+static int16_t modbus_discard_len;
+
+static const uint16_t PROGMEM modbus_crc_table[256] = {
+  0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+  0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+  0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+  0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+  0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+  0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+  0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+  0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+  0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+  0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+  0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+  0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+  0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+  0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+  0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+  0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+  0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+  0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+  0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+  0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+  0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+  0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+  0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+  0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+  0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+  0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+  0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+  0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+  0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+  0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+  0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+  0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
+};
+
 uint16_t
 modbus_crc_calc(uint8_t *data, uint8_t len)
 {
   uint16_t crc = 0xffff;
-  uint8_t i = 0;
-  while(i < len)
-    crc = _crc16_update(crc, data[i++]);
+  while (len--)
+    crc = (crc >> 8) ^ pgm_read_word(&modbus_crc_table[(uint8_t) crc ^ *data++]);
   return crc;
 }
 
+static inline uint8_t
+modbus_busy(void)
+{
+  return modbus_recv_len_ptr != NULL
+    || (usart(UCSR,B) & _BV(usart(TXCIE)));
+}
+
+static void
+modbus_txstart(uint8_t *data, uint8_t len, int16_t *recv_len)
+{
+  modbus_last_address = *data;
+
+  RS485_ENABLE_TX;
+
+  modbus_recv_len_ptr = recv_len;
+
+  modbus_data.crc = modbus_crc_calc(data, len);
+  modbus_data.crc_len = 2;
+
+  modbus_data.data = data;
+  modbus_data.len = len;
+
+  /* Enable the tx interrupt and send the first character */
+  modbus_data.sent = 1;
+  usart(UCSR,B) |= _BV(usart(TXCIE));
+  usart(UDR) = data[0];
+}
+
 void
 modbus_init(void)
 {
@@ -82,61 +194,79 @@ modbus_init(void)
     modbus_client_state.len = 0;
 #endif
 
+#ifdef MODBUS_HWTIMER_SUPPORT
+  TC2_PRESCALER_1024;
+  TC2_MODE_CTC;
+  TC2_COUNTER_COMPARE = MODBUS_T35_TICKS;
+#endif
+}
+
+void
+modbus_timer(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (modbus_recv_timer && --modbus_recv_timer == 0)
+      modbus_frame_done = 1;
+  }
 }
 
 void
 modbus_periodic(void)
 {
-  if (modbus_recv_timer == 0) return;
-  modbus_recv_timer--;
+  if (modbus_frame_done) {
+    modbus_frame_done = 0;
 
-  if (!modbus_recv_len_ptr) {
+    if (modbus_recv_len_ptr) {
+      int16_t len = modbus_data.len;
+      if (len < 2 || modbus_frame_error
+          || modbus_data.data[0] != modbus_last_address)
+        len = -1;
+      *modbus_recv_len_ptr = len;
+      modbus_recv_len_ptr = NULL;
+    }
 #ifdef MODBUS_CLIENT_SUPPORT
-    if (modbus_recv_timer == 0) {
+    else if (modbus_client_state.len > 2 && !modbus_frame_error) {
       /* check the crc */
       uint16_t crc = modbus_crc_calc(modbus_client_state.data, modbus_client_state.len - 2);
       uint16_t crc_recv =
         ((modbus_client_state.data[modbus_client_state.len - 1])  << 8)
         | modbus_client_state.data[modbus_client_state.len - 2];
-      if (crc != crc_recv) {
-        modbus_client_state.len = 0;
-        return;
-      }
       /* See if we are the receiver */
-      if (!(modbus_client_state.data[0] == MODBUS_ADDRESS
-          || modbus_client_state.data[0] == MODBUS_BROADCAST))
-        return;
-      modbus_client_state.len -= 2;
-      /* A message for our own modbus stack */
-      int16_t recv_len;
-      modbus_client_process(modbus_client_state.data, modbus_client_state.len,
-                            &recv_len);
-      if (recv_len) {
-        RS485_ENABLE_TX;
-
-        modbus_data.data = modbus_client_state.data;
-        modbus_data.len = recv_len; 
-
-        /* Enable the tx interrupt and send the first character */
-        modbus_data.sent = 1;
-        usart(UCSR,B) |= _BV(usart(TXCIE));
-        usart(UDR) = modbus_client_state.data[0];
+      if (crc == crc_recv
+          && (modbus_client_state.data[0] == MODBUS_ADDRESS
+              || modbus_client_state.data[0] == MODBUS_BROADCAST)) {
+        modbus_client_state.len -= 2;
+        /* A message for our own modbus stack */
+        int16_t recv_len;
+        modbus_client_process(modbus_client_state.data, modbus_client_state.len,
+                              &recv_len);
+        if (recv_len > 0) {
+          RS485_ENABLE_TX;
+
+          modbus_data.data = modbus_client_state.data;
+          modbus_data.len = recv_len;
+
+          /* Enable the tx interrupt and send the first character */
+          modbus_data.sent = 1;
+          usart(UCSR,B) |= _BV(usart(TXCIE));
+          usart(UDR) = modbus_client_state.data[0];
+        }
       }
       modbus_client_state.len = 0;
+    } else {
+      modbus_client_state.len = 0;
     }
 #endif
-    return;
+    modbus_frame_error = 0;
   }
-  if (modbus_recv_timer != 0) return;
-  *modbus_recv_len_ptr = modbus_data.len;
-
-  if (*modbus_recv_len_ptr < 2)
-      *modbus_recv_len_ptr = -1;
 
-  if (modbus_data.data[0] != modbus_last_address) {
-      *modbus_recv_len_ptr = -1;
+  /* Put the next waiting request on the bus */
+  if (modbus_queue_count && !modbus_busy()) {
+    struct modbus_request *req = &modbus_queue[modbus_queue_head];
+    modbus_queue_head = (modbus_queue_head + 1) % MODBUS_QUEUE_LEN;
+    modbus_queue_count--;
+    modbus_txstart(req->data, req->len, req->recv_len);
   }
-  modbus_recv_len_ptr = NULL;
 }
 
 uint8_t
@@ -148,28 +278,49 @@ modbus_rxstart(uint8_t *data, uint8_t len, int16_t *recv_len) {
       return 1;
   }
 #endif
-  if (modbus_data.crc_len != 0) return 0; /* There is an packet on the way */
-
-  modbus_last_address = *data;
-
-  RS485_ENABLE_TX;
-
-  modbus_recv_len_ptr = recv_len;
-
-  modbus_data.crc = modbus_crc_calc(data, len);
-  modbus_data.crc_len = 2;
-
-  modbus_data.data = data;
-  modbus_data.len = len;
-
-  /* Enable the tx interrupt and send the first character */
-  modbus_data.sent = 1;
-  usart(UCSR,B) |= _BV(usart(TXCIE));
-  usart(UDR) = data[0];
+  if (modbus_busy() || modbus_queue_count) {
+    /* There is a packet on the way, wait for our turn */
+    if (modbus_queue_count == MODBUS_QUEUE_LEN)
+      return 0;
+    struct modbus_request *req = &modbus_queue[
+      (modbus_queue_head + modbus_queue_count) % MODBUS_QUEUE_LEN];
+    req->data = data;
+    req->len = len;
+    req->recv_len = recv_len;
+    modbus_queue_count++;
+    return 1;
+  }
 
+  modbus_txstart(data, len, recv_len);
   return 1;
 }
 
+void
+modbus_rxcancel(int16_t *recv_len)
+{
+  /* Drop it from the queue, keeping the order of the others */
+  uint8_t i, j = 0;
+  for (i = 0; i < modbus_queue_count; i++) {
+    struct modbus_request *req =
+      &modbus_queue[(modbus_queue_head + i) % MODBUS_QUEUE_LEN];
+    if (req->recv_len == recv_len)
+      continue;
+    if (i != j)
+      modbus_queue[(modbus_queue_head + j) % MODBUS_QUEUE_LEN] = *req;
+    j++;
+  }
+  modbus_queue_count = j;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (modbus_recv_len_ptr == recv_len) {
+      /* Cut the frame short, the slave will drop it on the crc */
+      modbus_data.len = modbus_data.sent;
+      modbus_data.crc_len = 0;
+      modbus_recv_len_ptr = &modbus_discard_len;
+    }
+  }
+}
+
 ISR(usart(USART,_TX_vect))
 {
   if (modbus_data.sent < modbus_data.len) {
@@ -186,11 +337,22 @@ ISR(usart(USART,_TX_vect))
     /* No we are waiting for an answer */
     if (modbus_recv_len_ptr) {
       modbus_data.len = 0;
-      modbus_recv_timer = 4;
+      modbus_frame_error = 0;
+      modbus_recv_timer = MODBUS_ANSWER_TIMEOUT;
     }
   }
 }
 
+#ifdef MODBUS_HWTIMER_SUPPORT
+ISR(TC2_VECTOR_COMPARE)
+{
+  /* t3.5 of silence, the frame is complete */
+  TC2_INT_COMPARE_OFF;
+  modbus_frame_active = 0;
+  modbus_frame_done = 1;
+}
+#endif
+
 ISR(usart(USART,_RX_vect))
 {
   /* Ignore errors */
@@ -198,31 +360,49 @@ ISR(usart(USART,_RX_vect))
   {
     uint8_t v = usart(UDR);
     (void) v;
+    modbus_frame_error = 1;
     return;
   }
   uint8_t data = usart(UDR);
 
+  /* Our own transmission echoed back */
+  if (usart(UCSR,B) & _BV(usart(TXCIE)))
+    return;
+
+#ifdef MODBUS_HWTIMER_SUPPORT
+  /* Restart the t3.5 compare, a gap above t1.5 within a frame breaks it */
+  if (modbus_frame_active && TC2_COUNTER_CURRENT > MODBUS_T15_TICKS)
+    modbus_frame_error = 1;
+  modbus_frame_active = 1;
+  TC2_COUNTER_CURRENT = 0;
+  TC2_INT_COMPARE_CLR;
+  TC2_INT_COMPARE_ON;
+  modbus_recv_timer = 0;
+#else
+  modbus_recv_timer = 2;
+#endif
 
   if (!modbus_recv_len_ptr)
   {
 #ifdef MODBUS_CLIENT_SUPPORT
     /* This byte is not answer to a modbus/TCP || ecmd modbus request */
-    modbus_client_state.data[modbus_client_state.len++] = data;
-    modbus_recv_timer = 2;
+    if (modbus_client_state.len < MODBUS_BUFFER_LEN)
+      modbus_client_state.data[modbus_client_state.len++] = data;
 #endif
     return;
   }
   /* Is the buffer big enough */
-  if (modbus_data.len >= MODBUS_BUFFER_LEN) return;
+  if (modbus_data.len >= MODBUS_BUFFER_LEN
+      || modbus_recv_len_ptr == &modbus_discard_len)
+    return;
 
   modbus_data.data[modbus_data.len++] = data;
-
-  modbus_recv_timer = 2;
 }
 
 /*
   -- Ethersex META --
   header(protocols/modbus/modbus.h)
   init(modbus_init)
-  timer(1, modbus_periodic())
+  mainloop(modbus_periodic)
+  timer(1, modbus_timer())
 */
@@ -26,6 +26,10 @@
 /* Default baudrate */
 #define MODBUS_BAUDRATE 9600
 
+#ifndef MODBUS_QUEUE_LEN
+#define MODBUS_QUEUE_LEN 4
+#endif
+
 struct modbus_buffer {
   uint8_t *data;
   uint8_t sent;
@@ -36,7 +40,9 @@ struct modbus_buffer {
 
 void modbus_init(void);
 void modbus_periodic(void);
+void modbus_timer(void);
 uint8_t modbus_rxstart(uint8_t *data, uint8_t len, int16_t *recv_len);
+void modbus_rxcancel(int16_t *recv_len);
 uint16_t modbus_crc_calc(uint8_t *data, uint8_t len);
 
 #endif /* _MODBUS_H */
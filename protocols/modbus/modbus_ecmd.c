@@ -35,8 +35,6 @@
 #define STATE(a) ((a)->appstate.modbus)
 #define NIBBLE_TO_HEX(a) ((a) < 10 ? (a) + '0' : ((a) - 10 + 'a'))
 
-extern int16_t *modbus_recv_len_ptr;
-
 int16_t parse_cmd_modbus_recv(char *cmd, char *output, uint16_t len)
 {
   uint8_t cmd_len = strlen(cmd);
@@ -44,8 +42,6 @@ int16_t parse_cmd_modbus_recv(char *cmd, char *output, uint16_t len)
 
   if ((cmd_len % 2) != 0)
     return ECMD_ERR_PARSE_ERROR;
-  if (modbus_recv_len_ptr)
-    return ECMD_FINAL(snprintf_P(output, len, PSTR("modbus error: bus busy")));
 
 
   char hex[] = {0, 0, 0};
@@ -59,10 +55,17 @@ int16_t parse_cmd_modbus_recv(char *cmd, char *output, uint16_t len)
 
   int16_t recv_len = 0;
 
-  modbus_rxstart((uint8_t *)buffer, cmd_len / 2,&recv_len);
+  if (!modbus_rxstart((uint8_t *)buffer, cmd_len / 2,&recv_len))
+    return ECMD_FINAL(snprintf_P(output, len, PSTR("modbus error: bus busy")));
 
-  while((volatile uint8_t)recv_len == 0) {
+  /* modbus_timer() counts 20ms ticks, call it every second round */
+  uint8_t ticks = 0;
+  while(*(volatile int16_t *)&recv_len == 0) {
         _delay_ms(10);
+        if (++ticks == 2) {
+          ticks = 0;
+          modbus_timer();
+        }
         modbus_periodic();
   }
 
@@ -25,6 +25,7 @@
 
 #include "modbus_net.h"
 #include "protocols/uip/uip.h"
+#include "protocols/uip/uip_router.h"
 #include "core/debug.h"
 #include "protocols/modbus/modbus.h"
 
@@ -33,9 +34,6 @@
 #define STATE(a) ((a)->appstate.modbus)
 
 
-extern int16_t *modbus_recv_len_ptr;
-static int16_t recv_len = -2;
-
 void modbus_net_init(void)
 {
   uip_listen(HTONS(MODBUS_PORT), modbus_net_main);
@@ -44,19 +42,27 @@ void modbus_net_init(void)
 void modbus_net_main(void)
 {
   uint8_t *answer = uip_appdata;
-  uint8_t i = 0;
 
   if(uip_connected()) {
     /* New connection */
     memset(&uip_conn->appstate, 0, sizeof(uip_conn->appstate));
   } else if (uip_acked()) {
-    uip_conn->appstate.modbus.state = MODBUS_IDLE;
+    if (STATE(uip_conn).state == MODBUS_MUST_ANSWER) {
+      /* Let the next request of this client in */
+      STATE(uip_conn).state = MODBUS_IDLE;
+      uip_restart();
+    }
   } else if (uip_rexmit()) {
-    if (uip_conn->appstate.modbus.state == MODBUS_MUST_ANSWER)
+    if (STATE(uip_conn).state == MODBUS_MUST_ANSWER)
       goto send_new_data;
+    return;
   } else if (uip_closed() || uip_aborted() || uip_timedout()) {
+    if (STATE(uip_conn).state == MODBUS_WAIT_ANSWER)
+      modbus_rxcancel(&STATE(uip_conn).recv_len);
+    return;
+  }
 
-  } else if (uip_newdata()) {
+  if (uip_newdata()) {
     /* Have we space for a new packet? */
     if (STATE(uip_conn).state != MODBUS_IDLE) {
       /* we don't have enough space, sent error */
@@ -70,55 +76,57 @@ void modbus_net_main(void)
     memcpy(STATE(uip_conn).data, answer + 6, answer[5]);
     STATE(uip_conn).len = answer[5];
     STATE(uip_conn).transaction_id = (answer[0] | (answer[1] << 8));
-    STATE(uip_conn).state = MODBUS_MUST_SEND;
+    STATE(uip_conn).unit = answer[6];
+    STATE(uip_conn).function = answer[7];
+    STATE(uip_conn).recv_len = 0;
+
+    /* Queue it for the bus, the client waits with its next request
+       until this one is answered */
+    if (!modbus_rxstart((uint8_t *)STATE(uip_conn).data,
+                        STATE(uip_conn).len,
+                        &STATE(uip_conn).recv_len)) {
+      answer[8] = 0x06; // Server busy
+      goto error_response;
+    }
+    STATE(uip_conn).state = MODBUS_WAIT_ANSWER;
+    uip_stop();
   }
 
-  /* See if we can send new data */
-  if (recv_len != 0 || !modbus_recv_len_ptr)
-    /* Search for a connetion with data, that had to be send */
-    for (i = 0; i < UIP_CONNS; i ++)
-      if (uip_conns[i].callback == modbus_net_main
-          && uip_conns[i].tcpstateflags != UIP_CLOSED) {
-        if (uip_conns[i].appstate.modbus.state == MODBUS_MUST_SEND) {
-          /* Start the transmission */
-          recv_len = 0;
-          modbus_rxstart((uint8_t *)STATE(&uip_conns[i]).data,
-                         STATE(&uip_conns[i]).len,
-                         &recv_len);
-          STATE(&uip_conns[i]).state = MODBUS_WAIT_ANSWER;
-          break;
-        } else if (STATE(&uip_conns[i]).state == MODBUS_WAIT_ANSWER
-                   && recv_len != 0) {
-          uip_conn = &uip_conns[i];
-          STATE(uip_conn).state = MODBUS_MUST_ANSWER;
+  if (STATE(uip_conn).state != MODBUS_WAIT_ANSWER
+      || STATE(uip_conn).recv_len == 0)
+    return;
+
+  STATE(uip_conn).state = MODBUS_MUST_ANSWER;
+
 send_new_data:
-          if (recv_len == -1) {
-            // Send an error message
-            answer[8] = 0x05; // gateway problem
-            goto error_response;
-          }
-          uint16_t crc = modbus_crc_calc(STATE(uip_conn).data, recv_len - 2);
-          uint16_t crc_recv =
-            ((STATE(uip_conn).data[recv_len - 1])  << 8)
-            | (STATE(uip_conn).data[recv_len - 2]);
-          if (crc != crc_recv) {
-            // Send an error message
-            answer[8] = 0x0B; // gateway problem
-            goto error_response;
-          }
-          memcpy(answer + 6, STATE(uip_conn).data,
-                 recv_len - 2);
-          memset(answer, 0, 6);
-
-          answer[0] = STATE(uip_conn).transaction_id;
-          answer[1] = STATE(uip_conn).transaction_id >> 8;
-          answer[5] = recv_len - 2;
-
-          uip_udp_send(recv_len -2 + 6);
-        }
-
-      }
+  /* uip_appdata doesn't hold the request anymore, rebuild the header */
+  memset(answer, 0, 6);
+  answer[0] = STATE(uip_conn).transaction_id;
+  answer[1] = STATE(uip_conn).transaction_id >> 8;
+  answer[6] = STATE(uip_conn).unit;
+  answer[7] = STATE(uip_conn).function;
+
+  int16_t recv_len = STATE(uip_conn).recv_len;
+  if (recv_len == -1) {
+    // Send an error message
+    answer[8] = 0x05; // gateway problem
+    goto error_response;
+  }
+
+  uint16_t crc = modbus_crc_calc(STATE(uip_conn).data, recv_len - 2);
+  uint16_t crc_recv =
+    ((STATE(uip_conn).data[recv_len - 1])  << 8)
+    | (STATE(uip_conn).data[recv_len - 2]);
+  if (crc != crc_recv) {
+    // Send an error message
+    answer[8] = 0x0B; // gateway problem
+    goto error_response;
+  }
+  memcpy(answer + 6, STATE(uip_conn).data,
+         recv_len - 2);
+  answer[5] = recv_len - 2;
 
+  uip_send(answer, recv_len - 2 + 6);
   return;
 
 error_response:
@@ -130,10 +138,35 @@ error_response:
   uip_send(answer, 9);
 }
 
+void
+modbus_net_periodic(void)
+{
+#if UIP_CONNS <= 255
+  uint8_t i;
+#else
+  uint16_t i;
+#endif
+
+  /* Send the answers as soon as they are off the bus instead of waiting
+     for the next poll of the connection */
+  for (i = 0; i < UIP_CONNS; i++)
+    if (uip_conns[i].callback == modbus_net_main
+        && uip_conns[i].tcpstateflags != UIP_CLOSED
+        && STATE(&uip_conns[i]).state == MODBUS_WAIT_ANSWER
+        && STATE(&uip_conns[i]).recv_len != 0) {
+      uip_stack_set_active(uip_conns[i].stack);
+      uip_poll_conn(&uip_conns[i]);
+
+      if (uip_len > 0)
+        router_output();
+    }
+}
+
 /*
   -- Ethersex META --
   header(protocols/modbus/modbus_net.h)
   net_init(modbus_net_init)
+  mainloop(modbus_net_periodic)
 
   state_header(protocols/modbus/modbus_state.h)
   state_tcp(struct modbus_connection_state_t modbus)
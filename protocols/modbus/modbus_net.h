@@ -28,5 +28,6 @@
 
 void modbus_net_init(void);
 void modbus_net_main(void);
+void modbus_net_periodic(void);
 
 #endif /* MODBUS_NET_H */
@@ -27,7 +27,10 @@
 struct modbus_connection_state_t {
     uint8_t        state;
     uint16_t       transaction_id;
+    uint8_t        unit;
+    uint8_t        function;
     uint8_t        len;
+    int16_t        recv_len;
     uint8_t        data[MODBUS_BUFFER_LEN];
 };
 
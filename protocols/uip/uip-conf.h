@@ -75,14 +75,27 @@ typedef unsigned short uip_stats_t;
  *
  * \hideinitializer
  */
+#ifndef UIP_CONF_MAX_CONNECTIONS
 #define UIP_CONF_MAX_CONNECTIONS 3
+#endif
 
 /**
  * Maximum number of listening TCP ports.
  *
  * \hideinitializer
  */
+#ifndef UIP_CONF_MAX_LISTENPORTS
 #define UIP_CONF_MAX_LISTENPORTS 10
+#endif
+
+/**
+ * Number of buckets of the connection hash tables.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_HASH_SUPPORT
+#define UIP_CONF_HASH_SIZE       UIP_HASH_BUCKETS
+#endif
 
 /**
  * uIP buffer size.
@@ -123,7 +136,9 @@ typedef unsigned short uip_stats_t;
 #   define UIP_CONF_UDP             0
 #endif
 
+#ifndef UIP_CONF_UDP_CONNS
 #define UIP_CONF_UDP_CONNS            5
+#endif
 
 /**
  * UDP checksums on or off
@@ -181,6 +181,48 @@ uip_udp_conn_t *uip_udp_conn;
 uip_udp_conn_t uip_udp_conns[UIP_UDP_CONNS];
 #endif /* UIP_UDP */
 
+/* Connection table index, wide enough for raised table sizes. */
+#if UIP_CONNS > 253 || UIP_LISTENPORTS > 253 || UIP_UDP_CONNS > 253
+typedef u16_t uip_cidx_t;
+#define UIP_CIDX_NONE 0xffff
+#else
+typedef u8_t uip_cidx_t;
+#define UIP_CIDX_NONE 0xff
+#endif
+
+#if defined(TCP_FINE_TIMER_SUPPORT) && UIP_TCP
+/* Retransmission timer wheel.  Connections with outstanding data are
+   linked into the slot of their deadline tick, uip_tcp_fast_timer()
+   visits one slot per tick.  Entries not linked anywhere have
+   UIP_WHEEL_UNLINKED as their next index. */
+#define UIP_WHEEL_UNLINKED (UIP_CIDX_NONE - 1)
+static u16_t uip_tcp_ticks;
+static uip_cidx_t uip_wheel[UIP_WHEEL_SLOTS];
+static uip_cidx_t uip_wheel_next[UIP_CONNS];
+static u16_t uip_wheel_deadline[UIP_CONNS];
+#endif /* TCP_FINE_TIMER_SUPPORT && UIP_TCP */
+
+#if UIP_HASH
+
+#define uip_hash_fold(h) (((h) ^ ((h) >> 8)) & (UIP_HASH_SIZE - 1))
+
+#if UIP_TCP
+/* Each bucket holds the index of the first entry of a chain, the
+   chains are linked through the _next arrays.  Closed connections are
+   only unlinked when their slot is reused, lookups skip them. */
+static uip_cidx_t uip_conn_hash[UIP_HASH_SIZE];
+static uip_cidx_t uip_conn_next[UIP_CONNS];
+static uip_cidx_t uip_listen_hash[UIP_HASH_SIZE];
+static uip_cidx_t uip_listen_next[UIP_LISTENPORTS];
+#endif /* UIP_TCP */
+
+#if UIP_UDP
+/* Index of the connection that last received a datagram for a local
+   port.  Only set if no other connection uses the same local port. */
+static uip_cidx_t uip_udp_hint[UIP_HASH_SIZE];
+#endif /* UIP_UDP */
+#endif /* UIP_HASH */
+
 #if !UIP_CONF_IPV6
 static u16_t ipid;           /* Ths ipid variable is an increasing
 				number that is used for the IP ID
@@ -394,14 +436,92 @@ uip_udpchksum(void)
 #endif /* UIP_UDP_CHECKSUMS && UIP_UDP*/
 #endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
+#if UIP_HASH && UIP_TCP
+static u16_t
+uip_hash_tcp(u16_t lport, u16_t rport, const u16_t *ripaddr)
+{
+  u16_t h = lport ^ rport ^ ripaddr[sizeof(uip_ipaddr_t) / 2 - 1];
+  return uip_hash_fold(h);
+}
+
+static void
+uip_conn_unhash(uip_conn_t *conn)
+{
+  uip_cidx_t idx = conn - uip_conns;
+  uip_cidx_t *p = &uip_conn_hash[uip_hash_tcp(conn->lport, conn->rport,
+                                               conn->ripaddr)];
+  while(*p != UIP_CIDX_NONE) {
+    if(*p == idx) {
+      *p = uip_conn_next[idx];
+      return;
+    }
+    p = &uip_conn_next[*p];
+  }
+}
+
+static void
+uip_conn_rehash(uip_conn_t *conn)
+{
+  uip_cidx_t idx = conn - uip_conns;
+  uip_cidx_t *p = &uip_conn_hash[uip_hash_tcp(conn->lport, conn->rport,
+                                               conn->ripaddr)];
+  uip_conn_next[idx] = *p;
+  *p = idx;
+}
+#endif /* UIP_HASH && UIP_TCP */
+
+#if defined(TCP_FINE_TIMER_SUPPORT) && UIP_TCP
+static void
+uip_wheel_unlink(uip_conn_t *conn)
+{
+  uip_cidx_t idx = conn - uip_conns;
+  if(uip_wheel_next[idx] == UIP_WHEEL_UNLINKED) {
+    return;
+  }
+  uip_cidx_t *p = &uip_wheel[uip_wheel_deadline[idx] & (UIP_WHEEL_SLOTS - 1)];
+  while(*p < UIP_CONNS) {
+    if(*p == idx) {
+      *p = uip_wheel_next[idx];
+      break;
+    }
+    p = &uip_wheel_next[*p];
+  }
+  uip_wheel_next[idx] = UIP_WHEEL_UNLINKED;
+}
+
+static void
+uip_wheel_arm(uip_conn_t *conn, u16_t ticks)
+{
+  uip_cidx_t idx = conn - uip_conns;
+  uip_wheel_unlink(conn);
+  if(ticks == 0) {
+    ticks = 1;
+  }
+  uip_wheel_deadline[idx] = uip_tcp_ticks + ticks;
+  uip_cidx_t *p = &uip_wheel[uip_wheel_deadline[idx] & (UIP_WHEEL_SLOTS - 1)];
+  uip_wheel_next[idx] = *p;
+  *p = idx;
+}
+#endif /* TCP_FINE_TIMER_SUPPORT && UIP_TCP */
+
+#if UIP_HASH && UIP_UDP
+void
+uip_udp_hash_flush(void)
+{
+  for(u16_t c = 0; c < UIP_HASH_SIZE; ++c) {
+    uip_udp_hint[c] = UIP_CIDX_NONE;
+  }
+}
+#endif /* UIP_HASH && UIP_UDP */
+/*---------------------------------------------------------------------------*/
 void
 uip_init(void)
 {
 #if UIP_TCP
-  for(u8_t c = 0; c < UIP_LISTENPORTS; ++c) {
+  for(uip_cidx_t c = 0; c < UIP_LISTENPORTS; ++c) {
     uip_listenports[c].port = 0;
   }
-  for(u8_t c = 0; c < UIP_CONNS; ++c) {
+  for(uip_cidx_t c = 0; c < UIP_CONNS; ++c) {
     uip_conns[c].tcpstateflags = UIP_CLOSED;
 #if UIP_MULTI_STACK
     uip_conns[c].stack = 0;
@@ -413,7 +533,7 @@ uip_init(void)
 #endif /* UIP_ACTIVE_OPEN */
 
 #if UIP_UDP && !defined(TEENSY_SUPPORT) /* expect bss to be clear */
-  for(u8_t c = 0; c < UIP_UDP_CONNS; ++c) {
+  for(uip_cidx_t c = 0; c < UIP_UDP_CONNS; ++c) {
     uip_udp_conns[c].lport = 0;
 #if UIP_MULTI_STACK
     uip_udp_conns[c].stack = 0;
@@ -421,7 +541,26 @@ uip_init(void)
   }
 #endif /* UIP_UDP */
 
+#if defined(TCP_FINE_TIMER_SUPPORT) && UIP_TCP
+  for(u8_t c = 0; c < UIP_WHEEL_SLOTS; ++c) {
+    uip_wheel[c] = UIP_CIDX_NONE;
+  }
+  for(uip_cidx_t c = 0; c < UIP_CONNS; ++c) {
+    uip_wheel_next[c] = UIP_WHEEL_UNLINKED;
+  }
+#endif /* TCP_FINE_TIMER_SUPPORT && UIP_TCP */
 
+#if UIP_HASH
+#if UIP_TCP
+  for(u16_t c = 0; c < UIP_HASH_SIZE; ++c) {
+    uip_conn_hash[c] = UIP_CIDX_NONE;
+    uip_listen_hash[c] = UIP_CIDX_NONE;
+  }
+#endif /* UIP_TCP */
+#if UIP_UDP
+  uip_udp_hash_flush();
+#endif /* UIP_UDP */
+#endif /* UIP_HASH */
 }
 /*---------------------------------------------------------------------------*/
 #if UIP_TCP
@@ -461,7 +600,7 @@ uip_connect(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
 
   /* Check if this port is already in use, and if so try to find
      another one. */
-  for(u8_t c = 0; c < UIP_CONNS; ++c) {
+  for(uip_cidx_t c = 0; c < UIP_CONNS; ++c) {
     conn = &uip_conns[c];
     if(conn->tcpstateflags != UIP_CLOSED &&
        conn->lport == htons(lastport)) {
@@ -470,7 +609,7 @@ uip_connect(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
   }
 
   conn = 0;
-  for(u8_t c = 0; c < UIP_CONNS; ++c) {
+  for(uip_cidx_t c = 0; c < UIP_CONNS; ++c) {
     cconn = &uip_conns[c];
     if(cconn->tcpstateflags == UIP_CLOSED) {
       conn = cconn;
@@ -488,6 +627,10 @@ uip_connect(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
     return 0;
   }
 
+#if UIP_HASH
+  uip_conn_unhash(conn);
+#endif
+
   conn->tcpstateflags = UIP_SYN_SENT;
 
   conn->snd_nxt[0] = iss[0];
@@ -500,6 +643,10 @@ uip_connect(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
   conn->len = 1;   /* TCP length of the SYN is one. */
   conn->nrtx = 0;
   conn->timer = 1; /* Send the SYN next time around. */
+#ifdef TCP_FINE_TIMER_SUPPORT
+  conn->dupacks = 0;
+  uip_wheel_arm(conn, 1);
+#endif
   conn->rto = UIP_RTO;
   conn->sa = 0;
   conn->sv = 16;   /* Initial value of the RTT variance. */
@@ -512,6 +659,9 @@ uip_connect(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
 #endif
 
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+#if UIP_HASH
+  uip_conn_rehash(conn);
+#endif
 
   /* Add callback to connection */
   conn->callback = callback;
@@ -546,7 +696,7 @@ uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
   }
 
 #if !defined(TEENSY_SUPPORT) || (GCC_VERSION < 40601)
-  for(u8_t c = 0; c < UIP_UDP_CONNS; ++c) {
+  for(uip_cidx_t c = 0; c < UIP_UDP_CONNS; ++c) {
     if(uip_udp_conns[c].lport == htons(lastport)) {
       goto again;
     }
@@ -554,7 +704,7 @@ uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
 #endif
 
   conn = 0;
-  for(u8_t c = 0; c < UIP_UDP_CONNS; ++c) {
+  for(uip_cidx_t c = 0; c < UIP_UDP_CONNS; ++c) {
     if(uip_udp_conns[c].lport == 0) {
       conn = &uip_udp_conns[c];
       break;
@@ -567,6 +717,9 @@ uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
 
   conn->lport = HTONS(lastport);
   conn->rport = rport;
+#if UIP_HASH
+  uip_udp_hash_flush();
+#endif
   if(ripaddr == NULL) {
     memset(conn->ripaddr, 0, sizeof(uip_ipaddr_t));
   } else {
@@ -590,22 +743,38 @@ uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
 void
 uip_unlisten(u16_t port)
 {
-  for(u8_t c = 0; c < UIP_LISTENPORTS; ++c) {
+#if UIP_HASH
+  uip_cidx_t *p = &uip_listen_hash[uip_hash_fold(port)];
+  while(*p != UIP_CIDX_NONE) {
+    if(uip_listenports[*p].port == port) {
+      uip_listenports[*p].port = 0;
+      *p = uip_listen_next[*p];
+      return;
+    }
+    p = &uip_listen_next[*p];
+  }
+#else
+  for(uip_cidx_t c = 0; c < UIP_LISTENPORTS; ++c) {
     if(uip_listenports[c].port == port) {
       uip_listenports[c].port = 0;
       return;
     }
   }
+#endif
 }
 #endif /* !TEENSY_SUPPORT */
 /*---------------------------------------------------------------------------*/
 void
 uip_listen(u16_t port, uip_conn_callback_t callback)
 {
-  for(u8_t c = 0; c < UIP_LISTENPORTS; ++c) {
+  for(uip_cidx_t c = 0; c < UIP_LISTENPORTS; ++c) {
     if(uip_listenports[c].port == 0) {
       uip_listenports[c].port = port;
       uip_listenports[c].callback = callback;
+#if UIP_HASH
+      uip_listen_next[c] = uip_listen_hash[uip_hash_fold(port)];
+      uip_listen_hash[uip_hash_fold(port)] = c;
+#endif
       return;
     }
   }
@@ -686,8 +855,25 @@ uip_process(u8_t flag)
     goto drop;
   }
 
+#ifdef TCP_FINE_TIMER_SUPPORT
+  /* Check if we were invoked because the retransmission timer of the
+     connection expired. */
+  if(flag == UIP_REXMIT_TIMER) {
+    uip_len = 0;
+    uip_slen = 0;
+    if(uip_connr->tcpstateflags != UIP_CLOSED &&
+       uip_connr->tcpstateflags != UIP_TIME_WAIT &&
+       uip_connr->tcpstateflags != UIP_FIN_WAIT_2 &&
+       uip_outstanding(uip_connr)) {
+      goto tcp_rexmit;
+    }
+    goto drop;
+  }
+#endif /* TCP_FINE_TIMER_SUPPORT */
+
     /* Check if we were invoked because of the perodic timer fireing. */
   if(flag == UIP_TIMER) {
+#ifndef TCP_FINE_TIMER_SUPPORT
     /* Increase the initial sequence number. */
     if(++iss[3] == 0) {
       if(++iss[2] == 0) {
@@ -696,6 +882,7 @@ uip_process(u8_t flag)
 	}
       }
     }
+#endif
 
     /* Reset the length variables. */
     uip_len = 0;
@@ -734,7 +921,14 @@ uip_process(u8_t flag)
 	 connection's timer and see if it has reached the RTO value
 	 in which case we retransmit. */
       if(uip_outstanding(uip_connr)) {
+#ifdef TCP_FINE_TIMER_SUPPORT
+	/* Retransmissions are driven by uip_tcp_fast_timer(). */
+	goto drop;
+      tcp_rexmit:
+	{
+#else
 	if(uip_connr->timer-- == 0) {
+#endif
 	  if(uip_connr->nrtx == UIP_MAXRTX ||
 	     ((uip_connr->tcpstateflags == UIP_SYN_SENT ||
 	       uip_connr->tcpstateflags == UIP_SYN_RCVD) &&
@@ -753,9 +947,15 @@ uip_process(u8_t flag)
 	  }
 
 	  /* Exponential backoff. */
+#ifdef TCP_FINE_TIMER_SUPPORT
+	  uip_wheel_arm(uip_connr, (u16_t)uip_connr->rto <<
+			(uip_connr->nrtx > 4? 4: uip_connr->nrtx));
+	  uip_connr->dupacks = 0;
+#else
 	  uip_connr->timer = UIP_RTO << (uip_connr->nrtx > 4?
 					 4:
 					 uip_connr->nrtx);
+#endif
 	  ++(uip_connr->nrtx);
 
 	  /* Ok, so we need to retransmit. We do this differently
@@ -1117,6 +1317,22 @@ ip_check_end:
 #endif /* UIP_UDP_CHECKSUMS */
 
   /* Demultiplex this UDP packet between the UDP "connections". */
+#if UIP_HASH
+  {
+    uip_cidx_t h = uip_udp_hint[uip_hash_fold(UDPBUF->destport)];
+    if(h != UIP_CIDX_NONE) {
+      uip_udp_conn = &uip_udp_conns[h];
+      if(uip_udp_conn->lport == UDPBUF->destport &&
+         (uip_udp_conn->rport == 0 ||
+          UDPBUF->srcport == uip_udp_conn->rport) &&
+         (uip_ipaddr_cmp(uip_udp_conn->ripaddr, all_zeroes_addr) ||
+          uip_ipaddr_cmp(uip_udp_conn->ripaddr, all_ones_addr) ||
+          uip_ipaddr_cmp(BUF->srcipaddr, uip_udp_conn->ripaddr))) {
+        goto udp_found;
+      }
+    }
+  }
+#endif /* UIP_HASH */
   for(uip_udp_conn = &uip_udp_conns[UIP_UDP_CONNS - 1];
       uip_udp_conn >= &uip_udp_conns[0];
       --uip_udp_conn) {
@@ -1134,14 +1350,28 @@ ip_check_end:
        (uip_ipaddr_cmp(uip_udp_conn->ripaddr, all_zeroes_addr) ||
 	uip_ipaddr_cmp(uip_udp_conn->ripaddr, all_ones_addr) ||
 	uip_ipaddr_cmp(BUF->srcipaddr, uip_udp_conn->ripaddr))) {
-      goto udp_found;
+      goto udp_found_scan;
     }
   }
   DEBUG_PRINTF("udp: no matching connection found, sport %hu, dport %hu\n",
                ntohs(UDPBUF->srcport), ntohs(UDPBUF->destport));
   goto drop;
 
+ udp_found_scan:
+#if UIP_HASH
+  {
+    /* Remember the connection if it is the only one on this port. */
+    uip_cidx_t h = uip_udp_conn - uip_udp_conns;
+    for(uip_cidx_t c = 0; c < UIP_UDP_CONNS; ++c) {
+      if(c != h && uip_udp_conns[c].lport == uip_udp_conn->lport) {
+        h = UIP_CIDX_NONE;
+        break;
+      }
+    }
+    uip_udp_hint[uip_hash_fold(uip_udp_conn->lport)] = h;
+  }
  udp_found:
+#endif /* UIP_HASH */
   uip_conn = NULL;
   uip_flags = UIP_NEWDATA;
   uip_sappdata = uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN];
@@ -1207,8 +1437,15 @@ ip_check_end:
 
   /* Demultiplex this segment. */
   /* First check any active connections. */
+#if UIP_HASH
+  for(uip_cidx_t c = uip_conn_hash[uip_hash_tcp(BUF->destport, BUF->srcport,
+                                                BUF->srcipaddr)];
+      c != UIP_CIDX_NONE; c = uip_conn_next[c]) {
+    uip_connr = &uip_conns[c];
+#else
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
+#endif
     if(uip_connr->tcpstateflags != UIP_CLOSED &&
        BUF->destport == uip_connr->lport &&
        BUF->srcport == uip_connr->rport &&
@@ -1227,10 +1464,19 @@ ip_check_end:
 
   u16_t tmp16 = BUF->destport;
   /* Next, check listening connections. */
-  for(u8_t c = 0; c < UIP_LISTENPORTS; ++c) {
+#if UIP_HASH
+  uip_cidx_t lidx;
+  for(lidx = uip_listen_hash[uip_hash_fold(tmp16)];
+      lidx != UIP_CIDX_NONE; lidx = uip_listen_next[lidx]) {
+    if(tmp16 == uip_listenports[lidx].port)
+      goto found_listen;
+  }
+#else
+  for(uip_cidx_t c = 0; c < UIP_LISTENPORTS; ++c) {
     if(tmp16 == uip_listenports[c].port)
       goto found_listen;
   }
+#endif
 
   /* No matching connection found, so we send a RST packet. */
   UIP_STAT(++uip_stat.tcp.synrst);
@@ -1299,7 +1545,7 @@ ip_check_end:
      CLOSED connections are found. Thanks to Eddie C. Dost for a very
      nice algorithm for the TIME_WAIT search. */
   uip_connr = 0;
-  for(u8_t c = 0; c < UIP_CONNS; ++c) {
+  for(uip_cidx_t c = 0; c < UIP_CONNS; ++c) {
     if(uip_conns[c].tcpstateflags == UIP_CLOSED) {
       uip_connr = &uip_conns[c];
       break;
@@ -1323,11 +1569,16 @@ ip_check_end:
   uip_conn = uip_connr;
 
   /* Set callback to the given value in uip_listenports */
-  for(u8_t c = 0; c < UIP_LISTENPORTS; ++c)
+#if UIP_HASH
+  uip_conn->callback = uip_listenports[lidx].callback;
+  uip_conn_unhash(uip_connr);
+#else
+  for(uip_cidx_t c = 0; c < UIP_LISTENPORTS; ++c)
     if(tmp16 == uip_listenports[c].port) {
       uip_conn->callback = uip_listenports[c].callback;
       break;
     }
+#endif
 
 #if UIP_MULTI_STACK
   uip_conn->stack = uip_stack_get_active();
@@ -1338,10 +1589,17 @@ ip_check_end:
   uip_connr->sa = 0;
   uip_connr->sv = 4;
   uip_connr->nrtx = 0;
+#ifdef TCP_FINE_TIMER_SUPPORT
+  uip_connr->dupacks = 0;
+  uip_wheel_unlink(uip_connr);
+#endif
   uip_connr->wnd = 0; /* unset the personal window size for this connection */
   uip_connr->lport = BUF->destport;
   uip_connr->rport = BUF->srcport;
   uip_ipaddr_copy(uip_connr->ripaddr, BUF->srcipaddr);
+#if UIP_HASH
+  uip_conn_rehash(uip_connr);
+#endif
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
 
   uip_connr->snd_nxt[0] = iss[0];
@@ -1473,6 +1731,34 @@ ip_check_end:
       uip_connr->snd_nxt[3] = uip_acc32[3];
 
 
+#ifdef TCP_FINE_TIMER_SUPPORT
+      /* Do RTT estimation, unless we have done retransmissions.  The
+	 segment was sent rto ticks before its deadline. */
+      uip_cidx_t idx = uip_connr - uip_conns;
+      if(uip_connr->nrtx == 0 &&
+	 uip_wheel_next[idx] != UIP_WHEEL_UNLINKED) {
+	int16_t m = uip_connr->rto -
+	  (u16_t)(uip_wheel_deadline[idx] - uip_tcp_ticks);
+	if(m < 0) {
+	  m = 0;
+	}
+	m = m - (uip_connr->sa >> 3);
+	uip_connr->sa += m;
+	if(m < 0) {
+	  m = -m;
+	}
+	m = m - (uip_connr->sv >> 2);
+	uip_connr->sv += m;
+	u16_t rto = (uip_connr->sa >> 3) + uip_connr->sv;
+	uip_connr->rto = rto < UIP_RTO_MIN ? UIP_RTO_MIN :
+	  rto > 255 ? 255 : rto;
+      }
+      /* Set the acknowledged flag. */
+      uip_flags = UIP_ACKDATA;
+      /* Stop the retransmission timer. */
+      uip_wheel_unlink(uip_connr);
+      uip_connr->dupacks = 0;
+#else
       /* Do RTT estimation, unless we have done retransmissions. */
       if(uip_connr->nrtx == 0) {
 	signed char m;
@@ -1492,6 +1778,7 @@ ip_check_end:
       uip_flags = UIP_ACKDATA;
       /* Reset the retransmission timer. */
       uip_connr->timer = uip_connr->rto;
+#endif
 
       /* Reset length of outstanding data. */
       uip_connr->len = 0;
@@ -1665,6 +1952,28 @@ ip_check_end:
        tmp16 == 0) {
       tmp16 = uip_connr->initialmss;
     }
+#ifdef TCP_FINE_TIMER_SUPPORT
+    /* A pure ACK which neither acknowledges the outstanding segment nor
+       updates the window means the peer received data behind a lost
+       segment.  Retransmit at once instead of waiting for the timer. */
+    if(uip_outstanding(uip_connr) && !(uip_flags & UIP_ACKDATA) &&
+       uip_len == 0 && (BUF->flags & (TCP_SYN | TCP_FIN)) == 0 &&
+       tmp16 == uip_connr->mss &&
+       BUF->ackno[0] == uip_connr->snd_nxt[0] &&
+       BUF->ackno[1] == uip_connr->snd_nxt[1] &&
+       BUF->ackno[2] == uip_connr->snd_nxt[2] &&
+       BUF->ackno[3] == uip_connr->snd_nxt[3] &&
+       ++(uip_connr->dupacks) >= UIP_DUPACK_THRESH) {
+      uip_connr->dupacks = 0;
+      uip_connr->nrtx = 1;  /* no RTT sample from a retransmission */
+      uip_wheel_arm(uip_connr, uip_connr->rto);
+      UIP_STAT(++uip_stat.tcp.rexmit);
+      uip_slen = 0;
+      uip_flags = UIP_REXMIT;
+      UIP_APPCALL();
+      goto apprexmit;
+    }
+#endif /* TCP_FINE_TIMER_SUPPORT */
     uip_connr->mss = tmp16;
 
     /* If this packet constitutes an ACK for outstanding data (flagged
@@ -1886,6 +2195,14 @@ ip_check_end:
     }
   }
 
+#ifdef TCP_FINE_TIMER_SUPPORT
+  /* Start the retransmission timer when a segment goes out. */
+  if(uip_outstanding(uip_connr) &&
+     uip_wheel_next[uip_connr - uip_conns] == UIP_WHEEL_UNLINKED) {
+    uip_wheel_arm(uip_connr, uip_connr->rto);
+  }
+#endif
+
  tcp_send_noconn:
   BUF->ttl = UIP_TTL;
 #if UIP_CONF_IPV6
@@ -1964,6 +2281,10 @@ uip_tcp_timer(void)
 #endif
 
   for (i = 0; i < UIP_CONNS; i++) {
+#ifdef TCP_FINE_TIMER_SUPPORT
+    if (uip_conns[i].tcpstateflags == UIP_CLOSED)
+      continue;
+#endif
     uip_stack_set_active(uip_conns[i].stack);
     uip_periodic(i);
 
@@ -1974,13 +2295,117 @@ uip_tcp_timer(void)
 
   return;
 }
+
+#ifdef TCP_FINE_TIMER_SUPPORT
+void
+uip_tcp_fast_timer(void)
+{
+  /* Increase the initial sequence number. */
+  if(++iss[3] == 0) {
+    if(++iss[2] == 0) {
+      if(++iss[1] == 0) {
+	++iss[0];
+      }
+    }
+  }
+
+  /* Retransmit on all connections whose deadline is this tick, the
+     others in this slot are due in a later round. */
+  uip_cidx_t *p = &uip_wheel[++uip_tcp_ticks & (UIP_WHEEL_SLOTS - 1)];
+  while (*p < UIP_CONNS) {
+    uip_cidx_t c = *p;
+    if (uip_wheel_deadline[c] != uip_tcp_ticks) {
+      p = &uip_wheel_next[c];
+      continue;
+    }
+    *p = uip_wheel_next[c];
+    uip_wheel_next[c] = UIP_WHEEL_UNLINKED;
+
+    uip_stack_set_active(uip_conns[c].stack);
+    uip_conn = &uip_conns[c];
+    uip_process(UIP_REXMIT_TIMER);
+
+    if (uip_len > 0)
+      router_output();
+  }
+}
+#endif /* TCP_FINE_TIMER_SUPPORT */
 #endif // UIP_TCP == 1
 
+#ifdef TCP_SPLIT_SUPPORT
+static void
+uip_split_chksum(void)
+{
+#if UIP_CONF_IPV6
+  BUF->len[0] = ((uip_len - UIP_IPH_LEN) >> 8);
+  BUF->len[1] = ((uip_len - UIP_IPH_LEN) & 0xff);
+#else /* UIP_CONF_IPV6 */
+  BUF->len[0] = (uip_len >> 8);
+  BUF->len[1] = (uip_len & 0xff);
+  BUF->ipchksum = 0;
+  BUF->ipchksum = ~(uip_ipchksum());
+#endif /* UIP_CONF_IPV6 */
+  BUF->tcpchksum = 0;
+  BUF->tcpchksum = ~(uip_tcpchksum());
+}
+
+/* uIP allows only one unacknowledged segment per connection.  Peers
+ * doing delayed ACKs wait up to 200ms before acknowledging a single
+ * segment, which limits bulk transfers to one segment per 200ms.
+ * Sending each data segment as two halves makes the peer ACK at once,
+ * uIP itself still tracks the whole segment as outstanding. */
+void
+uip_split_output(void)
+{
+  u16_t hdrlen, len1, len2;
+  u8_t flags;
+
+  if (BUF->proto != UIP_PROTO_TCP)
+    goto out;
+
+  /* the second half is built in uip_buf, the first one must be gone */
+  if (!router_output_sync(&BUF->destipaddr))
+    goto out;
+
+  hdrlen = UIP_IPH_LEN + ((BUF->tcpoffset >> 4) << 2);
+  if (uip_len < hdrlen + 2)
+    goto out;
+
+  len1 = (uip_len - hdrlen) / 2;
+  len2 = uip_len - hdrlen - len1;
+  flags = BUF->flags;
+
+  /* first half, FIN and PSH belong to the second one */
+  uip_len = hdrlen + len1;
+  BUF->flags = flags & ~(TCP_FIN | TCP_PSH);
+  uip_split_chksum();
+  if (router_output_ll())
+    return;                     /* packet was replaced by an arp request */
+
+  /* second half */
+  memmove(&uip_buf[UIP_LLH_LEN + hdrlen],
+          &uip_buf[UIP_LLH_LEN + hdrlen + len1], len2);
+  uip_add32(BUF->seqno, len1);
+  memcpy(BUF->seqno, uip_acc32, 4);
+  BUF->flags = flags;
+  uip_len = hdrlen + len2;
+#if !UIP_CONF_IPV6
+  ++ipid;
+  BUF->ipid[0] = ipid >> 8;
+  BUF->ipid[1] = ipid & 0xff;
+#endif /* !UIP_CONF_IPV6 */
+  uip_split_chksum();
+
+out:
+  router_output_ll();
+}
+#endif /* TCP_SPLIT_SUPPORT */
+
 #if UIP_UDP == 1
 void
 uip_udp_timer(void)
 {
-#if UIP_CONNS <= 255
+#if UIP_UDP_CONNS <= 255
   uint8_t i;
 #else
   uint16_t i;
@@ -2007,5 +2432,6 @@ uip_udp_timer(void)
   header(protocols/uip/uip.h)
   header(protocols/uip/uip_router.h)
   ifdef(`conf_TCP', `timer(10, `uip_tcp_timer()')')
+  ifdef(`conf_TCP_FINE_TIMER', `timer(1, `uip_tcp_fast_timer()')')
   ifdef(`conf_UDP', `timer(10, `uip_udp_timer()')')
 */
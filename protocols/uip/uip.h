@@ -814,7 +814,22 @@ uip_udp_conn_t *uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callbac
  *
  * \hideinitializer
  */
+#if UIP_HASH
+#define uip_udp_bind(conn, port) do { (conn)->lport = port; \
+                                      uip_udp_hash_flush(); } while (0)
+#else
 #define uip_udp_bind(conn, port) (conn)->lport = port
+#endif
+
+#if UIP_HASH
+/**
+ * Forget the UDP lookup hints.
+ *
+ * Called whenever the local port of a UDP connection is set, as a
+ * hint is only valid while its local port is unique.
+ */
+void uip_udp_hash_flush(void);
+#endif
 
 /**
  * Send a UDP datagram of length len on the current connection.
@@ -1235,15 +1250,26 @@ struct __uip_conn {
 			 connection. */
   u16_t initialmss;   /**< Initial maximum segment size for the
 			 connection. */
+#ifdef TCP_FINE_TIMER_SUPPORT
+  u16_t sa;           /**< Retransmission time-out calculation state
+			 variable. */
+  u16_t sv;           /**< Retransmission time-out calculation state
+			 variable. */
+#else
   u8_t sa;            /**< Retransmission time-out calculation state
 			 variable. */
   u8_t sv;            /**< Retransmission time-out calculation state
 			 variable. */
+#endif
   u8_t rto;           /**< Retransmission time-out. */
   u8_t tcpstateflags; /**< TCP state and flags. */
   u8_t timer;         /**< The retransmission timer. */
   u8_t nrtx;          /**< The number of retransmissions for the last
 			 segment sent. */
+#ifdef TCP_FINE_TIMER_SUPPORT
+  u8_t dupacks;       /**< The number of duplicate ACKs received for
+			 the outstanding segment. */
+#endif
 
 #ifdef UIP_TIMEOUT_SUPPORT
   u16_t timeout;       /** < The connection timeout timer */
@@ -1448,6 +1474,8 @@ void uip_process(u8_t flag);
 #if UIP_UDP
 #define UIP_UDP_TIMER     5
 #endif /* UIP_UDP */
+#define UIP_REXMIT_TIMER  6     /* Tells uIP that the retransmission
+				   timer of a connection has expired. */
 
 /* The TCP states used in the uip_conn->tcpstateflags. */
 #define UIP_CLOSED      0
@@ -1688,6 +1716,9 @@ static inline uint8_t uip_buf_lock (void)
 /* periodic timer */
 #if UIP_TCP == 1
 void uip_tcp_timer(void);
+#ifdef TCP_FINE_TIMER_SUPPORT
+void uip_tcp_fast_timer(void);
+#endif
 #endif
 #if UIP_UDP == 1
 void uip_udp_timer(void);
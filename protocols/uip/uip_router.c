@@ -167,8 +167,8 @@ router_input(uint8_t origin)
   return;
 }
 
-void
-router_output(void) {
+uint8_t
+router_output_ll(void) {
 #ifdef IPCHAIR_HAVE_OUTPUT
   ipchair_OUTPUT_chair();
 #endif
@@ -177,10 +177,26 @@ router_output(void) {
   if (dest == 255)
     {
       uip_len = 0;
-      return;
+      return 0;
     }
 
-  router_output_to(dest);
+  return router_output_to(dest);
+}
+
+uint8_t
+router_output_sync(uip_ipaddr_t *destip)
+{
+  uint8_t dest = router_find_stack(destip);
+
+#ifdef ENC28J60_SUPPORT
+  if (dest == STACK_ENC)
+    return 1;
+#endif
+#ifdef TAP_SUPPORT
+  if (dest == STACK_TAP)
+    return 1;
+#endif
+  return 0;
 }
 
 uint8_t
@@ -201,7 +217,7 @@ router_output_to (uint8_t dest)
 #ifdef ENC28J60_SUPPORT
     case STACK_ENC:
       printf ("router_output_to: ENC28J60.\n");
-      enc28j60_txstart ();
+      retval = enc28j60_txstart ();
       break;
 #endif	/* ENC28J60_SUPPORT */
 
@@ -240,7 +256,7 @@ router_output_to (uint8_t dest)
 #ifdef TAP_SUPPORT
     case STACK_TAP:
       printf ("router_output_to: TAP.\n");
-      tap_txstart ();
+      retval = tap_txstart ();
       break;
 #endif  /* TAP_SUPPORT */
 
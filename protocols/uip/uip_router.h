@@ -34,10 +34,15 @@ uint8_t router_output_to (uint8_t stack);
 uint8_t router_find_stack(uip_ipaddr_t *forwardip);
 
 /* Find a suitable stack to transmit the packet in uip_buf and finally
-   send it.
+   send it.  Returns 1 if the packet has been replaced by an arp request.
    This function is only used by applications, not by the stack inputs 
    */
-void router_output(void);
+uint8_t router_output_ll(void);
+
+/* Returns 1 if the link packets to DESTIP are routed to has copied one
+   when its txstart returns, so uip_buf may be reused right away.  The
+   other links send from uip_buf (or their own buffer) later on. */
+uint8_t router_output_sync(uip_ipaddr_t *destip);
 
 #else
 
@@ -52,26 +57,40 @@ void router_output(void);
 
 #if defined(ENC28J60_SUPPORT)
 #  include "network.h"
-#  define router_output() enc28j60_txstart()
+#  define router_output_ll() enc28j60_txstart()
+#  define router_output_sync(dest) 1
 
 #elif defined(TAP_SUPPORT)
 #  include "core/host/tap.h"
-#  define router_output() tap_txstart()
+#  define router_output_ll() tap_txstart()
+#  define router_output_sync(dest) 1
 
 #elif defined(RFM12_IP_SUPPORT)
 #  include "hardware/radio/rfm12/rfm12.h"
-#  define router_output() (rfm12_txstart (uip_len), 0)
+#  define router_output_ll() (rfm12_txstart (uip_len), 0)
+#  define router_output_sync(dest) 0
 
 #elif defined(ZBUS_SUPPORT)
 #  include "protocols/zbus/zbus.h"
-#  define router_output() (zbus_txstart (uip_len));
+#  define router_output_ll() (zbus_txstart (uip_len), 0)
+#  define router_output_sync(dest) 0
 
 #elif defined(USB_NET_SUPPORT)
 #  include "protocols/usb/usb_net.h"
-#  define router_output() (usb_net_txstart(), 0)
+#  define router_output_ll() (usb_net_txstart(), 0)
+#  define router_output_sync(dest) 0
 
 #endif
 
 #endif	/* ROUTER_SUPPORT && UIP_MULTI_STACK */
 
+#ifdef TCP_SPLIT_SUPPORT
+/* Send the packet in uip_buf, TCP segments carrying data are split
+   into two halves (see uip.c). */
+void uip_split_output(void);
+#  define router_output() uip_split_output()
+#else
+#  define router_output() router_output_ll()
+#endif
+
 #endif	/* UIP_ROUTER_H */
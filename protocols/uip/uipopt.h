@@ -192,6 +192,27 @@
 #define UIP_LISTENPORTS UIP_CONF_MAX_LISTENPORTS
 #endif /* UIP_CONF_MAX_LISTENPORTS */
 
+/**
+ * The number of buckets of the connection hash tables.
+ *
+ * If set, incoming TCP segments are demultiplexed through hash tables
+ * over the active connections and the listening ports instead of
+ * scanning all of them, UDP datagrams are looked up through a table
+ * of hints.  This is only worth the RAM if the number of connections
+ * has been raised well above the default.  Must be a power of two.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_HASH_SIZE
+#define UIP_HASH_SIZE UIP_CONF_HASH_SIZE
+#define UIP_HASH 1
+#if UIP_HASH_SIZE & (UIP_HASH_SIZE - 1)
+#error "UIP_CONF_HASH_SIZE must be a power of two"
+#endif
+#else /* UIP_CONF_HASH_SIZE */
+#define UIP_HASH 0
+#endif /* UIP_CONF_HASH_SIZE */
+
 /**
  * Determines if support for TCP urgent data notification should be
  * compiled in.
@@ -206,9 +227,43 @@
 /**
  * The initial retransmission timeout counted in timer pulses.
  *
+ * With TCP_FINE_TIMER_SUPPORT the retransmission timers count 20ms
+ * ticks instead of 200ms timer pulses.
+ *
  * This should not be changed.
  */
+#ifdef TCP_FINE_TIMER_SUPPORT
+#define UIP_RTO         30
+#else
 #define UIP_RTO         3
+#endif
+
+#ifdef TCP_FINE_TIMER_SUPPORT
+/**
+ * The lower bound of the retransmission timeout in 20ms ticks.
+ *
+ * Must be above the delayed ACK timeout of the peers (200ms).
+ */
+#define UIP_RTO_MIN     12
+
+/**
+ * The number of slots of the retransmission timer wheel, a power of
+ * two.  Timeouts longer than this many ticks take several rounds.
+ */
+#define UIP_WHEEL_SLOTS 16
+
+/**
+ * The number of duplicate ACKs that trigger a fast retransmit.
+ *
+ * uIP has a single segment in flight, so duplicate ACKs are only seen
+ * if the segment was sent in two halves and the first one got lost.
+ */
+#ifdef TCP_SPLIT_SUPPORT
+#define UIP_DUPACK_THRESH 1
+#else
+#define UIP_DUPACK_THRESH 3
+#endif
+#endif /* TCP_FINE_TIMER_SUPPORT */
 
 /**
  * The maximum number of times a segment should be retransmitted
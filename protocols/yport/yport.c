@@ -24,6 +24,7 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
+#include <util/atomic.h>
 #include <util/delay.h>
 #include <string.h>
 #include "core/eeprom.h"
@@ -45,47 +46,228 @@ uint16_t yport_rx_frameerror;
 uint16_t yport_rx_overflow;
 uint16_t yport_rx_parityerror;
 uint16_t yport_rx_bufferfull;
+uint16_t yport_tx_bufferfull;
 #endif
 
+#define yport_next(i) ((yport_index_t) ((i) + 1 == YPORT_BUFFER_LEN ? 0 : (i) + 1))
+
+/* Indices written by the other side of the buffer have to be read in one
+ * go, which takes an atomic block if they are wider than a byte. */
+static inline yport_index_t
+yport_load(volatile yport_index_t *index)
+{
+#if YPORT_BUFFER_LEN < 256
+  return *index;
+#else
+  yport_index_t i;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    i = *index;
+  }
+  return i;
+#endif
+}
+
+static inline void
+yport_store(volatile yport_index_t *index, yport_index_t i)
+{
+#if YPORT_BUFFER_LEN < 256
+  *index = i;
+#else
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    *index = i;
+  }
+#endif
+}
+
 void
 yport_init(void)
 {
   usart_init();
 }
 
+uint16_t
+yport_tx_free(void)
+{
+  uint16_t head = yport_send_buffer.head;
+  uint16_t tail = yport_load(&yport_send_buffer.tail);
+  return (tail > head ? 0 : YPORT_BUFFER_LEN) + tail - head - 1;
+}
+
+uint16_t
+yport_tx_write(const uint8_t *data, uint16_t len)
+{
+  uint16_t free = yport_tx_free();
+  if (len > free)
+  {
+#ifdef DEBUG_YPORT
+    yport_tx_bufferfull++;
+#endif
+    len = free;
+  }
+  if (len == 0)
+    return 0;
+
+  yport_index_t head = yport_send_buffer.head;
+  for (uint16_t i = 0; i < len; i++)
+  {
+    yport_send_buffer.data[head] = data[i];
+    head = yport_next(head);
+  }
+  yport_store(&yport_send_buffer.head, head);
+
+  /* The data register empty interrupt fires at once if the usart is idle */
+  usart(UCSR,B) |= _BV(usart(UDRIE));
+  return len;
+}
+
+void
+yport_tx_purge(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    yport_send_buffer.head = yport_send_buffer.tail;
+  }
+}
+
+uint16_t
+yport_rx_used(void)
+{
+  uint16_t head = yport_load(&yport_recv_buffer.head);
+  uint16_t tail = yport_recv_buffer.tail;
+  return (head >= tail ? 0 : YPORT_BUFFER_LEN) + head - tail;
+}
+
+uint8_t
+yport_rx_peek(uint16_t offset)
+{
+  offset += yport_recv_buffer.tail;
+  if (offset >= YPORT_BUFFER_LEN)
+    offset -= YPORT_BUFFER_LEN;
+  return yport_recv_buffer.data[offset];
+}
+
+void
+yport_rx_consume(uint16_t len)
+{
+  len += yport_recv_buffer.tail;
+  if (len >= YPORT_BUFFER_LEN)
+    len -= YPORT_BUFFER_LEN;
+  yport_store(&yport_recv_buffer.tail, len);
+}
+
+#ifdef YPORT_RFC2217_SUPPORT
+static uint32_t yport_baudrate = YPORT_BAUDRATE;
+/* UCSRC can't be read back on devices sharing it with UBRRH */
+static uint8_t yport_ucsrc = _BV(usart(UCSZ,0)) | _BV(usart(UCSZ,1));
+
+static void
+yport_write_ucsrc(void)
+{
+  usart(UCSR,C) = yport_ucsrc | _BV_URSEL;
+}
+
+uint32_t
+yport_get_baudrate(void)
+{
+  return yport_baudrate;
+}
+
+uint8_t
+yport_set_baudrate(uint32_t baud)
+{
+  if (baud == 0)
+    return 0;
+
+  /* Prefer double speed mode, it has the finer resolution */
+  uint8_t u2x = 1;
+  uint32_t ubrr = (F_CPU / 8 + baud / 2) / baud;
+  if (ubrr > 4096)
+  {
+    u2x = 0;
+    ubrr = (F_CPU / 16 + baud / 2) / baud;
+  }
+  if (ubrr == 0 || ubrr > 4096)
+    return 0;
+  ubrr--;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    usart(UBRR,H) = ubrr >> 8;
+    usart(UBRR,L) = ubrr & 0xff;
+    if (u2x)
+      usart(UCSR,A) |= _BV(usart(U2X));
+    else
+      usart(UCSR,A) &= ~_BV(usart(U2X));
+  }
+  yport_baudrate = baud;
+  return 1;
+}
+
+/* The setters below take and return RFC 2217 values, 0 queries the
+ * current setting. */
+uint8_t
+yport_set_datasize(uint8_t size)
+{
+  if (size >= 5 && size <= 8)
+  {
+    yport_ucsrc = (yport_ucsrc & ~(_BV(usart(UCSZ,0)) | _BV(usart(UCSZ,1))))
+      | ((size - 5) << usart(UCSZ,0));
+    yport_write_ucsrc();
+  }
+  return ((yport_ucsrc >> usart(UCSZ,0)) & 3) + 5;
+}
+
 uint8_t
-yport_rxstart(uint8_t *data, uint16_t len)
-{
-  uint16_t diff = yport_send_buffer.len - yport_send_buffer.sent;
-  if (diff == 0) {
-    /* Copy the data to the send buffer */
-    memcpy(yport_send_buffer.data, data, len);
-    yport_send_buffer.len = len;
-    goto start_sending;
-  /* The actual packet can be pushed into the buffer */
-  } else if ((diff + len) < YPORT_BUFFER_LEN) {
-    memmove(yport_send_buffer.data, yport_send_buffer.data + yport_send_buffer.sent, diff);
-    memcpy(yport_send_buffer.data + diff, data, len);
-    yport_send_buffer.len = diff + len;
-    goto start_sending;
+yport_set_parity(uint8_t parity)
+{
+  uint8_t upm = 0xff;
+  if (parity == 1)              /* none */
+    upm = 0;
+  else if (parity == 2)         /* odd */
+    upm = _BV(usart(UPM,1)) | _BV(usart(UPM,0));
+  else if (parity == 3)         /* even */
+    upm = _BV(usart(UPM,1));
+  if (upm != 0xff)
+  {
+    yport_ucsrc = (yport_ucsrc & ~(_BV(usart(UPM,1)) | _BV(usart(UPM,0))))
+      | upm;
+    yport_write_ucsrc();
   }
-  return 0;
-start_sending:
-    yport_send_buffer.sent = 1;
-    /* Enable the tx interrupt and send the first character */
-    usart(UCSR,B) |= _BV(usart(TXCIE));
-    usart(UDR) = yport_send_buffer.data[0];
+  if (!(yport_ucsrc & _BV(usart(UPM,1))))
     return 1;
+  return (yport_ucsrc & _BV(usart(UPM,0))) ? 2 : 3;
 }
 
+uint8_t
+yport_set_stopsize(uint8_t stopsize)
+{
+  if (stopsize == 1 || stopsize == 2)
+  {
+    if (stopsize == 2)
+      yport_ucsrc |= _BV(usart(USBS));
+    else
+      yport_ucsrc &= ~_BV(usart(USBS));
+    yport_write_ucsrc();
+  }
+  return (yport_ucsrc & _BV(usart(USBS))) ? 2 : 1;
+}
+#endif /* YPORT_RFC2217_SUPPORT */
+
 
-ISR(usart(USART,_TX_vect))
+ISR(usart(USART,_UDRE_vect))
 {
-  if (yport_send_buffer.sent < yport_send_buffer.len) {
-    usart(UDR) = yport_send_buffer.data[yport_send_buffer.sent++];
-  } else {
+  yport_index_t tail = yport_send_buffer.tail;
+  if (tail != yport_send_buffer.head)
+  {
+    usart(UDR) = yport_send_buffer.data[tail];
+    yport_send_buffer.tail = yport_next(tail);
+  }
+  else
+  {
     /* Disable this interrupt */
-    usart(UCSR,B) &= ~(_BV(usart(TXCIE)));
+    usart(UCSR,B) &= ~(_BV(usart(UDRIE)));
   }
 }
 
@@ -106,8 +288,13 @@ ISR(usart(USART,_RX_vect))
     else
     {
       uint8_t v = usart(UDR);
-      if (yport_recv_buffer.len < YPORT_BUFFER_LEN)
-        yport_recv_buffer.data[yport_recv_buffer.len++] = v;
+      yport_index_t head = yport_recv_buffer.head;
+      yport_index_t next = yport_next(head);
+      if (next != yport_recv_buffer.tail)
+      {
+        yport_recv_buffer.data[head] = v;
+        yport_recv_buffer.head = next;
+      }
 #ifdef DEBUG_YPORT
       else
         yport_rx_bufferfull++;
@@ -25,14 +25,42 @@
 #define _YPORT_H
 
 
+#include <stdint.h>
+
+#if YPORT_BUFFER_LEN < 256
+typedef uint8_t yport_index_t;
+#else
+typedef uint16_t yport_index_t;
+#endif
+
+/* Single producer, single consumer ring buffer.  head is only written
+ * by the producer, tail only by the consumer, so neither side needs to
+ * lock the other out.  One byte is kept free to tell full from empty. */
 struct yport_buffer {
-  uint16_t len;
-  uint16_t sent;
+  volatile yport_index_t head;
+  volatile yport_index_t tail;
   uint8_t data[YPORT_BUFFER_LEN];
 };
 
 void yport_init(void);
-uint8_t yport_rxstart(uint8_t *data, uint16_t len);
+
+/* TCP -> serial */
+uint16_t yport_tx_free(void);
+uint16_t yport_tx_write(const uint8_t *data, uint16_t len);
+
+/* serial -> TCP */
+uint16_t yport_rx_used(void);
+uint8_t yport_rx_peek(uint16_t offset);
+void yport_rx_consume(uint16_t len);
+
+#ifdef YPORT_RFC2217_SUPPORT
+uint32_t yport_get_baudrate(void);
+uint8_t yport_set_baudrate(uint32_t baud);
+uint8_t yport_set_datasize(uint8_t size);
+uint8_t yport_set_parity(uint8_t parity);
+uint8_t yport_set_stopsize(uint8_t stopsize);
+#endif
+void yport_tx_purge(void);
 
 extern struct yport_buffer yport_send_buffer;
 extern struct yport_buffer yport_recv_buffer;
@@ -41,6 +69,7 @@ extern uint16_t yport_rx_frameerror;
 extern uint16_t yport_rx_overflow;
 extern uint16_t yport_rx_parityerror;
 extern uint16_t yport_rx_bufferfull;
+extern uint16_t yport_tx_bufferfull;
 #endif
 
 #endif /* _YPORT_H */
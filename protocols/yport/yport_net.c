@@ -22,72 +22,144 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
-#include <util/atomic.h>
 #include <string.h>
 #include "yport_net.h"
 #include "protocols/uip/uip.h"
 #include "core/debug.h"
 #include "yport.h"
+#include "yport_rfc2217.h"
 
 #include "config.h"
 
 uip_conn_t *yport_conn = NULL;
 
+/* Bytes of the receive buffer carried by the unacknowledged segment */
+static uint16_t yport_inflight;
+static uint8_t yport_purge_rx;
+
 void yport_net_init(void)
 {
   uip_listen(HTONS(YPORT_PORT), yport_net_main);
 }
 
+void
+yport_net_purge_rx(void)
+{
+  yport_purge_rx = 1;
+}
+
+/* Copy the control replies and as much serial data as fits into the
+ * segment.  A retransmission has to carry the very same bytes, so it is
+ * built from the same number of buffered bytes again. */
+static void
+yport_net_send(uint8_t rexmit)
+{
+  uint8_t *p = uip_sappdata;
+  uint16_t max = uip_mss();
+  uint16_t n = 0;
+  uint16_t i;
+  uint16_t avail;
+
+#ifdef YPORT_RFC2217_SUPPORT
+  n = yport_rfc2217_copy(p, rexmit);
+#endif
+
+  avail = rexmit ? yport_inflight : yport_rx_used();
+  for (i = 0; i < avail && n < max; i++)
+  {
+    uint8_t c = yport_rx_peek(i);
+#ifdef YPORT_RFC2217_SUPPORT
+    if (c == TELNET_IAC)
+    {
+      if (n + 2 > max)
+        break;
+      p[n++] = TELNET_IAC;
+    }
+#endif
+    p[n++] = c;
+  }
+  yport_inflight = i;
+
+  if (n > 0)
+    uip_send(p, n);
+}
+
+/* Advertise the free space of the send buffer as our receive window, so
+ * the peer never sends more than we can take. */
+static void
+yport_net_window(void)
+{
+  uint16_t free = yport_tx_free();
+  if (free < YPORT_BUFFER_LEN / 4)
+    uip_stop();
+  else
+  {
+    if (uip_stopped(uip_conn))
+      uip_restart();            /* sends a window update */
+    uip_conn->wnd = free;
+  }
+}
+
 void yport_net_main(void)
 {
-  if(uip_connected()) {
+  if (uip_connected()) {
     if (yport_conn == NULL) {
       yport_conn = uip_conn;
-      uip_conn->wnd = YPORT_BUFFER_LEN - 1;
+      yport_inflight = 0;
+      yport_purge_rx = 0;
+#ifdef YPORT_RFC2217_SUPPORT
+      yport_rfc2217_init();
+#endif
     }
-    else
+    else {
       /* if we have already an connection, send an error */
       uip_send("ERROR: Connection blocked\n", 27);
-  } else if (uip_acked()) {
-    /* If the peer is not our connection, close it */
-    if (yport_conn != uip_conn)
-      uip_close();
-    else {
-      /* Some data we have sent was acked, jipphie */
-      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-        yport_recv_buffer.len -= yport_recv_buffer.sent;
-        memmove(yport_recv_buffer.data,
-                yport_recv_buffer.data + yport_recv_buffer.sent,
-                yport_recv_buffer.len);
-      }
+      return;
     }
-  } else if (uip_closed() || uip_aborted() || uip_timedout()) {
+  }
+
+  if (uip_closed() || uip_aborted() || uip_timedout()) {
     /* if the closed connection was our connection, clean yport_conn */
     if (yport_conn == uip_conn)
       yport_conn = NULL;
-  } else if (uip_newdata()) {
-    if (uip_len <= YPORT_BUFFER_LEN && yport_rxstart(uip_appdata, uip_len) != 0) {
-      /* Prevent the other side from sending more data */
-      uip_stop();
-    }
+    return;
   }
-  if (uip_poll()
-      && uip_conn == yport_conn
-      && uip_stopped(yport_conn)
-      && yport_send_buffer.sent == yport_send_buffer.len)
-    uip_restart();
-  /* Send data */
-  if ((uip_poll()
-       || uip_acked()
-       || uip_rexmit())
-      && yport_conn == uip_conn
-      && yport_recv_buffer.len > 0) {
-    /* We have recieved data, lets propagade it */
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-      uip_send(yport_recv_buffer.data, yport_recv_buffer.len);
-      yport_recv_buffer.sent = yport_recv_buffer.len;
-    }
+
+  if (yport_conn != uip_conn) {
+    /* If the peer is not our connection, close it */
+    if (uip_acked())
+      uip_close();
+    return;
   }
+
+  if (uip_acked()) {
+    /* Some data we have sent was acked, jipphie */
+    yport_rx_consume(yport_inflight);
+    yport_inflight = 0;
+#ifdef YPORT_RFC2217_SUPPORT
+    yport_rfc2217_acked();
+#endif
+  }
+
+  if (yport_purge_rx && yport_inflight == 0) {
+    yport_rx_consume(yport_rx_used());
+    yport_purge_rx = 0;
+  }
+
+  if (uip_newdata()) {
+#ifdef YPORT_RFC2217_SUPPORT
+    yport_rfc2217_input(uip_appdata, uip_len);
+#else
+    yport_tx_write(uip_appdata, uip_len);
+#endif
+  }
+
+  if (uip_rexmit())
+    yport_net_send(1);
+  else if (!uip_outstanding(uip_conn))
+    yport_net_send(0);
+
+  yport_net_window();
 }
 
 /*
@@ -25,5 +25,6 @@
 
 void yport_net_init(void);
 void yport_net_main(void);
+void yport_net_purge_rx(void);
 
 #endif /* YPORT_NET_H */
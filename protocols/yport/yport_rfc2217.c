@@ -0,0 +1,294 @@
+/*
+ *
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+
+/* RFC 2217 (Telnet Com Port Control) for the yport, lets the client set
+ * baudrate, data size, parity and stop bits of the serial line. */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "yport.h"
+#include "yport_net.h"
+#include "yport_rfc2217.h"
+
+#define COMPORT_SIGNATURE        0
+#define COMPORT_SET_BAUDRATE     1
+#define COMPORT_SET_DATASIZE     2
+#define COMPORT_SET_PARITY       3
+#define COMPORT_SET_STOPSIZE     4
+#define COMPORT_SET_CONTROL      5
+#define COMPORT_SET_LINESTATE_MASK   10
+#define COMPORT_SET_MODEMSTATE_MASK  11
+#define COMPORT_PURGE_DATA       12
+#define COMPORT_SERVER_OFFSET    100
+
+#define YPORT_CTL_LEN 48
+#define YPORT_SB_LEN  8
+
+enum
+{
+  RFC2217_DATA,
+  RFC2217_IAC,
+  RFC2217_OPT,
+  RFC2217_SB,
+  RFC2217_SB_IAC,
+};
+
+/* Replies to the client, sent in front of the serial data.  The first
+ * ctl_inflight bytes are carried by the unacknowledged segment. */
+static uint8_t ctl_buf[YPORT_CTL_LEN];
+static uint8_t ctl_len;
+static uint8_t ctl_inflight;
+
+static uint8_t state;
+static uint8_t verb;
+static uint8_t sb_buf[YPORT_SB_LEN];
+static uint8_t sb_len;
+/* Options agreed on, bits 0-2 for the client side (WILL), 3-5 for ours */
+static uint8_t opts;
+
+void
+yport_rfc2217_init(void)
+{
+  state = RFC2217_DATA;
+  opts = 0;
+  ctl_len = 0;
+  ctl_inflight = 0;
+}
+
+static void
+ctl_put(const uint8_t *data, uint8_t len)
+{
+  if (ctl_len + len > YPORT_CTL_LEN)
+    return;                     /* client is flooding us with requests */
+  memcpy(ctl_buf + ctl_len, data, len);
+  ctl_len += len;
+}
+
+static void
+yport_rfc2217_negotiate(uint8_t v, uint8_t opt)
+{
+  uint8_t bit = 0;
+  uint8_t reply[3] = { TELNET_IAC, 0, opt };
+
+  if (opt == TELNET_OPT_BINARY)
+    bit = 1;
+  else if (opt == TELNET_OPT_SGA)
+    bit = 2;
+  else if (opt == TELNET_OPT_COMPORT && (v == TELNET_WILL || v == TELNET_WONT))
+    bit = 4;                    /* only the client does com port control */
+
+  if (v == TELNET_DO || v == TELNET_DONT)
+    bit <<= 3;
+
+  /* Only answer requests that change the state, to avoid loops */
+  if (v == TELNET_WILL || v == TELNET_DO)
+  {
+    if (bit && (opts & bit))
+      return;
+    opts |= bit;
+    if (v == TELNET_WILL)
+      reply[1] = bit ? TELNET_DO : TELNET_DONT;
+    else
+      reply[1] = bit ? TELNET_WILL : TELNET_WONT;
+  }
+  else
+  {
+    if (!(opts & bit))
+      return;
+    opts &= ~bit;
+    reply[1] = (v == TELNET_WONT) ? TELNET_DONT : TELNET_WONT;
+  }
+  ctl_put(reply, sizeof(reply));
+}
+
+static void
+comport_reply(uint8_t cmd, const uint8_t *value, uint8_t len)
+{
+  uint8_t buf[4 + 2 * 8 + 2];
+  uint8_t n = 0;
+
+  buf[n++] = TELNET_IAC;
+  buf[n++] = TELNET_SB;
+  buf[n++] = TELNET_OPT_COMPORT;
+  buf[n++] = cmd + COMPORT_SERVER_OFFSET;
+  for (uint8_t i = 0; i < len; i++)
+  {
+    if (value[i] == TELNET_IAC)
+      buf[n++] = TELNET_IAC;
+    buf[n++] = value[i];
+  }
+  buf[n++] = TELNET_IAC;
+  buf[n++] = TELNET_SE;
+  ctl_put(buf, n);
+}
+
+static void
+comport_command(uint8_t cmd, uint8_t *value, uint8_t len)
+{
+  uint8_t v = len ? value[0] : 0;
+
+  switch (cmd)
+  {
+    case COMPORT_SIGNATURE:
+      if (len == 0)
+        comport_reply(cmd, (const uint8_t *) "Ethersex", 8);
+      return;
+
+    case COMPORT_SET_BAUDRATE:
+      if (len >= 4)
+      {
+        uint32_t baud = ((uint32_t) value[0] << 24) |
+          ((uint32_t) value[1] << 16) | ((uint16_t) value[2] << 8) | value[3];
+        if (baud != 0)
+          yport_set_baudrate(baud);
+      }
+      {
+        uint32_t baud = yport_get_baudrate();
+        uint8_t buf[4] = { baud >> 24, baud >> 16, baud >> 8, baud };
+        comport_reply(cmd, buf, 4);
+      }
+      return;
+
+    case COMPORT_SET_DATASIZE:
+      v = yport_set_datasize(v);
+      break;
+
+    case COMPORT_SET_PARITY:
+      v = yport_set_parity(v);
+      break;
+
+    case COMPORT_SET_STOPSIZE:
+      v = yport_set_stopsize(v);
+      break;
+
+    case COMPORT_SET_CONTROL:
+      /* No flow control and no modem lines, BREAK/DTR/RTS are echoed */
+      if (v <= 3)
+        v = 1;
+      else if (v >= 13 && v <= 19)
+        v = 14;
+      break;
+
+    case COMPORT_SET_LINESTATE_MASK:
+    case COMPORT_SET_MODEMSTATE_MASK:
+      break;
+
+    case COMPORT_PURGE_DATA:
+      if (v & 1)
+        yport_net_purge_rx();
+      if (v & 2)
+        yport_tx_purge();
+      break;
+
+    default:
+      return;
+  }
+  comport_reply(cmd, &v, 1);
+}
+
+void
+yport_rfc2217_input(const uint8_t *data, uint16_t len)
+{
+  uint16_t start = 0;
+
+  for (uint16_t i = 0; i < len; i++)
+  {
+    uint8_t c = data[i];
+
+    switch (state)
+    {
+      case RFC2217_DATA:
+        if (c == TELNET_IAC)
+        {
+          yport_tx_write(data + start, i - start);
+          state = RFC2217_IAC;
+        }
+        continue;
+
+      case RFC2217_IAC:
+        if (c == TELNET_IAC)
+          yport_tx_write(&c, 1);        /* escaped 0xff */
+        else if (c >= TELNET_WILL)
+        {
+          verb = c;
+          state = RFC2217_OPT;
+          continue;
+        }
+        else if (c == TELNET_SB)
+        {
+          sb_len = 0;
+          state = RFC2217_SB;
+          continue;
+        }
+        break;                  /* other commands are ignored */
+
+      case RFC2217_OPT:
+        yport_rfc2217_negotiate(verb, c);
+        break;
+
+      case RFC2217_SB:
+        if (c == TELNET_IAC)
+          state = RFC2217_SB_IAC;
+        else if (sb_len < YPORT_SB_LEN)
+          sb_buf[sb_len++] = c;
+        continue;
+
+      case RFC2217_SB_IAC:
+        if (c == TELNET_IAC)
+        {
+          if (sb_len < YPORT_SB_LEN)
+            sb_buf[sb_len++] = c;
+          state = RFC2217_SB;
+          continue;
+        }
+        if (c == TELNET_SE && sb_len >= 2 && sb_buf[0] == TELNET_OPT_COMPORT)
+          comport_command(sb_buf[1], sb_buf + 2, sb_len - 2);
+        break;
+    }
+    /* back to plain data after this byte */
+    state = RFC2217_DATA;
+    start = i + 1;
+  }
+
+  if (state == RFC2217_DATA)
+    yport_tx_write(data + start, len - start);
+}
+
+uint8_t
+yport_rfc2217_copy(uint8_t *dest, uint8_t rexmit)
+{
+  uint8_t n = rexmit ? ctl_inflight : ctl_len;
+  memcpy(dest, ctl_buf, n);
+  ctl_inflight = n;
+  return n;
+}
+
+void
+yport_rfc2217_acked(void)
+{
+  ctl_len -= ctl_inflight;
+  memmove(ctl_buf, ctl_buf + ctl_inflight, ctl_len);
+  ctl_inflight = 0;
+}
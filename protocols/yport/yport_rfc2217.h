@@ -0,0 +1,46 @@
+/*
+ *
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+
+#ifndef YPORT_RFC2217_H
+#define YPORT_RFC2217_H
+
+#include <stdint.h>
+
+#define TELNET_SE    240
+#define TELNET_SB    250
+#define TELNET_WILL  251
+#define TELNET_WONT  252
+#define TELNET_DO    253
+#define TELNET_DONT  254
+#define TELNET_IAC   255
+
+#define TELNET_OPT_BINARY   0
+#define TELNET_OPT_SGA      3
+#define TELNET_OPT_COMPORT  44
+
+void yport_rfc2217_init(void);
+void yport_rfc2217_input(const uint8_t *data, uint16_t len);
+uint8_t yport_rfc2217_copy(uint8_t *dest, uint8_t rexmit);
+void yport_rfc2217_acked(void);
+
+#endif /* YPORT_RFC2217_H */
@@ -26,6 +26,9 @@ define(`exit_divert',15)dnl
 define(`startup_divert',16)dnl
 define(`mainloop_divert',17)dnl
 define(`timer_divert',18)dnl after timer divert there musn't be any other divert level
+define(`profile_name_divert',7)dnl
+define(`profile_table_divert',8)dnl
+define(`profile_trailer_divert',9)dnl
 divert(0)dnl
 /* This file has been generated automatically.
    Please do not modify it, edit the m4 scripts instead. */
@@ -61,6 +64,22 @@ void dyndns_update(void);
 void periodic_process(void);
 volatile uint8_t newtick;
 
+divert(profile_name_divert)dnl
+#ifdef META_PROFILING_SUPPORT
+#include "core/profile.h"
+
+divert(profile_table_divert)dnl
+
+const char *const profile_names[] PROGMEM = {
+divert(profile_trailer_divert)dnl
+};
+
+const uint8_t profile_hook_count =
+  sizeof (profile_names) / sizeof (profile_names[0]);
+struct profile_hook_t profile_hooks[sizeof (profile_names) /
+                                    sizeof (profile_names[0])];
+#endif /* META_PROFILING_SUPPORT */
+
 divert(initearly_divert)dnl
 void
 ethersex_meta_init (void)
@@ -105,6 +124,9 @@ divert(mainloop_divert)dnl
 void
 ethersex_meta_mainloop (void)
 {
+#ifdef META_PROFILING_SUPPORT
+    profile_loop ();
+#endif
 
 divert(timer_divert)dnl
     periodic_process(); wdt_kick();
@@ -154,9 +176,24 @@ divert(-1)');
 define(`state_udp',`') dnl udp and tcp state is handled by meta_header_magic.m4
 define(`state_tcp', `')
 
+dnl
+dnl With META_PROFILING every mainloop and timer hook is wrapped with a
+dnl timer reading, its name goes to profile_names[] in the same order.
+dnl
+define(`_profile_id', 0)
+define(`_profile_hook', `dnl
+divert(profile_name_divert)static const char profile_name_$1[] PROGMEM = "$2";
+divert(profile_table_divert)  profile_name_$1,
+divert(-1)define(`_hook', `PROFILE_HOOK ($1, $3)')dnl
+define(`_profile_id', incr($1))')
+define(`profile_hook', `ifdef(`conf_META_PROFILING',
+  `_profile_hook(_profile_id, `$1', `$2')',
+  `define(`_hook', `$2')')')
+
 define(`mainloop',`dnl
 dnl divert(prototypes)void $1 (void);
-divert(mainloop_divert)    $1 (); wdt_kick ();
+divert(-1)profile_hook(`$1', `$1 ()')dnl
+divert(mainloop_divert)    _hook; wdt_kick ();
 divert(-1)');
 
 dnl 
@@ -177,8 +214,11 @@ if (counter % $1 == 0) {
 timer_divert_end($1, `}
 ')dnl
 ')')
-define(`timer', `pushdivert()_divert_used($1)timer_divert_start($1, `$2;
+define(`_timer', `pushdivert()_divert_used($1)timer_divert_start($1, `$2;
 ')popdivert()')
+dnl The profile name is the call without blanks, parentheses and commas,
+dnl a comma left in the unquoted name would split the arguments.
+define(`timer', `pushdivert()divert(-1)profile_hook(patsubst(`$2', `[ (),]')`/$1', `$2')popdivert()_timer(`$1', defn(`_hook'))')
 divert(timer_divert_base)
 void periodic_process(void)
 {
@@ -260,4 +300,4 @@ divert(eval(timer_divert_base`+'timer_divert_last` * 2 + 2'))
   }
 }
 divert(-1)
-timer(timer_divert_last, `counter = 0')
+_timer(timer_divert_last, `counter = 0')
@@ -25,6 +25,7 @@
 
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
+#include <util/atomic.h>
 
 #include "config.h"
 #ifdef I2C_DS13X7_SUPPORT
@@ -39,6 +40,9 @@
 #ifdef NTP_SUPPORT
 #include "services/ntp/ntp.h"
 #endif
+#ifdef CLOCK_NTP_ADJUST_SUPPORT
+#include "core/eeprom.h"
+#endif
 #include "core/debug.h"
 #include "core/periodic.h"
 #include "clock.h"
@@ -61,6 +65,63 @@ static uint16_t ntp_timer = 1;
 timestamp_t uptime_timestamp;
 #endif
 
+#ifdef CLOCK_CPU_SUPPORT
+/* timer value the current second started at */
+static uint16_t second_start = 65536 - CLOCK_SECONDS;
+#elif !defined(CLOCK_CRYSTAL_SUPPORT)
+/* length of the current second in ticks */
+static uint8_t second_ticks = HZ;
+#endif
+
+#ifdef CLOCK_NTP_ADJUST_SUPPORT
+/* The clock is disciplined by shortening or stretching single seconds.
+ * All corrections are kept in 2^-24 s, one step is a 20ms tick or one
+ * timer count of the CPU clock. */
+#ifdef CLOCK_CPU_SUPPORT
+#define CLOCK_ADJ_QUANTUM   ((int32_t) ((1UL << 24) / CLOCK_SECONDS))
+#define CLOCK_ADJ_LIMIT     ((int16_t) (CLOCK_TICKS / 2))
+#else
+#define CLOCK_ADJ_QUANTUM   ((int32_t) ((1UL << 24) / HZ))
+#define CLOCK_ADJ_LIMIT     1
+#endif
+/* slew at most 500 ppm, like ntpd */
+#define CLOCK_SLEW_MAX      8389
+/* frequency corrections beyond 0.5 % are bogus */
+#define CLOCK_FREQ_MAX      83886L
+/* write the frequency back to EEPROM when it moved by 2 ppm */
+#define CLOCK_FREQ_SAVE     34
+
+static int32_t clock_freq;      /* frequency correction per second */
+static int32_t clock_freq_saved;
+static int32_t clock_slew;      /* offset still to be slewed */
+static int32_t clock_phase;     /* correction not yet applied */
+
+/* Called at the start of each second, returns the number of steps the
+ * second has to be shortened by (negative: stretched). */
+static int16_t
+clock_adjust_second(void)
+{
+  int32_t step = clock_slew;
+  if (step > CLOCK_SLEW_MAX)
+    step = CLOCK_SLEW_MAX;
+  else if (step < -CLOCK_SLEW_MAX)
+    step = -CLOCK_SLEW_MAX;
+  clock_slew -= step;
+
+  clock_phase += clock_freq + step;
+  int16_t n = clock_phase / CLOCK_ADJ_QUANTUM;
+  if (n > CLOCK_ADJ_LIMIT)
+    n = CLOCK_ADJ_LIMIT;
+  else if (n < -CLOCK_ADJ_LIMIT)
+    n = -CLOCK_ADJ_LIMIT;
+  clock_phase -= n * CLOCK_ADJ_QUANTUM;
+
+  return n;
+}
+#else
+#define clock_adjust_second()  0
+#endif
+
 
 void
 clock_init(void)
@@ -81,6 +142,13 @@ clock_init(void)
 
   /* reset dcf_count */
   dcf_count = 0;
+
+#ifdef CLOCK_NTP_ADJUST_SUPPORT
+  eeprom_restore(clock_freq, &clock_freq_saved, sizeof(int32_t));
+  if (clock_freq_saved > CLOCK_FREQ_MAX || clock_freq_saved < -CLOCK_FREQ_MAX)
+    clock_freq_saved = 0;
+  clock_freq = clock_freq_saved;
+#endif
 }
 
 #if defined(CLOCK_CRYSTAL_SUPPORT) || defined(CLOCK_CPU_SUPPORT)
@@ -97,8 +165,9 @@ ISR(TIMER_8_AS_1_VECTOR_OVERFLOW)
 #ifdef CLOCK_CPU_SUPPORT
   milliticks = 0;
 
-  TC1_COUNTER_CURRENT = 65536 - CLOCK_SECONDS;
-  TC1_COUNTER_COMPARE = 65536 - CLOCK_SECONDS + CLOCK_TICKS;
+  second_start = 65536 - CLOCK_SECONDS + clock_adjust_second();
+  TC1_COUNTER_CURRENT = second_start;
+  TC1_COUNTER_COMPARE = second_start + CLOCK_TICKS;
 #endif
 
 #if defined(NTP_SUPPORT) || defined(DCF77_SUPPORT)
@@ -134,7 +203,11 @@ clock_periodic(void)
 void
 clock_tick(void)
 {
-  if (++ticks >= 50)
+#if !defined(CLOCK_CRYSTAL_SUPPORT) && !defined(CLOCK_CPU_SUPPORT)
+  if (++ticks >= second_ticks)
+#else
+  if (++ticks >= HZ)
+#endif
   {
     /* Only clock here, when no crystal is connected */
 #if !defined(CLOCK_CRYSTAL_SUPPORT) && !defined(CLOCK_CPU_SUPPORT)
@@ -151,8 +224,14 @@ clock_tick(void)
 
     if (sync_timestamp)
       sync_timestamp++;
+
+    second_ticks = HZ - clock_adjust_second();
 #endif /* CLOCK_CRYSTAL_SUPPORT */
 
+#if defined(CLOCK_DATETIME_SUPPORT) || defined(DCF77_SUPPORT) || defined(CLOCK_DATE_SUPPORT) || defined(CLOCK_TIME_SUPPORT)
+    clock_datetime_tick(clock_timestamp);
+#endif
+
     ticks = 0;
   }
 }
@@ -183,27 +262,6 @@ clock_set_time(timestamp_t new_sync_timestamp)
   if (sync_timestamp)
   {
     delta = new_sync_timestamp - sync_timestamp;
-#if defined(CLOCK_NTP_ADJUST_SUPPORT) && !defined(CLOCK_CPU_SUPPORT)
-    NTPADJDEBUG("sync timestamp delta is %d\n", delta);
-    if (delta < -300 || delta > 300)
-      NTPADJDEBUG("eeek, delta too large. " "not adjusting.\n");
-
-    else if (sync_timestamp != clock_timestamp)
-      NTPADJDEBUG("our clock is not up with ntp clock.\n");
-
-    else if (NTP_RESYNC_PERIOD == -delta)
-      NTPADJDEBUG("-delta equals resync period, eeek!? "
-                  "clock isn't running at all.\n");
-    else
-    {
-      uint32_t new_value = TC1_COUNTER_COMPARE;
-      new_value *= NTP_RESYNC_PERIOD;
-      new_value /= NTP_RESYNC_PERIOD + delta;
-
-      NTPADJDEBUG("new OCR1A value %d\n", new_value);
-      TC1_COUNTER_COMPARE = new_value;
-    }
-#endif /* CLOCK_NTP_ADJUST_SUPPORT */
   }
 
   sync_timestamp = new_sync_timestamp;
@@ -232,12 +290,141 @@ clock_set_time(timestamp_t new_sync_timestamp)
 #endif
 }
 
+/* Set the clock including the phase within the second (1/65536 s). */
+void
+clock_set_time_frac(timestamp_t new_sync_timestamp, uint16_t frac)
+{
+  clock_set_time(new_sync_timestamp);
+
+#ifdef CLOCK_NTP_ADJUST_SUPPORT
+  clock_slew = 0;
+  clock_phase = 0;
+#endif
+
+#if defined(CLOCK_CPU_SUPPORT)
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    uint16_t offset = ((uint32_t) frac * CLOCK_SECONDS) >> 16;
+    second_start = 65536 - CLOCK_SECONDS;
+    TC1_COUNTER_CURRENT = second_start + offset;
+    TC1_COUNTER_COMPARE =
+      second_start + offset + CLOCK_TICKS - (offset % CLOCK_TICKS);
+  }
+#elif defined(CLOCK_CRYSTAL_SUPPORT)
+  while (TIMER_8_AS_1_COUNTER_BUSY_TST);
+  TIMER_8_AS_1_COUNTER_CURRENT = frac >> 8;
+#else
+  ticks = ((uint32_t) frac * HZ) >> 16;
+#endif
+}
+
 timestamp_t
 clock_get_time(void)
 {
   return clock_timestamp;
 }
 
+/* the actual time plus the fraction of the current second */
+timestamp_t
+clock_get_time_frac(uint16_t * frac)
+{
+  timestamp_t t;
+#if defined(CLOCK_CPU_SUPPORT)
+  uint16_t start, current;
+  ATOMIC_BLOCK(ATOMIC_FORCEON)
+  {
+    t = clock_timestamp;
+    start = second_start;
+    current = TC1_COUNTER_CURRENT;
+    /* overflow pending, the second is already over */
+    if (TC1_INT_OVERFLOW_TST && current < start)
+      current = 65535;
+  }
+  *frac = ((uint32_t) (current - start) << 16) / (uint16_t) (-start);
+#elif defined(CLOCK_CRYSTAL_SUPPORT)
+  uint8_t current;
+  ATOMIC_BLOCK(ATOMIC_FORCEON)
+  {
+    t = clock_timestamp;
+    current = TIMER_8_AS_1_COUNTER_CURRENT;
+    if (TIMER_8_AS_1_INT_OVERFLOW_TST)
+      current = 255;
+  }
+  *frac = current << 8;
+#else
+  t = clock_timestamp;
+  *frac = ((uint32_t) ticks << 16) / second_ticks;
+#endif
+  return t;
+}
+
+#ifdef CLOCK_CPU_SUPPORT
+/* timer1 wraps from 0xFFFF to the count the current second started at */
+uint16_t
+clock_second_start(void)
+{
+  uint16_t start;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    start = second_start;
+  }
+  return start;
+}
+#endif
+
+#ifdef CLOCK_NTP_ADJUST_SUPPORT
+/* Slew the clock by offset (1/65536 s) instead of stepping it. Replaces
+ * any slew still in progress, which is returned. */
+int32_t
+clock_adjtime(int32_t offset)
+{
+  int32_t left;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    left = clock_slew;
+    clock_slew = offset * 256;
+  }
+
+  n_sync_timestamp = clock_timestamp;
+  n_sync_tick = TIMER_8_AS_1_COUNTER_CURRENT;
+  delta = offset / 65536;
+
+  NTPADJDEBUG("slew %ld, %ld left over\n", offset, left / 256);
+  return left / 256;
+}
+
+int32_t
+clock_get_freq(void)
+{
+  return clock_freq;
+}
+
+/* Frequency correction in 2^-24 s per second, saved to EEPROM once it
+ * drifted away from the stored value. */
+void
+clock_set_freq(int32_t freq)
+{
+  if (freq > CLOCK_FREQ_MAX)
+    freq = CLOCK_FREQ_MAX;
+  else if (freq < -CLOCK_FREQ_MAX)
+    freq = -CLOCK_FREQ_MAX;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    clock_freq = freq;
+  }
+
+  NTPADJDEBUG("frequency %ld\n", freq);
+  if (freq - clock_freq_saved > CLOCK_FREQ_SAVE ||
+      clock_freq_saved - freq > CLOCK_FREQ_SAVE)
+  {
+    eeprom_save(clock_freq, &freq, sizeof(int32_t));
+    eeprom_update_chksum();
+    clock_freq_saved = freq;
+  }
+}
+#endif /* CLOCK_NTP_ADJUST_SUPPORT */
+
 timestamp_t
 clock_last_sync(void)
 {
@@ -286,6 +473,12 @@ clock_last_ntp(void)
 {
   return ntp_timer;
 }
+
+void
+set_ntp_timer(const uint16_t new_ntp_timer)
+{
+  ntp_timer = new_ntp_timer;
+}
 #endif
 
 #if defined(WHM_SUPPORT) || defined(UPTIME_SUPPORT) || defined(CONTROL6_SUPPORT)
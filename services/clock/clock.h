@@ -55,6 +55,7 @@ void set_ntp_count(const uint16_t new_ntp_count);
 
 /* the actual ntp_timer */
 uint16_t clock_last_ntp(void);
+void set_ntp_timer(const uint16_t new_ntp_timer);
 
 /* how long is the system up (seconds) */
 timestamp_t clock_get_uptime(void);
@@ -63,6 +64,24 @@ timestamp_t clock_get_uptime(void);
 void clock_set_time_raw(timestamp_t new_sync_timestamp);
 void clock_set_time_raw_hr(timestamp_t new_sync_timestamp, uint8_t new_ticks);
 void clock_set_time(timestamp_t new_sync_timestamp);
+void clock_set_time_frac(timestamp_t new_sync_timestamp, uint16_t frac);
+
+/* the actual time, frac receives the fraction of the second (1/65536 s) */
+timestamp_t clock_get_time_frac(uint16_t *frac);
+
+#ifdef CLOCK_CPU_SUPPORT
+/* the timer1 count the current second started at, see clock_get_time_frac */
+uint16_t clock_second_start(void);
+#endif
+
+#ifdef CLOCK_NTP_ADJUST_SUPPORT
+/* slew by offset (1/65536 s), returns the part of the last slew not done */
+int32_t clock_adjtime(int32_t offset);
+
+/* frequency correction (2^-24 s per second) */
+int32_t clock_get_freq(void);
+void clock_set_freq(int32_t freq);
+#endif
 
 /* get tick counter */
 uint8_t clock_get_ticks(void);
@@ -92,17 +92,47 @@ static const clock_timezone_t PROGMEM clock_tz = {
 };
 
 
+static timestamp_t dst_change[2];
+
+/* Year the DST transitions above belong to, and its bounds in local
+ * standard time, so clock_localtime only recomputes them once a year. */
+static uint8_t tz_year = 0xFF;
+static timestamp_t tz_year_begin;
+static timestamp_t tz_year_end;
+
+
 typedef struct
 {
-  timestamp_t when;
-  int8_t year;
-} dst_change_t;
+  timestamp_t t;
+  clock_datetime_t d;
+} clock_cache_t;
+
+/* Broken-down time of the last converted second, separately for UTC and
+ * local time.  Callers mostly ask for the current second (or the next),
+ * which is then a copy or an incremental step instead of a conversion. */
+static clock_cache_t clock_cache_utc = {
+  .t = 0,
+  .d = {.day = 1,.month = 1,.dow = EPOCH_DOW,.year = EPOCH_YEAR - 1900},
+};
+static clock_cache_t clock_cache_local = {
+  .t = 0,
+  .d = {.day = 1,.month = 1,.dow = EPOCH_DOW,.year = EPOCH_YEAR - 1900},
+};
 
-static dst_change_t dst_change[2] = { {0, -1}, {0, -1} };
 
+/* Days from 1.3.1968 to 1.1.1970.  Counting from the March following a
+ * leap day puts Feb 29th at the end of every four year cycle. */
+#define CLOCK_MARCH_EPOCH   671
+/* 1.3.2100 relative to 1.3.1968, 2100 is the only year within the range
+ * of timestamp_t breaking the four year rule. */
+#define CLOCK_MARCH_2100    48212
+#define CLOCK_MARCH_YEAR    1968
 
-void
-clock_datetime(clock_datetime_t * d, timestamp_t t)
+/* leap days from year 1 up to and including year y */
+#define CLOCK_LEAP_DAYS(y)  ((y) / 4 - (y) / 100 + (y) / 400)
+
+static void
+clock_datetime_compute(clock_datetime_t * d, timestamp_t t)
 {
   /* seconds */
   d->sec = t % 60;
@@ -116,61 +146,103 @@ clock_datetime(clock_datetime_t * d, timestamp_t t)
   d->hour = t % 24;
   t /= 24;
 
-  /* t/84600 is always <= 51000, so we can crop this to an uint16_t */
+  /* t/84600 is always <= 49710, so we can crop this to an uint16_t */
   uint16_t days = (uint16_t) t;
 
   /* day of week */
   d->dow = (days + EPOCH_DOW) % 7;
 
-  /* year: For every year from EPOCH_YEAR upto now, check for a leap year
-   * (for details on leap years see http://en.wikipedia.org/wiki/Leap_year) */
-  uint16_t year = EPOCH_YEAR;
-
-  /* year, check if we have enough days left to fill a year */
-  while (days >= 365)
+  /* days since 1.3.1968, with a phantom Feb 29th inserted for 2100 */
+  days += CLOCK_MARCH_EPOCH;
+  if (days >= CLOCK_MARCH_2100)
+    days++;
+
+  /* year within the four year cycle, the last day of the cycle is the
+   * leap day and still belongs to the fourth year */
+  uint16_t rem = days % 1461;
+  uint8_t yoc = rem / 365;
+  if (yoc == 4)
+    yoc = 3;
+  uint16_t year = CLOCK_MARCH_YEAR + (days / 1461) * 4 + yoc;
+
+  /* day and month of a year starting in March, months are 153 days per
+   * five months */
+  uint16_t doy = rem - yoc * 365;
+  uint8_t mp = (5 * doy + 2) / 153;
+  d->day = doy - (153 * mp + 2) / 5 + 1;
+
+  if (mp < 10)
   {
-    if (IS_LEAP_YEAR(year))
-    {
-      /* special case: leap year is not over after 365 days... */
-      if (days == 365)
-        break;
-
-      /* default case: leap years have one more day */
-      days -= 1;
-    }
-
-    /* normal years have 365 days */
-    days -= 365;
+    d->month = mp + 3;
+    d->yday = doy + 59 + IS_LEAP_YEAR(year);
+  }
+  else
+  {
+    /* January and February belong to the next year */
+    d->month = mp - 9;
+    d->yday = doy - 306;
     year++;
   }
 
   d->year = year - 1900;
 
-  /* day of year */
-  d->yday = days;
+  /* no daylight saving in utc */
+  d->isdst = 0;
+}
 
-  /* month */
-  d->month = 0;
-  for (;;)
-  {
-    uint8_t monthdays = clock_month_days(d->month + 1);
 
-    /* feb has one more day in a leap year */
-    if (d->month == 1 && IS_LEAP_YEAR(year))
-      monthdays++;
+static void
+clock_datetime_step(clock_datetime_t * d)
+{
+  if (++d->sec < 60)
+    return;
+  d->sec = 0;
+  if (++d->min < 60)
+    return;
+  d->min = 0;
+  if (++d->hour < 24)
+    return;
+  d->hour = 0;
+
+  if (++d->dow >= 7)
+    d->dow = 0;
+  d->yday++;
+
+  uint8_t monthdays = clock_month_days(d->month);
+  /* feb has one more day in a leap year */
+  if (d->month == 2 && IS_LEAP_YEAR(d->year + 1900))
+    monthdays++;
+  if (++d->day <= monthdays)
+    return;
+  d->day = 1;
+
+  if (++d->month <= 12)
+    return;
+  d->month = 1;
+  d->yday = 0;
+  d->year++;
+}
 
-    /* if we have not enough days left to fill this month, we are done */
-    if (days < monthdays)
-      break;
 
-    days -= monthdays;
-    d->month++;
+static clock_datetime_t *
+clock_datetime_cached(clock_cache_t * c, const timestamp_t t)
+{
+  if (t != c->t)
+  {
+    if (t == c->t + 1)
+      clock_datetime_step(&c->d);
+    else
+      clock_datetime_compute(&c->d, t);
+    c->t = t;
   }
+  return &c->d;
+}
 
-  d->month++;
-  d->day = (uint8_t) days + 1;
 
-  /* no daylight saving in utc */
+void
+clock_datetime(clock_datetime_t * d, timestamp_t t)
+{
+  *d = *clock_datetime_cached(&clock_cache_utc, t);
   d->isdst = 0;
 }
 
@@ -196,7 +268,7 @@ uint16_t
 clock_yday(const uint8_t day, const uint8_t month, const uint8_t year)
 {
   uint16_t yday =
-    pgm_read_word(&clock_monthydays[IS_LEAP_YEAR(year)][month - 1]);
+    pgm_read_word(&clock_monthydays[IS_LEAP_YEAR(year + EPOCH_CENTURY)][month - 1]);
   return yday + day - 1;
 }
 
@@ -231,7 +303,7 @@ clock_woy(const uint8_t day, const uint8_t month, const uint8_t year)
    * Folgejahres. */
   if (week == 53)
   {
-    if ((yday_1jan == 3) || ((yday_1jan == 2) && IS_LEAP_YEAR(year)))
+    if ((yday_1jan == 3) || ((yday_1jan == 2) && IS_LEAP_YEAR(year + EPOCH_CENTURY)))
       ;                         /* Das ist korrekt und erlaubt */
     else
       week = 1;                 /* Korrektur des Wertes */
@@ -245,7 +317,7 @@ void
 clock_yday2date(const uint16_t yday, const uint8_t year, uint8_t * day,
                 uint8_t * month)
 {
-  const uint16_t *p = clock_monthydays[IS_LEAP_YEAR(year)];
+  const uint16_t *p = clock_monthydays[IS_LEAP_YEAR(year + EPOCH_CENTURY)];
   for (int8_t m = 12; m >= 0; m--)
   {
     uint16_t d = pgm_read_word(p + m);
@@ -264,7 +336,8 @@ clock_date_to_timestamp(const uint8_t day, uint8_t month, const uint8_t year)
 {
   /* year */
   uint16_t y = year + EPOCH_CENTURY;
-  uint16_t days = (y - EPOCH_YEAR) * 365U + ((y - 1) / 4 - EPOCH_YEAR / 4);
+  uint16_t days = (y - EPOCH_YEAR) * 365U + CLOCK_LEAP_DAYS(y - 1)
+    - CLOCK_LEAP_DAYS(EPOCH_YEAR - 1);
 
   /* day + month */
   days += clock_yday(day, month, year);
@@ -272,17 +345,13 @@ clock_date_to_timestamp(const uint8_t day, uint8_t month, const uint8_t year)
 }
 
 
-static uint8_t
-clock_compute_change(dst_change_t * change, const clock_dst_t * dst_flash,
-                     const uint8_t year)
+static timestamp_t
+clock_compute_change(const clock_dst_t * dst_flash, const uint8_t year)
 {
   // copy block from flash to stack for faster access
   clock_dst_t dst;
   memcpy_P(&dst, dst_flash, sizeof(clock_dst_t));
 
-  if (change->year == year)
-    return 0;
-
   int8_t day = dst.dow - clock_dow(1, dst.month, year);
   if (day < 0)
     day += 7;
@@ -299,18 +368,23 @@ clock_compute_change(dst_change_t * change, const clock_dst_t * dst_flash,
   timestamp_t t = clock_date_to_timestamp(day, dst.month, year);
   t -= UTCTIME;
   t += dst.hour * 3600UL;
-  change->when = t;             // - UTCTIME + dst->hour * 3600UL;
-  change->year = year;
-  return 1;
+  return t;
 }
 
 
 static void
 clock_tz_compute(const uint8_t year)
 {
-  clock_compute_change(&dst_change[0], DSTBEGIN, year);
-  if (clock_compute_change(&dst_change[1], DSTEND, year))
-    dst_change[1].when -= DSTTIME;      /* tz.dstend.hour stores DST time */
+  if (tz_year == year)
+    return;
+
+  dst_change[0] = clock_compute_change(DSTBEGIN, year);
+  dst_change[1] = clock_compute_change(DSTEND, year);
+  dst_change[1] -= DSTTIME;     /* tz.dstend.hour stores DST time */
+
+  tz_year = year;
+  tz_year_begin = clock_date_to_timestamp(1, 1, year);
+  tz_year_end = clock_date_to_timestamp(1, 1, year + 1);
 }
 
 
@@ -323,10 +397,10 @@ clock_is_dst(const timestamp_t t)
   uint8_t isdst;
   /* We have to distinguish between northern and southern hemisphere. For
    * the latter the daylight saving time ends in the next year. */
-  if (dst_change[0].when > dst_change[1].when)
-    isdst = (t < dst_change[1].when || t >= dst_change[0].when);
+  if (dst_change[0] > dst_change[1])
+    isdst = (t < dst_change[1] || t >= dst_change[0]);
   else
-    isdst = (t >= dst_change[0].when && t < dst_change[1].when);
+    isdst = (t >= dst_change[0] && t < dst_change[1]);
 
   return isdst;
 }
@@ -335,8 +409,9 @@ clock_is_dst(const timestamp_t t)
 void
 clock_reset_dst_change(void)
 {
-  dst_change[0].year = -1;
-  dst_change[1].year = -1;
+  tz_year = 0xFF;
+  tz_year_begin = 0;
+  tz_year_end = 0;
 }
 
 
@@ -344,15 +419,30 @@ void
 clock_localtime(clock_datetime_t * d, const timestamp_t t)
 {
   timestamp_t localtime = t + UTCTIME;
-  clock_datetime(d, localtime);
-  clock_tz_compute(d->year);
-  uint8_t isdst = clock_is_dst(t);
-  if (isdst)
+  uint8_t isdst = 0;
+  if (DSTTIME)
   {
-    localtime += DSTTIME;
-    clock_datetime(d, localtime);
-    d->isdst = isdst;
+    /* the year is taken from local standard time */
+    if (localtime < tz_year_begin || localtime >= tz_year_end)
+      clock_tz_compute(clock_datetime_cached(&clock_cache_local,
+                                             localtime)->year);
+    isdst = clock_is_dst(t);
+    if (isdst)
+      localtime += DSTTIME;
   }
+  *d = *clock_datetime_cached(&clock_cache_local, localtime);
+  d->isdst = isdst;
+}
+
+
+/* Called once a second with the current time, keeps both caches one step
+ * behind at most. */
+void
+clock_datetime_tick(const timestamp_t t)
+{
+  clock_datetime_t d;
+  clock_datetime_cached(&clock_cache_utc, t);
+  clock_localtime(&d, t);
 }
 
 
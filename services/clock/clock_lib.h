@@ -55,7 +55,7 @@ typedef struct
 } clock_datetime_t;
 
 /* test if given year is a leap year */
-#define IS_LEAP_YEAR(y)  (((y % 4) == 0) && ( (y % 100 != 0) || (y % 400 == 0) ))
+#define IS_LEAP_YEAR(y)  ((((y) % 4) == 0) && (((y) % 100 != 0) || ((y) % 400 == 0)))
 /* current_time is the amount of seconds since 1.1.1900, 00:00:00 UTC */
 #define EPOCH_YEAR       1970
 #define EPOCH_CENTURY    (EPOCH_YEAR-(EPOCH_YEAR%100))
@@ -75,5 +75,6 @@ uint16_t clock_yday(const uint8_t, const uint8_t, const uint8_t);
 uint8_t clock_woy(const uint8_t, const uint8_t, const uint8_t);
 void clock_yday2date(const uint16_t, const uint8_t, uint8_t *, uint8_t *);
 void clock_reset_dst_change(void);
+void clock_datetime_tick(const timestamp_t);
 
 #endif /* __CLOCK_LIB_H */
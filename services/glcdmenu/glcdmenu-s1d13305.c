@@ -41,13 +41,62 @@ uint8_t currDrawByte_ui8 = 0;
 uint16_t currDrawX_ui16 = UINT16_MAX;
 uint16_t currDrawY_ui16 = UINT16_MAX;
 
+/**
+ * @brief Writes the buffered display byte back to the video RAM.
+ */
+static void glcdmenuWriteBackS1D13305(void)
+{
+	if (UINT16_MAX != currDrawX_ui16)
+	{
+		lcd_setCursorPos(drawLayer_ui8, currDrawX_ui16, currDrawY_ui16);
+		lcd_writeCmdByte(CMD_MWRITE);
+		lcd_waitForCntrlrReady();
+		lcd_writeData(currDrawByte_ui8);
+	}
+
+	currDrawByte_ui8 = 0;
+	currDrawX_ui16 = UINT16_MAX;
+	currDrawY_ui16 = UINT16_MAX;
+}
+
+/**
+ * @brief Changes some pixels of a display byte.
+ *
+ * Since the display memory is organized in bytes, we try to
+ * reduce write cycles by buffering writes to the same RAM
+ * address until a different address is written.
+ *
+ * @param xPos_ui16 X position of any pixel in the byte
+ * @param yPos_ui16 Y position on the screen
+ * @param mask_ui8 pixels to change
+ * @param bits_ui8 new pixel values
+ */
+static void glcdmenuMergeS1D13305(uint16_t xPos_ui16, uint16_t yPos_ui16,
+		uint8_t mask_ui8, uint8_t bits_ui8)
+{
+	/* Since we are drawing into a different byte now, send the current byte
+	 * to the controller first */
+	if ((xPos_ui16 / 8 != currDrawX_ui16 / 8) || (currDrawY_ui16
+			!= yPos_ui16))
+	{
+		glcdmenuWriteBackS1D13305();
+
+		/* Read the initial contents of the new byte */
+		lcd_setCursorPos(drawLayer_ui8, xPos_ui16, yPos_ui16);
+		lcd_writeCmdByte(CMD_MREAD);
+		currDrawByte_ui8 = lcd_readData();
+
+		currDrawX_ui16 = xPos_ui16;
+		currDrawY_ui16 = yPos_ui16;
+	}
+
+	currDrawByte_ui8 = (currDrawByte_ui8 & ~mask_ui8) | (bits_ui8 & mask_ui8);
+}
+
 /**
  * @brief Draws a pixel of the menu.
  *
- * Drawing is done directly into the video RAM. Since the
- * display memory is organized in bytes, we try to reduce
- * write cycles by buffering writes to the same RAM address
- * until a different address is written.
+ * Drawing is done directly into the video RAM.
  *
  * @param xPos_ui16 X position on the screen
  * @param yPos_ui16 Y position on the screen
@@ -58,38 +107,111 @@ void glcdmenuDrawS1D13305(uint16_t xPos_ui16, uint16_t yPos_ui16,
 {
 	if ((xPos_ui16 < CONF_S1D13305_RESX) && (yPos_ui16 < CONF_S1D13305_RESY))
 	{
-		/* Since we are drawing into a different byte now, send the current byte
-		 * to the controller first */
-		if ((xPos_ui16 / 8 != currDrawX_ui16 / 8) || (currDrawY_ui16
-				!= yPos_ui16))
-		{
-			/* Write... */
-			lcd_setCursorPos(drawLayer_ui8, currDrawX_ui16, currDrawY_ui16);
-			lcd_writeCmdByte(CMD_MWRITE);
-			lcd_writeData(currDrawByte_ui8);
+		glcdmenuMergeS1D13305(xPos_ui16, yPos_ui16, 0x80 >> (xPos_ui16 % 8),
+				(color_ui8 & 1) ? 0xFF : 0);
+	}
+	else
+	{
+		GLCDMENUDEBUG("Warning: Drawing %i, %i is out of bounds\n", xPos_ui16, yPos_ui16);
+	}
+}
+
+/**
+ * @brief Draws up to eight pixels of a line.
+ *
+ * @param xPos_ui16 X position of the first pixel
+ * @param yPos_ui16 Y position on the screen
+ * @param bits_ui8 pixels, the first one in the MSB
+ * @param count_ui8 number of pixels (1..8)
+ */
+void glcdmenuBitsS1D13305(uint16_t xPos_ui16, uint16_t yPos_ui16,
+		uint8_t bits_ui8, uint8_t count_ui8)
+{
+	uint8_t mask_ui8 = 0xFF << (8 - count_ui8);
+	uint8_t shift_ui8 = xPos_ui16 % 8;
+
+	if ((xPos_ui16 >= CONF_S1D13305_RESX) || (yPos_ui16 >= CONF_S1D13305_RESY))
+	{
+		GLCDMENUDEBUG("Warning: Drawing %i, %i is out of bounds\n", xPos_ui16, yPos_ui16);
+		return;
+	}
+
+	glcdmenuMergeS1D13305(xPos_ui16, yPos_ui16, mask_ui8 >> shift_ui8,
+			bits_ui8 >> shift_ui8);
 
-			/* Read the initial contents of the new byte */
-			lcd_setCursorPos(drawLayer_ui8, xPos_ui16, yPos_ui16);
-			lcd_writeCmdByte(CMD_MREAD);
-			currDrawByte_ui8 = lcd_readData();
+	/* Rest of the pixels in the next byte */
+	if ((shift_ui8 + count_ui8 > 8) && (xPos_ui16 + 8 < CONF_S1D13305_RESX))
+	{
+		glcdmenuMergeS1D13305(xPos_ui16 + 8, yPos_ui16,
+				mask_ui8 << (8 - shift_ui8), bits_ui8 << (8 - shift_ui8));
+	}
+}
 
-			currDrawX_ui16 = xPos_ui16;
-			currDrawY_ui16 = yPos_ui16;
+/**
+ * @brief Fills a rectangle.
+ *
+ * Bytes completely within the rectangle are streamed to the
+ * video RAM without reading them first.
+ *
+ * @param xPos_ui16 X position on the screen
+ * @param yPos_ui16 Y position on the screen
+ * @param width_ui16 width of the rectangle
+ * @param height_ui16 height of the rectangle
+ * @param color_ui8 color of the rectangle
+ */
+void glcdmenuFillS1D13305(uint16_t xPos_ui16, uint16_t yPos_ui16,
+		uint16_t width_ui16, uint16_t height_ui16, uint8_t color_ui8)
+{
+	uint8_t fill_ui8 = (color_ui8 & 1) ? 0xFF : 0;
+	uint16_t endX_ui16 = xPos_ui16 + width_ui16;
+	uint16_t endY_ui16 = yPos_ui16 + height_ui16;
+	uint16_t firstByte_ui16, lastByte_ui16, i;
+
+	if (endX_ui16 > CONF_S1D13305_RESX)
+		endX_ui16 = CONF_S1D13305_RESX;
+	if (endY_ui16 > CONF_S1D13305_RESY)
+		endY_ui16 = CONF_S1D13305_RESY;
+	if ((xPos_ui16 >= endX_ui16) || (yPos_ui16 >= endY_ui16))
+		return;
+
+	/* Whole bytes from firstByte to lastByte (exclusive) */
+	firstByte_ui16 = (xPos_ui16 + 7) / 8;
+	lastByte_ui16 = endX_ui16 / 8;
+
+	for (; yPos_ui16 < endY_ui16; yPos_ui16++)
+	{
+		if (firstByte_ui16 > lastByte_ui16)
+		{
+			/* Within a single byte */
+			glcdmenuMergeS1D13305(xPos_ui16, yPos_ui16,
+					(0xFF >> (xPos_ui16 % 8)) & (0xFF << (8 - endX_ui16 % 8)),
+					fill_ui8);
+			continue;
 		}
 
-		/*  Draw */
-		if (color_ui8 & 1)
+		if (xPos_ui16 % 8)
 		{
-			currDrawByte_ui8 |= (0x80 >> (xPos_ui16 % 8));
+			glcdmenuMergeS1D13305(xPos_ui16, yPos_ui16,
+					0xFF >> (xPos_ui16 % 8), fill_ui8);
 		}
-		else
+
+		if (firstByte_ui16 < lastByte_ui16)
 		{
-			currDrawByte_ui8 &= ~(0x80 >> (xPos_ui16 % 8));
+			glcdmenuWriteBackS1D13305();
+			lcd_setCursorPos(drawLayer_ui8, firstByte_ui16 * 8, yPos_ui16);
+			lcd_writeCmdByte(CMD_MWRITE);
+			for (i = firstByte_ui16; i < lastByte_ui16; i++)
+			{
+				lcd_waitForCntrlrReady();
+				lcd_writeData(fill_ui8);
+			}
+		}
+
+		if (endX_ui16 % 8)
+		{
+			glcdmenuMergeS1D13305(endX_ui16, yPos_ui16,
+					0xFF << (8 - endX_ui16 % 8), fill_ui8);
 		}
-	}
-	else
-	{
-		GLCDMENUDEBUG("Warning: Drawing %i, %i is out of bounds\n", xPos_ui16, yPos_ui16);
 	}
 }
 
@@ -102,14 +224,7 @@ void glcdmenuDrawS1D13305(uint16_t xPos_ui16, uint16_t yPos_ui16,
 void glcdmenuFlushS1D13305(void)
 {
 	/* First write the current draw byte to the display */
-	lcd_setCursorPos(drawLayer_ui8, currDrawX_ui16, currDrawY_ui16);
-	lcd_writeCmdByte(CMD_MWRITE);
-	lcd_waitForCntrlrReady();
-	lcd_writeData(currDrawByte_ui8);
-
-	currDrawByte_ui8 = 0;
-	currDrawX_ui16 = UINT16_MAX;
-	currDrawY_ui16 = UINT16_MAX;
+	glcdmenuWriteBackS1D13305();
 
 	/* Switch layers */
 	if (LCD_LAYER2 == drawLayer_ui8)
@@ -130,6 +245,27 @@ void glcdmenuFlushS1D13305(void)
 	}
 }
 
+/**
+ * @brief Starts a partial redraw
+ *
+ * Partial redraws go to the shown layer, the hidden one
+ * does not contain the current menu.
+ */
+void glcdmenuUpdateBeginS1D13305(void)
+{
+	glcdmenuWriteBackS1D13305();
+	drawLayer_ui8 = (LCD_LAYER2 == drawLayer_ui8) ? LCD_LAYER3 : LCD_LAYER2;
+}
+
+/**
+ * @brief Finishes a partial redraw
+ */
+void glcdmenuUpdateEndS1D13305(void)
+{
+	glcdmenuWriteBackS1D13305();
+	drawLayer_ui8 = (LCD_LAYER2 == drawLayer_ui8) ? LCD_LAYER3 : LCD_LAYER2;
+}
+
 /**
  * @brief Clears the current draw layer
  */
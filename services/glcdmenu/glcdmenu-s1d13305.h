@@ -25,9 +25,23 @@
 void
 glcdmenuDrawS1D13305(uint16_t xPos_ui16, uint16_t yPos_ui16, uint8_t color_ui8);
 
+void
+glcdmenuBitsS1D13305(uint16_t xPos_ui16, uint16_t yPos_ui16, uint8_t bits_ui8,
+		uint8_t count_ui8);
+
+void
+glcdmenuFillS1D13305(uint16_t xPos_ui16, uint16_t yPos_ui16,
+		uint16_t width_ui16, uint16_t height_ui16, uint8_t color_ui8);
+
 void
 glcdmenuFlushS1D13305(void);
 
+void
+glcdmenuUpdateBeginS1D13305(void);
+
+void
+glcdmenuUpdateEndS1D13305(void);
+
 void
 glcdmenuClearS1D13305(void);
 
@@ -89,6 +89,73 @@ void menu_screen_set(SCREENPOS x, SCREENPOS y, unsigned char color)
 #endif
 }
 
+/**
+ * @brief Fills a rectangle.
+ *
+ * Called from menu_interpreter.
+ * The menu_interpreter calls this function for boxes,
+ * solid lines and to clear the areas it redraws.
+ *
+ * @param x X position on the screen
+ * @param y Y position on the screen
+ * @param sx width of the rectangle
+ * @param sy height of the rectangle
+ * @param color color of the rectangle
+ */
+void menu_screen_fill(SCREENPOS x, SCREENPOS y, SCREENPOS sx, SCREENPOS sy,
+		unsigned char color)
+{
+#ifdef GLCDMENU_S1D13305
+	glcdmenuFillS1D13305(x, y, sx, sy, color);
+#endif
+}
+
+/**
+ * @brief Draws up to eight pixels of a line.
+ *
+ * Called from menu_interpreter.
+ * The menu_interpreter calls this function for text and
+ * bitmaps.
+ *
+ * @param x X position of the first pixel
+ * @param y Y position on the screen
+ * @param bits pixels, the first one in the MSB
+ * @param count number of pixels (1..8)
+ */
+void menu_screen_bits(SCREENPOS x, SCREENPOS y, unsigned char bits,
+		unsigned char count)
+{
+#ifdef GLCDMENU_S1D13305
+	glcdmenuBitsS1D13305(x, y, bits, count);
+#endif
+}
+
+/**
+ * @brief Partial redraw starts.
+ *
+ * Called from menu_interpreter.
+ * The menu_interpreter calls this function before it
+ * redraws parts of the screen which is currently shown.
+ */
+void menu_screen_update_begin(void)
+{
+#ifdef GLCDMENU_S1D13305
+	glcdmenuUpdateBeginS1D13305();
+#endif
+}
+
+/**
+ * @brief Partial redraw is done.
+ *
+ * Called from menu_interpreter.
+ */
+void menu_screen_update_end(void)
+{
+#ifdef GLCDMENU_S1D13305
+	glcdmenuUpdateEndS1D13305();
+#endif
+}
+
 /**
  * @brief Screen drawing is done.
  *
@@ -206,7 +273,11 @@ void glcdmenuSetChkBoxState(uint16_t idx_ui16, uint8_t state_ui8)
 {
 	if (MENU_CHECKBOX_MAX > idx_ui16)
 	{
-		menu_checkboxstate[idx_ui16] = state_ui8;
+		if (menu_checkboxstate[idx_ui16] != state_ui8)
+		{
+			menu_checkboxstate[idx_ui16] = state_ui8;
+			menu_damage_state(MENU_CHECKBOX, idx_ui16);
+		}
 	}
 	else
 	{
@@ -244,7 +315,11 @@ void glcdmenuSetRadioBtnState(uint16_t idx_ui16, uint8_t state_ui8)
 {
 	if (MENU_RADIOBUTTON_MAX > idx_ui16)
 	{
-		menu_radiobuttonstate[idx_ui16] = state_ui8;
+		if (menu_radiobuttonstate[idx_ui16] != state_ui8)
+		{
+			menu_radiobuttonstate[idx_ui16] = state_ui8;
+			menu_damage_state(MENU_RADIOBUTTON, idx_ui16);
+		}
 	}
 	else
 	{
@@ -282,7 +357,11 @@ void glcdmenuSelectListItem(uint16_t idx_ui16, uint16_t item_ui16)
 {
 	if (MENU_LIST_MAX > idx_ui16)
 	{
-		menu_listindexstate[idx_ui16] = item_ui16;
+		if (menu_listindexstate[idx_ui16] != item_ui16)
+		{
+			menu_listindexstate[idx_ui16] = item_ui16;
+			menu_damage_state(MENU_LIST, idx_ui16);
+		}
 	}
 	else
 	{
@@ -331,7 +410,8 @@ void glcdmenuSetGfxData(uint16_t idx_ui16, unsigned char* ptr_pc)
 /**
  * @brief Check if a redraw should be done.
  *
- * Redraws the menu if necessary.
+ * Redraws the menu if necessary. Objects whose state was
+ * changed by the setters above are redrawn alone.
  */
 int16_t glcdmenuCheckRedraw(void)
 {
@@ -342,6 +422,10 @@ int16_t glcdmenuCheckRedraw(void)
 		menu_redraw();
 		doRedraw_b = false;
 	}
+	else
+	{
+		menu_redraw_dirty();
+	}
 
 	return ECMD_FINAL_OK;
 }
@@ -51,6 +51,12 @@ unsigned char menu_focus_restore; //set to 1 if focus should be resored
 //the index of all objects in the list, 0 for objects which disallow a focus
 MENUADDR menu_focus_objects[MENU_OBJECTS_MAX];
 
+//clipping rectangle of the current redraw, x1 and y1 are exclusive
+unsigned short menu_clip_x0 = 0, menu_clip_y0 = 0;
+unsigned short menu_clip_x1 = MENU_SCREEN_X, menu_clip_y1 = MENU_SCREEN_Y;
+//area of the screen which needs a redraw, empty if x0 >= x1
+unsigned short menu_dirty_x0, menu_dirty_y0, menu_dirty_x1, menu_dirty_y1;
+
 MENUADDR menu_pc; //shows on the byte to read next
 void menu_pc_set(MENUADDR addr) {
 	menu_pc = addr;
@@ -86,11 +92,59 @@ MENUADDR menu_object_datasize(unsigned char object_id) {
 	}
 }
 
+void menu_clip_set(SCREENPOS x, SCREENPOS y, unsigned char color) {
+	if ((x >= menu_clip_x0) && (x < menu_clip_x1) &&
+	    (y >= menu_clip_y0) && (y < menu_clip_y1))
+		menu_screen_set(x, y, color);
+}
+
+void menu_clip_fill(SCREENPOS px, SCREENPOS py, SCREENPOS sx,
+                    SCREENPOS sy, unsigned char color) {
+	unsigned short x0 = px, y0 = py;
+	unsigned short x1 = x0+sx, y1 = y0+sy;
+	if (x0 < menu_clip_x0)
+		x0 = menu_clip_x0;
+	if (y0 < menu_clip_y0)
+		y0 = menu_clip_y0;
+	if (x1 > menu_clip_x1)
+		x1 = menu_clip_x1;
+	if (y1 > menu_clip_y1)
+		y1 = menu_clip_y1;
+	if ((x0 < x1) && (y0 < y1))
+		menu_screen_fill(x0, y0, x1-x0, y1-y0, color);
+}
+
+//draws count (up to 8) pixels from x on, taken from the msb of bits on
+void menu_clip_bits(SCREENPOS px, SCREENPOS py, unsigned char bits,
+                    unsigned char count) {
+	unsigned short x = px;
+	if ((py < menu_clip_y0) || (py >= menu_clip_y1))
+		return;
+	if (x < menu_clip_x0) {
+		if (x+count <= menu_clip_x0)
+			return;
+		bits <<= menu_clip_x0-x;
+		count -= menu_clip_x0-x;
+		x = menu_clip_x0;
+	}
+	if (x+count > menu_clip_x1) {
+		if (x >= menu_clip_x1)
+			return;
+		count = menu_clip_x1-x;
+	}
+	if (count)
+		menu_screen_bits(x, py, bits, count);
+}
+
 unsigned char menu_draw_Xline(SCREENPOS px, SCREENPOS py,
                               SCREENPOS length, unsigned char color) {
 	SCREENPOS x;
+	if ((color & 2) == 0) { //solid line
+		menu_clip_fill(px, py, length, 1, color & 1);
+		return color;
+	}
 	for (x = px; x < px+length; x++) {
-		menu_screen_set(x, py, color & 1);
+		menu_clip_set(x, py, color & 1);
 		if (color & 2) //invert lsb if 2. bit is set.
 			color = ~color | 0x02;
 	}
@@ -100,8 +154,12 @@ unsigned char menu_draw_Xline(SCREENPOS px, SCREENPOS py,
 unsigned char menu_draw_Yline(SCREENPOS px, SCREENPOS py,
                               SCREENPOS length, unsigned char color) {
 	SCREENPOS y;
+	if ((color & 2) == 0) { //solid line
+		menu_clip_fill(px, py, 1, length, color & 1);
+		return color;
+	}
 	for (y = py; y < py+length; y++) {
-		menu_screen_set(px, y, color & 1);
+		menu_clip_set(px, y, color & 1);
 		if (color & 2) //invert lsb if 2. bit is set.
 			color = ~color | 0x02;
 	}
@@ -124,14 +182,7 @@ void menu_draw_border(SCREENPOS px, SCREENPOS py, SCREENPOS sx,
 
 void menu_draw_box(SCREENPOS px, SCREENPOS py, SCREENPOS sx,
                    SCREENPOS sy, unsigned char color) {
-	SCREENPOS x, y;
-	SCREENPOS ex = px+sx;
-	SCREENPOS ey = py+sy;
-	for (y = py; y < ey; y++) {
-		for (x = px; x < ex; x++) {
-			menu_screen_set(x, y, color);
-		}
-	}
+	menu_clip_fill(px, py, sx, sy, color);
 }
 
 unsigned char menu_text_byte_get(MENUADDR baseaddr, unsigned short index,
@@ -296,12 +347,12 @@ void menu_checkbox(unsigned char hasfocus) {
 	printf("Drawing checkbox %i with state %i\n", ckbnumber, color);
 #endif
 	//TODO: make the pattern available as gfx instead of hard coded values
-	menu_screen_set(px+1, py+4, color);
-	menu_screen_set(px+2, py+5, color);
-	menu_screen_set(px+3, py+4, color);
-	menu_screen_set(px+4, py+3, color);
-	menu_screen_set(px+5, py+2, color);
-	menu_screen_set(px+6, py+1, color);
+	menu_clip_set(px+1, py+4, color);
+	menu_clip_set(px+2, py+5, color);
+	menu_clip_set(px+3, py+4, color);
+	menu_clip_set(px+4, py+3, color);
+	menu_clip_set(px+5, py+2, color);
+	menu_clip_set(px+6, py+1, color);
 #else
 #ifdef DEBUG
 	printf("Error: Checkbox used, but not compiled in\n");
@@ -334,18 +385,18 @@ void menu_radiobutton(unsigned char hasfocus) {
 	printf("Drawing radiobutton of group %i, checked on %i. Tableentry: %i\n", radionumber, radioselect, menu_checkboxstate[radionumber]);
 #endif
 	//TODO: make the pattern available as gfx instead of hard coded values
-	menu_screen_set(px+3, py+2, color);
-	menu_screen_set(px+4, py+2, color);
-	menu_screen_set(px+2, py+3, color);
-	menu_screen_set(px+3, py+3, color);
-	menu_screen_set(px+4, py+3, color);
-	menu_screen_set(px+5, py+3, color);
-	menu_screen_set(px+3, py+5, color);
-	menu_screen_set(px+4, py+5, color);
-	menu_screen_set(px+2, py+4, color);
-	menu_screen_set(px+3, py+4, color);
-	menu_screen_set(px+4, py+4, color);
-	menu_screen_set(px+5, py+4, color);
+	menu_clip_set(px+3, py+2, color);
+	menu_clip_set(px+4, py+2, color);
+	menu_clip_set(px+2, py+3, color);
+	menu_clip_set(px+3, py+3, color);
+	menu_clip_set(px+4, py+3, color);
+	menu_clip_set(px+5, py+3, color);
+	menu_clip_set(px+3, py+5, color);
+	menu_clip_set(px+4, py+5, color);
+	menu_clip_set(px+2, py+4, color);
+	menu_clip_set(px+3, py+4, color);
+	menu_clip_set(px+4, py+4, color);
+	menu_clip_set(px+5, py+4, color);
 #else
 #ifdef DEBUG
 	printf("Error: Radiobutton used, but not compiled in\n");
@@ -378,11 +429,14 @@ void menu_gfx(unsigned char hasfocus) {
 	unsigned char storage = (options >> MENU_OPTIONS_STORAGE) & 1;
 	unsigned char havedata = 0;
 	unsigned char data = 0;
+	unsigned char bits, nbits;
 	SCREENPOS x, y;
 #ifdef DEBUG
 	printf("Drawing gfx at %i, %i, compressed: %i, storage: %i, address: %i\n", px, py, compressed, storage, gfxaddr);
 #endif
 	for (y = py; y < py+sy; y++) {
+		bits = 0;
+		nbits = 0;
 		for (x = px; x < px+sx; x++) {
 			//check if we have source data
 			if (havedata == 0) { //fetch a next byte
@@ -407,8 +461,15 @@ void menu_gfx(unsigned char hasfocus) {
 			}
 			havedata--;
 			//printf("%i, %i: %i from %i\n", x, y, color, data);
-			menu_screen_set(x, y, color);
+			bits = (bits << 1) | color;
+			nbits++;
+			if (nbits == 8) { //draw eight pixels at once
+				menu_clip_bits(x-7, y, bits, 8);
+				nbits = 0;
+			}
 		}
+		if (nbits)
+			menu_clip_bits(px+sx-nbits, y, bits << (8-nbits), nbits);
 	}
 	if ((hasfocus) || (options & (1<<MENU_OPTIONS_RECTANGLE))) //append dotted border
 		menu_draw_border(px, py, sx, sy, 1, hasfocus);
@@ -668,27 +729,8 @@ void menu_draw_windowcontent(unsigned char focusallow) {
 	}
 }
 
-void menu_redraw(void) {
-	//skip over possible global shortcuts if menu_window_init = 0
-	if (menu_window_init == 0) { //first start
-		unsigned char token = menu_byte_get(menu_window_start);
-		while (token == MENU_SHORTCUT) {
-			//should only happen at the beginning for global shortcuts
-			menu_window_start += menu_object_datasize(MENU_SHORTCUT)+1;
-			token = menu_byte_get(menu_window_start);
-		}
-	}
-#ifdef DEBUG
-	printf("window init: %i, subwindow start: %i, window start: %i\n", menu_window_init, menu_subwindow_start, menu_window_start);
-#endif
-	menu_screen_clear();
-	if (menu_subwindow_start) {
-		if (menu_window_init != menu_subwindow_start) {
-			menu_new_window(menu_subwindow_start);
-		}
-	} else if (menu_window_init != menu_window_start) {
-		menu_new_window(menu_window_start);
-	}
+//draws the window and the subwindow, if shown, within the clipping rectangle
+static void menu_draw_windows(void) {
 	//draw window
 	menu_pc_set(menu_window_start);
 	unsigned char token = menu_byte_get_next();
@@ -732,9 +774,135 @@ void menu_redraw(void) {
 #endif
 		}
 	}
+}
+
+void menu_redraw(void) {
+	//skip over possible global shortcuts if menu_window_init = 0
+	if (menu_window_init == 0) { //first start
+		unsigned char token = menu_byte_get(menu_window_start);
+		while (token == MENU_SHORTCUT) {
+			//should only happen at the beginning for global shortcuts
+			menu_window_start += menu_object_datasize(MENU_SHORTCUT)+1;
+			token = menu_byte_get(menu_window_start);
+		}
+	}
+#ifdef DEBUG
+	printf("window init: %i, subwindow start: %i, window start: %i\n", menu_window_init, menu_subwindow_start, menu_window_start);
+#endif
+	menu_dirty_x1 = menu_dirty_x0 = 0; //everything gets redrawn
+	menu_screen_clear();
+	if (menu_subwindow_start) {
+		if (menu_window_init != menu_subwindow_start) {
+			menu_new_window(menu_subwindow_start);
+		}
+	} else if (menu_window_init != menu_window_start) {
+		menu_new_window(menu_window_start);
+	}
+	menu_draw_windows();
 	menu_screen_flush();
 }
 
+//adds the rectangle of the object at addr to the area which needs a redraw
+static void menu_damage_object(MENUADDR addr) {
+	MENUADDR p = addr+1;
+	unsigned short px = menu_byte_get(p++);
+	unsigned short py = menu_byte_get(p++);
+#ifdef LARGESCREEN
+	unsigned char lpxy = menu_byte_get(p++);
+	px += (unsigned short)(lpxy & 0xF0) << 4;
+	py += (unsigned short)(lpxy & 0x0F) << 8;
+#endif
+	unsigned short sx = menu_byte_get(p++);
+	unsigned short sy = menu_byte_get(p++);
+#ifdef LARGESCREEN
+	unsigned char lsxy = menu_byte_get(p++);
+	sx += (unsigned short)(lsxy & 0xF0) << 4;
+	sy += (unsigned short)(lsxy & 0x0F) << 8;
+#endif
+#ifdef DEBUG
+	printf("Damaged object at %i: %i;%i with size %i;%i\n", addr, px, py, sx, sy);
+#endif
+	if (menu_dirty_x0 >= menu_dirty_x1) {
+		menu_dirty_x0 = px;
+		menu_dirty_y0 = py;
+		menu_dirty_x1 = px+sx;
+		menu_dirty_y1 = py+sy;
+		return;
+	}
+	if (px < menu_dirty_x0)
+		menu_dirty_x0 = px;
+	if (py < menu_dirty_y0)
+		menu_dirty_y0 = py;
+	if (px+sx > menu_dirty_x1)
+		menu_dirty_x1 = px+sx;
+	if (py+sy > menu_dirty_y1)
+		menu_dirty_y1 = py+sy;
+}
+
+static void menu_damage_scan(MENUADDR seekpos, unsigned char type,
+                             unsigned char index, unsigned char mask) {
+	//jump over the window definition
+	seekpos += menu_object_datasize(menu_byte_get(seekpos))+1;
+	while (1) {
+		unsigned char obj = menu_byte_get(seekpos);
+		if ((obj == MENU_WINDOW) || (obj == MENU_SUBWINDOW) || (obj == MENU_INVALID))
+			break;
+		//checkboxes, radiobuttons and lists have their index at the same place
+		if ((obj == type) &&
+		    ((menu_byte_get(seekpos+MENU_CKRAD_OFF+2*MENU_ADDR_BYTES) & mask) == index))
+			menu_damage_object(seekpos);
+		seekpos += menu_object_datasize(obj)+1;
+	}
+}
+
+/* Marks the checkboxes (MENU_CHECKBOX), radiobuttons (MENU_RADIOBUTTON, index
+is the group) or lists (MENU_LIST) with the given index on the shown windows as
+changed. menu_redraw_dirty() redraws them.
+*/
+void menu_damage_state(unsigned char type, unsigned char index) {
+	unsigned char mask = 0xff;
+	if (menu_window_init == 0)
+		return; //nothing drawn yet
+	if (type == MENU_RADIOBUTTON)
+		mask = 0x0f;
+	menu_damage_scan(menu_window_start, type, index, mask);
+	if (menu_subwindow_start)
+		menu_damage_scan(menu_subwindow_start, type, index, mask);
+}
+
+/* Redraws only the damaged area, directly on the shown screen. Everything
+within it is drawn like on a full redraw, so overlapping objects stay right.
+*/
+void menu_redraw_dirty(void) {
+	MENUADDR shown = menu_window_start;
+	if (menu_subwindow_start)
+		shown = menu_subwindow_start;
+	if ((menu_window_init == 0) || (menu_window_init != shown)) {
+		menu_redraw(); //window switch pending
+		return;
+	}
+	if (menu_dirty_x0 >= menu_dirty_x1)
+		return;
+	menu_clip_x0 = menu_dirty_x0;
+	menu_clip_y0 = menu_dirty_y0;
+	menu_clip_x1 = menu_dirty_x1 < MENU_SCREEN_X ? menu_dirty_x1 : MENU_SCREEN_X;
+	menu_clip_y1 = menu_dirty_y1 < MENU_SCREEN_Y ? menu_dirty_y1 : MENU_SCREEN_Y;
+	menu_dirty_x1 = menu_dirty_x0 = 0;
+#ifdef DEBUG
+	printf("Redrawing %i;%i to %i;%i\n", menu_clip_x0, menu_clip_y0, menu_clip_x1, menu_clip_y1);
+#endif
+	if ((menu_clip_x0 < menu_clip_x1) && (menu_clip_y0 < menu_clip_y1)) {
+		menu_screen_update_begin();
+		menu_clip_fill(menu_clip_x0, menu_clip_y0, menu_clip_x1-menu_clip_x0,
+		               menu_clip_y1-menu_clip_y0, 0);
+		menu_draw_windows();
+		menu_screen_update_end();
+	}
+	menu_clip_x0 = menu_clip_y0 = 0;
+	menu_clip_x1 = MENU_SCREEN_X;
+	menu_clip_y1 = MENU_SCREEN_Y;
+}
+
 void menu_run_action(MENUADDR addr) {
 	menu_pc_set(addr);
 #ifdef DEBUG
@@ -767,7 +935,8 @@ static void menu_handle_checkbox(MENUADDR addr) {
 	unsigned char index = menu_byte_get(addr+MENU_CKRAD_OFF+2*MENU_ADDR_BYTES);
 	if (index < MENU_CHECKBOX_MAX)
 		menu_checkboxstate[index] = 1-menu_checkboxstate[index];
-	menu_redraw(); //Improvement: May be faster if only the checkbox gets redrawn
+	menu_damage_object(addr);
+	menu_redraw_dirty();
 }
 
 #endif
@@ -780,7 +949,8 @@ static void menu_handle_radiobutton(MENUADDR addr) {
 	groupindex &= 0x0f;
 	if (groupindex < MENU_RADIOBUTTON_MAX)
 		menu_radiobuttonstate[groupindex] = value;
-	menu_redraw(); //Improvement: May be faster if only the radiobutton gets redrawn
+	menu_damage_state(MENU_RADIOBUTTON, groupindex);
+	menu_redraw_dirty();
 }
 
 #endif
@@ -824,7 +994,8 @@ static void menu_handle_listbox(MENUADDR addr, unsigned char key) {
 			if (nvalue != menu_listindexstate[listindex]) {
 				menu_listindexstate[listindex] = nvalue;
 				menu_action(65535-1-listindex);
-				menu_redraw();
+				menu_damage_object(addr);
+				menu_redraw_dirty();
 			}
 		}
 	}
@@ -859,6 +1030,8 @@ void menu_keypress(unsigned char key) {
 	//look if key swiches the focus
 	if (key == menu_focus_key_prev) {
 		unsigned char i;
+		if (focusaddr)
+			menu_damage_object(focusaddr);
 		for (i = 0; i < menu_objects; i++) { //seek next object which is focusable
 			menu_focus--;
 			if (menu_focus >= menu_objects)
@@ -869,11 +1042,15 @@ void menu_keypress(unsigned char key) {
 #ifdef DEBUG
 		printf("New focus: %i\n", menu_focus);
 #endif
-		menu_redraw();
+		if (menu_focus_objects[menu_focus])
+			menu_damage_object(menu_focus_objects[menu_focus]);
+		menu_redraw_dirty();
 		return;
 	}
 	if (key == menu_focus_key_next) {
 		unsigned char i;
+		if (focusaddr)
+			menu_damage_object(focusaddr);
 		for (i = 0; i < menu_objects; i++) { //seek next object which is focusable
 			menu_focus++;
 			if (menu_focus >= menu_objects)
@@ -884,7 +1061,9 @@ void menu_keypress(unsigned char key) {
 #ifdef DEBUG
 		printf("New focus: %i\n", menu_focus);
 #endif
-		menu_redraw();
+		if (menu_focus_objects[menu_focus])
+			menu_damage_object(menu_focus_objects[menu_focus]);
+		menu_redraw_dirty();
 		return;
 	}
 	//look if key is part of a shortcut
@@ -63,12 +63,19 @@ NOTE: The List element is only partially supported by now.
 */
 //#define MENU_MOUSE_SUPPORT
 
-//Implement the five functions by your own:
+//Implement the nine functions by your own:
 extern unsigned char menu_byte_get(MENUADDR addr);
 extern void menu_screen_set(SCREENPOS x, SCREENPOS y, unsigned char color);
 extern void menu_screen_flush(void);
 extern void menu_screen_clear(void);
 extern unsigned char menu_action(unsigned short action);
+//fills a rectangle, always within the screen
+extern void menu_screen_fill(SCREENPOS x, SCREENPOS y, SCREENPOS sx, SCREENPOS sy, unsigned char color);
+//sets count (1..8) pixels from x on to the bits, msb first, always within the screen
+extern void menu_screen_bits(SCREENPOS x, SCREENPOS y, unsigned char bits, unsigned char count);
+//enclose a redraw of the damaged area, which goes to the shown screen directly
+extern void menu_screen_update_begin(void);
+extern void menu_screen_update_end(void);
 
 //arrys for dynamic data
 extern unsigned char * menu_strings[];
@@ -212,8 +219,15 @@ possible.
 #endif
 
 void menu_redraw(void);
+void menu_redraw_dirty(void);
+void menu_damage_state(unsigned char type, unsigned char index);
 void menu_keypress(unsigned char key);
 
+//drawing functions clipped to the area being redrawn, used by menu-text.c
+void menu_clip_set(SCREENPOS x, SCREENPOS y, unsigned char color);
+void menu_clip_fill(SCREENPOS px, SCREENPOS py, SCREENPOS sx, SCREENPOS sy, unsigned char color);
+void menu_clip_bits(SCREENPOS px, SCREENPOS py, unsigned char bits, unsigned char count);
+
 #ifdef MENU_MOUSE_SUPPORT
 void menu_mouse(SCREENPOS x, SCREENPOS y, unsigned char key);
 #endif
@@ -174,7 +174,8 @@ unsigned char menu_font_heigth(unsigned char font) {
 unsigned char menu_char_draw(SCREENPOS posx, SCREENPOS posy, unsigned char font, unsigned char cdraw) {
 	unsigned char nunbyte, charwidth, nunbit;
 	unsigned char copyedbytes[5];
-	SCREENPOS tempx, tempy;
+	unsigned char columns[5], ncolumns, bits;
+	SCREENPOS tempx;
 	unsigned char byte_eq_count,nun;
 	unsigned char shrink;
 	if ((font & 1)) {
@@ -214,27 +215,32 @@ unsigned char menu_char_draw(SCREENPOS posx, SCREENPOS posy, unsigned char font,
 				}
 			} //end of loop
 		} //end if shrink != 0
+		//a removed column gets overdrawn by the next one
+		ncolumns = 0;
 		for (nunbyte = 0; nunbyte < 5;nunbyte++) {
 			tempx = posx+charwidth;
 			if (tempx < posx+charwidth) {
 				break; //prevent overflow to the left side of the screen
 			}
-			for (nunbit = 0; nunbit < 7;nunbit++) {
-				tempy = posy+nunbit;
-				if ((copyedbytes[nunbyte] & (0x01<<nunbit)) != 0) {
-					menu_screen_set(tempx, tempy, 1);
-				} else
-					menu_screen_set(tempx, tempy, 0);
-			}       //end: inner loop
-			if (font & 2)
-				menu_screen_set(tempx, posy+7, 1);
+			columns[charwidth] = copyedbytes[nunbyte];
+			if (ncolumns <= charwidth)
+				ncolumns = charwidth+1;
 			if ((copyedbytes[nunbyte] != 0) || (shrink == 0)) {
 				charwidth++;
 			}       //end: charwidth++
 		}         //end: outer loop
-		if (font & 2) { //underline empty part between chars (this is not perfect on word ending)
+		//draw line by line, all columns of a line at once
+		for (nunbit = 0; nunbit < 7;nunbit++) {
+			bits = 0;
+			for (nunbyte = 0; nunbyte < ncolumns; nunbyte++) {
+				if ((columns[nunbyte] & (0x01<<nunbit)) != 0)
+					bits |= 0x80 >> nunbyte;
+			}
+			menu_clip_bits(posx, posy+nunbit, bits, ncolumns);
+		}
+		if (font & 2) { //underline, including the empty part between chars (this is not perfect on word ending)
 			//printf("%i, %i\n", posx, charwidth);
-			menu_screen_set(posx+charwidth, posy+7, 1);
+			menu_clip_fill(posx, posy+7, charwidth < ncolumns ? ncolumns : charwidth+1, 1, 1);
 		}
 	}          //end: valid char
 	return charwidth++;
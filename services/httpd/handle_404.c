@@ -25,12 +25,13 @@ void
 httpd_handle_404 (void)
 {
     if (uip_acked ()) {
-	uip_close ();
+	httpd_done ();
 	return;
     }
 
     PASTE_RESET ();
     PASTE_P (httpd_header_404);
+    PASTE_CONNECTION ();
     PASTE_P (httpd_header_length);
     PASTE_LEN_P (httpd_body_404);
     PASTE_P (httpd_header_end);
@@ -19,6 +19,7 @@
  */
 
 #include "config.h"
+#include "core/periodic.h"
 #include "protocols/ecmd/parser.h"
 #include "protocols/ecmd/ecmd-base.h"
 #include "httpd.h"
@@ -31,6 +32,30 @@
 # define printf(...)   ((void)0)
 #endif
 
+#ifdef HTTPD_ECMD_BATCH_SUPPORT
+/* Body of the one batch request being served; there is not enough RAM
+   to give each connection its own. */
+static char httpd_ecmd_batch[HTTPD_ECMD_BATCH_LENGTH];
+static uip_conn_t *httpd_ecmd_batch_conn;
+static uint16_t httpd_ecmd_batch_size;	/* Content-Length */
+static uint16_t httpd_ecmd_batch_len;	/* Bytes received so far */
+static uint16_t httpd_ecmd_batch_pos;	/* Start of the next command */
+static uint16_t httpd_ecmd_batch_skip;	/* Header bytes in 1st segment */
+static uint8_t httpd_ecmd_batch_seq[4];	/* rcv_nxt behind 1st segment */
+static uint8_t httpd_ecmd_batch_eol;	/* Line ends in a row, 2 = body */
+static uint8_t httpd_ecmd_batch_match;	/* Content-Length chars matched */
+static uint8_t httpd_ecmd_batch_idle;	/* Polls without new data */
+
+static const char httpd_ecmd_batch_clen[] PROGMEM = "content-length:";
+#define HTTPD_ECMD_BATCH_NOMATCH 0xFF
+
+/* uip_tcp_timer polls each connection every 10 ticks. */
+#define HTTPD_ECMD_BATCH_POLLS (HTTPD_ECMD_BATCH_TIMEOUT * (HZ / 10))
+
+static uint8_t httpd_ecmd_batch_next (void);
+#endif	/* HTTPD_ECMD_BATCH_SUPPORT */
+
+
 void
 httpd_handle_ecmd_setup (char *encoded_cmd)
 {
@@ -60,6 +85,7 @@ httpd_handle_ecmd_setup (char *encoded_cmd)
 
     if (maxlen == 0) {
 	printf ("httpd_ecmd: received ecmd too long.\n");
+	STATE->handler = httpd_handle_400;
 	return;
     }
 
@@ -73,11 +99,37 @@ httpd_handle_ecmd_send_header (void)
 {
     PASTE_RESET ();
     PASTE_P (httpd_header_200);
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    /* The length of the output isn't known in advance, hence chunk it. */
+    if (STATE->keepalive)
+	PASTE_P (httpd_header_chunked);
+#endif
+    PASTE_CONNECTION ();
     PASTE_P (httpd_header_ecmd);
     PASTE_SEND ();
 }
 
 
+static void
+httpd_handle_ecmd_send_body (void)
+{
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    if (STATE->keepalive) {
+	/* The terminating empty chunk goes along with the last line. */
+	PASTE_RESET ();
+	PASTE_PF (PSTR ("%x\r\n%s\r\n"), strlen (STATE->u.ecmd.output),
+		  STATE->u.ecmd.output);
+	if (STATE->eof)
+	    PASTE_P (httpd_body_chunk_end);
+	PASTE_SEND ();
+	return;
+    }
+#endif	/* HTTPD_KEEPALIVE_SUPPORT */
+
+    uip_send (STATE->u.ecmd.output, strlen (STATE->u.ecmd.output));
+}
+
+
 void
 httpd_handle_ecmd (void)
 {
@@ -90,8 +142,10 @@ httpd_handle_ecmd (void)
     }
 
     if (!uip_rexmit ()) {
-	if (STATE->eof)
-	    uip_close ();
+	if (STATE->eof) {
+	    httpd_done ();
+	    return;
+	}
 	else {
 	    int16_t len = ecmd_parse_command(STATE->u.ecmd.input,
 					     STATE->u.ecmd.output,
@@ -101,9 +155,25 @@ httpd_handle_ecmd (void)
 		len = ECMD_AGAIN(len);
             }
 	    else if (is_ECMD_ERR(len)) {	/* Error */
-		uip_close();
-		return;
+#ifdef HTTPD_ECMD_BATCH_SUPPORT
+		if (STATE->handler == httpd_handle_ecmd_batch) {
+		    /* Report it and go on with the next command. */
+		    len = sprintf_P (STATE->u.ecmd.output, PSTR ("error"));
+		    if (!httpd_ecmd_batch_next ())
+			STATE->eof = 1;
+		}
+		else
+#endif	/* HTTPD_ECMD_BATCH_SUPPORT */
+		{
+		    uip_close();
+		    return;
+		}
 	    }
+#ifdef HTTPD_ECMD_BATCH_SUPPORT
+	    else if (STATE->handler == httpd_handle_ecmd_batch
+		     && httpd_ecmd_batch_next ())
+		;		/* More commands to go. */
+#endif	/* HTTPD_ECMD_BATCH_SUPPORT */
 	    else
 		STATE->eof = 1;
 
@@ -112,5 +182,207 @@ httpd_handle_ecmd (void)
 	}
     }
 
-    uip_send (STATE->u.ecmd.output, strlen (STATE->u.ecmd.output));
+    httpd_handle_ecmd_send_body ();
+}
+
+
+#ifdef HTTPD_ECMD_BATCH_SUPPORT
+static void
+httpd_handle_ecmd_busy (void)
+{
+    if (uip_acked ()) {
+	uip_close ();
+	return;
+    }
+
+    PASTE_RESET ();
+    PASTE_P (httpd_header_503);
+    PASTE_SEND ();
+}
+
+
+/* Skip the request header up to the empty line, which may be spread over
+   several segments.  Content-Length is parsed on the way, so it may be in
+   any segment and even be split between two.  Returns the number of
+   header bytes in DATA. */
+static uint16_t
+httpd_ecmd_batch_header (char *data, uint16_t len)
+{
+    uint16_t i;
+    for (i = 0; i < len && httpd_ecmd_batch_eol < 2; i ++) {
+	char c = data[i];
+	if (c == '\n') {
+	    httpd_ecmd_batch_eol ++;
+	    httpd_ecmd_batch_match = 0;
+	    continue;
+	}
+	if (c == '\r')
+	    continue;
+	httpd_ecmd_batch_eol = 0;
+
+	uint8_t m = httpd_ecmd_batch_match;
+	if (m == HTTPD_ECMD_BATCH_NOMATCH)
+	    continue;
+
+	if (m == sizeof (httpd_ecmd_batch_clen) - 1) {
+	    /* Within the value; anything too big ends up as LENGTH + 1. */
+	    if (c >= '0' && c <= '9') {
+		uint16_t size = httpd_ecmd_batch_size * 10 + (c - '0');
+		if (size > HTTPD_ECMD_BATCH_LENGTH)
+		    size = HTTPD_ECMD_BATCH_LENGTH + 1;
+		httpd_ecmd_batch_size = size;
+	    }
+	    else if (c != ' ')
+		httpd_ecmd_batch_match = HTTPD_ECMD_BATCH_NOMATCH;
+	}
+	else if ((c | 0x20) == pgm_read_byte (&httpd_ecmd_batch_clen[m]))
+	    httpd_ecmd_batch_match ++;
+	else
+	    httpd_ecmd_batch_match = HTTPD_ECMD_BATCH_NOMATCH;
+    }
+
+    return i;
+}
+
+
+/* Called for "POST /ecmd" before the request header is modified.  Note
+   where the body starts and claim the batch buffer.  Returns 0 and sets
+   an error handler if the buffer is busy; the length is checked once
+   the whole header has been seen. */
+uint8_t
+httpd_handle_ecmd_batch_setup (void)
+{
+    if (httpd_ecmd_batch_conn && httpd_ecmd_batch_conn != uip_conn) {
+	printf ("httpd_ecmd: batch buffer busy.\n");
+	STATE->handler = httpd_handle_ecmd_busy;
+	return 0;
+    }
+
+    httpd_ecmd_batch_eol = 0;
+    httpd_ecmd_batch_match = 0;
+    httpd_ecmd_batch_size = 0;
+    httpd_ecmd_batch_idle = 0;
+    httpd_ecmd_batch_skip = httpd_ecmd_batch_header (uip_appdata, uip_len);
+    memcpy (httpd_ecmd_batch_seq, uip_conn->rcv_nxt, 4);
+    httpd_ecmd_batch_conn = uip_conn;
+    httpd_ecmd_batch_len = 0;
+    httpd_ecmd_batch_pos = 0;
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    STATE->body = 1;
+#endif
+    return 1;
+}
+
+
+void
+httpd_handle_ecmd_batch_release (void)
+{
+    if (httpd_ecmd_batch_conn == uip_conn)
+	httpd_ecmd_batch_conn = NULL;
+}
+
+
+/* Copy the next command line of the batch to the input buffer.  Returns 0
+   if there is none left. */
+static uint8_t
+httpd_ecmd_batch_next (void)
+{
+    while (httpd_ecmd_batch_pos < httpd_ecmd_batch_len) {
+	char *line = httpd_ecmd_batch + httpd_ecmd_batch_pos;
+	uint16_t len = httpd_ecmd_batch_len - httpd_ecmd_batch_pos;
+	char *lf = memchr (line, '\n', len);
+	if (lf)
+	    len = lf - line;
+
+	httpd_ecmd_batch_pos += len + 1;
+	if (len && line[len - 1] == '\r')
+	    len --;
+	if (len == 0)
+	    continue;		/* Skip empty lines. */
+
+	/* Rather fail than execute a truncated command. */
+	if (len >= ECMD_INPUTBUF_LENGTH)
+	    len = 0;
+
+	memcpy (STATE->u.ecmd.input, line, len);
+	STATE->u.ecmd.input[len] = 0;
+	return 1;
+    }
+
+    return 0;
+}
+
+
+void
+httpd_handle_ecmd_batch (void)
+{
+    if (httpd_ecmd_batch_eol < 2
+	|| httpd_ecmd_batch_len < httpd_ecmd_batch_size) {
+	if (!uip_newdata ()) {
+	    /* Don't let a stalled client hold the buffer forever. */
+	    if (uip_poll ()
+		&& ++ httpd_ecmd_batch_idle >= HTTPD_ECMD_BATCH_POLLS) {
+		printf ("httpd_ecmd: batch body timed out.\n");
+		httpd_cleanup ();
+		uip_abort ();
+	    }
+	    return;
+	}
+	httpd_ecmd_batch_idle = 0;
+
+	/* Setup has looked at the header part of its own segment. */
+	if (memcmp (httpd_ecmd_batch_seq, uip_conn->rcv_nxt, 4))
+	    httpd_ecmd_batch_skip = 0;
+
+	char *data = (char *) uip_appdata + httpd_ecmd_batch_skip;
+	uint16_t len = uip_len - httpd_ecmd_batch_skip;
+	httpd_ecmd_batch_skip = 0;
+
+	uint16_t skip = httpd_ecmd_batch_header (data, len);
+	data += skip;
+	len -= skip;
+
+	if (httpd_ecmd_batch_eol < 2)
+	    return;		/* Header continues in the next segment. */
+
+	if (httpd_ecmd_batch_size == 0
+	    || httpd_ecmd_batch_size > HTTPD_ECMD_BATCH_LENGTH) {
+	    printf ("httpd_ecmd: bad batch length %u.\n",
+		    httpd_ecmd_batch_size);
+	    httpd_cleanup ();
+	    STATE->handler = httpd_handle_400;
+	    httpd_handle_400 ();
+	    return;
+	}
+
+	if (len > httpd_ecmd_batch_size - httpd_ecmd_batch_len) {
+	    /* Pipelined data we have no room for, close after response. */
+	    len = httpd_ecmd_batch_size - httpd_ecmd_batch_len;
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+	    STATE->keepalive = 0;
+#endif
+	}
+
+	memcpy (httpd_ecmd_batch + httpd_ecmd_batch_len, data, len);
+	httpd_ecmd_batch_len += len;
+
+	if (httpd_ecmd_batch_len < httpd_ecmd_batch_size)
+	    return;		/* Wait for the rest of the body. */
+
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+	/* Hold back pipelined requests until this one is answered. */
+	if (STATE->keepalive)
+	    uip_stop ();
+#endif
+
+	if (!httpd_ecmd_batch_next ()) {
+	    httpd_cleanup ();
+	    STATE->handler = httpd_handle_400;
+	    httpd_handle_400 ();
+	    return;
+	}
+    }
+
+    httpd_handle_ecmd ();
 }
+#endif	/* HTTPD_ECMD_BATCH_SUPPORT */
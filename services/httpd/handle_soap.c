@@ -86,8 +86,10 @@ httpd_handle_soap (void)
 
 	if (STATE->u.soap.error)
 	    PASTE_P (httpd_header_500_xml);
-	else
+	else {
 	    PASTE_P (httpd_header_200);
+	    PASTE_CONNECTION ();
+	}
 
 	PASTE_P (httpd_header_ct_xml);
 	soap_paste_result (&STATE->u.soap);
@@ -30,6 +30,21 @@
 static void
 httpd_handle_vfs_send_header (void)
 {
+#ifdef HTTPD_ETAG_SUPPORT
+    uint32_t etag = vfs_etag (STATE->u.vfs.fd);
+    if (etag && etag == STATE->u.vfs.etag) {
+	/* The client's copy is up to date, send headers only. */
+	PASTE_RESET ();
+	PASTE_P (httpd_header_304);
+	PASTE_CONNECTION ();
+	PASTE_ETAG (etag);
+	PASTE_P (httpd_header_end);
+	PASTE_SEND ();
+	STATE->eof = 1;
+	return;
+    }
+#endif	/* HTTPD_ETAG_SUPPORT */
+
     PASTE_RESET ();
     PASTE_P (httpd_header_200);
 
@@ -39,6 +54,15 @@ httpd_handle_vfs_send_header (void)
 	PASTE_P (httpd_header_length);
 	PASTE_LEN (len);
     }
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    else
+	STATE->keepalive = 0;	/* Only EOF can delimit the body. */
+#endif
+    PASTE_CONNECTION ();
+#ifdef HTTPD_ETAG_SUPPORT
+    if (etag)
+	PASTE_ETAG (etag);
+#endif
 
     /* Check whether the file is gzip compressed. */
     unsigned char buf[READ_AHEAD_LEN];
@@ -116,7 +140,7 @@ httpd_handle_vfs (void)
 	httpd_handle_vfs_send_header ();
 
     else if (STATE->eof && !uip_rexmit())
-	uip_close ();
+	httpd_done ();
 
     else
 	httpd_handle_vfs_send_body ();
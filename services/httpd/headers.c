@@ -25,9 +25,26 @@
 
 const char PROGMEM httpd_header_200[] =
 "HTTP/1.1 200 OK\n"
+#ifndef HTTPD_KEEPALIVE_SUPPORT
+"Connection: close\n"
+#endif
+;
+
+
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+const char PROGMEM httpd_header_close[] =
 "Connection: close\n";
 
 
+const char PROGMEM httpd_header_chunked[] =
+"Transfer-Encoding: chunked\n";
+
+
+const char PROGMEM httpd_body_chunk_end[] =
+"0\r\n\r\n";
+#endif	/* HTTPD_KEEPALIVE_SUPPORT */
+
+
 const char PROGMEM httpd_header_ct_css[] =
 "Content-Type: text/css; charset=utf-8\n\n";
 
@@ -52,6 +69,25 @@ const char PROGMEM httpd_header_ecmd[] =
 #endif	/* ECMD_PARSER_SUPPORT */
 
 
+#ifdef HTTPD_ETAG_SUPPORT
+const char PROGMEM httpd_header_304[] =
+"HTTP/1.1 304 Not Modified\n"
+#ifndef HTTPD_KEEPALIVE_SUPPORT
+"Connection: close\n"
+#endif
+;
+
+
+const char PROGMEM httpd_header_etag[] =
+"ETag: \"%08lx\"\n"
+#if HTTPD_CACHE_MAX_AGE > 0
+"Cache-Control: max-age=%lu\n";
+#else
+"Cache-Control: no-cache\n";
+#endif
+#endif	/* HTTPD_ETAG_SUPPORT */
+
+
 const char PROGMEM httpd_header_400[] =
 "HTTP/1.1 400 Bad Request\n"
 "Connection: close\n"
@@ -79,9 +115,20 @@ const char PROGMEM httpd_body_400[] =
 "Bad Request\n";
 
 
+#ifdef HTTPD_ECMD_BATCH_SUPPORT
+const char PROGMEM httpd_header_503[] =
+"HTTP/1.1 503 Service Unavailable\n"
+"Connection: close\n"
+"Retry-After: 1\n"
+"Content-Length: 0\n\n";
+#endif	/* HTTPD_ECMD_BATCH_SUPPORT */
+
+
 const char PROGMEM httpd_header_404[] =
 "HTTP/1.1 404 File Not Found\n"
+#ifndef HTTPD_KEEPALIVE_SUPPORT
 "Connection: close\n"
+#endif
 "Content-Type: text/plain; charset=utf-8\n";
 
 
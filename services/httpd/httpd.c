@@ -74,6 +74,144 @@ httpd_cleanup (void)
     if (STATE->handler == httpd_handle_soap)
       soap_deallocate_context (&STATE->u.soap);
 #endif	/* HTTPD_SOAP_SUPPORT */
+
+#ifdef HTTPD_ECMD_BATCH_SUPPORT
+    httpd_handle_ecmd_batch_release ();
+#endif	/* HTTPD_ECMD_BATCH_SUPPORT */
+}
+
+
+/* Prepare the connection state for the next request. */
+static void
+httpd_reset (void)
+{
+    STATE->handler = NULL;
+    STATE->header_acked = 0;
+    STATE->eof = 0;
+    STATE->header_reparse = 0;
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    STATE->header_done = 0;
+    STATE->keepalive = 0;
+    STATE->body = 0;
+    STATE->idle = 0;
+#endif
+#ifdef HTTPD_AUTH_SUPPORT
+    STATE->auth_state = PAM_UNKOWN;
+#endif
+}
+
+
+/* The response has been sent and acknowledged completely. */
+void
+httpd_done (void)
+{
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    if (STATE->keepalive) {
+	printf ("httpd: response done, keeping connection\n");
+	httpd_cleanup ();
+	httpd_reset ();
+	STATE->served = 1;
+
+	/* Open the receive window again, pipelined requests were held
+	   back by the peer meanwhile. */
+	uip_restart ();
+	return;
+    }
+#endif	/* HTTPD_KEEPALIVE_SUPPORT */
+
+    uip_close ();
+}
+
+
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+/* Look for the end of the request header in the new data.  While at it,
+   decide whether the connection may be kept alive: the client has to speak
+   HTTP/1.1 and must not ask for "Connection: close".  Returns the number
+   of bytes behind the header in this segment. */
+static uint16_t
+httpd_scan_header (uint8_t first)
+{
+    char *ptr = uip_appdata;
+    char *end = ptr + uip_len;
+
+    while (ptr < end) {
+	char *line = ptr;
+	while (ptr < end && *ptr != '\n')
+	    ptr ++;
+	if (ptr == end)
+	    break;		/* Line continues in the next segment. */
+	ptr ++;
+
+	if (first) {
+	    first = 0;
+	    STATE->keepalive = ptr - line >= 10
+		&& strncmp_P (ptr - 10, PSTR ("HTTP/1.1\r\n"), 10) == 0;
+	}
+	else if (*line == '\r' || *line == '\n') {
+	    STATE->header_done = 1;
+	    return end - ptr;
+	}
+	else if (strncasecmp_P (line, PSTR ("Connection: close"), 17) == 0)
+	    STATE->keepalive = 0;
+    }
+
+    return 0;
+}
+
+
+/* Count the idle time of kept alive connections once a second.  If there
+   is no free connection slot left, those which have been served already are
+   closed with the next poll, new ones still get their first request. */
+void
+httpd_periodic (void)
+{
+#if UIP_CONNS <= 255
+    uint8_t i, slots = 0;
+#else
+    uint16_t i, slots = 0;
+#endif
+
+    for (i = 0; i < UIP_CONNS; i ++)
+	if (uip_conns[i].tcpstateflags == UIP_CLOSED
+	    || uip_conns[i].tcpstateflags == UIP_TIME_WAIT)
+	    slots ++;
+
+    for (i = 0; i < UIP_CONNS; i ++) {
+	struct httpd_connection_state_t *state = &uip_conns[i].appstate.httpd;
+
+	if (uip_conns[i].callback != httpd_main
+	    || uip_conns[i].tcpstateflags != UIP_ESTABLISHED
+	    || state->handler)
+	    continue;
+
+	if (slots == 0 && state->served)
+	    state->idle = HTTPD_KEEPALIVE_TIMEOUT;
+	else if (state->idle < HTTPD_KEEPALIVE_TIMEOUT)
+	    state->idle ++;
+    }
+}
+#endif	/* HTTPD_KEEPALIVE_SUPPORT */
+
+
+/* Find the request header starting with NAME in the current segment and
+   return a pointer behind it, or NULL.  Only the first segment of a
+   request is searched, a header sent in a later one is not found. */
+char *
+httpd_find_header (PGM_P name)
+{
+    uint8_t len = strlen_P (name);
+    char *ptr = uip_appdata;
+    char *end = ptr + uip_len;
+
+    while ((ptr = memchr (ptr, '\n', end - ptr))) {
+	ptr ++;
+	if (end - ptr <= len)
+	    break;
+	if (strncasecmp_P (ptr, name, len) == 0)
+	    return ptr + len;
+    }
+
+    return NULL;
 }
 
 
@@ -98,19 +236,38 @@ httpd_handle_input (void)
 
 #ifdef HTTPD_SOAP_SUPPORT
     if (strncasecmp_P (uip_appdata, PSTR ("POST /soap"), 10) == 0) {
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+      STATE->keepalive = 0;	/* The body is read until the peer closes. */
+#endif
       soap_initialize_context (&STATE->u.soap);
       STATE->handler = httpd_handle_soap;
       return;
     }
 #endif	/* HTTPD_SOAP_SUPPORT */
 
+#ifdef HTTPD_ETAG_SUPPORT
+    /* Look at the headers before the request line gets modified. */
+    char *tag = httpd_find_header (PSTR ("If-None-Match: \""));
+    uint32_t etag = tag ? strtoul (tag, NULL, 16) : 0;
+#endif
+
+    uint8_t post = 0;
+#ifdef HTTPD_ECMD_BATCH_SUPPORT
+    if (strncasecmp_P (uip_appdata, PSTR ("POST /" ECMD_INDEX " "), 11) == 0) {
+	/* Note the body's position before the header gets modified. */
+	if (!httpd_handle_ecmd_batch_setup ())
+	    return;
+	post = 1;
+    }
+    else
+#endif	/* HTTPD_ECMD_BATCH_SUPPORT */
     if (strncasecmp_P (uip_appdata, PSTR ("GET /"), 5)) {
 	printf ("httpd: received request is not GET.\n");
 	STATE->handler = httpd_handle_400;
 	return;
     }
 
-    char *filename = uip_appdata + 5; /* beyond slash */
+    char *filename = uip_appdata + 5 + post; /* beyond slash */
     ptr = strchr (filename, ' ');
 
     if (ptr == NULL) {
@@ -220,6 +377,13 @@ after_auth:
 
 
 
+#ifdef HTTPD_ECMD_BATCH_SUPPORT
+    if (post) {
+	STATE->handler = httpd_handle_ecmd_batch;
+	return;
+    }
+#endif	/* HTTPD_ECMD_BATCH_SUPPORT */
+
 #ifdef ECMD_PARSER_SUPPORT
     uint8_t offset = strlen_P(PSTR(ECMD_INDEX "?"));
     if (strncmp_P (filename, PSTR(ECMD_INDEX "?"), offset) == 0) {
@@ -238,6 +402,10 @@ after_auth:
 	STATE->u.vfs.content_type = *filename;
     }
 
+#ifdef HTTPD_ETAG_SUPPORT
+    STATE->u.vfs.etag = etag;
+#endif
+
     STATE->u.vfs.fd = vfs_open (filename);
     if (STATE->u.vfs.fd) {
       STATE->handler = httpd_handle_vfs;
@@ -268,6 +436,9 @@ after_auth:
 
 #ifdef HTTP_SD_DIR_SUPPORT
     if ((STATE->u.dir.handle = vfs_sd_chdir (filename - 1))) {
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+	STATE->keepalive = 0;	/* Listings have no Content-Length. */
+#endif
 	strncpy (STATE->u.dir.dirname, filename - 1, SD_DIR_MAX_DIRNAME_LEN);
 	STATE->u.dir.dirname[SD_DIR_MAX_DIRNAME_LEN - 1] = 0;
 	if (lastchar != '/') {
@@ -303,20 +474,44 @@ httpd_main(void)
 	printf ("httpd: new connection\n");
 
 	/* initialize struct */
-	STATE->handler = NULL;
-	STATE->header_acked = 0;
-	STATE->eof = 0;
-	STATE->header_reparse = 0;
-#ifdef HTTPD_AUTH_SUPPORT
-        STATE->auth_state = PAM_UNKOWN;
+	httpd_reset ();
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+	STATE->served = 0;
 #endif
     }
 
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    uint16_t trailing = 0;
+    if (uip_newdata() && !STATE->header_done)
+	trailing = httpd_scan_header (!STATE->handler && !STATE->header_reparse);
+#endif
+
     if (uip_newdata() && (!STATE->handler || STATE->header_reparse)) {
 	printf ("httpd: new data\n");
 	httpd_handle_input ();
     }
 
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    /* Hold back pipelined requests until this one is answered.  Anything
+       behind the header in the same segment is acknowledged already, but
+       there's no room to keep it, hence close after the response.
+       Handlers reading a request body take care of this themselves. */
+    if (uip_newdata() && STATE->header_done && STATE->keepalive
+	&& !STATE->body) {
+	if (trailing)
+	    STATE->keepalive = 0;
+	else
+	    uip_stop ();
+    }
+
+    if (uip_poll() && !STATE->handler
+	&& STATE->idle >= HTTPD_KEEPALIVE_TIMEOUT) {
+	printf ("httpd: closing idle connection\n");
+	uip_close ();
+	return;
+    }
+#endif	/* HTTPD_KEEPALIVE_SUPPORT */
+
 #ifdef HTTPD_AUTH_SUPPORT
     if (STATE->auth_state == PAM_DENIED && STATE->handler != httpd_handle_401) {
       httpd_cleanup();
@@ -344,6 +539,7 @@ httpd_main(void)
   -- Ethersex META --
   header(services/httpd/httpd.h)
   net_init(httpd_init)
+  ifdef(`conf_HTTPD_KEEPALIVE', `timer(50, httpd_periodic())')
 
   state_header(services/httpd/httpd_state.h)
   state_tcp(struct httpd_connection_state_t httpd)
@@ -37,6 +37,8 @@
 void httpd_init (void);
 void httpd_main (void);
 void httpd_cleanup (void);
+void httpd_done (void);
+void httpd_periodic (void);
 
 void httpd_handle_400 (void);
 void httpd_handle_401 (void);
@@ -50,10 +52,19 @@ void httpd_handle_soap (void);
 void httpd_handle_ecmd_setup (char *encoded_cmd);
 void httpd_handle_ecmd (void);
 
+uint8_t httpd_handle_ecmd_batch_setup (void);
+void httpd_handle_ecmd_batch_release (void);
+void httpd_handle_ecmd_batch (void);
+
+char *httpd_find_header (PGM_P name);
+
 PGM_P httpd_mimetype_detect (const uint8_t *);
 
 /* headers */
 extern const char httpd_header_200[];
+extern const char httpd_header_close[];
+extern const char httpd_header_chunked[];
+extern const char httpd_body_chunk_end[];
 extern const char httpd_header_ct_css[];
 extern const char httpd_header_ct_html[];
 extern const char httpd_header_ct_xhtml[];
@@ -63,12 +74,15 @@ extern const char httpd_header_ct_xicon[];
 #endif
 
 extern const char httpd_header_ecmd[];
+extern const char httpd_header_304[];
+extern const char httpd_header_etag[];
 extern const char httpd_header_400[];
 extern const char httpd_header_gzip[];
 extern const char httpd_header_401[];
 extern const char httpd_body_401[];
 extern const char httpd_body_400[];
 extern const char httpd_header_404[];
+extern const char httpd_header_503[];
 extern const char httpd_body_404[];
 extern const char httpd_header_length[];
 extern const char httpd_header_end[];
@@ -89,12 +103,24 @@ extern const char httpd_header_end[];
 				    PSTR ("%lu\n"), a)
 #endif
 
+#define PASTE_ETAG(a)     sprintf_P(uip_appdata + strlen(uip_appdata),	\
+				    httpd_header_etag, (uint32_t) (a),	\
+				    (uint32_t) HTTPD_CACHE_MAX_AGE)
+
 #define PASTE_LEN_P(a)    sprintf_P(uip_appdata + strlen(uip_appdata),	\
 				    PSTR ("%u\n"), strlen_P(a))
 
 /* FIXME maybe check uip_mss and emit warning on debugging console. */
 #define PASTE_SEND()    uip_send(uip_appdata, strlen(uip_appdata))
 
+/* Announce the end of the connection, unless it is kept alive. */
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+#  define PASTE_CONNECTION()	do { if (!STATE->keepalive)		\
+				       PASTE_P (httpd_header_close); } while (0)
+#else
+#  define PASTE_CONNECTION()	do { } while (0)
+#endif
+
 
 #define STATE (&uip_conn->appstate.httpd)
 
@@ -38,6 +38,19 @@ struct httpd_connection_state_t {
     unsigned header_acked		: 1;
     unsigned header_reparse		: 1;
     unsigned eof			: 1;
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    /* The empty line ending the request header has been received. */
+    unsigned header_done		: 1;
+    /* Keep the connection open for the next request after this one. */
+    unsigned keepalive			: 1;
+    /* The handler reads a request body. */
+    unsigned body			: 1;
+    /* At least one request has been answered. */
+    unsigned served			: 1;
+
+    /* Seconds spent waiting for the next request. */
+    uint8_t idle;
+#endif	/* HTTPD_KEEPALIVE_SUPPORT */
 
 #ifdef HTTPD_AUTH_SUPPORT
         uint8_t auth_state;
@@ -56,6 +69,11 @@ struct httpd_connection_state_t {
 	    unsigned char content_type;
 
 	    vfs_size_t acked, sent;
+
+#ifdef HTTPD_ETAG_SUPPORT
+	    /* Tag from the request's If-None-Match header, or 0. */
+	    uint32_t etag;
+#endif
 	} vfs;
 #endif	/* VFS_SUPPORT */
 
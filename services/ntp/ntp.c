@@ -35,6 +35,39 @@ static uip_udp_conn_t *ntp_conn = NULL;
 static uint8_t ntp_tries = 0;
 #endif
 
+/* Offsets and delays are kept as 16.16 fixed point seconds. */
+#define NTP_STEP        ((int32_t) NTP_STEP_THRESHOLD * 65536 / 1000)
+/* Answers with a clock further off are not measured, but set directly. */
+#define NTP_STEP_SECONDS 16384
+#define NTP_FILTER_LEN  8
+/* Poll quickly for a few times after start and after the clock was set,
+ * to fill the filter. */
+#define NTP_BURST       4
+#define NTP_BURST_INTERVAL 4
+/* Do not estimate the frequency from shorter intervals. */
+#define NTP_FLL_MIN     64
+/* ... nor from offsets beyond a minute */
+#define NTP_FLL_MAX     (64L << 16)
+
+struct ntp_sample
+{
+  int32_t offset;
+  int32_t delay;
+};
+
+/* Clock filter, the sample with the lowest delay is the most trustworthy
+ * as it suffered the least from asymmetric queueing. */
+static struct ntp_sample ntp_filter[NTP_FILTER_LEN];
+static uint8_t ntp_samples;
+static uint8_t ntp_used;
+static uint8_t ntp_burst = NTP_BURST;
+
+/* transmit timestamp of our last request, the server echoes it */
+static struct ntp_date_time ntp_xmt;
+#ifdef CLOCK_NTP_ADJUST_SUPPORT
+static timestamp_t ntp_last_update;
+#endif
+
 #ifdef DNS_SUPPORT
 void
 ntp_dns_query_cb(char *name, uip_ipaddr_t *ipaddr)
@@ -86,6 +119,61 @@ ntp_init()
 }
 
 
+static void
+ntp_timestamp(struct ntp_date_time *ts, timestamp_t t, uint16_t frac)
+{
+  ts->seconds = HTONL(t + JAN_1970);
+  ts->fraction = HTONL((uint32_t) frac << 16);
+}
+
+
+/* a - b as 16.16 fixed point, good for about nine hours */
+static int32_t
+ntp_diff(const struct ntp_date_time *a, const struct ntp_date_time *b)
+{
+  return ((NTOHL(a->seconds) - NTOHL(b->seconds)) << 16) +
+    (int32_t) (NTOHL(a->fraction) >> 16) -
+    (int32_t) (NTOHL(b->fraction) >> 16);
+}
+
+
+static void
+ntp_discipline(timestamp_t now, uint16_t frac, int32_t offset)
+{
+  uint8_t slew = (offset <= NTP_STEP && offset >= -NTP_STEP);
+
+#ifdef CLOCK_NTP_ADJUST_SUPPORT
+  int32_t left = slew ? clock_adjtime(offset) : 0;
+
+  /* What is left after the last slew accumulated over the interval, due
+   * to our clock running too fast or too slow. Correct a quarter of that
+   * per update, or all of it when it was large enough to be stepped. */
+  if (offset < NTP_FLL_MAX && offset > -NTP_FLL_MAX &&
+      ntp_last_update && now - ntp_last_update >= NTP_FLL_MIN)
+    clock_set_freq(clock_get_freq() + (offset - left) * (slew ? 64 : 256)
+                   / (int32_t) (now - ntp_last_update));
+  ntp_last_update = now;
+
+  if (slew)
+    return;
+#endif
+
+  /* step */
+  uint32_t f = (uint32_t) frac + (uint16_t) offset;
+  now += (offset >> 16) + (f >> 16);
+#ifdef DEBUG_NTP
+  debug_printf("NTP: Set new time: %lu\n", now);
+#endif
+  clock_set_time_frac(now, f);
+  ntp_samples = 0;
+  if (!slew)
+    ntp_burst = NTP_BURST;
+#ifdef CLOCK_NTP_ADJUST_SUPPORT
+  ntp_last_update = now;
+#endif
+}
+
+
 void
 ntp_send_packet(void)
 {
@@ -119,6 +207,11 @@ ntp_send_packet(void)
   pkt->rootdelay = HTONL(0x10000); /* 1 second */
   pkt->rootdispersion = HTONL(0x10000); /* 1 second */
 
+  uint16_t frac;
+  timestamp_t now = clock_get_time_frac(&frac);
+  ntp_timestamp(&ntp_xmt, now, frac);
+  pkt->xmt = ntp_xmt;
+
   /* push the packet out ... */
   uip_udp_conn = ntp_conn;
   uip_process(UIP_UDP_SEND_CONN);
@@ -134,17 +227,85 @@ ntp_newdata(void)
 {
   if (!uip_newdata ()) return;
 
-  uint32_t ntp_timestamp;
+  struct ntp_date_time rcv;
+  uint16_t frac;
+  timestamp_t now = clock_get_time_frac(&frac);
+  ntp_timestamp(&rcv, now, frac);
+
   struct ntp_packet *pkt = uip_appdata;
-  /* We must save an unix timestamp */
-  ntp_timestamp = NTOHL(pkt->rec.seconds) - JAN_1970;
 
+  /* Only accept server answers to our last request, and no kiss-o'-death
+   * or unsynchronized server. */
+  if ((pkt->li_vn_mode & 0x07) != 4 || (pkt->li_vn_mode & 0xc0) == 0xc0 ||
+      pkt->stratum == 0 ||
+      pkt->org.seconds != ntp_xmt.seconds ||
+      pkt->org.fraction != ntp_xmt.fraction)
+  {
 #ifdef DEBUG_NTP
-    debug_printf("NTP: Set new time: %lu\n",ntp_timestamp);
+    debug_printf("NTP: drop bogus answer\n");
+#endif
+    return;
+  }
+  ntp_xmt.seconds = 0;          /* no duplicates */
+
+  int32_t seconds = NTOHL(pkt->xmt.seconds) - NTOHL(rcv.seconds);
+  if (seconds > NTP_STEP_SECONDS || seconds < -NTP_STEP_SECONDS)
+  {
+    /* We must save an unix timestamp */
+    now = NTOHL(pkt->xmt.seconds) - JAN_1970;
+#ifdef DEBUG_NTP
+    debug_printf("NTP: Set new time: %lu\n", now);
+#endif
+    clock_set_time_frac(now, NTOHL(pkt->xmt.fraction) >> 16);
+    ntp_samples = 0;
+    ntp_burst = NTP_BURST;
+#ifdef CLOCK_NTP_ADJUST_SUPPORT
+    ntp_last_update = 0;
 #endif
-  clock_set_time(ntp_timestamp);
+  }
+  else
+  {
+    /* offset = ((T2 - T1) + (T3 - T4)) / 2, delay = (T4 - T1) - (T3 - T2) */
+    int32_t d21 = ntp_diff(&pkt->rec, &pkt->org);
+    int32_t d34 = ntp_diff(&pkt->xmt, &rcv);
+    struct ntp_sample *sample =
+      &ntp_filter[ntp_samples++ % NTP_FILTER_LEN];
+    sample->offset = (d21 + d34) / 2;
+    sample->delay = d21 - d34;
+    if (sample->delay < 0)
+      sample->delay = 0;
+    if (ntp_samples == 2 * NTP_FILTER_LEN)
+      ntp_samples = NTP_FILTER_LEN;
+
+    uint8_t best = 0;
+    uint8_t n = ntp_samples < NTP_FILTER_LEN ? ntp_samples : NTP_FILTER_LEN;
+    for (uint8_t i = 1; i < n; i++)
+      if (ntp_filter[i].delay < ntp_filter[best].delay)
+        best = i;
+
+    int32_t offset = ntp_filter[best].offset;
+#ifdef DEBUG_NTP
+    debug_printf("NTP: offset %ld delay %ld, filtered %ld\n",
+                 sample->offset, sample->delay, offset);
+#endif
+
+    /* each sample is used only once */
+    if (best != ntp_used || sample == &ntp_filter[best])
+    {
+      ntp_used = best;
+      ntp_discipline(now, frac, offset);
+    }
+  }
+
   set_dcf_count(0);
   set_ntp_count(1);
+  if (ntp_burst)
+  {
+    ntp_burst--;
+    set_ntp_timer(NTP_BURST_INTERVAL);
+  }
+  else
+    set_ntp_timer(NTP_QUERY_INTERVAL);
 #ifdef NTPD_SUPPORT
   ntp_setstratum(pkt->stratum);
 #endif
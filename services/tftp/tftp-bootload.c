@@ -27,6 +27,7 @@
 #include <util/atomic.h>
 
 #include "protocols/uip/uip.h"
+#include "protocols/uip/uip_router.h"
 #include "core/eeprom.h"
 #include "core/mbr.h"
 #include "core/debug.h"
@@ -49,7 +50,6 @@
 #undef SPM_PAGESIZE
 #define SPM_PAGESIZE 256
 #endif
-#define TFTP_BLOCK_SIZE 512
 #if FLASHEND > UINT16_MAX
 typedef uint32_t flash_base_t;
 #define __pgm_read_byte pgm_read_byte_far
@@ -98,6 +98,7 @@ commit_changes:
 void
 tftp_handle_packet(void)
 {
+  struct tftp_connection_state_t *state = &uip_udp_conn->appstate.tftp;
   /*
    * overwrite udp connection information (i.e. take from incoming packet)
    */
@@ -107,9 +108,12 @@ tftp_handle_packet(void)
   /*
    * care for incoming tftp packet now ...
    */
-  uint16_t i;
+  uint16_t i, block;
   flash_base_t base;
   struct tftp_hdr *pk = uip_appdata;
+#ifdef TFTP_OPTIONS_SUPPORT
+  uint8_t opts;
+#endif
 
   switch (HTONS(pk->type))
   {
@@ -118,53 +122,82 @@ tftp_handle_packet(void)
        * streaming data back to the client (upload) ...
        */
     case 1:                             /* read request */
-      uip_udp_conn->appstate.tftp.download = 1;
-      uip_udp_conn->appstate.tftp.transfered = 0;
-      uip_udp_conn->appstate.tftp.finished = 0;
+      state->download = 1;
+      state->transfered = 0;
+      state->sent = 0;
+      state->finished = 0;
+      state->blksize = TFTP_DEFAULT_BLKSIZE;
+      state->windowsize = 1;
 
       bootload_delay = 0;               /* stop bootloader. */
+#ifdef TFTP_OPTIONS_SUPPORT
+      opts = tftp_parse_options(state, pk->u.raw, 2, TFTP_MAX_BLKSIZE);
+
+      /* tftp_flush() needs a link that copies the block right away */
+      if (!router_output_sync(&uip_udp_conn->ripaddr))
+        state->windowsize = 1;
+
+      if (opts)
+      {
+        /* the client acks the OACK with block 0 */
+        uip_udp_send(tftp_oack(state, opts));
+        break;
+      }
+#endif
       goto send_data;
 
     case 4:                             /* acknowledgement */
-      if (uip_udp_conn->appstate.tftp.download != 1)
+      if (state->download != 1)
         goto error_out;
 
-      if (HTONS(pk->u.ack.block) < uip_udp_conn->appstate.tftp.transfered
-          || (HTONS(pk->u.ack.block)
-              > uip_udp_conn->appstate.tftp.transfered + 1))
-        goto error_out;                 /* ack out of order */
+      block = HTONS(pk->u.ack.block);
+      if (block < state->transfered || block > state->sent)
+        break;                          /* stale ack of an earlier window */
 
-      uip_udp_conn->appstate.tftp.transfered = HTONS(pk->u.ack.block);
+      state->transfered = block;
+      if (block != state->sent)
+      {
+        /* client lost a block, resend the window from there */
+        state->sent = block;
+        state->finished = 0;
+      }
     send_data:
-      if (uip_udp_conn->appstate.tftp.finished)
+      if (state->finished)
       {
         bootload_delay = CONF_BOOTLOAD_DELAY;   /* restart bootloader. */
         return;                         /* nothing more to do */
       }
 
-      pk->type = HTONS(3);              /* data packet */
-      pk->u.data.block = HTONS(uip_udp_conn->appstate.tftp.transfered + 1);
+      for (;;)
+      {
+        pk->type = HTONS(3);            /* data packet */
+        pk->u.data.block = HTONS(state->sent + 1);
 
-      base = (flash_base_t) TFTP_BLOCK_SIZE *
-        (flash_base_t) (uip_udp_conn->appstate.tftp.transfered);
+        base = (flash_base_t) state->blksize * (flash_base_t) state->sent;
+        state->sent++;
 
-      /* base overflowed ! */
+        /* base overflowed ! */
 #if FLASHEND == UINT16_MAX
-      if (uip_udp_conn->appstate.tftp.transfered && base == 0)
+        if (state->sent > 1 && base == 0)
 #else
-      if (base > FLASHEND)
+        if (base > FLASHEND)
 #endif
-      {
-        uip_udp_send(4);        /* send empty packet to finish transfer */
-        uip_udp_conn->appstate.tftp.finished = 1;
-        return;
-      }
+        {
+          uip_udp_send(4);      /* send empty packet to finish transfer */
+          state->finished = 1;
+          return;
+        }
+
+        for (i = 0; i < state->blksize; i++)
+          pk->u.data.data[i] = __pgm_read_byte(base + i);
+
+        uip_udp_send(4 + state->blksize);
 
-      for (i = 0; i < TFTP_BLOCK_SIZE; i++)
-        pk->u.data.data[i] = __pgm_read_byte(base + i);
+        if (state->sent - state->transfered >= state->windowsize)
+          break;
 
-      uip_udp_send(4 + TFTP_BLOCK_SIZE);
-      uip_udp_conn->appstate.tftp.transfered++;
+        tftp_flush();
+      }
       break;
 #endif /* TFTP_UPLOAD_SUPPORT */
 
@@ -172,50 +205,91 @@ tftp_handle_packet(void)
        * streaming data from the client (firmware download) ...
        */
     case 2:                             /* write request */
-      uip_udp_conn->appstate.tftp.download = 0;
-      uip_udp_conn->appstate.tftp.transfered = 0;
-      uip_udp_conn->appstate.tftp.finished = 0;
+      state->download = 0;
+      state->transfered = 0;
+      state->sent = 0;
+      state->finished = 0;
+      state->nak = 0;
+      state->blksize = TFTP_DEFAULT_BLKSIZE;
+      state->windowsize = 1;
+
+#ifdef TFTP_OPTIONS_SUPPORT
+      opts = tftp_parse_options(state, pk->u.raw, 2, TFTP_FLASH_BLKSIZE);
+      if (state->blksize % SPM_PAGESIZE)
+      {
+        /* decline, we can only flash whole pages */
+        state->blksize = TFTP_DEFAULT_BLKSIZE;
+        opts &= ~TFTP_OPT_BLKSIZE;
+      }
+      if (opts)
+      {
+        /* the OACK replaces the ack of block 0 */
+        uip_udp_send(tftp_oack(state, opts));
+        break;
+      }
+#endif
 
       pk->u.ack.block = HTONS(0);
       goto send_ack;
 
+#ifdef TFTP_OPTIONS_SUPPORT
+    case 6:                             /* option acknowledgement */
+      /* the server accepted (some of) the options of our read request */
+      if (state->download != 0 || state->transfered != 0)
+        goto error_out;
+
+      tftp_parse_options(state, pk->u.raw, 0, TFTP_FLASH_BLKSIZE);
+      if (state->blksize % SPM_PAGESIZE)
+        goto error_out;                 /* can't flash that */
+
+      pk->u.ack.block = HTONS(0);
+      goto send_ack;
+#endif
+
     case 3:                             /* data packet */
       bootload_delay = 0;               /* stop bootloader. */
 
-      if (uip_udp_conn->appstate.tftp.download != 0)
+      if (state->download != 0)
         goto error_out;
 
-      if (HTONS(pk->u.ack.block) < uip_udp_conn->appstate.tftp.transfered)
-        goto error_out;                 /* too early */
+      block = HTONS(pk->u.data.block);
 
-      if (HTONS(pk->u.ack.block) == uip_udp_conn->appstate.tftp.transfered)
+      if (block == state->transfered)
         goto send_ack;                  /* already handled */
 
-      if (HTONS(pk->u.ack.block) > uip_udp_conn->appstate.tftp.transfered + 1)
-        goto error_out;                 /* too late */
+      if (block != state->transfered + 1)
+      {
+        if (block < state->transfered || state->nak)
+          return;                       /* rest of a window, drop it */
+
+        /* a block got lost, make the sender restart the window
+         * after the last one we have */
+        state->nak = 1;
+        pk->u.ack.block = HTONS(state->transfered);
+        goto send_ack;
+      }
 
-      base = (flash_base_t) TFTP_BLOCK_SIZE *
-        (flash_base_t) (HTONS(pk->u.ack.block) - 1);
+      base = (flash_base_t) state->blksize * (flash_base_t) (block - 1);
 
-      for (i = uip_datalen() - 4; i < TFTP_BLOCK_SIZE; i++)
+      for (i = uip_datalen() - 4; i < state->blksize; i++)
         pk->u.data.data[i] = 0xFF;      /* EOF reached, init rest */
 
       debug_putchar('.');
 
 #ifdef TFTP_CRC_SUPPORT
       /* only flash when we are receiving an application binary */
-      if (!uip_udp_conn->appstate.tftp.verify_crc)
+      if (!state->verify_crc)
 #endif
       {
-        for (i = 0; i < TFTP_BLOCK_SIZE / SPM_PAGESIZE; i++)
+        for (i = 0; i < state->blksize / SPM_PAGESIZE; i++)
           flash_page(base + i * SPM_PAGESIZE,
               pk->u.data.data + i * SPM_PAGESIZE);
       }
 
       /* last packet in sequence */
-      if (uip_datalen() < TFTP_BLOCK_SIZE + 4)
+      if (uip_datalen() < state->blksize + 4)
       {
-        uip_udp_conn->appstate.tftp.finished = 1;
+        state->finished = 1;
 
 #ifdef TFTP_CRC_SUPPORT
         if (status.verify_tftp_crc_content)
@@ -231,7 +305,7 @@ tftp_handle_packet(void)
         }
         else
         {
-          if (uip_udp_conn->appstate.tftp.verify_crc)
+          if (state->verify_crc)
           {
             debug_putstr("\nCRC OK\n");
           }
@@ -251,10 +325,17 @@ tftp_handle_packet(void)
                                          * then start app */
       }
 
-      uip_udp_conn->appstate.tftp.transfered = HTONS(pk->u.ack.block);
+      state->transfered = block;
+      state->nak = 0;
+
+      /* ack at the end of every window and the last block */
+      if (!state->finished
+          && state->transfered - state->sent < state->windowsize)
+        return;
 
     /* send ack */
     send_ack:
+      state->sent = state->transfered;
       pk->type = HTONS(4);
       uip_udp_send(4);
       break;
@@ -269,12 +350,12 @@ tftp_handle_packet(void)
       uip_udp_send(7);
 
 #ifdef TFTP_CRC_SUPPORT
-      if(uip_udp_conn->appstate.tftp.verify_crc)
+      if(state->verify_crc)
         /* there was no matching crc file on the tftp server.
          * so we will try to get the application binary.
          * the initial request connection should already be unbound. */
         tftp_fire_tftpomatic(&uip_udp_conn->ripaddr,
-            uip_udp_conn->appstate.tftp.filename, 0);
+            state->filename, 0);
 #endif
   }
 }
@@ -53,6 +53,10 @@ tftp_handle_packet(void)
    * care for incoming tftp packet now ...
    */
   struct tftp_hdr *pk = uip_appdata;
+  uint16_t block;
+#ifdef TFTP_OPTIONS_SUPPORT
+  uint8_t opts;
+#endif
 
   switch (HTONS(pk->type))
   {
@@ -62,41 +66,82 @@ tftp_handle_packet(void)
     case 1:                    /* read request */
       state->download = 1;
       state->transfered = 0;
+      state->sent = 0;
       state->finished = 0;
+      state->blksize = TFTP_DEFAULT_BLKSIZE;
+      state->windowsize = 1;
 
+      if (state->fh)
+        vfs_close(state->fh);   /* request retransmitted */
       state->fh = vfs_open(pk->u.raw);
       if (state->fh == NULL)
         goto error_out;
 
+#ifdef TFTP_OPTIONS_SUPPORT
+      opts = tftp_parse_options(state, pk->u.raw, 2, TFTP_MAX_BLKSIZE);
+
+      /* the blocks of a window are built in uip_buf one after the
+       * other, links which send from there later get one at a time */
+      if (!router_output_sync(&uip_udp_conn->ripaddr))
+        state->windowsize = 1;
+
+      if (opts)
+      {
+        /* the client acks the OACK with block 0 */
+        uip_udp_send(tftp_oack(state, opts));
+        break;
+      }
+#endif
       goto send_data;
 
     case 4:                    /* acknowledgement */
       if (state->download != 1)
         goto error_out;
 
-      if (HTONS(pk->u.ack.block) < state->transfered
-          || (HTONS(pk->u.ack.block) > state->transfered + 1))
-        goto error_out;         /* ack out of order */
+      block = HTONS(pk->u.ack.block);
+      if (block < state->transfered || block > state->sent)
+        break;                  /* stale ack of an earlier window */
 
-      state->transfered = HTONS(pk->u.ack.block);
+      state->transfered = block;
+
+      if (block != state->sent)
+      {
+        /* client lost a block, resend the window from there */
+        if (vfs_fseek(state->fh, (vfs_size_t) block * state->blksize,
+                      SEEK_SET))
+          goto error_out;
+        state->sent = block;
+        state->finished = 0;
+      }
 
     send_data:
       if (state->finished)
         goto close_connection;
 
-      pk->type = HTONS(3);      /* data packet */
-      pk->u.data.block = HTONS(state->transfered + 1);
+      for (;;)
+      {
+        pk->type = HTONS(3);    /* data packet */
+        pk->u.data.block = HTONS(state->sent + 1);
 
-      fs_size_t ret = vfs_read(state->fh, pk->u.data.data, 512);
+        vfs_size_t ret = vfs_read(state->fh, pk->u.data.data,
+                                  state->blksize);
 
-      if (ret < 0)
-        goto error_out;
+        if (ret == (vfs_size_t) -1)
+          goto error_out;       /* read error */
 
-      if (ret < 512)
-        state->finished = 1;
+        if (ret < state->blksize)
+          state->finished = 1;
+
+        uip_udp_send(4 + ret);
+        state->sent++;
+
+        if (state->finished
+            || state->sent - state->transfered >= state->windowsize)
+          break;
 
-      uip_udp_send(4 + ret);
-      state->transfered++;
+        /* file is read sequentially, no seek between the blocks */
+        tftp_flush();
+      }
       break;
 
       /*
@@ -105,15 +150,33 @@ tftp_handle_packet(void)
     case 2:                    /* write request */
       state->download = 0;
       state->transfered = 0;
+      state->sent = 0;
       state->finished = 0;
+      state->nak = 0;
+      state->blksize = TFTP_DEFAULT_BLKSIZE;
+      state->windowsize = 1;
 
-      state->fh = vfs_open_or_creat(pk->u.raw);
+      if (state->fh)
+        vfs_close(state->fh);   /* request retransmitted */
+      state->fh = vfs_open(pk->u.raw);
+      if (state->fh == NULL)
+        state->fh = vfs_creat(pk->u.raw);
       if (state->fh == NULL)
         goto error_out;
 
-      if (vfs_truncate (&fh, 0));
+      if (vfs_truncate(state->fh, 0))
         goto error_out;
 
+#ifdef TFTP_OPTIONS_SUPPORT
+      opts = tftp_parse_options(state, pk->u.raw, 2, TFTP_MAX_BLKSIZE);
+      if (opts)
+      {
+        /* the OACK replaces the ack of block 0 */
+        uip_udp_send(tftp_oack(state, opts));
+        break;
+      }
+#endif
+
       pk->u.ack.block = HTONS(0);
       goto send_ack;
 
@@ -121,24 +184,42 @@ tftp_handle_packet(void)
       if (state->download != 0)
         goto error_out;
 
-      if (HTONS(pk->u.ack.block) < state->transfered)
-        goto error_out;         /* too early */
+      block = HTONS(pk->u.data.block);
 
-      if (HTONS(pk->u.ack.block) == state->transfered)
+      if (block == state->transfered)
         goto send_ack;          /* already handled */
 
-      if (HTONS(pk->u.ack.block) > state->transfered + 1)
-        goto error_out;         /* too late */
+      if (block != state->transfered + 1)
+      {
+        if (block < state->transfered || state->nak)
+          break;                /* rest of a window, drop it */
+
+        /* a block got lost, make the sender restart the window
+         * after the last one we have */
+        state->nak = 1;
+        pk->u.ack.block = HTONS(state->transfered);
+        goto send_ack;
+      }
 
-      if (vfs_write(state->fh, pk->u.data.data, uip_datalen() - 4) <= 0)
+      /* only in order blocks are written, so the file grows
+       * sequentially without seeking */
+      if (uip_datalen() > 4
+          && vfs_write(state->fh, pk->u.data.data, uip_datalen() - 4) <= 0)
         goto error_out;
 
-      if (uip_datalen() < 512 + 4)
+      if (uip_datalen() < state->blksize + 4)
         state->finished = 1;
 
-      state->transfered = HTONS(pk->u.ack.block);
+      state->transfered = block;
+      state->nak = 0;
+
+      /* ack at the end of every window and the last block */
+      if (!state->finished
+          && state->transfered - state->sent < state->windowsize)
+        break;
 
     send_ack:
+      state->sent = state->transfered;
       pk->type = HTONS(4);
       uip_udp_send(4);          /* send ack */
 
@@ -159,15 +240,9 @@ tftp_handle_packet(void)
       uip_udp_send(5);
 
     close_connection:
-      if (uip_slen)
-      {
-        /* there's still data that has to be sent,
-         * push it immediately. */
-        uip_process(UIP_UDP_SEND_CONN);
-        router_output();
-
-        uip_slen = 0;           /* don't send twice. */
-      }
+      /* there's still data that has to be sent,
+       * push it immediately. */
+      tftp_flush();
 
       /* Reset connection. */
       uip_ipaddr_copy(uip_udp_conn->ripaddr, all_ones_addr);
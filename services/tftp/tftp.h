@@ -56,8 +56,28 @@ struct tftp_hdr
 };
 
 
+#define TFTP_DEFAULT_BLKSIZE   512
+/* largest block that fits into uip_buf */
+#define TFTP_MAX_BLKSIZE       (UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPUDPH_LEN - 4)
+
+/* firmware blocks are flashed in whole pages */
+#define TFTP_FLASH_BLKSIZE     (TFTP_MAX_BLKSIZE / SPM_PAGESIZE * SPM_PAGESIZE)
+
+/* option flags, see RFC 2347, 2348 and 7440 */
+#define TFTP_OPT_BLKSIZE       1
+#define TFTP_OPT_WINDOWSIZE    2
+
+struct tftp_connection_state_t;
+
 /* prototypes */
 void tftp_handle_packet(void);
+void tftp_flush(void);
+
+#ifdef TFTP_OPTIONS_SUPPORT
+uint8_t tftp_parse_options(struct tftp_connection_state_t *state,
+                           char *opt, uint8_t skip, uint16_t max_blksize);
+uint16_t tftp_oack(struct tftp_connection_state_t *state, uint8_t opts);
+#endif
 
 
 #if defined(BOOTLOADER_SUPPORT)  \
@@ -120,6 +140,9 @@ __tftp_fire_tftpomatic(uip_ipaddr_t * ip, const char *filename)
   tftp_recv_conn->appstate.tftp.download = 0;
   tftp_recv_conn->appstate.tftp.transfered = 0;
   tftp_recv_conn->appstate.tftp.finished = 0;
+  tftp_recv_conn->appstate.tftp.sent = 0;
+  tftp_recv_conn->appstate.tftp.blksize = TFTP_DEFAULT_BLKSIZE;
+  tftp_recv_conn->appstate.tftp.windowsize = 1;
   tftp_recv_conn->appstate.tftp.bootp_image = 1;
 #ifdef TFTP_CRC_SUPPORT
   tftp_recv_conn->appstate.tftp.verify_crc = verify_crc && tag_found;
@@ -20,8 +20,11 @@
  */
 
 #include <avr/pgmspace.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "protocols/uip/uip.h"
+#include "protocols/uip/uip_router.h"
 #include "tftp.h"
 #include "tftp_net.h"
 #include "tftp_state.h"
@@ -56,6 +59,98 @@ tftp_net_init(void)
 }
 
 
+/* Push out the packet prepared in uip_appdata right away, so the next
+ * one of a window can be built in its place.  The link must have copied
+ * it by then (router_output_sync()), otherwise the window is 1. */
+void
+tftp_flush(void)
+{
+  if (!uip_slen)
+    return;
+
+  uip_process(UIP_UDP_SEND_CONN);
+  router_output();
+
+  uip_slen = 0;                 /* don't send twice. */
+}
+
+
+#ifdef TFTP_OPTIONS_SUPPORT
+/* Parse the NUL separated name/value pairs at OPT, after skipping SKIP
+ * strings (filename and mode of a request), and update blksize and
+ * windowsize of STATE.  Returns the TFTP_OPT_* flags of the accepted
+ * options. */
+uint8_t
+tftp_parse_options(struct tftp_connection_state_t *state, char *opt,
+                   uint8_t skip, uint16_t max_blksize)
+{
+  char *end = (char *) uip_appdata + uip_datalen();
+  uint8_t opts = 0;
+
+  while (opt < end)
+  {
+    char *val = memchr(opt, 0, end - opt);
+    if (!val++)
+      break;                    /* truncated */
+    if (skip)
+    {
+      skip--;
+      opt = val;
+      continue;
+    }
+    if (!memchr(val, 0, end - val))
+      break;
+
+    uint32_t v = strtoul(val, NULL, 10);
+
+    if (strcasecmp_P(opt, PSTR("blksize")) == 0 && v >= 8)
+    {
+      state->blksize = v > max_blksize ? max_blksize : v;
+      opts |= TFTP_OPT_BLKSIZE;
+    }
+    else if (strcasecmp_P(opt, PSTR("windowsize")) == 0 && v >= 1)
+    {
+      state->windowsize = v > TFTP_WINDOWSIZE ? TFTP_WINDOWSIZE : v;
+      opts |= TFTP_OPT_WINDOWSIZE;
+    }
+
+    opt = val + strlen(val) + 1;
+  }
+
+  return opts;
+}
+
+
+/* Write an option acknowledgement for OPTS to uip_appdata,
+ * returns its length. */
+uint16_t
+tftp_oack(struct tftp_connection_state_t *state, uint8_t opts)
+{
+  struct tftp_hdr *pk = uip_appdata;
+  char *p = pk->u.raw;
+
+  pk->type = HTONS(6);          /* option acknowledgement */
+
+  if (opts & TFTP_OPT_BLKSIZE)
+  {
+    strcpy_P(p, PSTR("blksize"));
+    p += 8;
+    utoa(state->blksize, p, 10);
+    p += strlen(p) + 1;
+  }
+  if (opts & TFTP_OPT_WINDOWSIZE)
+  {
+    strcpy_P(p, PSTR("windowsize"));
+    p += 11;
+    utoa(state->windowsize, p, 10);
+    p += strlen(p) + 1;
+  }
+
+  return p - (char *) uip_appdata;
+}
+#endif /* TFTP_OPTIONS_SUPPORT */
+
+
 void
 tftp_net_main(void)
 {
@@ -180,7 +275,19 @@ tftp_net_main(void)
   tftp_pk->u.raw[l++] = 't';
   tftp_pk->u.raw[l++] = '\0';
 
-  uip_udp_send(l + 9);
+#ifdef TFTP_OPTIONS_SUPPORT
+  /* ask for full pages and a window, the server may decline both */
+  strcpy_P(&tftp_pk->u.raw[l], PSTR("blksize"));
+  l += 8;
+  utoa(TFTP_FLASH_BLKSIZE, &tftp_pk->u.raw[l], 10);
+  l += strlen(&tftp_pk->u.raw[l]) + 1;
+  strcpy_P(&tftp_pk->u.raw[l], PSTR("windowsize"));
+  l += 11;
+  utoa(TFTP_WINDOWSIZE, &tftp_pk->u.raw[l], 10);
+  l += strlen(&tftp_pk->u.raw[l]) + 1;
+#endif
+
+  uip_udp_send(l + 2);
 
   /* uip_udp_conn->appstate.tftp.fire_req = 0; */
 
@@ -33,6 +33,7 @@ struct tftp_connection_state_t
 #endif
   unsigned download:1;
   unsigned finished:1;
+  unsigned nak:1;               /* acked a gap, wait for the sender */
 
 #ifdef BOOTLOADER_SUPPORT
   unsigned bootp_image:1;       // FIXME is this of any use?
@@ -47,6 +48,10 @@ struct tftp_connection_state_t
 #endif
 
   uint16_t transfered;          /* also retry countdown */
+  uint16_t sent;                /* last block sent (download) or
+                                 * acknowledged (upload) */
+  uint16_t blksize;
+  uint8_t windowsize;
 };
 
 #endif /* TFTP_STATE_H */
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Checks clock_datetime(), clock_localtime() and clock_mktime() against the
+   C library over the whole range of timestamp_t.  Every second is run
+   through the incremental path, every day through the full conversion. */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "services/clock/clock_lib.h"
+
+/* The default zone of the clock configuration, see services/clock/config.in */
+#define TEST_TZ "CET-1CEST,M3.5.0/2,M10.5.0/3"
+
+static unsigned long failures;
+
+static void
+check (const char *what, timestamp_t t, const clock_datetime_t *d,
+       const struct tm *tm)
+{
+  if (d->sec == tm->tm_sec && d->min == tm->tm_min
+      && d->hour == tm->tm_hour && d->day == tm->tm_mday
+      && d->month == tm->tm_mon + 1 && d->year == tm->tm_year
+      && d->dow == tm->tm_wday && d->yday == tm->tm_yday
+      && d->isdst == tm->tm_isdst)
+    return;
+
+  if (failures ++ < 10)
+    printf ("%s(%lu): %02u.%02u.%u %02u:%02u:%02u dow %u yday %u dst %d, "
+	    "expected %02d.%02d.%d %02d:%02d:%02d dow %d yday %d dst %d\n",
+	    what, (unsigned long) t, d->day, d->month, d->year + 1900,
+	    d->hour, d->min, d->sec, d->dow, d->yday, d->isdst,
+	    tm->tm_mday, tm->tm_mon + 1, tm->tm_year + 1900, tm->tm_hour,
+	    tm->tm_min, tm->tm_sec, tm->tm_wday, tm->tm_yday, tm->tm_isdst);
+}
+
+static void
+check_utc (const char *what, timestamp_t t, const clock_datetime_t *d)
+{
+  time_t tt = t;
+  struct tm tm;
+  gmtime_r (&tt, &tm);
+  check (what, t, d, &tm);
+}
+
+/* Every day, at a different second each, so the cache never steps. */
+static void
+test_compute (void)
+{
+  clock_datetime_t d;
+
+  for (uint32_t day = 0; day <= UINT32_MAX / 86400; day ++) {
+    uint64_t t64 = day * 86400ULL + (day * 7919) % 86400;
+    timestamp_t t = t64 > UINT32_MAX ? UINT32_MAX : t64;
+
+    clock_datetime (&d, t);
+    check_utc ("clock_datetime", t, &d);
+
+    d.hour = d.min = d.sec = 0;
+    if (clock_mktime (&d, 0) != day * 86400 && failures ++ < 10)
+      printf ("clock_mktime(%02u.%02u.%u) = %lu, expected %lu\n",
+	      d.day, d.month, d.year + 1900,
+	      (unsigned long) clock_mktime (&d, 0),
+	      (unsigned long) day * 86400);
+  }
+}
+
+/* Every second in a row, compared in full once a minute. */
+static void
+test_step (void)
+{
+  clock_datetime_t d, minute = { 0 };
+  timestamp_t t = 0;
+
+  do {
+    clock_datetime (&d, t);
+    if (d.sec == 0) {
+      check_utc ("clock_datetime", t, &d);
+      minute = d;
+    }
+    else {
+      minute.sec = t % 60;
+      if (d.sec != minute.sec || d.min != minute.min
+	  || d.hour != minute.hour || d.day != minute.day
+	  || d.month != minute.month || d.year != minute.year
+	  || d.dow != minute.dow || d.yday != minute.yday)
+	check_utc ("clock_datetime", t, &d);
+    }
+  } while (++ t != 0);
+}
+
+/* Both sides of every full hour, which includes all DST changes. */
+static void
+test_local (void)
+{
+  clock_datetime_t d;
+  struct tm tm;
+
+  setenv ("TZ", TEST_TZ, 1);
+  tzset ();
+
+  for (timestamp_t t = 3600; t < UINT32_MAX - 2 * 3600; t += 3600) {
+    for (timestamp_t s = t - 1; s <= t; s ++) {
+      time_t tt = s;
+      clock_localtime (&d, s);
+      localtime_r (&tt, &tm);
+      check ("clock_localtime", s, &d, &tm);
+    }
+  }
+}
+
+int
+main (void)
+{
+  test_compute ();
+  test_local ();
+  test_step ();
+
+  if (failures) {
+    printf ("clock_lib: %lu failures\n", failures);
+    return 1;
+  }
+  return 0;
+}
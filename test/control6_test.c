@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+
+
+/* The lookup of the ECMD variables of control6, with the C code the
+   Makefile generates from control6_test.src through the control6 m4.
+   control6_find() must return the same as a linear search over
+   c6_ecmd_vars, for every variable and for names that aren't, and the
+   hash chains m4 computed must hold every variable once, in the bucket
+   of the hash of its name as computed here.  "c6 set" must wake the
+   thread waiting for the variable. */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "control6.c"
+
+static unsigned failures;
+
+#define expect(cond) do { if (!(cond)) { \
+  printf ("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+  failures ++; } } while (0)
+
+#define VARS	(sizeof (c6_ecmd_vars) / sizeof (c6_ecmd_vars[0]))
+#define BUCKETS	(sizeof (c6_ecmd_head) / sizeof (c6_ecmd_head[0]))
+
+int
+snprintf_P (char *buf, int len, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  va_start (ap, fmt);
+  n = vsnprintf (buf, len, fmt, ap);
+  va_end (ap);
+  return n;
+}
+
+static uint8_t
+linear_find (const char *name)
+{
+  for (uint8_t i = 0; i < VARS; i ++)
+    if (strcmp (name, c6_ecmd_vars[i].name) == 0)
+      return i;
+  return 255;
+}
+
+static unsigned lookups;
+
+static void
+check (const char *name)
+{
+  lookups ++;
+  if (control6_find (name) != linear_find (name))
+    {
+      printf ("control6_find (\"%s\") is %u, not %u\n", name,
+	      control6_find (name), linear_find (name));
+      failures ++;
+    }
+}
+
+static const char chars[] =
+  "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+
+static int16_t
+ecmd (char *line)
+{
+  char output[32];
+
+  if (strncmp (line, "get ", 4) == 0)
+    return parse_cmd_c6_get (line + 4, output, sizeof (output));
+  return parse_cmd_c6_set (line + 4, output, sizeof (output));
+}
+
+int
+main (void)
+{
+  char name[64];
+  unsigned chained = 0, longest = 0;
+  struct c6_vario_type value;
+
+  /* The chains */
+  for (unsigned b = 0; b < BUCKETS; b ++)
+    {
+      unsigned len = 0;
+      for (uint8_t i = c6_ecmd_head[b]; i != 255; i = c6_ecmd_next[i])
+	{
+	  uint16_t hash = 0;
+	  for (const char *p = c6_ecmd_vars[i].name; *p; p ++)
+	    hash = hash * 33 + (uint8_t) *p;
+	  expect (hash % BUCKETS == b);
+	  if (++ len > VARS)
+	    break;
+	}
+      chained += len;
+      if (len > longest)
+	longest = len;
+    }
+  expect (chained == VARS);
+
+  /* Every variable, and its name changed a bit */
+  for (unsigned i = 0; i < VARS; i ++)
+    {
+      size_t len = strlen (c6_ecmd_vars[i].name);
+
+      strcpy (name, c6_ecmd_vars[i].name);
+      check (name);
+      expect (control6_find (name) == i);
+
+      name[len - 1] = 0;
+      check (name);
+      name[len - 1] = c6_ecmd_vars[i].name[len - 1];
+      strcpy (name + len, "s");
+      check (name);
+      name[0] ^= 0x20;
+      name[len] = 0;
+      check (name);
+    }
+
+  /* All names of up to three characters */
+  check ("");
+  for (int a = 0; chars[a]; a ++)
+    for (int b = -1; b < 0 || chars[b]; b ++)
+      for (int c = -1; c < 0 || chars[c]; c ++)
+	{
+	  char *p = name;
+	  *p ++ = chars[a];
+	  if (b >= 0)
+	    *p ++ = chars[b];
+	  if (c >= 0)
+	    *p ++ = chars[c];
+	  *p = 0;
+	  check (name);
+	}
+
+  /* ECMD access, and the thread waiting for temp > limit */
+  control6_init ();
+  control6_run ();
+  control6_run ();
+  expect (control6_get ("mode", &value) && value.data.d_uint8_t == 0);
+  expect (ecmd (strcpy (name, "get nosuchvar")) == ECMD_ERR_PARSE_ERROR);
+  expect (ecmd (strcpy (name, "set x_y -128")) == ECMD_FINAL_OK);
+  expect (control6_get ("x_y", &value) && value.data.d_int8_t == -128);
+  expect (ecmd (strcpy (name, "set temp 301")) == ECMD_FINAL_OK);
+  control6_wakeup ();
+  expect (control6_get ("mode", &value) && value.data.d_uint8_t == 1);
+
+  if (failures)
+    {
+      printf ("control6_test: %u failures\n", failures);
+      return 1;
+    }
+
+  printf ("  %u variables in %u buckets, longest chain %u, %u lookups\n",
+	  (unsigned) VARS, (unsigned) BUCKETS, longest, lookups);
+  return 0;
+}
@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+
+
+/* Drives dc3840.c against a model of the camera, byte by byte.  The
+   bytes written to the USART are parsed as commands, the camera's
+   replies come into the RX interrupt at 921600 baud while the simulated
+   time goes on, either in the delays of the driver or between two
+   passes of the mainloop.  The image is downloaded to a fake 23K256
+   and must come out of it unchanged.  A mainloop too slow for the ring
+   must make the driver request the picture again, a camera that stops
+   sending must be given up on. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+#include <avr/io.h>
+#include <util/delay.h>
+
+/* The USART registers of the camera, see cam_udr and cam_ucsra */
+#define usart(a, ...)		a ## __VA_ARGS__
+#define generate_usart_init()	static void usart_init (void) { }
+#define ISR(vector)		void vector (void)
+#define UDR			(*cam_udr ())
+#define UCSRA			cam_ucsra ()
+#define UDRE			5
+
+static volatile uint8_t *cam_udr (void);
+static uint8_t cam_ucsra (void);
+static void cam_delay_us (unsigned long us);
+
+#undef _delay_ms
+#define _delay_us(us)		cam_delay_us (us)
+#define _delay_ms(ms)		cam_delay_us ((ms) * 1000UL)
+
+#include "hardware/camera/dc3840.c"
+
+static unsigned failures;
+
+#define expect(cond)							\
+  do {									\
+    if (!(cond))							\
+      {									\
+	fprintf (stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);	\
+	failures ++;							\
+      }									\
+  } while (0)
+
+/* The serial RAM */
+static uint8_t sram[SRAM23K256_SIZE];
+
+void
+sram23k256_read (uint16_t address, uint8_t data[], uint16_t len)
+{
+  expect ((uint32_t) address + len <= sizeof (sram));
+  memcpy (data, sram + address, len);
+}
+
+void
+sram23k256_write (uint16_t address, uint8_t data[], uint16_t len)
+{
+  expect ((uint32_t) address + len <= sizeof (sram));
+  memcpy (sram + address, data, len);
+}
+
+/* The camera.  Time is counted in ns, a byte takes 10 bits at 921600
+   baud. */
+#define CAM_BYTE_NS	10851
+
+static unsigned long long cam_now, cam_next;
+static uint8_t cam_out[70000];
+static unsigned cam_out_len, cam_out_pos;
+static uint8_t cam_cmd[8], cam_cmd_len;
+static uint8_t cam_tx, cam_tx_pending, cam_rx, cam_in_isr;
+
+static uint16_t cam_image_len;	/* size of the snapshot */
+static unsigned cam_cut;	/* stop sending the image after that much */
+static uint8_t cam_nak;		/* command to NAK */
+static unsigned cam_gets;	/* GET_PICTURE requests */
+
+static uint8_t
+cam_image (unsigned i)
+{
+  return (i * 7 + (i >> 8) * 13) ^ 0x5A;
+}
+
+static void
+cam_reply (uint8_t a, uint8_t b, uint8_t c, uint8_t d, uint8_t e)
+{
+  uint8_t reply[8] = { 0xFF, 0xFF, 0xFF, a, b, c, d, e };
+
+  if (cam_out_pos == cam_out_len)
+    {
+      cam_out_pos = cam_out_len = 0;
+      if (cam_next < cam_now)
+	cam_next = cam_now;
+    }
+  memcpy (cam_out + cam_out_len, reply, 8);
+  cam_out_len += 8;
+}
+
+static void
+cam_command (void)
+{
+  uint8_t a = cam_cmd[3];
+
+  if (a == DC3840_CMD_ACK)
+    return;
+  if (a == cam_nak)
+    {
+      cam_reply (DC3840_CMD_NAK, 0, 0, 1, 0);
+      return;
+    }
+
+  cam_reply (DC3840_CMD_ACK, a, 0, 0, 0);
+  if (a != DC3840_CMD_GET_PICTURE)
+    return;
+
+  cam_gets ++;
+  cam_reply (DC3840_CMD_DATA, DC3840_DATA_TYPE_JPEG, cam_image_len & 0xFF,
+	     cam_image_len >> 8, 0);
+  for (unsigned i = 0; i < cam_image_len && i < cam_cut; i ++)
+    cam_out[cam_out_len ++] = cam_image (i);
+}
+
+/* The byte last written to UDR has left the USART */
+static void
+cam_flush (void)
+{
+  if (!cam_tx_pending)
+    return;
+  cam_tx_pending = 0;
+
+  if (cam_cmd_len < 3 && cam_tx != 0xFF)
+    cam_cmd_len = 0;
+  else
+    cam_cmd[cam_cmd_len ++] = cam_tx;
+
+  if (cam_cmd_len == 8)
+    {
+      cam_cmd_len = 0;
+      cam_command ();
+    }
+}
+
+static volatile uint8_t *
+cam_udr (void)
+{
+  if (cam_in_isr)
+    return &cam_rx;
+
+  cam_flush ();
+  cam_tx_pending = 1;
+  return &cam_tx;
+}
+
+static uint8_t
+cam_ucsra (void)
+{
+  cam_flush ();
+  return _BV (UDRE);
+}
+
+/* Let the time go on, the camera's bytes are received meanwhile */
+static void
+cam_delay_us (unsigned long us)
+{
+  cam_flush ();
+  cam_now += us * 1000ULL;
+
+  while (cam_out_pos < cam_out_len && cam_next <= cam_now)
+    {
+      cam_rx = cam_out[cam_out_pos ++];
+      cam_in_isr = 1;
+      USART_RX_vect ();
+      cam_in_isr = 0;
+      cam_next += CAM_BYTE_NS;
+    }
+}
+
+static void
+cam_reset (uint16_t image_len)
+{
+  cam_image_len = image_len;
+  cam_cut = -1;
+  cam_nak = 0;
+  cam_gets = 0;
+  cam_out_len = cam_out_pos = 0;
+  memset (sram, 0, sizeof (sram));
+}
+
+/* The mainloop, a pass takes PASS_US while the camera is on its first
+   SLOW_GETS requests and 50 us afterwards.  dc3840_fetch_timeout is
+   called every 100 ms.  Returns the time the download took. */
+static unsigned long long
+mainloop (unsigned pass_us, unsigned slow_gets)
+{
+  unsigned long long start = cam_now, timer = cam_now;
+
+  while (dc3840_fetching ())
+    {
+      if (cam_now - start > 10000000000ULL)
+	{
+	  fprintf (stderr, "download hangs\n");
+	  failures ++;
+	  dc3840_fetch_state = DC3840_FETCH_IDLE;
+	  break;
+	}
+
+      cam_delay_us (cam_gets <= slow_gets ? pass_us : 50);
+      dc3840_fetch_step ();
+      if (cam_now - timer >= 100000000ULL)
+	{
+	  timer = cam_now;
+	  dc3840_fetch_timeout ();
+	}
+    }
+
+  return cam_now - start;
+}
+
+/* Whether the image in the serial RAM is the camera's */
+static int
+image_ok (uint16_t len)
+{
+  static uint8_t data[512];
+
+  if (dc3840_data_length != len)
+    return 0;
+
+  for (unsigned offset = 0; offset < len; offset += sizeof (data))
+    {
+      uint16_t n = len - offset < sizeof (data) ? len - offset : sizeof (data);
+      if (dc3840_get_data (data, offset, n))
+	return 0;
+      for (unsigned i = 0; i < n; i ++)
+	if (data[i] != cam_image (offset + i))
+	  return 0;
+    }
+
+  return dc3840_get_data (data, len - 1, 2) == 1;
+}
+
+int
+main (void)
+{
+  uint8_t byte;
+  unsigned long long took;
+
+  /* Sync */
+  cam_reset (0);
+  dc3840_init ();
+  expect (dc3840_reply_ptr >= 8);
+
+  /* A fast mainloop keeps up with the camera */
+  cam_reset (5000);
+  expect (dc3840_capture () == 0);
+  expect (dc3840_fetching ());
+  expect (dc3840_data_length == 0);
+  expect (dc3840_capture () == 1);	/* still downloading */
+  took = mainloop (100, 0);
+  expect (cam_gets == 1);
+  expect (image_ok (5000));
+
+  /* The ring overflows once, the picture is requested again */
+  cam_reset (3333);
+  expect (dc3840_capture () == 0);
+  mainloop (2000, 1);
+  expect (cam_gets == 2);
+  expect (image_ok (3333));
+
+  /* It overflows every time, the driver gives up */
+  cam_reset (3333);
+  expect (dc3840_capture () == 0);
+  mainloop (2000, 100);
+  expect (cam_gets == 1 + DC3840_FETCH_RETRIES);
+  expect (dc3840_data_length == 0);
+  expect (dc3840_get_data (&byte, 0, 1) == 1);
+
+  /* The camera stops sending in the middle of the image */
+  cam_reset (5000);
+  cam_cut = 3001;
+  expect (dc3840_capture () == 0);
+  mainloop (100, 0);
+  expect (dc3840_data_length == 0);
+  expect (!dc3840_fetching ());
+
+  /* Too large for the serial RAM */
+  cam_reset (SRAM23K256_DC3840_SIZE + 1);
+  expect (dc3840_capture () == 0);
+  mainloop (100, 0);
+  expect (dc3840_data_length == 0);
+
+  /* The camera refuses the snapshot */
+  cam_reset (5000);
+  cam_nak = DC3840_CMD_SNAPSHOT;
+  expect (dc3840_capture () == 1);
+  expect (!dc3840_fetching ());
+  expect (cam_gets == 0);
+
+  /* Downloading in one go, the largest image that fits */
+  cam_reset (SRAM23K256_DC3840_SIZE);
+  expect (dc3840_capture () == 0);
+  expect (dc3840_fetch_wait () == 0);
+  expect (image_ok (SRAM23K256_DC3840_SIZE));
+
+  if (failures)
+    {
+      printf ("dc3840_test: %u failures\n", failures);
+      return 1;
+    }
+
+  printf ("  5000 bytes in %llu ms\n", took / 1000000);
+  return 0;
+}
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+
+
+/* Decodes DHT frames with dht_decode.c from the timer timestamps of
+   their falling edges, as the DHT_EDGE_SUPPORT interrupt takes them.
+   Frames are generated with random data, bit timings anywhere in the
+   datasheet's range and 2-8 us interrupt latency, and sampled by timer1
+   as it runs: in CTC mode for the periodic tick, free running for the
+   frequency counter and restarted at the start of the second for the
+   CPU clock, the frame starting anywhere in the timer's cycle.  None of
+   them may decode to wrong data, and few fail.  A few fixed frames at
+   the limits of the timings must decode exactly.  Frames with a
+   dropped edge or a wrong checksum must be rejected, and the CPU clock
+   frames across the wrap show what passing 65536 for its span did. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/dht/dht_decode.c"
+
+static unsigned failures;
+
+#define expect(cond) do { if (!(cond)) { \
+  printf ("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+  failures ++; } } while (0)
+
+/* timer1 as sampled by the interrupt */
+struct timer {
+  const char *name;
+  uint32_t hz;
+  uint32_t span;		/* counts from one wrap to the next */
+};
+
+static const struct timer ctc = { "62.5kHz CTC", 62500, 62500 / 50 };
+static const struct timer free16 = { "16MHz free running", 16000000, 65536 };
+static const struct timer free20 = { "20MHz free running", 20000000, 65536 };
+/* the second shortened by the clock adjustment */
+static const struct timer cpu = { "62.5kHz CPU clock", 62500, 62500 - 300 };
+
+static uint32_t seed = 1;
+
+static uint32_t
+random_range (uint32_t lo, uint32_t hi)
+{
+  seed = seed * 1103515245 + 12345;
+  return lo + (seed >> 8) % (hi - lo + 1);
+}
+
+/* The counter at ns after the timer's cycle began phase counts ago */
+static uint16_t
+count (const struct timer *t, uint32_t phase, uint64_t ns)
+{
+  uint32_t n = (phase + ns * t->hz / 1000000000) % t->span;
+  return 65536 - t->span + n;	/* 0 + n but for the CPU clock */
+}
+
+static int
+one (const struct timer *t)
+{
+  return t->hz * 100UL / 1000000UL;	/* DHT_TIMER_ONE */
+}
+
+/* Edge times in ns of a frame with the data, the sensor's timings
+   drawn from the datasheet's range */
+static void
+frame (uint64_t *ns, const uint8_t *data)
+{
+  uint64_t t = random_range (20000, 40000);	/* response after release */
+
+  ns[0] = t;
+  t += random_range (75000, 85000) + random_range (75000, 85000);
+  ns[1] = t;
+  for (int i = 0; i < 40; i ++)
+    {
+      t += random_range (48000, 55000);
+      if (data[i / 8] & (0x80 >> (i % 8)))
+	t += random_range (68000, 75000);
+      else
+	t += random_range (22000, 30000);
+      ns[i + 2] = t;
+    }
+}
+
+/* The timestamps the interrupt takes of the edges */
+static void
+sample (const struct timer *t, uint32_t phase, const uint64_t *ns,
+	uint16_t *falling)
+{
+  for (int i = 0; i < DHT_EDGES; i ++)
+    falling[i] = count (t, phase, ns[i] + random_range (2000, 8000));
+}
+
+static void
+random_data (uint8_t *data, int bad_checksum)
+{
+  for (int i = 0; i < 4; i ++)
+    data[i] = random_range (0, 255);
+  data[4] = data[0] + data[1] + data[2] + data[3];
+  if (bad_checksum)
+    data[4] ^= 1 << random_range (0, 7);
+}
+
+#define FRAMES 20000
+
+/* Random frames, the wrap anywhere.  Returns the failed frames. */
+static unsigned
+random_frames (const struct timer *t, uint32_t span)
+{
+  unsigned failed = 0, wrapped = 0, wrong = 0;
+
+  for (int f = 0; f < FRAMES; f ++)
+    {
+      uint8_t sent[5], data[5];
+      uint64_t ns[DHT_EDGES];
+      uint16_t falling[DHT_EDGES];
+      uint32_t phase = random_range (0, t->span - 1);
+
+      random_data (sent, 0);
+      frame (ns, sent);
+      sample (t, phase, ns, falling);
+      wrapped += falling[DHT_EDGES - 1] < falling[0];
+
+      if (dht_decode (falling, DHT_EDGES, span, one (t), data) != DHT_OK)
+	failed ++;
+      else if (memcmp (data, sent, 5))
+	wrong ++;
+    }
+
+  printf ("  %-20s span %5lu: %5u of %u frames failed, %u across the wrap\n",
+	  t->name, (unsigned long) span, failed, FRAMES, wrapped);
+  expect (wrapped > 0);
+  expect (wrong == 0);
+  return failed;
+}
+
+/* Frames at the limits of the timings, in us: the response, then low
+   and high of every bit */
+struct fixed {
+  uint8_t data[5];
+  uint8_t low, zero, high;
+};
+
+static const struct fixed fixed[] = {
+  { { 0x02, 0x8C, 0x01, 0x5F, 0xEE }, 50, 26, 70 },	/* 65.2%, 35.1C */
+  { { 0x01, 0xB5, 0x80, 0x65, 0x9B }, 48, 22, 68 },	/* 43.7%, -10.1C */
+  { { 0x2D, 0x00, 0x17, 0x00, 0x44 }, 55, 30, 75 },	/* DHT11 45%, 23C */
+  { { 0xFF, 0xFF, 0x00, 0x00, 0xFE }, 55, 30, 68 },
+  { { 0x00, 0x00, 0x00, 0x00, 0x00 }, 48, 30, 75 },
+};
+
+static void
+fixed_frame (const struct fixed *f, uint64_t *ns)
+{
+  uint64_t t = 30000;
+
+  ns[0] = t;
+  t += 160000;
+  ns[1] = t;
+  for (int i = 0; i < 40; i ++)
+    {
+      t += f->low * 1000;
+      t += (f->data[i / 8] & (0x80 >> (i % 8)) ? f->high : f->zero) * 1000;
+      ns[i + 2] = t;
+    }
+}
+
+int
+main (void)
+{
+  static const struct timer *timers[] = { &ctc, &free16, &free20, &cpu };
+  uint8_t sent[5], data[5];
+  uint64_t ns[DHT_EDGES];
+  uint16_t falling[DHT_EDGES];
+
+  /* Generated frames */
+  for (unsigned i = 0; i < sizeof (timers) / sizeof (timers[0]); i ++)
+    expect (random_frames (timers[i], timers[i]->span) < FRAMES / 200);
+
+  /* The CPU clock with the span of a free running timer */
+  expect (random_frames (&cpu, 65536) > 0);
+
+  /* Fixed frames, each with the wrap at every edge */
+  for (unsigned f = 0; f < sizeof (fixed) / sizeof (fixed[0]); f ++)
+    for (unsigned i = 0; i < sizeof (timers) / sizeof (timers[0]); i ++)
+      {
+	const struct timer *t = timers[i];
+	fixed_frame (&fixed[f], ns);
+	for (int e = 0; e < DHT_EDGES; e ++)
+	  {
+	    uint32_t phase = t->span - 1 - ns[e] * t->hz / 1000000000 % t->span;
+	    for (int k = 0; k < DHT_EDGES; k ++)
+	      falling[k] = count (t, phase, ns[k]);
+	    memset (data, 0, sizeof (data));
+	    expect (dht_decode (falling, DHT_EDGES, t->span, one (t), data)
+		    == DHT_OK);
+	    expect (memcmp (data, fixed[f].data, 5) == 0);
+	  }
+      }
+
+  /* Dropped edges, and no response at all */
+  for (unsigned i = 0; i < sizeof (timers) / sizeof (timers[0]); i ++)
+    {
+      const struct timer *t = timers[i];
+      random_data (sent, 0);
+      frame (ns, sent);
+      for (int e = 0; e < DHT_EDGES; e ++)
+	{
+	  uint64_t dropped[DHT_EDGES];
+	  memcpy (dropped, ns, e * sizeof (ns[0]));
+	  memcpy (dropped + e, ns + e + 1, (DHT_EDGES - e - 1) * sizeof (ns[0]));
+	  sample (t, random_range (0, t->span - 1), dropped, falling);
+	  expect (dht_decode (falling, DHT_EDGES - 1, t->span, one (t), data)
+		  == DHT_ERR_EDGES);
+	}
+      expect (dht_decode (falling, 0, t->span, one (t), data)
+	      == DHT_ERR_EDGES);
+    }
+
+  /* A bit period too long, as when the edge between two ones was lost
+     and a glitch took its place at the end */
+  random_data (sent, 0);
+  sent[2] = 0xFF;
+  frame (ns, sent);
+  for (int e = 18; e < DHT_EDGES - 1; e ++)
+    ns[e] = ns[e + 1];
+  ns[DHT_EDGES - 1] = ns[DHT_EDGES - 2] + 10000;
+  sample (&ctc, 0, ns, falling);
+  expect (dht_decode (falling, DHT_EDGES, ctc.span, one (&ctc), data)
+	  == DHT_ERR_TIMING);
+
+  /* Wrong checksums */
+  for (int f = 0; f < 1000; f ++)
+    {
+      const struct timer *t = timers[f % 4];
+      random_data (sent, 1);
+      struct fixed bad = fixed[0];
+      memcpy (bad.data, sent, 5);
+      fixed_frame (&bad, ns);
+      sample (t, random_range (0, t->span - 1), ns, falling);
+      expect (dht_decode (falling, DHT_EDGES, t->span, one (t), data)
+	      == DHT_ERR_CHECKSUM);
+    }
+
+  if (failures)
+    {
+      printf ("dht_test: %u failures\n", failures);
+      return 1;
+    }
+  return 0;
+}
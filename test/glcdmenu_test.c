@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Runs the menu interpreter on a framebuffer in RAM, with the sample menu
+   of menudata-progmem.c.  After random key presses and state changes the
+   partial redraw must leave the screen as a full redraw draws it.  The
+   pixel writes of both are counted, the partial ones should be a small
+   fraction. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#include "menu-interpreter.h"
+#include "services/glcdmenu/menu-interpreter/menudata-progmem.c"
+
+#define STEPS 20000
+
+/* double buffered like the S1D13305 layers */
+static uint8_t screen[2][MENU_SCREEN_Y][MENU_SCREEN_X];
+static uint8_t shown, target = 1;
+
+static unsigned long pixels;		/* pixel writes */
+static unsigned failures;
+
+#define expect(cond) do { if (!(cond)) { \
+  printf ("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+  failures ++; } } while (0)
+
+static void
+put (SCREENPOS x, SCREENPOS y, unsigned char color)
+{
+  expect (x < MENU_SCREEN_X && y < MENU_SCREEN_Y);
+  if (x < MENU_SCREEN_X && y < MENU_SCREEN_Y)
+    screen[target][y][x] = color & 1;
+  pixels ++;
+}
+
+unsigned char
+menu_byte_get (MENUADDR addr)
+{
+  expect (addr < MENU_DATASIZE);
+  return addr < MENU_DATASIZE ? menudata[addr] : 0;
+}
+
+void
+menu_screen_set (SCREENPOS x, SCREENPOS y, unsigned char color)
+{
+  put (x, y, color);
+}
+
+void
+menu_screen_fill (SCREENPOS x, SCREENPOS y, SCREENPOS sx, SCREENPOS sy,
+		  unsigned char color)
+{
+  for (SCREENPOS j = 0; j < sy; j ++)
+    for (SCREENPOS i = 0; i < sx; i ++)
+      put (x + i, y + j, color);
+}
+
+void
+menu_screen_bits (SCREENPOS x, SCREENPOS y, unsigned char bits,
+		  unsigned char count)
+{
+  expect (count >= 1 && count <= 8);
+  for (uint8_t i = 0; i < count; i ++)
+    put (x + i, y, bits << i & 0x80 ? 1 : 0);
+}
+
+void
+menu_screen_flush (void)
+{
+  shown = target;
+  target = !shown;
+}
+
+void
+menu_screen_clear (void)
+{
+  memset (screen[target], 0, sizeof (screen[target]));
+}
+
+void
+menu_screen_update_begin (void)
+{
+  target = shown;
+}
+
+void
+menu_screen_update_end (void)
+{
+  target = !shown;
+}
+
+unsigned char
+menu_action (unsigned short action)
+{
+  return 0;
+}
+
+extern unsigned char menu_focus_key_next, menu_focus_key_prev,
+  menu_key_enter;
+
+/* A random key press or change of a checkbox, radiobutton or list */
+static void
+random_step (void)
+{
+  uint8_t r = rand () % 10;
+
+  if (r < 3)
+    menu_keypress (menu_focus_key_next);
+  else if (r < 4)
+    menu_keypress (menu_focus_key_prev);
+  else if (r < 6)
+    menu_keypress (menu_key_enter);
+  else if (r < 7)
+    menu_keypress (rand () % 256);
+  else if (r < 8)
+    {
+      uint8_t i = rand () % MENU_CHECKBOX_MAX;
+      uint8_t state = rand () & 1;
+      if (menu_checkboxstate[i] != state)
+	{
+	  menu_checkboxstate[i] = state;
+	  menu_damage_state (MENU_CHECKBOX, i);
+	}
+    }
+  else if (r < 9)
+    {
+      uint8_t state = rand () % 4;
+      if (menu_radiobuttonstate[0] != state)
+	{
+	  menu_radiobuttonstate[0] = state;
+	  menu_damage_state (MENU_RADIOBUTTON, 0);
+	}
+    }
+  else
+    {
+      uint8_t i = rand () % MENU_LIST_MAX;
+      uint16_t state = rand () % 5;
+      if (menu_listindexstate[i] != state)
+	{
+	  menu_listindexstate[i] = state;
+	  menu_damage_state (MENU_LIST, i);
+	}
+    }
+}
+
+int
+main (void)
+{
+  static uint8_t partial_screen[MENU_SCREEN_Y][MENU_SCREEN_X];
+  static unsigned char text0[] = "hello", text1[] = "Wq";
+  unsigned long partial = 0, full = 0;
+
+  menu_strings[0] = text0;
+  menu_strings[1] = text1;
+  menu_redraw ();
+
+  srand (1);
+  for (unsigned step = 0; step < STEPS; step ++)
+    {
+      random_step ();
+
+      unsigned long before = pixels;
+      menu_redraw_dirty ();
+      partial += pixels - before;
+      memcpy (partial_screen, screen[shown], sizeof (partial_screen));
+
+      before = pixels;
+      menu_redraw ();
+      full += pixels - before;
+
+      if (memcmp (partial_screen, screen[shown], sizeof (partial_screen)))
+	{
+	  printf ("step %u: partial redraw differs from the full one\n",
+		  step);
+	  failures ++;
+	}
+    }
+
+  printf ("  %u steps: %lu pixels written by partial redraws, %lu by full "
+	  "ones (%.1f%%)\n", STEPS, partial, full, 100.0 * partial / full);
+  expect (partial * 20 < full);
+
+  if (failures)
+    {
+      printf ("glcdmenu: %u failures\n", failures);
+      return 1;
+    }
+  return 0;
+}
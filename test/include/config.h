@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Stands in for the generated config.h when a module is built into one of
+   the host tests.  The tests pass the options they need with -D. */
+
+#ifndef _TEST_CONFIG_H
+#define _TEST_CONFIG_H
+
+#include <stdint.h>
+
+#define ARCH_AVR	1
+#define ARCH_HOST	2
+#define ARCH		ARCH_HOST
+
+/* this is autoconf.h as well, see protocols/usb/usbconfig.h */
+#define AUTOCONF_INCLUDED
+
+/* main callback functions for uip, as in the top level config.h */
+#define UIP_APPCALL if (uip_conn->callback != NULL) uip_conn->callback
+#define UIP_UDP_APPCALL if (uip_udp_conn->callback) uip_udp_conn->callback
+
+/* no watchdog on the host */
+#define wdt_kick()
+
+#endif	/* _TEST_CONFIG_H */
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+
+/* Stands in for the generated meta.h.  The real one collects the
+   application state of all enabled TCP and UDP applications into these
+   unions, the host tests keep theirs in their own variables. */
+
+#ifndef _TEST_META_H
+#define _TEST_META_H
+
+#include <stdint.h>
+
+typedef union { uint8_t raw[16]; } uip_tcp_appstate_t;
+typedef union { uint8_t raw[16]; } uip_udp_appstate_t;
+
+#endif	/* _TEST_META_H */
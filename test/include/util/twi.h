@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* The TWI definitions used by the I2C drivers, for the host tests that
+   replace hardware/i2c/master/i2c_master.c with a simulated bus. */
+
+#ifndef _TEST_UTIL_TWI_H
+#define _TEST_UTIL_TWI_H
+
+#define TW_WRITE	0
+#define TW_READ		1
+
+#endif	/* _TEST_UTIL_TWI_H */
@@ -0,0 +1,377 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Feeds IR traces to irmp.c built for decoding from edge timestamps.
+   Each trace is decoded three times: sampled at IRMP_HZ as the tick
+   interrupt does, replayed from its edges by irmp_replay() alone, and
+   through the edge interrupt and irmp_process() polled at random
+   intervals.  All three must give the frames the trace was made of, and
+   the replay as many samples as the tick interrupt takes. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+/* The timer and the receiver pin of the edge mode */
+static uint32_t sim_counts;		/* timer counts since the start */
+static uint8_t sim_input = 1;		/* receiver output, low active */
+
+#define ISR(vector)			void vector (void)
+#define IRMP_RX_VECTOR			irmp_test_edge_vect
+#define TC0_VECTOR_OVERFLOW		irmp_test_overflow_vect
+#define IRMP_RX_PCINT_PIN		0
+#define irmp_rx_configure_pcint()	do { } while (0)
+#define PIN_HIGH(pin)			sim_input
+#define PIN_BV(pin)			1
+#define PIN_CLEAR(pin)			do { } while (0)
+#define DDR_CONFIG_IN(pin)		do { } while (0)
+#define TC0_PRESCALER_1			do { } while (0)
+#define TC0_PRESCALER_8			do { } while (0)
+#define TC0_PRESCALER_64		do { } while (0)
+#define TC0_PRESCALER_256		do { } while (0)
+#define TC0_PRESCALER_1024		do { } while (0)
+#define TC0_COUNTER_CURRENT		((uint8_t) sim_counts)
+#define TC0_INT_COMPARE_OFF		do { } while (0)
+#define TC0_INT_OVERFLOW_ON		do { } while (0)
+#define TC0_INT_OVERFLOW_CLR		do { } while (0)
+#define TC0_INT_OVERFLOW_TST		0
+
+#include "hardware/ir/irmp/irmp.c"
+
+ISR(IRMP_RX_VECTOR);
+ISR(TC0_VECTOR_OVERFLOW);
+
+#define MAX_EDGES	1024
+#define MAX_FRAMES	16
+
+static double edge_time[MAX_EDGES];	/* seconds from the trace start */
+static uint8_t edge_level[MAX_EDGES];	/* receiver output after the edge */
+static unsigned edges;
+
+static irmp_data_t frames[3][MAX_FRAMES];
+static unsigned frame_count[3];
+
+static unsigned failures;
+static unsigned frames_total;
+
+static const char *trace_name;
+
+#define expect(cond) do { if (!(cond)) { \
+  printf ("%s:%d: %s: %s failed\n", __FILE__, __LINE__, trace_name, #cond); \
+  failures ++; } } while (0)
+
+/* Up to 30 us off, as receivers stretch and shrink marks */
+static double
+jitter (void)
+{
+  return (rand () % 61 - 30) * 1e-6;
+}
+
+static void
+trace_add (double *t, uint8_t mark, double len)
+{
+  uint8_t level = !mark;
+  uint8_t previous = edges ? edge_level[edges - 1] : 1;
+  if (level != previous && edges < MAX_EDGES)
+    {
+      edge_time[edges] = *t;
+      edge_level[edges ++] = level;
+    }
+  *t += len;
+}
+
+static void
+trace_nec (double *t, uint16_t address, uint8_t command)
+{
+  uint32_t code = address | (uint32_t) command << 16
+    | (uint32_t) (uint8_t) ~command << 24;
+
+  trace_add (t, 1, 9e-3 + jitter ());
+  trace_add (t, 0, 4.5e-3);
+  for (uint8_t bit = 0; bit < 32; bit ++)
+    {
+      trace_add (t, 1, 560e-6 + jitter ());
+      trace_add (t, 0, (code >> bit & 1) ? 1690e-6 : 560e-6);
+    }
+  trace_add (t, 1, 560e-6);
+}
+
+static void
+trace_nec_repeat (double *t)
+{
+  trace_add (t, 1, 9e-3 + jitter ());
+  trace_add (t, 0, 2.25e-3);
+  trace_add (t, 1, 560e-6);
+}
+
+static void
+trace_sircs (double *t, uint8_t address, uint8_t command)
+{
+  uint16_t code = (command & 0x7f) | (address & 0x1f) << 7;
+
+  trace_add (t, 1, 2.4e-3 + jitter ());
+  for (uint8_t bit = 0; bit < 12; bit ++)
+    {
+      trace_add (t, 0, 600e-6);
+      trace_add (t, 1, ((code >> bit & 1) ? 1200e-6 : 600e-6) + jitter ());
+    }
+}
+
+static void
+trace_rc5 (double *t, uint8_t toggle, uint8_t address, uint8_t command)
+{
+  uint16_t code = 3 << 12 | (toggle & 1) << 11 | (address & 0x1f) << 6
+    | (command & 0x3f);
+
+  for (int8_t bit = 13; bit >= 0; bit --)
+    {
+      uint8_t one = code >> bit & 1;
+      trace_add (t, !one, 889e-6);
+      trace_add (t, one, 889e-6);
+    }
+}
+
+/* Pause up to period after the frame started at start */
+static void
+trace_pause (double *t, double start, double period)
+{
+  trace_add (t, 0, start + period - *t);
+}
+
+static void
+collect (unsigned decoder)
+{
+  irmp_data_t *data;
+  while ((data = irmp_read ()) != NULL)
+    if (frame_count[decoder] < MAX_FRAMES)
+      frames[decoder][frame_count[decoder] ++] = *data;
+}
+
+/* The tick interrupt, sampling at a random phase */
+static void
+decode_sampled (double end)
+{
+  double phase = rand () % 1000 / 1000.0 / IRMP_HZ;
+  unsigned n = 0;
+
+  for (uint32_t tick = 0; ; tick ++)
+    {
+      double t = phase + (double) tick / IRMP_HZ;
+      if (t > end)
+	break;
+      while (n < edges && edge_time[n] <= t)
+	n ++;
+      irmp_rx_sample (n ? edge_level[n - 1] : 1);
+      collect (0);
+    }
+}
+
+static uint32_t
+counts (double t)
+{
+  return t * EDGE_HZ;
+}
+
+/* irmp_replay() with the durations the edge interrupt would store.  The
+   samples fed up to each edge must be as many as the tick interrupt
+   takes from the first edge after silence on, so the phase is kept. */
+static void
+decode_replayed (void)
+{
+  uint32_t first = 0, last = 0, fed = 0;
+
+  for (unsigned n = 0; n < edges; n ++)
+    {
+      uint32_t now = counts (edge_time[n]);
+      uint32_t duration = n ? now - last : 0xFFFF;
+
+      if (duration < EDGE_IDLE)
+	{
+	  /* up to the edge, which isn't there yet */
+	  irmp_replay (duration, edge_level[n - 1]);
+	  fed += irmp_edge_fed;
+	  expect (fed == (uint64_t) (now - first) * IRMP_HZ / EDGE_HZ);
+	}
+      else
+	{
+	  first = now;
+	  fed = 0;
+	}
+
+      irmp_replay (duration > 0xFFFF ? 0xFFFF : duration, edge_level[n]);
+      collect (1);
+      last = now;
+    }
+  irmp_replay (0xFFFF, edges ? edge_level[edges - 1] : 1);
+  collect (1);
+}
+
+/* Lets the timer run up to count, with its overflow interrupts */
+static void
+run_timer (uint32_t count)
+{
+  while ((sim_counts >> 8) < (count >> 8))
+    {
+      sim_counts = (sim_counts | 0xff) + 1;
+      irmp_test_overflow_vect ();
+    }
+  sim_counts = count;
+}
+
+/* The edge interrupt and the mainloop, which comes round every 50 us to
+   3 ms and sometimes stalls for 10 ms */
+static void
+decode_interrupts (double end)
+{
+  uint32_t start = sim_counts;
+  uint32_t poll = start;
+  unsigned n = 0;
+
+  while (poll < start + counts (end))
+    {
+      uint32_t us = rand () % 20 ? 50 + rand () % 2950 : 10000;
+      poll += (uint64_t) us * EDGE_HZ / 1000000;
+
+      for (; n < edges && start + counts (edge_time[n]) <= poll; n ++)
+	{
+	  run_timer (start + counts (edge_time[n]));
+	  sim_input = edge_level[n];
+	  irmp_test_edge_vect ();
+	}
+      run_timer (poll);
+      irmp_process ();
+      collect (2);
+    }
+}
+
+static void
+decode (const char *name, double t)
+{
+  trace_name = name;
+  /* long enough to complete the last frame */
+  double end = t + 0.3;
+
+  memset (frame_count, 0, sizeof (frame_count));
+  decode_sampled (end);
+  decode_replayed ();
+  decode_interrupts (end);
+  frames_total += frame_count[0];
+
+  expect (frame_count[0] > 0);
+  for (unsigned decoder = 1; decoder < 3; decoder ++)
+    {
+      expect (frame_count[decoder] == frame_count[0]);
+      expect (memcmp (frames[decoder], frames[0],
+		      frame_count[0] * sizeof (irmp_data_t)) == 0);
+    }
+}
+
+static void
+expect_frame (unsigned i, uint8_t protocol, uint16_t address,
+	      uint16_t command, uint8_t flags)
+{
+  expect (i < frame_count[0]);
+  if (i >= frame_count[0])
+    return;
+  expect (frames[0][i].protocol == protocol);
+  expect (frames[0][i].address == address);
+  expect (frames[0][i].command == command);
+  expect (frames[0][i].flags == flags);
+}
+
+int
+main (void)
+{
+  char name[32];
+
+  trace_name = "init";
+  irmp_init ();
+
+  for (unsigned run = 0; run < 100; run ++)
+    {
+      srand (run);
+      double t = 0.01 + rand () % 1000 * 1e-6;
+      edges = 0;
+
+      uint16_t address = rand ();
+      uint8_t command = rand ();
+
+      switch (run % 3)
+	{
+	case 0:
+	  /* a key held for three frames, pressed again after a pause */
+	  for (uint8_t i = 0; i < 4; i ++)
+	    {
+	      double start = t;
+	      if (i == 0 || i == 3)
+		trace_nec (&t, address, command);
+	      else
+		trace_nec_repeat (&t);
+	      trace_pause (&t, start, i == 2 ? 0.3 : 0.108);
+	    }
+	  sprintf (name, "NEC %04x %02x", address, command);
+	  decode (name, t);
+	  expect_frame (0, IRMP_PROTO_NEC, address, command, 0);
+	  expect_frame (1, IRMP_PROTO_NEC, address, command, IRMP_FLAG_REPETITION);
+	  expect_frame (2, IRMP_PROTO_NEC, address, command, IRMP_FLAG_REPETITION);
+	  expect_frame (3, IRMP_PROTO_NEC, address, command, 0);
+	  break;
+
+	case 1:
+	  for (uint8_t i = 0; i < 3; i ++)
+	    {
+	      double start = t;
+	      trace_sircs (&t, address, command);
+	      trace_pause (&t, start, 0.045);
+	    }
+	  sprintf (name, "SIRCS %02x %02x", address & 0x1f, command & 0x7f);
+	  decode (name, t);
+	  /* all 12 bits end up in the command */
+	  expect_frame (0, IRMP_PROTO_SIRCS, 0,
+			(address & 0x1f) << 7 | (command & 0x7f), 0);
+	  break;
+
+	case 2:
+	  for (uint8_t i = 0; i < 2; i ++)
+	    {
+	      double start = t;
+	      trace_rc5 (&t, i, address, command);
+	      trace_pause (&t, start, 0.114);
+	    }
+	  sprintf (name, "RC5 %02x %02x", address & 0x1f, command & 0x3f);
+	  decode (name, t);
+	  expect_frame (0, IRMP_PROTO_RC5, address & 0x1f, command & 0x3f, 0);
+	  /* toggled, so not a repetition */
+	  expect_frame (1, IRMP_PROTO_RC5, address & 0x1f, command & 0x3f, 0);
+	  break;
+	}
+    }
+
+  printf ("  100 traces, %u frames\n", frames_total);
+  if (failures)
+    {
+      printf ("irmp: %u failures\n", failures);
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+
+/* Plays WAV files from a memory backed VFS through pwm_wav.c.  The
+   Timer0 interrupt is called directly, the mainloop hook every so many
+   samples, and every sample written to the PWM is recorded.  8 bit mono
+   and 16 bit stereo files, a file with an odd sized extra chunk and a
+   raw file without header must come out sample by sample, at the rate
+   from their header.  A mainloop too slow for the buffers must cause
+   underruns, but must not lose or repeat samples. */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+/* Timer0, Timer2 and the PWM pin */
+static uint8_t TCCR0B, TCCR2A, TCCR2B, OCR2A, DDRD, TIMSK0, tcnt0;
+
+#define ISR(vector)		void vector (void)
+#define TC0_COUNTER_CURRENT	tcnt0
+#define CS00			0
+#define CS01			1
+#define CS20			0
+#define WGM20			0
+#define WGM21			1
+#define COM2A1			7
+#define TOIE0			0
+
+#include "hardware/pwm/pwm_wav.c"
+
+/* The VFS with a single file in memory */
+static const char *file_name;
+static uint8_t file[32768];
+static vfs_size_t file_len, file_pos;
+static struct vfs_file_handle_t file_handle;
+static unsigned file_open;
+
+struct vfs_file_handle_t *
+vfs_open (const char *filename)
+{
+  if (file_open || strcmp (filename, file_name))
+    return NULL;
+  file_open = 1;
+  file_pos = 0;
+  return &file_handle;
+}
+
+vfs_size_t
+vfs_read_write_size (uint8_t flag, struct vfs_file_handle_t *handle,
+		     void *buf, vfs_size_t length)
+{
+  if (flag == 2)
+    return file_len;
+  if (flag == 1)
+    return 0;
+  if (length > file_len - file_pos)
+    length = file_len - file_pos;
+  memcpy (buf, file + file_pos, length);
+  file_pos += length;
+  return length;
+}
+
+uint8_t
+vfs_fseek_truncate_close (uint8_t flag, struct vfs_file_handle_t *handle,
+			  vfs_size_t length, uint8_t whence)
+{
+  if (flag == 2)
+    file_open = 0;
+  else if (flag == 0)
+    {
+      vfs_size_t pos = whence == SEEK_CUR ? file_pos + length : length;
+      if (pos > file_len)
+	return 1;
+      file_pos = pos;
+    }
+  return 0;
+}
+
+int
+snprintf_P (char *buf, int len, const char *fmt, ...)
+{
+  va_list ap;
+  int n;
+
+  va_start (ap, fmt);
+  n = vsnprintf (buf, len, fmt, ap);
+  va_end (ap);
+  return n;
+}
+
+static unsigned failures;
+
+#define expect(cond) do { if (!(cond)) { \
+  printf ("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+  failures ++; } } while (0)
+
+/* what the file should sound like, and what it did */
+static uint8_t expected[16384], played[16384];
+static unsigned expected_len, played_len;
+
+static void
+put16 (uint8_t *p, uint16_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void
+put32 (uint8_t *p, uint32_t v)
+{
+  put16 (p, v);
+  put16 (p + 2, v >> 16);
+}
+
+/* Writes a WAV file of FRAMES frames to file[] and the samples the PWM
+   should get to expected[].  An EXTRA sized chunk goes before the fmt
+   chunk. */
+static void
+make_wav (uint8_t channels, uint8_t bits, uint32_t rate, unsigned frames,
+	  uint8_t extra)
+{
+  uint8_t *p = file + 12;
+  uint8_t frame = channels * bits / 8;
+
+  memcpy (file, "RIFF", 4);
+  memcpy (file + 8, "WAVE", 4);
+  if (extra)
+    {
+      memcpy (p, "LIST", 4);
+      put32 (p + 4, extra);
+      memset (p + 8, 'x', extra);
+      p += 8 + ((extra + 1) & ~1);
+    }
+  memcpy (p, "fmt ", 4);
+  put32 (p + 4, 16);
+  put16 (p + 8, 1);
+  put16 (p + 10, channels);
+  put32 (p + 12, rate);
+  put32 (p + 16, rate * frame);
+  put16 (p + 20, frame);
+  put16 (p + 22, bits);
+  memcpy (p + 24, "data", 4);
+  put32 (p + 28, frames * frame);
+  p += 32;
+
+  for (unsigned i = 0; i < frames; i ++)
+    for (uint8_t c = 0; c < channels; c ++)
+      {
+	if (bits == 8)
+	  *p ++ = i * 7 + c * 50;
+	else
+	  {
+	    uint16_t v = i * 263 + c * 1000;
+	    put16 (p, v);
+	    p += 2;
+	  }
+	if (c == 0)
+	  expected[i] = bits == 8 ? (uint8_t) (i * 7)
+	    : (uint8_t) ((uint16_t) (i * 263) >> 8) ^ 0x80;
+      }
+  expected_len = frames;
+  file_len = p - file;
+  put32 (file + 4, file_len - 8);
+}
+
+/* Plays the file, the mainloop runs every EVERY samples.  Returns the
+   ECMD result. */
+static int16_t
+play (const char *name, unsigned every)
+{
+  char cmd[32], output[16];
+  uint16_t counter = 0;
+  int16_t ret;
+
+  file_name = name;
+  played_len = 0;
+  sprintf (cmd, " %s", name);
+  ret = parse_cmd_pwm_wav_play (cmd, output, sizeof (output));
+  if (ret != ECMD_FINAL_OK)
+    return ret;
+
+  for (unsigned t = 1; TCCR0B && t < 100000; t ++)
+    {
+      TIMER0_OVF_vect ();
+      if (pwmbytecounter != counter)
+	{
+	  counter = pwmbytecounter;
+	  if (played_len < sizeof (played))
+	    played[played_len ++] = OCR2A;
+	}
+      if (t % every == 0)
+	pwm_wav_mainloop ();
+    }
+  pwm_wav_mainloop ();
+  return ret;
+}
+
+int
+main (void)
+{
+  char output[16];
+
+  /* 8 bit mono with an odd sized chunk in front */
+  make_wav (1, 8, 8000, 3000, 5);
+  expect (play ("a.wav", 16) == ECMD_FINAL_OK);
+  expect (wav_prescaler == 1 << CS01 && wav_divisor == 250);
+  expect (played_len == expected_len);
+  expect (memcmp (played, expected, expected_len) == 0);
+  expect (pwm_wav_underruns == 0);
+  expect (!file_open && TCCR0B == 0);
+
+  /* 16 bit stereo, the high byte of the left channel */
+  make_wav (2, 16, 22050, 2000, 0);
+  expect (play ("b.wav", 16) == ECMD_FINAL_OK);
+  expect (wav_prescaler == 1 << CS01 && wav_divisor == 90);
+  expect (played_len == expected_len);
+  expect (memcmp (played, expected, expected_len) == 0);
+  expect (pwm_wav_underruns == 0);
+  expect (!file_open && TCCR0B == 0);
+
+  /* a mainloop slower than a buffer: underruns, but every sample */
+  make_wav (1, 8, 8000, 3000, 0);
+  expect (play ("c.wav", 2 * WAVEBUFFERLEN + 50) == ECMD_FINAL_OK);
+  expect (played_len == expected_len);
+  expect (memcmp (played, expected, expected_len) == 0);
+  expect (pwm_wav_underruns > 0);
+  unsigned underruns = pwm_wav_underruns;
+  expect (parse_cmd_pwm_wav_underruns ("", output, sizeof (output)) > 0);
+  expect ((unsigned) atoi (output) == underruns);
+
+  /* raw samples without header at 8kHz */
+  for (unsigned i = 0; i < 1000; i ++)
+    expected[i] = file[i] = i * 3;
+  expected_len = file_len = 1000;
+  expect (play ("raw", 16) == ECMD_FINAL_OK);
+  expect (wav_prescaler == 1 << CS01 && wav_divisor == 250);
+  expect (played_len == expected_len);
+  expect (memcmp (played, expected, expected_len) == 0);
+
+  /* unsupported and missing files */
+  make_wav (1, 8, 8000, 100, 0);
+  file[12 + 22] = 24;
+  expect (play ("d.wav", 16) == ECMD_ERR_READ_ERROR);
+  expect (!file_open && TCCR0B == 0);
+  file_name = "f.wav";
+  expect (parse_cmd_pwm_wav_play (" g.wav", output, sizeof (output))
+	  == ECMD_ERR_READ_ERROR);
+
+  /* stopped while playing */
+  make_wav (1, 8, 8000, 3000, 0);
+  file_name = "h.wav";
+  expect (parse_cmd_pwm_wav_play (" h.wav", output, sizeof (output))
+	  == ECMD_FINAL_OK);
+  expect (file_open && TCCR0B != 0);
+  expect (parse_cmd_pwm_wav_stop ("", output, sizeof (output))
+	  == ECMD_FINAL_OK);
+  expect (!file_open && TCCR0B == 0);
+
+  if (failures)
+    {
+      printf ("pwm_wav: %u failures\n", failures);
+      return 1;
+    }
+  printf ("  %u underruns with a mainloop every %u samples\n", underruns,
+	  2 * WAVEBUFFERLEN + 50);
+  return 0;
+}
@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Runs sd_raw.c against a card simulated at the SPI level, which counts
+   the commands it gets.  Reads and writes are checked against an image
+   of the card, the counters against what the configuration should do.
+   The Makefile builds it once per configuration, with the serial RAM
+   cache simulated by an array. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hardware/storage/sd_reader/sd_raw_config.h"
+
+/* SPI registers and chip select of the simulated card */
+static uint8_t SPCR, SPSR;
+enum { SPR0, SPR1, CPHA, CPOL, MSTR, DORD, SPE, SPIE };
+#define SPI2X 0
+
+static uint8_t card_selected;
+#undef configure_pin_ss
+#undef select_card
+#undef unselect_card
+#define configure_pin_ss()	do { } while (0)
+#define select_card()		(card_selected = 1)
+#define unselect_card()		(card_selected = 0)
+
+#include "hardware/storage/sd_reader/sd_raw.c"
+
+#define CARD_BLOCKS 64
+#define CARD_SIZE (CARD_BLOCKS * 512)
+
+static uint8_t card[CARD_SIZE];		/* what the card holds */
+static uint8_t image[CARD_SIZE];	/* what it should hold */
+
+#ifdef SER_RAM_CACHE_SD
+static uint8_t sram[SRAM23K256_SIZE];
+
+void
+sram23k256_read (uint16_t address, uint8_t data[], uint16_t len)
+{
+  memcpy (data, sram + address, len);
+}
+
+void
+sram23k256_write (uint16_t address, uint8_t data[], uint16_t len)
+{
+  memcpy (sram + address, data, len);
+}
+#endif
+
+static struct {
+  unsigned cmd17, cmd18, cmd12, cmd24, cmd25;
+  unsigned read, written;		/* blocks */
+} counters;
+
+enum {
+  CARD_IDLE,
+  CARD_READING,				/* CMD18 running */
+  CARD_WRITE_TOKEN,			/* waiting for a start token */
+  CARD_WRITE_DATA,
+};
+
+static uint8_t card_state;
+static uint8_t card_multi;
+static uint32_t card_address;
+static uint8_t command[6];
+static uint8_t command_len;
+static uint8_t data[514];
+static uint16_t data_len;
+
+/* bytes the card sends next */
+static uint8_t out[600];
+static uint16_t out_head, out_tail;
+/* position of the start token of a data block in out, a block counts as
+   read once the host clocks it in */
+static int16_t out_token = -1;
+
+static void
+card_send (uint8_t b)
+{
+  out[out_tail ++] = b;
+}
+
+static void
+card_send_block (void)
+{
+  card_send (0xff);
+  out_token = out_tail;
+  card_send (0xfe);
+  for (uint16_t i = 0; i < 512; i ++)
+    card_send (card_address < CARD_SIZE ? card[card_address + i] : 0);
+  card_send (0x00);			/* crc */
+  card_send (0x00);
+  card_address += 512;
+}
+
+static void
+card_command (void)
+{
+  uint8_t cmd = command[0] & 0x3f;
+  uint32_t arg = (uint32_t) command[1] << 24 | (uint32_t) command[2] << 16
+    | command[3] << 8 | command[4];
+
+  out_head = out_tail = 0;
+  out_token = -1;
+  if (cmd == CMD_STOP_TRANSMISSION) {
+    /* a stuff byte, the response, then busy */
+    counters.cmd12 ++;
+    card_send (0xff);
+    card_send (0x00);
+    card_send (0x00);
+    card_state = CARD_IDLE;
+    return;
+  }
+
+  card_send (0xff);
+  switch (cmd) {
+  case CMD_GO_IDLE_STATE:
+    card_send (1 << R1_IDLE_STATE);
+    break;
+  case CMD_APP:
+  case CMD_SD_SEND_OP_COND:
+  case CMD_SET_BLOCKLEN:
+    card_send (0x00);
+    break;
+  case CMD_READ_SINGLE_BLOCK:
+  case CMD_READ_MULTIPLE_BLOCK:
+    card_send (0x00);
+    card_address = arg;
+    card_send_block ();
+    if (cmd == CMD_READ_MULTIPLE_BLOCK) {
+      counters.cmd18 ++;
+      card_state = CARD_READING;
+    }
+    else
+      counters.cmd17 ++;
+    break;
+  case CMD_WRITE_SINGLE_BLOCK:
+  case CMD_WRITE_MULTIPLE_BLOCK:
+    card_send (0x00);
+    card_address = arg;
+    card_multi = cmd == CMD_WRITE_MULTIPLE_BLOCK;
+    if (card_multi)
+      counters.cmd25 ++;
+    else
+      counters.cmd24 ++;
+    card_state = CARD_WRITE_TOKEN;
+    break;
+  default:
+    card_send (1 << R1_ILL_COMMAND);
+    break;
+  }
+}
+
+uint8_t
+spi_send (uint8_t b)
+{
+  if (!card_selected)
+    return 0xff;
+
+  uint8_t reply = 0xff;
+  if (out_head < out_tail) {
+    if (out_head == out_token && b == 0xff)
+      counters.read ++;
+    reply = out[out_head ++];
+  }
+  else {
+    out_head = out_tail = 0;
+    out_token = -1;
+    if (card_state == CARD_READING)
+      card_send_block ();
+  }
+
+  switch (card_state) {
+  case CARD_WRITE_DATA:
+    data[data_len ++] = b;
+    if (data_len == sizeof (data)) {
+      if (card_address < CARD_SIZE)
+	memcpy (card + card_address, data, 512);
+      card_address += 512;
+      counters.written ++;
+      out_head = out_tail = 0;
+      out_token = -1;
+      card_send (0xe0 | DR_STATUS_ACCEPTED);
+      card_send (0x00);			/* busy */
+      card_state = card_multi ? CARD_WRITE_TOKEN : CARD_IDLE;
+    }
+    return reply;
+
+  case CARD_WRITE_TOKEN:
+    if (b == (card_multi ? 0xfc : 0xfe)) {
+      data_len = 0;
+      card_state = CARD_WRITE_DATA;
+    }
+    else if (b == 0xfd && card_multi) {
+      out_head = out_tail = 0;
+      card_send (0xff);
+      card_send (0x00);			/* busy */
+      card_state = CARD_IDLE;
+    }
+    return reply;
+  }
+
+  if (command_len == 0 && (b & 0xc0) != 0x40)
+    return reply;
+  command[command_len ++] = b;
+  if (command_len == sizeof (command)) {
+    command_len = 0;
+    card_command ();
+  }
+  return reply;
+}
+
+
+static unsigned failures;
+
+#define expect(cond) do { if (!(cond)) { \
+      printf ("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+      failures ++; } } while (0)
+
+static void
+reset_counters (const char *what)
+{
+  static const char *current;
+  if (current)
+    printf ("  %-24s CMD17 %3u  CMD18 %3u  CMD12 %3u  CMD24 %3u  CMD25 %3u"
+	    "  blocks read %3u written %3u\n", current, counters.cmd17,
+	    counters.cmd18, counters.cmd12, counters.cmd24, counters.cmd25,
+	    counters.read, counters.written);
+  memset (&counters, 0, sizeof (counters));
+  current = what;
+}
+
+static void
+read_check (uint32_t offset, uint16_t length)
+{
+  uint8_t buffer[1024];
+  expect (sd_raw_read (offset, buffer, length));
+  expect (memcmp (buffer, image + offset, length) == 0);
+}
+
+#if SD_RAW_WRITE_SUPPORT
+static void
+write_check (uint32_t offset, uint16_t length)
+{
+  uint8_t buffer[4096];
+  for (uint16_t i = 0; i < length; i ++)
+    buffer[i] = rand ();
+  memcpy (image + offset, buffer, length);
+  expect (sd_raw_write (offset, buffer, length));
+}
+
+static void
+sync_check (void)
+{
+  expect (sd_raw_sync ());
+  expect (memcmp (card, image, CARD_SIZE) == 0);
+  /* a multi-block write must be over */
+  expect (card_state == CARD_IDLE);
+}
+#endif
+
+int
+main (void)
+{
+  srand (1);
+  for (uint32_t i = 0; i < CARD_SIZE; i ++)
+    card[i] = image[i] = rand ();
+
+  expect (sd_raw_init ());
+
+  reset_counters ("sequential reads");
+  for (uint32_t offset = 512; offset < 41 * 512; offset += 100)
+    read_check (offset, 100);
+#ifdef SD_MULTIBLOCK_SUPPORT
+  expect (counters.cmd18 == 1);
+#endif
+
+  reset_counters ("file reads with FAT");
+  for (uint8_t cluster = 0; cluster < 10; cluster ++) {
+    read_check (64, 32);
+    read_check (2 * 512 + 5, 10);
+    for (uint16_t offset = 0; offset < 4 * 512; offset += 128)
+      read_check ((20 + cluster * 4) * 512 + offset, 128);
+  }
+#if SD_CACHE_BLOCKS >= 4
+  /* FAT and directory block stay cached */
+  expect (counters.read <= 40 + 2);
+#endif
+
+#ifdef SER_RAM_CACHE_SD
+  reset_counters ("file read");
+  for (uint32_t offset = 50 * 512; offset < 58 * 512; offset += 100)
+    read_check (offset, 100);
+  /* the last two blocks of the file are sent again */
+  reset_counters ("retransmit");
+  for (uint32_t offset = 56 * 512 + 50; offset < 58 * 512; offset += 300)
+    read_check (offset, 300);
+  expect (counters.read == 0);
+#endif
+
+  reset_counters ("random reads");
+  for (uint16_t i = 0; i < 200; i ++)
+    read_check (rand () % (CARD_SIZE - 600), 1 + rand () % 600);
+
+#if SD_RAW_WRITE_SUPPORT
+  reset_counters ("8 block write");
+  write_check (10 * 512, 4096);
+  sync_check ();
+  expect (counters.written == 8);
+#ifdef SD_MULTIBLOCK_SUPPORT
+  expect (counters.cmd25 == 1 && counters.cmd24 == 0);
+#else
+  expect (counters.cmd25 == 0);
+#endif
+
+  reset_counters ("8 single block writes");
+  for (uint8_t i = 0; i < 8; i ++)
+    write_check ((40 + i) * 512, 512);
+  sync_check ();
+  expect (counters.written == 8);
+#ifdef SD_MULTIBLOCK_SUPPORT
+  /* each block is buffered and flushed when the next one comes */
+  expect (counters.cmd25 == 1 && counters.cmd24 == 0);
+#endif
+
+  reset_counters ("appends of 128 bytes");
+  for (uint32_t offset = 20 * 512; offset < 36 * 512; offset += 128)
+    write_check (offset, 128);
+  sync_check ();
+  expect (counters.written == 16);
+
+  reset_counters ("random reads and writes");
+  for (uint16_t i = 0; i < 2000; i ++) {
+    uint32_t offset = rand () % (CARD_SIZE - 700);
+    uint16_t length = 1 + rand () % 700;
+    if (rand () & 1)
+      write_check (offset, length);
+    else
+      read_check (offset, length);
+    if (i % 97 == 0)
+      sync_check ();
+  }
+  sync_check ();
+#endif
+
+  reset_counters (NULL);
+  if (failures) {
+    printf ("sd_raw: %u failures\n", failures);
+    return 1;
+  }
+  return 0;
+}
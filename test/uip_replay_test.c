@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+
+/* Replays a packet trace through uip_input() with the connection tables
+   raised into the hundreds, as on a host build gateway.  The TCP
+   connections are opened first, then a trace of TCP segments to them,
+   to a closed port and UDP datagrams to bound ports is generated into
+   a buffer of pcap style records and replayed as fast as possible.
+   The Makefile builds it with and without UIP_HASH_SUPPORT, both check
+   that every packet reached its connection and print the time per
+   packet. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "protocols/uip/uip.c"
+
+#define LISTEN_PORT	8000		/* up to + UIP_LISTENPORTS */
+#define UDP_PORT	9000		/* up to + UIP_UDP_CONNS */
+#define CLOSED_PORT	7
+#define PACKETS		200000
+#define TCP_DATA	64
+#define UDP_DATA	32
+
+/* pcap record header, the packet follows */
+struct record {
+  uint32_t ts_sec, ts_usec, incl_len, orig_len;
+};
+
+static uint8_t *trace;
+static size_t trace_len;
+
+static unsigned failures;
+
+#define expect(cond) do { if (!(cond)) { \
+  printf ("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+  failures ++; } } while (0)
+
+/* what the peers sent, and what arrived */
+static uint32_t peer_seq[UIP_CONNS];
+static unsigned sent_tcp_bytes, sent_udp, sent_closed;
+static unsigned tcp_connected, tcp_bytes, udp_received, udp_polls;
+static unsigned resets, frames;
+static uint32_t last_seqno;
+
+static uint32_t
+get32 (const uint8_t *p)
+{
+  return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static void
+put32 (uint8_t *p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static void
+tcp_callback (void)
+{
+  if (uip_connected ())
+    tcp_connected ++;
+  if (uip_newdata ())
+    tcp_bytes += uip_datalen ();
+}
+
+static void
+udp_callback (void)
+{
+  if (uip_poll ())
+    udp_polls ++;
+  else if (uip_newdata ())
+    udp_received ++;
+}
+
+/* router_output_ll(), remembers what uIP answered */
+uint8_t
+tap_txstart (void)
+{
+  frames ++;
+  if (BUF->proto == UIP_PROTO_TCP)
+    {
+      last_seqno = get32 (BUF->seqno);
+      if (BUF->flags & TCP_RST)
+	resets ++;
+    }
+  return 0;
+}
+
+/* the remote end of TCP connection or UDP socket n */
+static void
+peer_address (uint16_t n)
+{
+  uip_ipaddr (BUF->srcipaddr, 10, 1, n >> 8, n & 0xff);
+  uip_ipaddr_copy (BUF->destipaddr, uip_hostaddr);
+}
+
+static void
+ip_header (uint8_t proto)
+{
+  BUF->vhl = 0x45;
+  BUF->ttl = 64;
+  BUF->proto = proto;
+  BUF->len[0] = uip_len >> 8;
+  BUF->len[1] = uip_len & 0xff;
+  BUF->ipchksum = ~uip_ipchksum ();
+}
+
+/* Builds a TCP segment from connection n's peer in uip_buf */
+static void
+build_tcp (uint16_t n, uint16_t lport, uint32_t seqno, uint32_t ackno,
+	   uint8_t flags, uint16_t len)
+{
+  memset (BUF, 0, UIP_IPTCPH_LEN);
+  uip_len = UIP_IPTCPH_LEN + len;
+  peer_address (n);
+  BUF->srcport = HTONS (1024 + n);
+  BUF->destport = HTONS (lport);
+  put32 (BUF->seqno, seqno);
+  put32 (BUF->ackno, ackno);
+  BUF->tcpoffset = 5 << 4;
+  BUF->flags = flags;
+  BUF->wnd[0] = 0x10;
+  for (uint16_t i = 0; i < len; i ++)
+    uip_buf[UIP_LLH_LEN + UIP_IPTCPH_LEN + i] = seqno + i;
+  ip_header (UIP_PROTO_TCP);
+  BUF->tcpchksum = ~uip_tcpchksum ();
+}
+
+/* Builds a UDP datagram to socket n in uip_buf */
+static void
+build_udp (uint16_t n, uint16_t len)
+{
+  memset (UDPBUF, 0, UIP_IPUDPH_LEN);
+  uip_len = UIP_IPUDPH_LEN + len;
+  peer_address (n);
+  UDPBUF->srcport = HTONS (1024 + n);
+  UDPBUF->destport = HTONS (UDP_PORT + n);
+  UDPBUF->udplen = HTONS (UIP_UDPH_LEN + len);
+  memset (&uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN], n, len);
+  ip_header (UIP_PROTO_UDP);
+  UDPBUF->udpchksum = ~uip_udpchksum ();
+  if (UDPBUF->udpchksum == 0)
+    UDPBUF->udpchksum = 0xffff;
+}
+
+static void
+deliver (void)
+{
+  router_input (0);
+  if (uip_len > 0)
+    router_output ();
+}
+
+/* Appends the packet in uip_buf to the trace */
+static void
+record (uint32_t usec)
+{
+  struct record *r = (struct record *) (trace + trace_len);
+
+  r->ts_sec = usec / 1000000;
+  r->ts_usec = usec % 1000000;
+  r->incl_len = r->orig_len = uip_len;
+  memcpy (r + 1, &uip_buf[UIP_LLH_LEN], uip_len);
+  trace_len += sizeof (*r) + uip_len;
+}
+
+static void
+replay (void)
+{
+  size_t pos = 0;
+
+  while (pos < trace_len)
+    {
+      struct record *r = (struct record *) (trace + pos);
+
+      memcpy (&uip_buf[UIP_LLH_LEN], r + 1, r->incl_len);
+      uip_len = r->incl_len;
+      deliver ();
+      pos += sizeof (*r) + r->incl_len;
+    }
+}
+
+int
+main (void)
+{
+  uip_ipaddr_t ip;
+  struct timespec start, end;
+  unsigned ns;
+
+  uip_init ();
+  uip_ipaddr (ip, 10, 0, 0, 1);
+  uip_sethostaddr (ip);
+  uip_ipaddr (ip, 255, 0, 0, 0);
+  uip_setnetmask (ip);
+
+  for (uint16_t i = 0; i < UIP_LISTENPORTS; i ++)
+    uip_listen (HTONS (LISTEN_PORT + i), tcp_callback);
+
+  /* open all TCP connections */
+  for (uint16_t n = 0; n < UIP_CONNS; n ++)
+    {
+      uint16_t lport = LISTEN_PORT + n % UIP_LISTENPORTS;
+
+      peer_seq[n] = n * 100000;
+      build_tcp (n, lport, peer_seq[n] ++, 0, TCP_SYN, 0);
+      deliver ();
+      build_tcp (n, lport, peer_seq[n], last_seqno + 1, TCP_ACK, 0);
+      deliver ();
+    }
+  expect (tcp_connected == UIP_CONNS);
+
+  for (uint16_t n = 0; n < UIP_UDP_CONNS; n ++)
+    {
+      uip_udp_conn_t *conn = uip_udp_new (NULL, 0, udp_callback);
+      expect (conn != NULL);
+      if (conn)
+	uip_udp_bind (conn, HTONS (UDP_PORT + n));
+    }
+  uip_udp_timer ();
+  expect (udp_polls == UIP_UDP_CONNS);
+
+  /* generate the trace: 60% TCP data, 30% UDP, 10% to a closed port */
+  trace = malloc (PACKETS * (sizeof (struct record) + UIP_IPTCPH_LEN
+			     + TCP_DATA));
+  srand (1);
+  for (uint32_t i = 0; i < PACKETS; i ++)
+    {
+      int kind = rand () % 10;
+      uint16_t n;
+
+      if (kind < 6)
+	{
+	  n = rand () % UIP_CONNS;
+	  build_tcp (n, LISTEN_PORT + n % UIP_LISTENPORTS, peer_seq[n], 1,
+		     TCP_ACK | TCP_PSH, TCP_DATA);
+	  peer_seq[n] += TCP_DATA;
+	  sent_tcp_bytes += TCP_DATA;
+	}
+      else if (kind < 9)
+	{
+	  build_udp (rand () % UIP_UDP_CONNS, UDP_DATA);
+	  sent_udp ++;
+	}
+      else
+	{
+	  build_tcp (rand () % UIP_CONNS, CLOSED_PORT, 1, 1, TCP_ACK, 0);
+	  sent_closed ++;
+	}
+      record (i * 10);
+    }
+
+  frames = resets = 0;
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  replay ();
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  ns = ((end.tv_sec - start.tv_sec) * 1000000000LL
+	+ end.tv_nsec - start.tv_nsec) / PACKETS;
+
+  expect (tcp_bytes == sent_tcp_bytes);
+  expect (udp_received == sent_udp);
+  expect (resets == sent_closed);
+  expect (frames == sent_tcp_bytes / TCP_DATA + sent_closed);
+
+  printf ("  %u packets, %u TCP connections, %u UDP sockets: %u ns per packet\n",
+	  PACKETS, UIP_CONNS, UIP_UDP_CONNS, ns);
+
+  if (failures)
+    {
+      printf ("uip_replay: %u failures\n", failures);
+      return 1;
+    }
+  return 0;
+}
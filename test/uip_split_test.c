@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+
+/* Measures a bulk TCP transfer from uIP to a peer doing delayed ACKs,
+   the case uip_split_output() is for.  uip.c runs on the TAP link, the
+   frames it sends are checked (checksums, sequence numbers, payload)
+   and delivered to a simulated peer over a 10 Mbit/s full duplex link.
+   The peer acknowledges every second segment at once and a single one
+   after 200ms, as common TCP stacks do.  Time is simulated, the AVR's
+   own processing time is not accounted for.  The Makefile builds it
+   with and without TCP_SPLIT_SUPPORT, both print the throughput. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "protocols/uip/uip.c"
+
+#define TOTAL		65536		/* bytes to transfer */
+#define PORT		2701
+#define LATENCY		100		/* µs one way, plus the wire time */
+#define DELACK		200000		/* µs, the peer's delayed ACK */
+#define TIMER		200000		/* µs, uip_tcp_timer() */
+#define LIMIT		60000000	/* µs to give up after */
+#define PEER_ISS	0x10000000UL
+
+#define QUEUE		16
+
+/* A segment on the wire, the payload is checked when sent */
+struct segment {
+  uint32_t arrival, seqno, ackno;
+  uint16_t len;
+  uint8_t flags;
+};
+
+struct link {
+  struct segment queue[QUEUE];
+  uint8_t head, count;
+  uint32_t free;			/* wire busy until */
+};
+
+static struct link to_peer, to_uip;
+static uint32_t now;
+
+static unsigned failures;
+
+#define expect(cond) do { if (!(cond)) { \
+  printf ("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+  failures ++; } } while (0)
+
+/* the sender */
+static uint32_t app_acked, app_outstanding;
+static unsigned app_sends, app_rexmits;
+
+/* the peer */
+static uint32_t uip_iss, rcv_nxt, first_data, last_data;
+static uint32_t delack_due;		/* 0 if no ACK is pending */
+static uint8_t unacked, connected;
+static unsigned segments, delayed_acks, immediate_acks, out_of_order;
+
+static uint32_t
+get32 (const uint8_t *p)
+{
+  return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static void
+put32 (uint8_t *p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static void
+link_send (struct link *link, uint32_t seqno, uint32_t ackno, uint16_t len,
+	   uint8_t flags)
+{
+  struct segment *s;
+
+  expect (link->count < QUEUE);
+  if (link->count == QUEUE)
+    return;
+  s = &link->queue[(link->head + link->count ++) % QUEUE];
+
+  /* Ethernet header, FCS, preamble and gap: 38 bytes, 0.8µs/byte */
+  if (link->free < now)
+    link->free = now;
+  link->free += (UIP_IPTCPH_LEN + len + 38) * 8 / 10;
+  s->arrival = link->free + LATENCY;
+  s->seqno = seqno;
+  s->ackno = ackno;
+  s->len = len;
+  s->flags = flags;
+}
+
+/* The sending application */
+static void
+app_callback (void)
+{
+  if (uip_acked ())
+    {
+      app_acked += app_outstanding;
+      app_outstanding = 0;
+    }
+  if (uip_rexmit ())
+    app_rexmits ++;
+  else if (app_outstanding || app_acked == TOTAL)
+    return;
+  else
+    {
+      app_outstanding = TOTAL - app_acked;
+      if (app_outstanding > uip_mss ())
+	app_outstanding = uip_mss ();
+      app_sends ++;
+    }
+
+  for (uint16_t i = 0; i < app_outstanding; i ++)
+    ((uint8_t *) uip_appdata)[i] = app_acked + i;
+  uip_send (uip_appdata, app_outstanding);
+}
+
+/* router_output_ll(), checks the frame in uip_buf and puts it on the
+   wire to the peer */
+uint8_t
+tap_txstart (void)
+{
+  uint16_t hdrlen = UIP_IPH_LEN + ((BUF->tcpoffset >> 4) << 2);
+  uint16_t len = uip_len - hdrlen;
+  uint32_t seqno = get32 (BUF->seqno);
+  uint8_t *data = &uip_buf[UIP_LLH_LEN + hdrlen];
+
+  expect (BUF->proto == UIP_PROTO_TCP);
+  expect ((BUF->len[0] << 8 | BUF->len[1]) == uip_len);
+  expect (uip_ipchksum () == 0xffff);
+  expect (uip_tcpchksum () == 0xffff);
+
+  if (BUF->flags & TCP_SYN)
+    uip_iss = seqno;
+  else
+    for (uint16_t i = 0; i < len; i ++)
+      if (data[i] != (uint8_t) (seqno - uip_iss - 1 + i))
+	{
+	  expect (data[i] == (uint8_t) (seqno - uip_iss - 1 + i));
+	  break;
+	}
+
+  link_send (&to_peer, seqno, get32 (BUF->ackno), len, BUF->flags);
+  return 0;
+}
+
+/* A segment from the peer, built in uip_buf and passed to uip_input() */
+static void
+uip_deliver (struct segment *s)
+{
+  memset (BUF, 0, UIP_IPTCPH_LEN + 4);
+  uip_len = UIP_IPTCPH_LEN;
+  BUF->vhl = 0x45;
+  BUF->ttl = 64;
+  BUF->proto = UIP_PROTO_TCP;
+  uip_ipaddr (BUF->srcipaddr, 10, 0, 0, 2);
+  uip_ipaddr_copy (BUF->destipaddr, uip_hostaddr);
+  BUF->srcport = HTONS (40000);
+  BUF->destport = HTONS (PORT);
+  put32 (BUF->seqno, s->seqno);
+  put32 (BUF->ackno, s->ackno);
+  BUF->tcpoffset = 5 << 4;
+  BUF->flags = s->flags;
+  BUF->wnd[0] = 0xff;
+  BUF->wnd[1] = 0xff;
+  if (s->flags & TCP_SYN)
+    {
+      /* MSS option, 1460 */
+      BUF->tcpoffset = 6 << 4;
+      BUF->optdata[0] = TCP_OPT_MSS;
+      BUF->optdata[1] = TCP_OPT_MSS_LEN;
+      BUF->optdata[2] = 1460 >> 8;
+      BUF->optdata[3] = 1460 & 0xff;
+      uip_len += 4;
+    }
+  BUF->len[0] = uip_len >> 8;
+  BUF->len[1] = uip_len & 0xff;
+  BUF->ipchksum = ~uip_ipchksum ();
+  BUF->tcpchksum = ~uip_tcpchksum ();
+
+  router_input (0);
+  if (uip_len > 0)
+    router_output ();
+}
+
+static void
+peer_ack (void)
+{
+  link_send (&to_uip, PEER_ISS + 1, rcv_nxt, 0, TCP_ACK);
+  delack_due = 0;
+  unacked = 0;
+}
+
+/* A segment from uIP arrives at the peer */
+static void
+peer_deliver (struct segment *s)
+{
+  if (s->flags & TCP_SYN)
+    {
+      expect (s->ackno == PEER_ISS + 1);
+      rcv_nxt = s->seqno + 1;
+      connected = 1;
+      peer_ack ();
+      return;
+    }
+  if (s->len == 0)
+    return;
+
+  segments ++;
+  if (s->seqno != rcv_nxt)
+    {
+      out_of_order ++;
+      immediate_acks ++;
+      peer_ack ();
+      return;
+    }
+
+  if (first_data == 0)
+    first_data = now;
+  rcv_nxt += s->len;
+  if (rcv_nxt - uip_iss - 1 == TOTAL)
+    last_data = now;
+
+  if (++ unacked >= 2)
+    {
+      immediate_acks ++;
+      peer_ack ();
+    }
+  else if (delack_due == 0)
+    delack_due = now + DELACK;
+}
+
+static struct segment *
+link_next (struct link *link)
+{
+  return link->count ? &link->queue[link->head] : NULL;
+}
+
+static void
+link_pop (struct link *link)
+{
+  link->head = (link->head + 1) % QUEUE;
+  link->count --;
+}
+
+int
+main (void)
+{
+  uip_ipaddr_t ip;
+  uint32_t timer_due = TIMER;
+
+  uip_init ();
+  uip_ipaddr (ip, 10, 0, 0, 1);
+  uip_sethostaddr (ip);
+  uip_ipaddr (ip, 255, 255, 255, 0);
+  uip_setnetmask (ip);
+  uip_listen (HTONS (PORT), app_callback);
+
+  link_send (&to_uip, PEER_ISS, 0, 0, TCP_SYN);
+
+  while (last_data == 0 && now < LIMIT)
+    {
+      struct segment *p = link_next (&to_peer);
+      struct segment *u = link_next (&to_uip);
+
+      /* the next event */
+      now = timer_due;
+      if (delack_due && delack_due < now)
+	now = delack_due;
+      if (p && p->arrival < now)
+	now = p->arrival;
+      if (u && u->arrival < now)
+	now = u->arrival;
+
+      if (p && p->arrival == now)
+	{
+	  peer_deliver (p);
+	  link_pop (&to_peer);
+	}
+      else if (u && u->arrival == now)
+	{
+	  uip_deliver (u);
+	  link_pop (&to_uip);
+	}
+      else if (delack_due == now)
+	{
+	  delayed_acks ++;
+	  peer_ack ();
+	}
+      else
+	{
+	  uip_tcp_timer ();
+	  timer_due += TIMER;
+	}
+    }
+
+  expect (connected);
+  expect (last_data != 0);
+  expect (out_of_order == 0);
+  expect (app_rexmits == 0);
+#ifdef TCP_SPLIT_SUPPORT
+  /* every segment goes out in two halves, the peer ACKs them at once */
+  expect (segments == 2 * app_sends);
+  expect (delayed_acks == 0);
+#else
+  expect (segments == app_sends);
+#endif
+
+  if (last_data > first_data)
+    printf ("  %u bytes in %u segments in %u ms, %u KB/s, "
+	    "%u delayed ACKs\n", TOTAL, segments,
+	    (unsigned) ((last_data - first_data) / 1000),
+	    (unsigned) ((uint64_t) TOTAL * 1000000 / 1024
+			/ (last_data - first_data)), delayed_acks);
+
+  if (failures)
+    {
+      printf ("uip_split: %u failures\n", failures);
+      return 1;
+    }
+  return 0;
+}
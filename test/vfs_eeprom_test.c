@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+/* Runs vfs_eeprom.c, vfs_eeprom_raw.c and i2c_24CXX.c against a 24C256
+   simulated at the level of I2C transactions.  The simulation counts
+   transactions, bytes on the bus and page write cycles, and keeps the
+   device busy (not acknowledging) for a few polls after each write.
+   Files are written and read back, with a simulated reset in between:
+   everything written must already be in the EEPROM when a call
+   returns.  The Makefile builds it with and without the line cache. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hardware/i2c/master/i2c_24CXX.c"
+#include "hardware/i2c/master/vfs_eeprom.c"
+#include "hardware/i2c/master/vfs_eeprom_raw.c"
+
+#define EEPROM_SIZE	32768
+#define EEPROM_PAGE	CONF_I2C_24CXX_PAGESIZE
+#define WRITE_POLLS	5	/* not acknowledged after a write */
+
+static uint8_t eeprom[EEPROM_SIZE];
+static uint16_t eeprom_pointer;
+static uint8_t eeprom_busy;
+
+static struct {
+  unsigned transactions, nacks, bytes, write_cycles;
+} counters;
+
+static unsigned failures;
+
+#define expect(cond) do { if (!(cond)) { \
+  printf ("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+  failures ++; } } while (0)
+
+/* One transaction with the simulated EEPROM, 1 if it was acknowledged.
+   Writes wrap around inside the EEPROM page, like the real device. */
+static uint8_t
+eeprom_transaction (uint8_t address, uint8_t *wbuf, uint8_t wlen,
+		    uint8_t *rbuf, uint8_t rlen)
+{
+  counters.transactions ++;
+  counters.bytes += 1 + wlen + (rlen ? 1 + rlen : 0);
+  if (address != I2C_SLA_24CXX || eeprom_busy)
+    {
+      if (eeprom_busy)
+	eeprom_busy --;
+      counters.nacks ++;
+      return 0;
+    }
+
+  if (wlen >= 2)
+    eeprom_pointer = (wbuf[0] << 8 | wbuf[1]) % EEPROM_SIZE;
+  if (wlen > 2)
+    {
+      uint16_t page = eeprom_pointer - eeprom_pointer % EEPROM_PAGE;
+      for (uint8_t i = 2; i < wlen; i ++)
+	{
+	  eeprom[eeprom_pointer] = wbuf[i];
+	  eeprom_pointer = page + (eeprom_pointer + 1) % EEPROM_PAGE;
+	}
+      counters.write_cycles ++;
+      eeprom_busy = WRITE_POLLS;
+    }
+  for (uint8_t i = 0; i < rlen; i ++)
+    {
+      rbuf[i] = eeprom[eeprom_pointer];
+      eeprom_pointer = (eeprom_pointer + 1) % EEPROM_SIZE;
+    }
+  return 1;
+}
+
+/* The I2C master queue, run by i2c_master_wait_idle() instead of the
+   TWI interrupt */
+static i2c_request_t *queue_head, *queue_tail;
+static i2c_request_t *done_head, *done_tail;
+
+uint8_t
+i2c_master_detect (uint8_t range_start, uint8_t range_end)
+{
+  return I2C_SLA_24CXX;
+}
+
+void
+i2c_master_enqueue (i2c_request_t *req)
+{
+  req->next = NULL;
+  req->status = I2C_REQ_QUEUED;
+  if (queue_head)
+    queue_tail->next = req;
+  else
+    queue_head = req;
+  queue_tail = req;
+}
+
+void
+i2c_master_wait_idle (void)
+{
+  while (queue_head)
+    {
+      i2c_request_t *req = queue_head;
+      queue_head = req->next;
+      req->next = NULL;
+      req->status = eeprom_transaction (req->address, req->wbuf, req->wlen,
+					req->rbuf, req->rlen)
+	? I2C_REQ_DONE : I2C_REQ_ERROR;
+      if (req->callback)
+	{
+	  if (done_head)
+	    done_tail->next = req;
+	  else
+	    done_head = req;
+	  done_tail = req;
+	}
+    }
+}
+
+void
+i2c_master_process (void)
+{
+  while (done_head)
+    {
+      i2c_request_t *req = done_head;
+      done_head = req->next;
+      req->next = NULL;
+      req->callback (req);
+    }
+}
+
+uint8_t
+i2c_master_transfer (uint8_t address, uint8_t *wbuf, uint8_t wlen,
+		     uint8_t *rbuf, uint8_t rlen)
+{
+  i2c_master_wait_idle ();
+  return eeprom_transaction (address, wbuf, wlen, rbuf, rlen);
+}
+
+/* One pass of the mainloop: the bus and the callbacks make progress */
+static void
+mainloop (void)
+{
+  i2c_master_wait_idle ();
+  i2c_master_process ();
+}
+
+/* A reset: the RAM contents are gone, the EEPROM keeps what it got */
+static void
+reset (void)
+{
+  mainloop ();
+#if SFS_CACHE_LINES > 0
+  memset (vfs_eeprom_cache, 0xff, sizeof (vfs_eeprom_cache));
+#endif
+  i2c_24cxx_writing = 0;
+  eeprom_busy = 0;
+  vfs_eeprom_init ();
+}
+
+#define FILE_SIZE 1000
+
+static uint8_t content[FILE_SIZE];
+
+static void
+check_file (const char *name, vfs_size_t chunk)
+{
+  static uint8_t buf[FILE_SIZE];
+  struct vfs_file_handle_t *handle = vfs_eeprom_open (name);
+
+  expect (handle != NULL);
+  if (!handle)
+    return;
+  expect (vfs_eeprom_filesize (handle) == FILE_SIZE);
+
+  vfs_size_t pos = 0;
+  while (pos < FILE_SIZE)
+    {
+      vfs_size_t len = vfs_eeprom_read (handle, buf + pos, chunk);
+      if (!len)
+	break;
+      pos += len;
+    }
+  expect (pos == FILE_SIZE);
+  expect (memcmp (buf, content, FILE_SIZE) == 0);
+  vfs_eeprom_close (handle);
+}
+
+int
+main (void)
+{
+  memset (eeprom, 0xff, sizeof (eeprom));
+  for (unsigned i = 0; i < FILE_SIZE; i ++)
+    content[i] = i * 7 + i / 251;
+
+  /* the write cycle is polled in the background, the next access
+     waits for it */
+  i2c_24CXX_init ();
+  uint8_t byte = 0x5a;
+  expect (i2c_24CXX_write_block (100, &byte, 1) == 1);
+  expect (eeprom_busy && i2c_24cxx_writing);
+  mainloop ();
+  expect (eeprom_busy && i2c_24cxx_writing);
+  while (i2c_24cxx_writing)
+    mainloop ();
+  expect (!eeprom_busy && eeprom[100] == 0x5a);
+  expect (i2c_24CXX_write_block (100, &byte, 1) == 1);
+  byte = 0;
+  expect (i2c_24CXX_read_block (100, &byte, 1) == 1);
+  expect (byte == 0x5a && !i2c_24cxx_writing);
+  memset (eeprom, 0xff, sizeof (eeprom));
+
+  /* format */
+  vfs_eeprom_init ();
+  reset ();
+  expect (eeprom[0] == SFS_MAGIC_SUPERBLOCK);
+
+  /* written in chunks crossing EEPROM and filesystem pages, without a
+     close before the reset */
+  struct vfs_file_handle_t *handle = vfs_eeprom_create ("index.html");
+  expect (handle != NULL);
+  memset (&counters, 0, sizeof (counters));
+  for (vfs_size_t pos = 0; handle && pos < FILE_SIZE; pos += 37)
+    {
+      vfs_size_t len = FILE_SIZE - pos < 37 ? FILE_SIZE - pos : 37;
+      expect (vfs_eeprom_write (handle, content + pos, len) == len);
+    }
+  printf ("  write: %u transactions, %u write cycles, %u polls NACKed\n",
+	  counters.transactions, counters.write_cycles, counters.nacks);
+  free (handle);
+  reset ();
+
+  memset (&counters, 0, sizeof (counters));
+  check_file ("index.html", 50);
+  printf ("  sequential read: %u transactions, %u bytes\n",
+	  counters.transactions, counters.bytes);
+#if SFS_CACHE_LINES > 0
+  /* the size and the data each take one transaction per line, plus
+     the file and superblock pages */
+  expect (counters.transactions
+	  <= 2 * ((FILE_SIZE / (SFS_PAGE_SIZE - 4) + 1) / SFS_CACHE_LINE_PAGES)
+	  + 4);
+#endif
+
+  /* a second file in front of the first one's data doesn't disturb it */
+  handle = vfs_eeprom_create ("other");
+  expect (handle != NULL);
+  if (handle)
+    {
+      expect (vfs_eeprom_write (handle, "hello", 5) == 5);
+      free (handle);
+    }
+  reset ();
+  check_file ("index.html", 333);
+
+  /* raw writes are seen by the filesystem */
+  handle = vfs_eeprom_open ("index.html");
+  expect (handle != NULL);
+  if (handle)
+    {
+      uint8_t buf[SFS_PAGE_SIZE];
+      vfs_eeprom_inode_t page = handle->u.ee.file_page;
+      check_file ("index.html", FILE_SIZE);	/* page is cached now */
+
+      struct vfs_file_handle_t *raw = vfs_eeprom_raw_open ("1");
+      expect (raw != NULL);
+      raw->u.ee_raw.inode = page;
+      vfs_eeprom_read_page (page, buf, SFS_PAGE_SIZE);
+      strcpy (((struct vfs_eeprom_page_file *) buf)->filename, "renamed");
+      expect (vfs_eeprom_raw_write (raw, buf, SFS_PAGE_SIZE)
+	      == SFS_PAGE_SIZE);
+      vfs_eeprom_raw_close (raw);
+      vfs_eeprom_close (handle);
+
+      expect (vfs_eeprom_open ("index.html") == NULL);
+      check_file ("renamed", 100);
+    }
+
+  if (failures)
+    {
+      printf ("vfs_eeprom: %u failures\n", failures);
+      return 1;
+    }
+  return 0;
+}
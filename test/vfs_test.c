@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2026 by Ethersex Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+
+/* Runs the name routing and the lookup cache of core/vfs/vfs.c against
+   three fake backends standing in for "ee", "sd" and "inline".  The
+   fakes know a list of names each and count how often they are asked
+   for a file, so the tests can check which backends a lookup probed:
+   prefixed names go to their backend only, the search order is kept,
+   hits and misses are answered from the cache until they expire or a
+   file is created, and two names with the same FNV-1a hash are told
+   apart. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/vfs/vfs.h"
+
+#define FAKE_FILES	4
+
+struct fake {
+  const char *files[FAKE_FILES];
+  unsigned probes, creates;
+};
+
+static struct fake fakes[VFS_LAST];
+
+static struct vfs_file_handle_t *
+fake_open (uint8_t type, const char *name)
+{
+  struct vfs_file_handle_t *fh;
+
+  fakes[type].probes ++;
+  for (uint8_t i = 0; i < FAKE_FILES; i ++)
+    if (fakes[type].files[i] && strcmp (fakes[type].files[i], name) == 0)
+      {
+	fh = malloc (sizeof (*fh));
+	fh->fh_type = type;
+	return fh;
+      }
+
+  return NULL;
+}
+
+static struct vfs_file_handle_t *
+fake_create (uint8_t type, const char *name)
+{
+  fakes[type].creates ++;
+  for (uint8_t i = 0; i < FAKE_FILES; i ++)
+    if (fakes[type].files[i] == NULL)
+      {
+	fakes[type].files[i] = strdup (name);
+	return fake_open (type, name);
+      }
+
+  return NULL;
+}
+
+static void
+fake_close (struct vfs_file_handle_t *fh)
+{
+  free (fh);
+}
+
+#define FAKE(name, type) \
+  static struct vfs_file_handle_t * \
+  fake_ ## name ## _open (const char *filename) \
+  { return fake_open (type, filename); } \
+  static struct vfs_file_handle_t * \
+  fake_ ## name ## _create (const char *filename) \
+  { return fake_create (type, filename); }
+
+FAKE (ee, VFS_EEPROM)
+FAKE (sd, VFS_SD)
+FAKE (inline, VFS_INLINE)
+
+#define FAKE_FUNCS(name) { #name, fake_ ## name ## _open, fake_close, \
+    NULL, NULL, NULL, NULL, fake_ ## name ## _create, NULL, NULL }
+
+#undef VFS_EEPROM_FUNCS
+#undef VFS_SD_FUNCS
+#undef VFS_INLINE_FUNCS
+#define VFS_EEPROM_FUNCS	FAKE_FUNCS (ee)
+#define VFS_SD_FUNCS		FAKE_FUNCS (sd)
+#define VFS_INLINE_FUNCS	FAKE_FUNCS (inline)
+
+#include "core/vfs/vfs.c"
+
+static unsigned failures;
+
+#define expect(cond) do { if (!(cond)) { \
+  printf ("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+  failures ++; } } while (0)
+
+/* Opens NAME, returns the backend it was found on or -1, and puts the
+   number of probed backends into *PROBES. */
+static int
+lookup (const char *name, unsigned *probes)
+{
+  struct vfs_file_handle_t *fh;
+  int type = -1;
+
+  for (uint8_t i = 0; i < VFS_LAST; i ++)
+    fakes[i].probes = 0;
+
+  fh = vfs_open (name);
+  if (fh)
+    {
+      type = fh->fh_type;
+      vfs_close (fh);
+    }
+
+  *probes = 0;
+  for (uint8_t i = 0; i < VFS_LAST; i ++)
+    *probes += fakes[i].probes;
+  return type;
+}
+
+static uint32_t
+fnv (const char *name)
+{
+  uint32_t hash = 2166136261UL;
+  while (*name)
+    hash = (hash ^ (uint8_t) *name ++) * 16777619UL;
+  return hash;
+}
+
+struct name_hash {
+  uint32_t hash, n;
+};
+
+static int
+name_hash_cmp (const void *a, const void *b)
+{
+  const struct name_hash *x = a, *y = b;
+  return x->hash < y->hash ? -1 : x->hash > y->hash;
+}
+
+/* Finds two names of the same length with the same FNV-1a hash */
+static void
+find_collision (char *a, char *b)
+{
+  const uint32_t count = 1 << 20;
+  struct name_hash *names = malloc (count * sizeof (*names));
+  char name[16];
+
+  for (uint32_t n = 0; n < count; n ++)
+    {
+      sprintf (name, "f%07u.txt", n);
+      names[n].hash = fnv (name);
+      names[n].n = n;
+    }
+  qsort (names, count, sizeof (*names), name_hash_cmp);
+
+  for (uint32_t i = 1; i < count; i ++)
+    if (names[i].hash == names[i - 1].hash)
+      {
+	sprintf (a, "f%07u.txt", names[i - 1].n);
+	sprintf (b, "f%07u.txt", names[i].n);
+	break;
+      }
+  free (names);
+}
+
+int
+main (void)
+{
+  char a[16] = "", b[16] = "";
+  unsigned probes;
+
+  fakes[VFS_EEPROM].files[0] = "config";
+  fakes[VFS_SD].files[0] = "index.html";
+  fakes[VFS_SD].files[1] = "log.txt";
+  fakes[VFS_INLINE].files[0] = "index.html";
+  fakes[VFS_INLINE].files[1] = "style.css";
+
+  /* prefixed names go to that backend only */
+  expect (lookup ("sd:index.html", &probes) == VFS_SD && probes == 1);
+  expect (lookup ("ee:config", &probes) == VFS_EEPROM && probes == 1);
+  expect (lookup ("ee:log.txt", &probes) == -1 && probes == 1);
+
+  /* the search order is "inline sd", ee is reachable by prefix only */
+  expect (lookup ("index.html", &probes) == VFS_INLINE && probes == 1);
+  expect (lookup ("log.txt", &probes) == VFS_SD && probes == 2);
+  expect (lookup ("config", &probes) == -1 && probes == 2);
+
+  /* answered from the cache: hits probe their backend, misses nothing */
+  expect (lookup ("log.txt", &probes) == VFS_SD && probes == 1);
+  expect (lookup ("config", &probes) == -1 && probes == 0);
+  expect (lookup ("missing", &probes) == -1 && probes == 2);
+  expect (lookup ("missing", &probes) == -1 && probes == 0);
+
+  /* a file that appears behind the cache's back shows up on expiry */
+  fakes[VFS_SD].files[2] = "missing";
+  for (uint8_t i = 0; i < VFS_LOOKUP_CACHE_TTL - 1; i ++)
+    vfs_lookup_periodic ();
+  expect (lookup ("missing", &probes) == -1 && probes == 0);
+  vfs_lookup_periodic ();
+  expect (lookup ("missing", &probes) == VFS_SD && probes == 2);
+
+  /* creating a file flushes the cache, the first backend in the search
+     order that can create files gets it */
+  expect (lookup ("new.txt", &probes) == -1 && probes == 2);
+  struct vfs_file_handle_t *fh = vfs_create ("new.txt");
+  expect (fh != NULL && fh->fh_type == VFS_INLINE);
+  if (fh)
+    vfs_close (fh);
+  expect (lookup ("new.txt", &probes) == VFS_INLINE && probes == 1);
+
+  /* a file gone from its backend is searched for again */
+  expect (lookup ("log.txt", &probes) == VFS_SD && probes == 2);
+  fakes[VFS_SD].files[1] = NULL;
+  fakes[VFS_INLINE].files[3] = "log.txt";
+  expect (lookup ("log.txt", &probes) == VFS_INLINE && probes == 2);
+
+  /* more names than cache entries */
+  for (uint8_t round = 0; round < 2; round ++)
+    for (uint8_t i = 0; i < VFS_LOOKUP_CACHE_LEN + 2; i ++)
+      {
+	char name[8];
+	sprintf (name, "x%u", i);
+	expect (lookup (name, &probes) == -1);
+      }
+
+  /* a cached miss must not hide a file whose name has the same hash */
+  find_collision (a, b);
+  expect (*a && *b && strcmp (a, b) && fnv (a) == fnv (b));
+  fakes[VFS_SD].files[3] = b;
+  expect (lookup (a, &probes) == -1 && probes == 2);
+  expect (lookup (b, &probes) == VFS_SD);
+  expect (lookup (a, &probes) == -1);
+
+  if (failures)
+    {
+      printf ("vfs: %u failures\n", failures);
+      return 1;
+    }
+  printf ("  %s and %s collide in FNV-1a\n", a, b);
+  return 0;
+}